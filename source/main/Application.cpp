@@ -62,6 +62,7 @@ static int              g_app_state_pending;     ///< Requested state change
 static std::string      g_app_language;          ///< Config: STR Language
 static std::string      g_app_locale;            ///< Config: STR Language Short
 static bool             g_app_multithread;       ///< Config: STR Multi-threading
+static int              g_app_exit_code;         ///< Returned from main()
 static std::string      g_app_screenshot_format; ///< Config: STR Screenshot Format
 
 // Simulation
@@ -228,6 +229,7 @@ bool            GetDiagEnvmap              () { return g_diag_envmap
 STR_CREF        GetAppLanguage             () { return g_app_language;             }
 STR_CREF        GetAppLocale               () { return g_app_locale;               }
 bool            GetAppMultithread          () { return g_app_multithread;          }
+int             GetAppExitCode             () { return g_app_exit_code;            }
 STR_CREF        GetAppScreenshotFormat     () { return g_app_screenshot_format;    }
 IoInputGrabMode GetIoInputGrabMode         () { return (IoInputGrabMode)g_io_input_grab_mode ; }
 bool            GetIoArcadeControls        () { return g_io_arcade_controls;       }
@@ -309,6 +311,7 @@ void SetDiagEnvmap           (bool            v) { SetVarBool    (g_diag_envmap
 void SetAppLanguage          (STR_CREF        v) { SetVarStr     (g_app_language         , "app_language"              , v); }
 void SetAppLocale            (STR_CREF        v) { SetVarStr     (g_app_locale           , "app_locale"                , v); }
 void SetAppMultithread       (bool            v) { SetVarBool    (g_app_multithread      , "app_multithread"           , v); }
+void SetAppExitCode          (int             v) { SetVarInt     (g_app_exit_code        , "app_exit_code"             , v); }
 void SetAppScreenshotFormat  (STR_CREF        v) { SetVarStr     (g_app_screenshot_format, "app_screenshot_format"     , v); }
 void SetIoInputGrabMode      (IoInputGrabMode v) { SetVarEnum    (g_io_input_grab_mode   , "io_input_grab_mode",    (int)v, IoInputGrabModeToStr); }
 void SetIoArcadeControls     (bool            v) { SetVarBool    (g_io_arcade_controls   , "io_arcade_controls"        , v); }
@@ -454,6 +457,7 @@ void Init()
     g_app_locale           = "en";
     g_app_screenshot_format= "jpg";
     g_app_multithread      = true;
+    g_app_exit_code        = 0;
 
     g_mp_state_active      = MP_STATE_DISABLED;
     g_mp_state_pending     = MP_STATE_NONE;
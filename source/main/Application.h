@@ -195,6 +195,7 @@ bool                 GetDiagEnvmap           ();
 std::string const &  GetAppLanguage          ();
 std::string const &  GetAppLocale            ();
 bool                 GetAppMultithread       ();
+int                  GetAppExitCode          ();
 std::string const &  GetAppScreenshotFormat  ();
 IoInputGrabMode      GetIoInputGrabMode      ();
 bool                 GetIoArcadeControls     ();
@@ -277,6 +278,7 @@ void SetDiagEnvmap           (bool                v);
 void SetAppLanguage          (std::string const & v);
 void SetAppLocale            (std::string const & v);
 void SetAppMultithread       (bool                v);
+void SetAppExitCode          (int                 v);
 void SetAppScreenshotFormat  (std::string const & v);
 void SetIoInputGrabMode      (IoInputGrabMode     v);
 void SetIoArcadeControls     (bool                v);
@@ -79,6 +79,8 @@ SoundScriptManager::SoundScriptManager() :
     // reset all states
     state_map.clear();
 
+    command_buffers.resize(MAX_TRUCKS);
+
     sound_manager = new SoundManager();
 
     if (!sound_manager)
@@ -279,29 +281,136 @@ void SoundScriptManager::modulate(int truck, int mod, float value, int linkType,
     if (mod >= SS_MAX_MOD)
         return;
 
-    for (int i = 0; i < free_gains[mod]; i++)
+    const int key = truck * SS_MAX_MOD + mod;
+
+    auto gains_itor = gains_by_truck_mod.find(key);
+    if (gains_itor != gains_by_truck_mod.end())
     {
-        SoundScriptInstance* inst = gains[mod + i * SS_MAX_MOD];
-        if (inst && inst->truck == truck && inst->sound_link_type == linkType && inst->sound_link_item_id == linkItemID)
+        for (SoundScriptInstance* inst : gains_itor->second)
         {
-            // this one requires modulation
-            float gain = value * value * inst->templ->gain_square + value * inst->templ->gain_multiplier + inst->templ->gain_offset;
-            gain = std::max(0.0f, gain);
-            gain = std::min(gain, 1.0f);
-            inst->setGain(gain);
+            if (inst->sound_link_type == linkType && inst->sound_link_item_id == linkItemID)
+            {
+                // this one requires modulation
+                float gain = value * value * inst->templ->gain_square + value * inst->templ->gain_multiplier + inst->templ->gain_offset;
+                gain = std::max(0.0f, gain);
+                gain = std::min(gain, 1.0f);
+                inst->setGain(gain);
+            }
         }
     }
 
-    for (int i = 0; i < free_pitches[mod]; i++)
+    auto pitches_itor = pitches_by_truck_mod.find(key);
+    if (pitches_itor != pitches_by_truck_mod.end())
     {
-        SoundScriptInstance* inst = pitches[mod + i * SS_MAX_MOD];
-        if (inst && inst->truck == truck && inst->sound_link_type == linkType && inst->sound_link_item_id == linkItemID)
+        for (SoundScriptInstance* inst : pitches_itor->second)
+        {
+            if (inst->sound_link_type == linkType && inst->sound_link_item_id == linkItemID)
+            {
+                // this one requires modulation
+                float pitch = value * value * inst->templ->pitch_square + value * inst->templ->pitch_multiplier + inst->templ->pitch_offset;
+                pitch = std::max(0.0f, pitch);
+                inst->setPitch(pitch);
+            }
+        }
+    }
+}
+
+void SoundScriptManager::queueTrigOnce(int truck, int trig, int linkType, int linkItemID)
+{
+    queueTrigger(truck, QUEUED_TRIG_ONCE, trig, linkType, linkItemID);
+}
+
+void SoundScriptManager::queueTrigStart(int truck, int trig, int linkType, int linkItemID)
+{
+    queueTrigger(truck, QUEUED_TRIG_START, trig, linkType, linkItemID);
+}
+
+void SoundScriptManager::queueTrigStop(int truck, int trig, int linkType, int linkItemID)
+{
+    queueTrigger(truck, QUEUED_TRIG_STOP, trig, linkType, linkItemID);
+}
+
+void SoundScriptManager::queueTrigger(int truck, int action, int trig, int linkType, int linkItemID)
+{
+    if (disabled)
+        return;
+    if (truck < 0 || truck >= MAX_TRUCKS)
+        return;
+
+    std::vector<queued_trigger_t>& triggers = command_buffers[truck].triggers;
+
+    // a command repeating the previous one of the same trigger has no effect (start, stop) or gets merged (once)
+    for (auto itor = triggers.rbegin(); itor != triggers.rend(); ++itor)
+    {
+        if (itor->trig == trig && itor->link_type == linkType && itor->link_item_id == linkItemID)
         {
-            // this one requires modulation
-            float pitch = value * value * inst->templ->pitch_square + value * inst->templ->pitch_multiplier + inst->templ->pitch_offset;
-            pitch = std::max(0.0f, pitch);
-            inst->setPitch(pitch);
+            if (itor->action == action)
+                return;
+            break;
+        }
+    }
+
+    queued_trigger_t command;
+    command.action       = action;
+    command.trig         = trig;
+    command.link_type    = linkType;
+    command.link_item_id = linkItemID;
+    triggers.push_back(command);
+}
+
+void SoundScriptManager::queueModulate(int truck, int mod, float value, int linkType, int linkItemID)
+{
+    if (disabled)
+        return;
+    if (truck < 0 || truck >= MAX_TRUCKS)
+        return;
+
+    std::vector<queued_modulation_t>& modulations = command_buffers[truck].modulations;
+    for (queued_modulation_t& command : modulations)
+    {
+        if (command.mod == mod && command.link_type == linkType && command.link_item_id == linkItemID)
+        {
+            command.value = value;
+            return;
+        }
+    }
+
+    queued_modulation_t command;
+    command.mod          = mod;
+    command.link_type    = linkType;
+    command.link_item_id = linkItemID;
+    command.value        = value;
+    modulations.push_back(command);
+}
+
+void SoundScriptManager::flushQueuedCommands()
+{
+    if (disabled)
+        return;
+
+    for (int truck = 0; truck < MAX_TRUCKS; truck++)
+    {
+        command_buffer_t& buffer = command_buffers[truck];
+        if (buffer.modulations.empty() && buffer.triggers.empty())
+            continue;
+
+        // modulations first, so that sounds triggered below start with the latest gain and pitch
+        for (queued_modulation_t const& command : buffer.modulations)
+        {
+            modulate(truck, command.mod, command.value, command.link_type, command.link_item_id);
+        }
+        for (queued_trigger_t const& command : buffer.triggers)
+        {
+            switch (command.action)
+            {
+            case QUEUED_TRIG_ONCE:  trigOnce (truck, command.trig, command.link_type, command.link_item_id); break;
+            case QUEUED_TRIG_START: trigStart(truck, command.trig, command.link_type, command.link_item_id); break;
+            case QUEUED_TRIG_STOP:  trigStop (truck, command.trig, command.link_type, command.link_item_id); break;
+            default: break;
+            }
         }
+        buffer.modulations.clear();
+        buffer.triggers.clear();
     }
 }
 
@@ -415,11 +524,13 @@ SoundScriptInstance* SoundScriptManager::createInstance(Ogre::String templatenam
     {
         gains[templ->gain_source + free_gains[templ->gain_source] * SS_MAX_MOD] = inst;
         free_gains[templ->gain_source]++;
+        gains_by_truck_mod[truck * SS_MAX_MOD + templ->gain_source].push_back(inst);
     }
     if (templ->pitch_source != SS_MOD_NONE)
     {
         pitches[templ->pitch_source + free_pitches[templ->pitch_source] * SS_MAX_MOD] = inst;
         free_pitches[templ->pitch_source]++;
+        pitches_by_truck_mod[truck * SS_MAX_MOD + templ->pitch_source].push_back(inst);
     }
 
     // SoundTrigger: SS_TRIG_ALWAYSON
@@ -28,6 +28,8 @@
 
 #include <OgreScriptLoader.h>
 
+#include <vector>
+
 enum {
     MAX_SOUNDS_PER_SCRIPT = 16,
     MAX_INSTANCES_PER_GROUP = 256
@@ -275,6 +277,15 @@ public:
     void modulate    (int truck, int mod, float value, int linkType = SL_DEFAULT, int linkItemID=-1);
     void modulate    (Beam *b,   int mod, float value, int linkType = SL_DEFAULT, int linkItemID=-1);
 
+    // deferred functions for the physics loop, applied by flushQueuedCommands()
+    // thread-safe as long as every truck is simulated by one thread at a time
+    void queueTrigOnce (int truck, int trig, int linkType = SL_DEFAULT, int linkItemID=-1);
+    void queueTrigStart(int truck, int trig, int linkType = SL_DEFAULT, int linkItemID=-1);
+    void queueTrigStop (int truck, int trig, int linkType = SL_DEFAULT, int linkItemID=-1);
+    void queueModulate (int truck, int mod, float value, int linkType = SL_DEFAULT, int linkItemID=-1);
+    /// Main thread only, physics must not be running
+    void flushQueuedCommands();
+
     void setEnabled(bool state);
 
     void setCamera(Ogre::Vector3 position, Ogre::Vector3 direction, Ogre::Vector3 up, Ogre::Vector3 velocity);
@@ -289,6 +300,31 @@ public:
 
 private:
 
+    enum QueuedTriggerAction { QUEUED_TRIG_ONCE, QUEUED_TRIG_START, QUEUED_TRIG_STOP };
+
+    struct queued_modulation_t
+    {
+        int   mod;
+        int   link_type;
+        int   link_item_id;
+        float value;
+    };
+
+    struct queued_trigger_t
+    {
+        int action; // QueuedTriggerAction
+        int trig;
+        int link_type;
+        int link_item_id;
+    };
+
+    /// Commands of one truck; only the last value of each modulation is kept, repeated triggers are merged
+    struct command_buffer_t
+    {
+        std::vector<queued_modulation_t> modulations;
+        std::vector<queued_trigger_t>    triggers;
+    };
+
     SoundScriptTemplate* createTemplate(Ogre::String name, Ogre::String groupname, Ogre::String filename);
     void skipToNextCloseBrace(Ogre::DataStreamPtr& chunk);
     void skipToNextOpenBrace(Ogre::DataStreamPtr& chunk);
@@ -313,6 +349,14 @@ private:
     int free_gains[SS_MAX_MOD];
     SoundScriptInstance *gains[SS_MAX_MOD * MAX_INSTANCES_PER_GROUP];
 
+    // same instances as `gains` and `pitches`, by truck * SS_MAX_MOD + mod
+    std::map <int, std::vector<SoundScriptInstance*> > gains_by_truck_mod;
+    std::map <int, std::vector<SoundScriptInstance*> > pitches_by_truck_mod;
+
+    std::vector<command_buffer_t> command_buffers; // one per truck number
+
+    void queueTrigger(int truck, int action, int trig, int linkType, int linkItemID);
+
     // state map
     // soundLinks, soundItems, trucks, triggers
     std::map <int, std::map <int, std::map <int, std::map <int, bool > > > > state_map;
@@ -38,9 +38,6 @@ struct wheel_t
     Ogre::Real avgSpeed;
     Ogre::Real delta_rotation; //!< Difference in wheel position
     float rp;
-    float rp1; //<! Networking; triple buffer
-    float rp2; //<! Networking; triple buffer
-    float rp3; //<! Networking; triple buffer
     float width;
 
     // for skidmarks
@@ -21,6 +21,7 @@
 
 #include "BeamEngine.h"
 
+#include "ApproxMath.h"
 #include "BeamFactory.h"
 #include "Scripting.h"
 #include "SoundScriptManager.h"
@@ -92,6 +93,7 @@ BeamEngine::BeamEngine(float minRPM, float maxRPM, float torque, std::vector<flo
     , rnd_antilag_chance(0.9975)
     , minRPM_antilag(3000)
     , antilag_power_factor(170)
+    , antilag_rand_state(1)
 {
     fullRPMRange = (maxRPM - minRPM);
     oneThirdRPMRange = fullRPMRange / 3.0f;
@@ -261,7 +263,7 @@ void BeamEngine::update(float dt, int doUpdate)
     if (doUpdate)
     {
 #ifdef USE_OPENAL
-        SoundScriptManager::getSingleton().modulate(trucknum, SS_MOD_INJECTOR, acc);
+        SoundScriptManager::getSingleton().queueModulate(trucknum, SS_MOD_INJECTOR, acc);
 #endif // USE_OPENAL
     }
 
@@ -272,7 +274,7 @@ void BeamEngine::update(float dt, int doUpdate)
         if (apressure > 50000.0f)
         {
 #ifdef USE_OPENAL
-            SoundScriptManager::getSingleton().trigOnce(trucknum, SS_TRIG_AIR_PURGE);
+            SoundScriptManager::getSingleton().queueTrigOnce(trucknum, SS_TRIG_AIR_PURGE);
 #endif // USE_OPENAL
             apressure = 0.0f;
         }
@@ -336,11 +338,11 @@ void BeamEngine::update(float dt, int doUpdate)
 
                             if (b_flutter)
                             {
-                                SoundScriptManager::getSingleton().trigStart(trucknum, SS_TRIG_TURBOWASTEGATE);
+                                SoundScriptManager::getSingleton().queueTrigStart(trucknum, SS_TRIG_TURBOWASTEGATE);
                                 if (curTurboRPM[i] < minWGPsi * wastegate_threshold_n)
                                 {
                                     b_flutter = false;
-                                    SoundScriptManager::getSingleton().trigStop(trucknum, SS_TRIG_TURBOWASTEGATE);
+                                    SoundScriptManager::getSingleton().queueTrigStop(trucknum, SS_TRIG_TURBOWASTEGATE);
                                 }
                             }
                         }
@@ -374,17 +376,17 @@ void BeamEngine::update(float dt, int doUpdate)
                 // anti lag
                 if (b_anti_lag && curAcc < 0.5)
                 {
-                    float f = frand();
+                    float f = frand(antilag_rand_state);
                     if (curEngineRPM > minRPM_antilag && f > rnd_antilag_chance)
                     {
                         if (curTurboRPM[i] > maxTurboRPM * 0.35 && curTurboRPM[i] < maxTurboRPM)
                         {
                             turbotorque -= (turbotorque * (f * antilag_power_factor));
-                            SoundScriptManager::getSingleton().trigStart(trucknum, SS_TRIG_TURBOBACKFIRE);
+                            SoundScriptManager::getSingleton().queueTrigStart(trucknum, SS_TRIG_TURBOBACKFIRE);
                         }
                     }
                     else
-                        SoundScriptManager::getSingleton().trigStop(trucknum, SS_TRIG_TURBOBACKFIRE);
+                        SoundScriptManager::getSingleton().queueTrigStop(trucknum, SS_TRIG_TURBOBACKFIRE);
                 }
 
                 // update main turbo rpm
@@ -403,12 +405,12 @@ void BeamEngine::update(float dt, int doUpdate)
 
                     if (curAcc < 0.06 && curTurboRPM[i] > minBOVPsi * 10000)
                     {
-                        SoundScriptManager::getSingleton().trigStart(trucknum, SS_TRIG_TURBOBOV);
+                        SoundScriptManager::getSingleton().queueTrigStart(trucknum, SS_TRIG_TURBOBOV);
                         curBOVTurboRPM[i] += dt * turboBOVtorque / (turboInertia * 0.1);
                     }
                     else
                     {
-                        SoundScriptManager::getSingleton().trigStop(trucknum, SS_TRIG_TURBOBOV);
+                        SoundScriptManager::getSingleton().queueTrigStop(trucknum, SS_TRIG_TURBOBOV);
                         if (curBOVTurboRPM[i] < curTurboRPM[i])
                             curBOVTurboRPM[i] += dt * turboBOVtorque / (turboInertia * 0.05);
                         else
@@ -447,7 +449,7 @@ void BeamEngine::update(float dt, int doUpdate)
     {
         if (running && curEngineRPM < stallRPM)
         {
-            stop();
+            stop(true);
         }
 
         if (contact && starter && !running)
@@ -460,7 +462,7 @@ void BeamEngine::update(float dt, int doUpdate)
             {
                 running = true;
 #ifdef USE_OPENAL
-                SoundScriptManager::getSingleton().trigStart(trucknum, SS_TRIG_ENGINE);
+                SoundScriptManager::getSingleton().queueTrigStart(trucknum, SS_TRIG_ENGINE);
 #endif // USE_OPENAL
             }
         }
@@ -513,7 +515,7 @@ void BeamEngine::update(float dt, int doUpdate)
                 {
                     // engage a gear
 #ifdef USE_OPENAL
-                    SoundScriptManager::getSingleton().trigStart(trucknum, SS_TRIG_SHIFT);
+                    SoundScriptManager::getSingleton().queueTrigStart(trucknum, SS_TRIG_SHIFT);
 #endif // USE_OPENAL
                     if (autoselect != NEUTRAL)
                     {
@@ -529,7 +531,7 @@ void BeamEngine::update(float dt, int doUpdate)
             {
                 // we're done shifting
 #ifdef USE_OPENAL
-                SoundScriptManager::getSingleton().trigStop(trucknum, SS_TRIG_SHIFT);
+                SoundScriptManager::getSingleton().queueTrigStop(trucknum, SS_TRIG_SHIFT);
 #endif // USE_OPENAL
                 setAcc(autocurAcc);
                 shifting = 0;
@@ -642,13 +644,13 @@ void BeamEngine::update(float dt, int doUpdate)
                 if ((autoselect == DRIVE && curGear < numGears && curClutch > 0.99f) || (autoselect == TWO && curGear < std::min(2, numGears)))
                 {
                     kickdownDelayCounter = 100;
-                    shift(1);
+                    shift(1, true);
                 }
             }
             else if (curGear > 1 && refWheelRevolutions * gearsRatio[curGear] < maxRPM && (curEngineRPM < minRPM || (curEngineRPM < minRPM + shiftBehaviour * halfRPMRange / 2.0f &&
                 getEnginePower(curWheelRevolutions * gearsRatio[curGear]) > getEnginePower(curWheelRevolutions * gearsRatio[curGear + 1]))))
             {
-                shift(-1);
+                shift(-1, true);
             }
 
             int newGear = curGear;
@@ -778,7 +780,7 @@ void BeamEngine::update(float dt, int doUpdate)
                 newGear > curGear && std::abs(curWheelRevolutions * (gearsRatio[newGear + 1] - gearsRatio[curGear + 1])) > oneThirdRPMRange / 3.0f)
             {
                 if (absVelocity - relVelocity < 0.5f)
-                    shiftTo(newGear);
+                    shiftTo(newGear, true);
             }
 
             if (accs.size() > 200)
@@ -816,23 +818,23 @@ void BeamEngine::updateAudio(int doUpdate)
     if (hasturbo)
     {
         for (int i = 0; i < numTurbos; i++)
-            SoundScriptManager::getSingleton().modulate(trucknum, SS_MOD_TURBO, curTurboRPM[i]);
+            SoundScriptManager::getSingleton().queueModulate(trucknum, SS_MOD_TURBO, curTurboRPM[i]);
     }
 
     if (doUpdate)
     {
-        SoundScriptManager::getSingleton().modulate(trucknum, SS_MOD_ENGINE, curEngineRPM);
-        SoundScriptManager::getSingleton().modulate(trucknum, SS_MOD_TORQUE, curClutchTorque);
-        SoundScriptManager::getSingleton().modulate(trucknum, SS_MOD_GEARBOX, curWheelRevolutions);
+        SoundScriptManager::getSingleton().queueModulate(trucknum, SS_MOD_ENGINE, curEngineRPM);
+        SoundScriptManager::getSingleton().queueModulate(trucknum, SS_MOD_TORQUE, curClutchTorque);
+        SoundScriptManager::getSingleton().queueModulate(trucknum, SS_MOD_GEARBOX, curWheelRevolutions);
     }
     // reverse gear beep
     if (curGear == -1 && running)
     {
-        SoundScriptManager::getSingleton().trigStart(trucknum, SS_TRIG_REVERSE_GEAR);
+        SoundScriptManager::getSingleton().queueTrigStart(trucknum, SS_TRIG_REVERSE_GEAR);
     }
     else
     {
-        SoundScriptManager::getSingleton().trigStop(trucknum, SS_TRIG_REVERSE_GEAR);
+        SoundScriptManager::getSingleton().queueTrigStop(trucknum, SS_TRIG_REVERSE_GEAR);
     }
 #endif // USE_OPENAL
 }
@@ -1078,7 +1080,7 @@ void BeamEngine::setGearRange(int v)
     curGearRange = v;
 }
 
-void BeamEngine::stop()
+void BeamEngine::stop(bool queue_sounds)
 {
     if (!running)
         return;
@@ -1087,7 +1089,10 @@ void BeamEngine::stop()
     // Script Event - engine death
     TRIGGER_EVENT(SE_TRUCK_ENGINE_DIED, m_actor->trucknum);
 #ifdef USE_OPENAL
-    SoundScriptManager::getSingleton().trigStop(m_actor->trucknum, SS_TRIG_ENGINE);
+    if (queue_sounds)
+        SoundScriptManager::getSingleton().queueTrigStop(m_actor->trucknum, SS_TRIG_ENGINE);
+    else
+        SoundScriptManager::getSingleton().trigStop(m_actor->trucknum, SS_TRIG_ENGINE);
 #endif // USE_OPENAL
 }
 
@@ -1101,7 +1106,7 @@ void BeamEngine::autoSetAcc(float val)
     }
 }
 
-void BeamEngine::shift(int val)
+void BeamEngine::shift(int val, bool queue_sounds)
 {
     if (!val || curGear + val < -1 || curGear + val > getNumGears())
         return;
@@ -1116,22 +1121,28 @@ void BeamEngine::shift(int val)
         if (curClutch > 0.25f)
         {
 #ifdef USE_OPENAL
-            SoundScriptManager::getSingleton().trigOnce(m_actor->trucknum, SS_TRIG_GEARSLIDE);
+            if (queue_sounds)
+                SoundScriptManager::getSingleton().queueTrigOnce(m_actor->trucknum, SS_TRIG_GEARSLIDE);
+            else
+                SoundScriptManager::getSingleton().trigOnce(m_actor->trucknum, SS_TRIG_GEARSLIDE);
 #endif // USE_OPENAL
         }
         else
         {
 #ifdef USE_OPENAL
-            SoundScriptManager::getSingleton().trigOnce(m_actor->trucknum, SS_TRIG_SHIFT);
+            if (queue_sounds)
+                SoundScriptManager::getSingleton().queueTrigOnce(m_actor->trucknum, SS_TRIG_SHIFT);
+            else
+                SoundScriptManager::getSingleton().trigOnce(m_actor->trucknum, SS_TRIG_SHIFT);
 #endif // USE_OPENAL
             curGear += val;
         }
     }
 }
 
-void BeamEngine::shiftTo(int newGear)
+void BeamEngine::shiftTo(int newGear, bool queue_sounds)
 {
-    shift(newGear - curGear);
+    shift(newGear - curGear, queue_sounds);
 }
 
 void BeamEngine::updateShifts()
@@ -1205,6 +1216,46 @@ int BeamEngine::getAutoShift()
     return (int)autoselect;
 }
 
+void BeamEngine::getControlState(ControlState& out)
+{
+    out.acc              = curAcc;
+    out.auto_acc         = autocurAcc;
+    out.clutch           = curClutch;
+    out.shift_clock      = shiftclock;
+    out.post_shift_clock = postshiftclock;
+    out.gear             = curGear;
+    out.gear_range       = curGearRange;
+    out.shift_val        = shiftval;
+    out.shifting         = shifting;
+    out.post_shifting    = postshifting;
+    out.starter          = starter;
+    out.contact          = contact;
+    out.running          = running;
+    out.automode         = automode;
+    out.autoselect       = autoselect;
+    out.antilag_rand_state = antilag_rand_state;
+}
+
+void BeamEngine::setControlState(ControlState const& state)
+{
+    curAcc         = state.acc;
+    autocurAcc     = state.auto_acc;
+    curClutch      = state.clutch;
+    shiftclock     = state.shift_clock;
+    postshiftclock = state.post_shift_clock;
+    curGear        = state.gear;
+    curGearRange   = state.gear_range;
+    shiftval       = state.shift_val;
+    shifting       = state.shifting;
+    postshifting   = state.post_shifting;
+    starter        = state.starter;
+    contact        = state.contact != 0;
+    running        = state.running != 0;
+    automode       = state.automode;
+    autoselect     = static_cast<autoswitch>(state.autoselect);
+    antilag_rand_state = state.antilag_rand_state;
+}
+
 void BeamEngine::setManualClutch(float val)
 {
     if (automode >= MANUAL)
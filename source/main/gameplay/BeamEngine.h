@@ -131,8 +131,11 @@ public:
     void setGear(int v);
     void setGearRange(int v);
 
-    // stall engine
-    void stop();
+    /**
+    * Stalls the engine. Plays sounds.
+    * @param queue_sounds True when called from the physics loop, see SoundScriptManager::queueTrigStop()
+    */
+    void stop(bool queue_sounds = false);
 
     // high level controls
     bool hasContact() { return contact; };
@@ -161,14 +164,15 @@ public:
 
     /**
     * Changes gear by a relative offset. Plays sounds.
+    * @param queue_sounds True when called from the physics loop, see SoundScriptManager::queueTrigOnce()
     */
-    void shift(int val);
+    void shift(int val, bool queue_sounds = false);
 
     /**
     * Changes gear to given value. Plays sounds.
     * @see BeamEngine::shift
     */
-    void shiftTo(int val);
+    void shiftTo(int val, bool queue_sounds = false);
 
     /**
     * Changes gears. Plays sounds.
@@ -177,6 +181,34 @@ public:
 
     void update(float dt, int doUpdate);
 
+    /**
+    * Driver controls and gearbox state; everything input handling changes between frames.
+    * Fixed-size members only, it's written to physics recordings as is.
+    * @see RoR::PhysicsRecorder
+    */
+    struct ControlState
+    {
+        float acc;
+        float auto_acc;
+        float clutch;
+        float shift_clock;
+        float post_shift_clock;
+        int   gear;
+        int   gear_range;
+        int   shift_val;
+        int   shifting;
+        int   post_shifting;
+        int   starter;
+        int   contact;
+        int   running;
+        int   automode;
+        int   autoselect;
+        unsigned int antilag_rand_state;
+    };
+
+    void getControlState(ControlState& out);
+    void setControlState(ControlState const& state);
+
     /**
     * Updates sound effects (engine/turbo/clutch/etc...)
     */
@@ -298,6 +330,7 @@ protected:
     float minRPM_antilag;
     float rnd_antilag_chance;
     float antilag_power_factor;
+    unsigned int antilag_rand_state; //!< frand() state; per engine, since trucks are simulated in parallel
 
     // air pressure
     TorqueCurve* torqueCurve;
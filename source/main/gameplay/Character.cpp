@@ -53,6 +53,7 @@ Character::Character(int source, unsigned int streamid, int colourNumber, bool r
     , mCharacterNode(0)
     , mHideOwnNetLabel(BSETTING("HideOwnNetLabel", false))
     , mMoveableText(0)
+    , mNetLastUpdateTime(0)
     , networkAuthLevel(0)
     , networkUsername("")
     , physicsEnabled(true)
@@ -641,6 +642,10 @@ void Character::sendStreamData()
     if (beamCoupling)
         return;
 
+    if (mNetTimer.getMilliseconds() - mNetLastUpdateTime < RoR::Networking::GetStreamSendInterval(1))
+        return; // Rate limit, see setting "Network Character Send Rate"
+    mNetLastUpdateTime = mNetTimer.getMilliseconds();
+
     Networking::CharacterMsgPos msg;
     msg.command = Networking::CHARACTER_CMD_POSITION;
     msg.pos_x = mCharacterNode->getPosition().x;
@@ -654,7 +659,7 @@ void Character::sendStreamData()
 #endif // USE_SOCKETW
 }
 
-void Character::receiveStreamData(unsigned int& type, int& source, unsigned int& streamid, char* buffer)
+void Character::receiveStreamData(unsigned int type, int source, unsigned int streamid, char* buffer)
 {
 #ifdef USE_SOCKETW
     if (type == RoRnet::MSG2_STREAM_DATA && m_source_id == source && m_stream_id == streamid)
@@ -36,7 +36,7 @@ public:
     bool getPhysicsEnabled() { return physicsEnabled; };
     bool getVisible();
 
-    void receiveStreamData(unsigned int& type, int& source, unsigned int& streamid, char* buffer);
+    void receiveStreamData(unsigned int type, int source, unsigned int streamid, char* buffer);
 
     int getSourceID() { return m_source_id; };
 
@@ -100,6 +100,7 @@ protected:
     void setAnimationMode(Ogre::String mode, float time = 0);
 
     Ogre::Timer mNetTimer;
+    unsigned long mNetLastUpdateTime;
 
     bool mHideOwnNetLabel;
 
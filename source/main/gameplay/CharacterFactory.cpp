@@ -76,9 +76,9 @@ void CharacterFactory::DeleteAllRemoteCharacters()
 }
 
 #ifdef USE_SOCKETW
-void CharacterFactory::handleStreamData(std::vector<RoR::Networking::recv_packet_t> packet_buffer)
+void CharacterFactory::handleStreamData(std::vector<RoR::Networking::recv_packet_t> const& packet_buffer)
 {
-    for (auto packet : packet_buffer)
+    for (auto& packet : packet_buffer)
     {
         if (packet.header.command == RoRnet::MSG2_STREAM_REGISTER)
         {
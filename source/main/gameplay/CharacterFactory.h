@@ -39,7 +39,7 @@ public:
     void DeleteAllRemoteCharacters();
     void update(float dt);
 #ifdef USE_SOCKETW
-    void handleStreamData(std::vector<RoR::Networking::recv_packet_t> packet);
+    void handleStreamData(std::vector<RoR::Networking::recv_packet_t> const& packet);
 #endif // USE_SOCKETW
 
 private:
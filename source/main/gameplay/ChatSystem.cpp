@@ -112,9 +112,9 @@ void ReceiveStreamData(unsigned int type, int source, char* buffer)
 #endif // USE_SOCKETW
 
 #ifdef USE_SOCKETW
-void HandleStreamData(std::vector<RoR::Networking::recv_packet_t> packet_buffer)
+void HandleStreamData(std::vector<RoR::Networking::recv_packet_t> const& packet_buffer)
 {
-    for (auto packet : packet_buffer)
+    for (auto& packet : packet_buffer)
     {
         ReceiveStreamData(packet.header.command, packet.header.source, packet.buffer);
     }
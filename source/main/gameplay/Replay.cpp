@@ -20,6 +20,7 @@
 
 #include "Replay.h"
 #include <Ogre.h>
+#include "Application.h"
 #include "Utils.h"
 #include "GUIManager.h"
 #include "Language.h"
@@ -34,18 +35,15 @@ Replay::Replay(Beam* b, int _numFrames)
 
     replayTimer = new Timer();
 
-    // DO NOT get memory here, get memory when we use it first time!
-    nodes = 0;
-    beams = 0;
-    times = 0;
-
     outOfMemory = false;
 
-    unsigned long bsize = (numNodes * numFrames * sizeof(node_simple_t) + numBeams * numFrames * sizeof(beam_simple_t) + numFrames * sizeof(unsigned long)) / 1024.0f;
-    LOG("replay buffer size: " + TOSTRING(bsize) + " kB");
-
-    writeIndex = 0;
-    firstRun = 1;
+    // frames are stored as they come in, the frame buffers are allocated on first use
+    std::string spill_filename = RoR::App::GetSysCacheDir() + PATH_SLASH + "replay" + TOSTRING(b->trucknum) + ".tmp";
+    recorder = new RoR::ReplayRecorder(numNodes, numBeams, numFrames, spill_filename);
+    readFrame = -1;
+    readTime = 0;
+    curFrameTime = 0;
+    curOffset = 0;
 
     hidden = false;
     visible = false;
@@ -72,15 +70,13 @@ Replay::Replay(Beam* b, int _numFrames)
 
 Replay::~Replay()
 {
-    if (nodes)
+    if (!writeNodes.empty())
     {
-        free(nodes);
-        nodes = 0;
-        free(beams);
-        beams = 0;
-        free(times);
-        times = 0;
+        LOG("replay: " + TOSTRING(recorder->GetEndFrame() - recorder->GetFirstFrame()) + " frames, "
+            + TOSTRING(recorder->GetMemorySize() / 1024) + " kB in memory, "
+            + TOSTRING(recorder->GetSpilledSize() / 1024) + " kB on disk");
     }
+    delete recorder;
     delete replayTimer;
 }
 
@@ -88,58 +84,39 @@ void* Replay::getWriteBuffer(int type)
 {
     if (outOfMemory)
         return 0;
-    if (!nodes)
+    try
     {
-        // get memory
-        nodes = (node_simple_t*)calloc(numNodes * numFrames, sizeof(node_simple_t));
-        if (!nodes)
+        if (writeNodes.empty())
         {
-            outOfMemory = true;
-            return 0;
-        }
-        beams = (beam_simple_t*)calloc(numBeams * numFrames, sizeof(beam_simple_t));
-        if (!beams)
-        {
-            free(nodes);
-            nodes = 0;
-            outOfMemory = true;
-            return 0;
-        }
-        times = (unsigned long*)calloc(numFrames, sizeof(unsigned long));
-        if (!times)
-        {
-            free(nodes);
-            nodes = 0;
-            free(beams);
-            beams = 0;
-            outOfMemory = true;
-            return 0;
+            writeNodes.resize(numNodes);
+            writeBeams.resize(numBeams);
+            readNodes.resize(numNodes);
+            readBeams.resize(numBeams);
         }
     }
-    void* ptr = 0;
-    times[writeIndex] = replayTimer->getMicroseconds();
-    if (type == 0)
+    catch (std::bad_alloc&)
     {
-        // nodes
-        ptr = (void *)(nodes + (writeIndex * numNodes));
+        outOfMemory = true;
+        return 0;
     }
+    if (type == 0)
+        return (void *)(writeNodes.data());
     else if (type == 1)
-    {
-        // beams
-        ptr = (void *)(beams + (writeIndex * numBeams));
-    }
-    return ptr;
+        return (void *)(writeBeams.data());
+    return 0;
 }
 
 void Replay::writeDone()
 {
-    if (outOfMemory)
+    if (outOfMemory || writeNodes.empty())
         return;
-    writeIndex++;
-    if (writeIndex == numFrames)
+    try
     {
-        firstRun = 0;
-        writeIndex = 0;
+        recorder->WriteFrame(writeNodes.data(), writeBeams.data(), replayTimer->getMicroseconds());
+    }
+    catch (std::bad_alloc&)
+    {
+        outOfMemory = true;
     }
 }
 
@@ -151,29 +128,29 @@ void* Replay::getReadBuffer(int offset, int type, unsigned long& time)
     if (offset <= -numFrames)
         offset = -numFrames + 1;
 
-    int delta = writeIndex + offset;
-    if (delta < 0)
-        if (firstRun && type == 0)
-            return (void *)(nodes);
-        else if (firstRun && type == 1)
-            return (void *)(beams);
-        else
-            delta += numFrames;
+    // before the buffer was filled, stay at the oldest frame
+    int frame = std::max(recorder->GetEndFrame() + offset, recorder->GetFirstFrame());
+    if (frame != readFrame && !outOfMemory && !readNodes.empty())
+    {
+        readFrame = -1;
+        if (recorder->ReadFrame(frame, readNodes.data(), readBeams.data(), readTime))
+            readFrame = frame;
+    }
 
     // set the time
-    time = times[delta];
+    time = readTime;
     curFrameTime = time;
     curOffset = offset;
     updateGUI();
 
-    if (outOfMemory)
+    if (outOfMemory || readFrame == -1)
         return 0;
 
     // return buffer pointer
     if (type == 0)
-        return (void *)(nodes + delta * numNodes);
+        return (void *)(readNodes.data());
     else if (type == 1)
-        return (void *)(beams + delta * numBeams);
+        return (void *)(readBeams.data());
     return 0;
 }
 
@@ -26,20 +26,13 @@
 
 #include "RoRPrerequisites.h"
 #include "Beam.h"
+#include "ReplayRecorder.h"
 
-struct node_simple_t
-{
-    Ogre::Vector3 position;
-    Ogre::Vector3 velocity;
-    Ogre::Vector3 forces;
-};
-
-struct beam_simple_t
-{
-    bool broken;
-    bool disabled;
-};
+#include <vector>
 
+/// Records the simulated truck for instant replay; see RoR::ReplayRecorder for the storage.
+/// Buffers are frame-sized scratch arrays: the write buffers are encoded by writeDone(),
+/// the read buffers hold the frame decoded by the last getReadBuffer() call.
 class Replay : public ZeroedMemoryAllocator
 {
 public:
@@ -67,15 +60,16 @@ protected:
     bool hidden;
     bool visible;
 
-    int writeIndex;
-    int firstRun;
     unsigned long curFrameTime;
     int curOffset;
 
-    // malloc'ed
-    node_simple_t* nodes;
-    beam_simple_t* beams;
-    unsigned long* times;
+    RoR::ReplayRecorder* recorder;
+    std::vector<node_simple_t> writeNodes;
+    std::vector<beam_simple_t> writeBeams;
+    std::vector<node_simple_t> readNodes;
+    std::vector<beam_simple_t> readBeams;
+    int readFrame; // frame number in the recorder, -1 = none
+    unsigned long readTime;
 
     // windowing
     MyGUI::WidgetPtr panel;
@@ -0,0 +1,582 @@
+/*
+    This source file is part of Rigs of Rods
+    Copyright 2013-2017 Petr Ohlidal & contributors
+
+    For more information, see http://www.rigsofrods.org/
+
+    Rigs of Rods is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License version 3, as
+    published by the Free Software Foundation.
+
+    Rigs of Rods is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with Rigs of Rods. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "ReplayRecorder.h"
+
+#include "RoRPrerequisites.h"
+
+#include <algorithm>
+#include <cstdio>
+
+using namespace RoR;
+
+// Frame encoding
+// --------------
+// Keyframe (first frame of a segment):
+//   per node: 6 varints (zigzag) - quantized position x,y,z and velocity x,y,z
+//   beam states: 2 bits per beam (broken, disabled), packed
+// Other frames:
+//   per node, one of:
+//     00xxyyzz                - position residuals in range [-2, 1], 2 bits each
+//     01nnnnnn                - n+1 nodes with zero residuals
+//     10000000 + 3 varints    - position residuals (zigzag)
+//   beam changes: varint count, then per changed beam varint(index_delta << 2 | state_xor)
+// Residuals are against the previous position (2nd frame of segment) or the linear
+// extrapolation of the two previous positions (all further frames).
+
+const float ReplayRecorder::POSITION_SCALE = 1024.f;
+const float ReplayRecorder::VELOCITY_SCALE = 256.f;
+
+static const int32_t QUANTIZED_LIMIT    = 1 << 28; // keeps residuals within 31 bits
+static const char    TAG_RUN            = 0x40;
+static const char    TAG_LONG           = char(0x80);
+static const int     MAX_RUN            = 64;
+static const size_t  COMPACT_MIN_WASTE  = 16u * 1024u * 1024u;
+
+static inline uint32_t ZigZag(int32_t v)    { return (static_cast<uint32_t>(v) << 1) ^ static_cast<uint32_t>(v >> 31); }
+static inline int32_t  UnZigZag(uint32_t v) { return static_cast<int32_t>(v >> 1) ^ -static_cast<int32_t>(v & 1); }
+
+static inline int32_t Quantize(float value, float scale)
+{
+    const float q = value * scale;
+    if (!(q > -QUANTIZED_LIMIT)) // also catches NaN
+        return (q < 0.f) ? -QUANTIZED_LIMIT : 0;
+    if (q > QUANTIZED_LIMIT)
+        return QUANTIZED_LIMIT;
+    return static_cast<int32_t>((q < 0.f) ? (q - 0.5f) : (q + 0.5f));
+}
+
+static inline uint8_t BeamState(beam_simple_t const& beam)
+{
+    return static_cast<uint8_t>((beam.broken ? 1 : 0) | (beam.disabled ? 2 : 0));
+}
+
+static void PutVarint(std::vector<char>& out, uint32_t v)
+{
+    while (v >= 0x80)
+    {
+        out.push_back(static_cast<char>((v & 0x7F) | 0x80));
+        v >>= 7;
+    }
+    out.push_back(static_cast<char>(v));
+}
+
+static bool GetVarint(const char*& pos, const char* end, uint32_t& out)
+{
+    uint32_t v = 0;
+    for (int shift = 0; shift < 35; shift += 7)
+    {
+        if (pos == end)
+            return false;
+        const uint8_t byte = static_cast<uint8_t>(*pos++);
+        v |= static_cast<uint32_t>(byte & 0x7F) << shift;
+        if (!(byte & 0x80))
+        {
+            out = v;
+            return true;
+        }
+    }
+    return false;
+}
+
+ReplayRecorder::ReplayRecorder(int num_nodes, int num_beams, int max_frames, std::string const& spill_filename):
+    m_num_nodes(num_nodes),
+    m_num_beams(num_beams),
+    m_max_frames(std::max(max_frames, 1)),
+    m_enc_pos1(num_nodes * 3, 0),
+    m_enc_pos2(num_nodes * 3, 0),
+    m_enc_beams(num_beams, 0),
+    m_dec_frame(-1),
+    m_dec_offset(0),
+    m_dec_pos1(num_nodes * 3, 0),
+    m_dec_pos2(num_nodes * 3, 0),
+    m_dec_beams(num_beams, 0),
+    m_dec_velocity(num_nodes, Ogre::Vector3::ZERO),
+    m_spill_filename(spill_filename),
+    m_spill_failed(false),
+    m_spill_end(0),
+    m_spill_live_size(0)
+{
+}
+
+ReplayRecorder::~ReplayRecorder()
+{
+    m_spill_map.Close();
+    if (m_spill_end > 0)
+        std::remove(m_spill_filename.c_str());
+}
+
+int ReplayRecorder::GetFirstFrame() const
+{
+    return (m_segments.empty()) ? 0 : m_segments.front().first_frame;
+}
+
+int ReplayRecorder::GetEndFrame() const
+{
+    return (m_segments.empty()) ? 0 : m_segments.back().first_frame + static_cast<int>(m_segments.back().times.size());
+}
+
+size_t ReplayRecorder::GetMemorySize() const
+{
+    size_t size = 0;
+    for (Segment const& segment : m_segments)
+        size += segment.data.capacity() + segment.times.capacity() * sizeof(unsigned long);
+    return size;
+}
+
+void ReplayRecorder::WriteFrame(const node_simple_t* nodes, const beam_simple_t* beams, unsigned long time)
+{
+    if (m_segments.empty() || m_segments.back().times.size() == KEYFRAME_INTERVAL)
+    {
+        const int first_frame = this->GetEndFrame();
+        size_t expected_size = 0;
+        if (!m_segments.empty())
+        {
+            m_segments.back().data.shrink_to_fit();
+            expected_size = m_segments.back().data.size();
+        }
+        m_segments.push_back(Segment());
+        Segment& segment = m_segments.back();
+        segment.first_frame = first_frame;
+        segment.spill_offset = 0;
+        segment.spill_size = 0;
+        segment.spilled = false;
+        segment.times.reserve(KEYFRAME_INTERVAL);
+        segment.data.reserve(expected_size);
+
+        this->SpillSegments();
+    }
+
+    Segment& segment = m_segments.back();
+    const size_t index = segment.times.size();
+    if (index == 0)
+        this->EncodeKeyframe(segment.data, nodes, beams);
+    else
+        this->EncodeDelta(segment.data, nodes, beams, index >= 2);
+    segment.times.push_back(time);
+
+    this->DropOldSegments();
+}
+
+void ReplayRecorder::EncodeKeyframe(std::vector<char>& out, const node_simple_t* nodes, const beam_simple_t* beams)
+{
+    for (int i = 0; i < m_num_nodes; ++i)
+    {
+        int32_t* pos1 = &m_enc_pos1[i * 3];
+        int32_t* pos2 = &m_enc_pos2[i * 3];
+        for (int c = 0; c < 3; ++c)
+        {
+            pos1[c] = pos2[c] = Quantize(nodes[i].position[c], POSITION_SCALE);
+            PutVarint(out, ZigZag(pos1[c]));
+        }
+        for (int c = 0; c < 3; ++c)
+        {
+            PutVarint(out, ZigZag(Quantize(nodes[i].velocity[c], VELOCITY_SCALE)));
+        }
+    }
+
+    uint8_t packed = 0;
+    for (int i = 0; i < m_num_beams; ++i)
+    {
+        m_enc_beams[i] = BeamState(beams[i]);
+        packed |= m_enc_beams[i] << ((i & 3) * 2);
+        if ((i & 3) == 3 || i == m_num_beams - 1)
+        {
+            out.push_back(static_cast<char>(packed));
+            packed = 0;
+        }
+    }
+}
+
+void ReplayRecorder::EncodeDelta(std::vector<char>& out, const node_simple_t* nodes, const beam_simple_t* beams, bool second_order)
+{
+    int run = 0;
+    for (int i = 0; i < m_num_nodes; ++i)
+    {
+        int32_t* pos1 = &m_enc_pos1[i * 3];
+        int32_t* pos2 = &m_enc_pos2[i * 3];
+        int32_t residual[3];
+        bool is_zero = true;
+        bool is_short = true;
+        for (int c = 0; c < 3; ++c)
+        {
+            const int32_t q = Quantize(nodes[i].position[c], POSITION_SCALE);
+            const int32_t predicted = (second_order) ? (2 * pos1[c] - pos2[c]) : pos1[c];
+            residual[c] = q - predicted;
+            pos2[c] = pos1[c];
+            pos1[c] = q;
+            is_zero  = is_zero && (residual[c] == 0);
+            is_short = is_short && (residual[c] >= -2) && (residual[c] <= 1);
+        }
+
+        if (is_zero)
+        {
+            if (++run == MAX_RUN)
+            {
+                out.push_back(TAG_RUN | static_cast<char>(run - 1));
+                run = 0;
+            }
+            continue;
+        }
+        if (run > 0)
+        {
+            out.push_back(TAG_RUN | static_cast<char>(run - 1));
+            run = 0;
+        }
+
+        if (is_short)
+        {
+            out.push_back(static_cast<char>(((residual[0] & 3) << 4) | ((residual[1] & 3) << 2) | (residual[2] & 3)));
+        }
+        else
+        {
+            out.push_back(TAG_LONG);
+            for (int c = 0; c < 3; ++c)
+                PutVarint(out, ZigZag(residual[c]));
+        }
+    }
+    if (run > 0)
+    {
+        out.push_back(TAG_RUN | static_cast<char>(run - 1));
+    }
+
+    uint32_t num_changes = 0;
+    for (int i = 0; i < m_num_beams; ++i)
+    {
+        if (BeamState(beams[i]) != m_enc_beams[i])
+            ++num_changes;
+    }
+    PutVarint(out, num_changes);
+    int prev_index = 0;
+    for (int i = 0; i < m_num_beams && num_changes > 0; ++i)
+    {
+        const uint8_t state = BeamState(beams[i]);
+        if (state != m_enc_beams[i])
+        {
+            PutVarint(out, (static_cast<uint32_t>(i - prev_index) << 2) | (state ^ m_enc_beams[i]));
+            m_enc_beams[i] = state;
+            prev_index = i;
+            --num_changes;
+        }
+    }
+}
+
+bool ReplayRecorder::DecodeFrame(const char*& pos, const char* end, int index_in_segment, Segment const& segment, node_simple_t* out_nodes)
+{
+    if (index_in_segment == 0)
+    {
+        uint32_t v;
+        for (int i = 0; i < m_num_nodes; ++i)
+        {
+            int32_t* pos1 = &m_dec_pos1[i * 3];
+            int32_t* pos2 = &m_dec_pos2[i * 3];
+            for (int c = 0; c < 3; ++c)
+            {
+                if (!GetVarint(pos, end, v))
+                    return false;
+                pos1[c] = pos2[c] = UnZigZag(v);
+                out_nodes[i].position[c] = pos1[c] / POSITION_SCALE;
+            }
+            for (int c = 0; c < 3; ++c)
+            {
+                if (!GetVarint(pos, end, v))
+                    return false;
+                m_dec_velocity[i][c] = UnZigZag(v) / VELOCITY_SCALE;
+            }
+            out_nodes[i].velocity = m_dec_velocity[i];
+        }
+
+        const int num_bytes = (m_num_beams + 3) / 4;
+        if (end - pos < num_bytes)
+            return false;
+        for (int i = 0; i < m_num_beams; ++i)
+        {
+            m_dec_beams[i] = (static_cast<uint8_t>(pos[i / 4]) >> ((i & 3) * 2)) & 3;
+        }
+        pos += num_bytes;
+        return true;
+    }
+
+    const bool second_order = (index_in_segment >= 2);
+    const unsigned long dt_us = segment.times[index_in_segment] - segment.times[index_in_segment - 1];
+    const float velocity_scale = (dt_us > 0) ? (1000000.f / (dt_us * POSITION_SCALE)) : 0.f;
+
+    int run = 0;
+    for (int i = 0; i < m_num_nodes; ++i)
+    {
+        int32_t residual[3] = { 0, 0, 0 };
+        if (run > 0)
+        {
+            --run;
+        }
+        else
+        {
+            if (pos == end)
+                return false;
+            const uint8_t tag = static_cast<uint8_t>(*pos++);
+            if (tag & 0x80)
+            {
+                uint32_t v;
+                for (int c = 0; c < 3; ++c)
+                {
+                    if (!GetVarint(pos, end, v))
+                        return false;
+                    residual[c] = UnZigZag(v);
+                }
+            }
+            else if (tag & 0x40)
+            {
+                run = tag & 0x3F; // this node is the first of the run
+            }
+            else
+            {
+                residual[0] = (((tag >> 4) & 3) ^ 2) - 2;
+                residual[1] = (((tag >> 2) & 3) ^ 2) - 2;
+                residual[2] = (( tag       & 3) ^ 2) - 2;
+            }
+        }
+
+        int32_t* pos1 = &m_dec_pos1[i * 3];
+        int32_t* pos2 = &m_dec_pos2[i * 3];
+        for (int c = 0; c < 3; ++c)
+        {
+            // Unsigned arithmetic, damaged data mustn't overflow
+            const uint32_t predicted = (second_order) ? (2u * pos1[c] - pos2[c]) : pos1[c];
+            const int32_t q = static_cast<int32_t>(predicted + static_cast<uint32_t>(residual[c]));
+            out_nodes[i].position[c] = q / POSITION_SCALE;
+            out_nodes[i].velocity[c] = (q - pos1[c]) * velocity_scale;
+            pos2[c] = pos1[c];
+            pos1[c] = q;
+        }
+    }
+    if (run > 0)
+        return false;
+
+    uint32_t num_changes;
+    if (!GetVarint(pos, end, num_changes))
+        return false;
+    uint32_t index = 0;
+    for (uint32_t n = 0; n < num_changes; ++n)
+    {
+        uint32_t v;
+        if (!GetVarint(pos, end, v))
+            return false;
+        index += v >> 2;
+        if (index >= static_cast<uint32_t>(m_num_beams))
+            return false;
+        m_dec_beams[index] ^= (v & 3);
+    }
+    return true;
+}
+
+bool ReplayRecorder::ReadFrame(int frame, node_simple_t* out_nodes, beam_simple_t* out_beams, unsigned long& out_time)
+{
+    if (frame < this->GetFirstFrame() || frame >= this->GetEndFrame())
+        return false;
+
+    // All segments but the last one are full
+    Segment const& segment = m_segments[(frame - m_segments.front().first_frame) / KEYFRAME_INTERVAL];
+    const int index = frame - segment.first_frame;
+
+    size_t size = 0;
+    const char* data = this->GetSegmentData(segment, size);
+    if (!data)
+        return false;
+
+    // Continue after the last decoded frame if it precedes this one within the segment, otherwise start at the keyframe
+    int next_index = 0;
+    const char* pos = data;
+    if (m_dec_frame >= segment.first_frame && m_dec_frame < frame)
+    {
+        next_index = m_dec_frame - segment.first_frame + 1;
+        pos = data + m_dec_offset;
+    }
+
+    for (int i = next_index; i <= index; ++i)
+    {
+        if (!this->DecodeFrame(pos, data + size, i, segment, out_nodes))
+        {
+            m_dec_frame = -1;
+            return false;
+        }
+    }
+    m_dec_frame = frame;
+    m_dec_offset = static_cast<size_t>(pos - data);
+
+    for (int i = 0; i < m_num_beams; ++i)
+    {
+        out_beams[i].broken   = (m_dec_beams[i] & 1) != 0;
+        out_beams[i].disabled = (m_dec_beams[i] & 2) != 0;
+    }
+    out_time = segment.times[index];
+    return true;
+}
+
+const char* ReplayRecorder::GetSegmentData(Segment const& segment, size_t& out_size)
+{
+    if (!segment.spilled)
+    {
+        out_size = segment.data.size();
+        return segment.data.data();
+    }
+
+    // The mapping is opened lazily and reopened when the file has grown since
+    if (!m_spill_map.IsOpen() || m_spill_map.GetSize() < segment.spill_offset + segment.spill_size)
+    {
+        if (!m_spill_map.Open(m_spill_filename) || m_spill_map.GetSize() < segment.spill_offset + segment.spill_size)
+        {
+            LOG("Replay: cannot read spill file '" + m_spill_filename + "'");
+            m_spill_map.Close();
+            return nullptr;
+        }
+    }
+    out_size = segment.spill_size;
+    return m_spill_map.GetData() + segment.spill_offset;
+}
+
+void ReplayRecorder::SpillSegments()
+{
+    if (m_spill_failed || m_segments.size() <= static_cast<size_t>(MAX_MEMORY_SEGMENTS))
+        return;
+
+    const size_t num_to_spill = m_segments.size() - MAX_MEMORY_SEGMENTS;
+    size_t first = 0;
+    while (first < num_to_spill && m_segments[first].spilled)
+        ++first;
+    if (first == num_to_spill)
+        return;
+
+    // Appending to a mapped file isn't portable
+    m_spill_map.Close();
+    FILE* file = std::fopen(m_spill_filename.c_str(), (m_spill_end == 0) ? "wb" : "ab");
+    if (!file)
+    {
+        LOG("Replay: cannot create spill file '" + m_spill_filename + "', keeping all frames in memory");
+        m_spill_failed = true;
+        return;
+    }
+
+    size_t last = first;
+    for (; last < num_to_spill; ++last)
+    {
+        Segment& segment = m_segments[last];
+        if (std::fwrite(segment.data.data(), 1, segment.data.size(), file) != segment.data.size())
+            break;
+        segment.spill_offset = m_spill_end;
+        segment.spill_size = segment.data.size();
+        segment.spilled = true;
+        m_spill_end += segment.spill_size;
+        m_spill_live_size += segment.spill_size;
+    }
+
+    if (std::fclose(file) != 0 || last < num_to_spill)
+    {
+        // The segments of this batch still have their data, read them from memory
+        LOG("Replay: cannot write spill file '" + m_spill_filename + "', keeping further frames in memory");
+        m_spill_failed = true;
+        for (size_t i = first; i < last; ++i)
+        {
+            m_segments[i].spilled = false;
+            m_spill_end -= m_segments[i].spill_size;
+            m_spill_live_size -= m_segments[i].spill_size;
+        }
+        return;
+    }
+
+    for (size_t i = first; i < last; ++i)
+    {
+        std::vector<char>().swap(m_segments[i].data);
+    }
+}
+
+void ReplayRecorder::DropOldSegments()
+{
+    bool dropped_spilled = false;
+    while (m_segments.size() > 1 && this->GetEndFrame() - m_segments[1].first_frame >= m_max_frames)
+    {
+        if (m_segments.front().spilled)
+        {
+            m_spill_live_size -= m_segments.front().spill_size;
+            dropped_spilled = true;
+        }
+        m_segments.pop_front();
+    }
+
+    if (dropped_spilled)
+    {
+        // Spilled segments are the oldest ones, so the live data are the tail of the file
+        const size_t waste = (m_segments.front().spilled) ? m_segments.front().spill_offset : m_spill_end;
+        if (waste > std::max(m_spill_live_size, COMPACT_MIN_WASTE))
+            this->CompactSpillFile();
+    }
+}
+
+void ReplayRecorder::CompactSpillFile()
+{
+    if (!m_segments.front().spilled)
+    {
+        m_spill_map.Close();
+        std::remove(m_spill_filename.c_str());
+        m_spill_end = 0;
+        return;
+    }
+
+    const size_t live_begin = m_segments.front().spill_offset;
+    const size_t live_size = m_spill_end - live_begin;
+    if (!m_spill_map.IsOpen() || m_spill_map.GetSize() < m_spill_end)
+    {
+        if (!m_spill_map.Open(m_spill_filename) || m_spill_map.GetSize() < m_spill_end)
+            return;
+    }
+
+    // Write aside and rename, so a failed write leaves the old file intact
+    const std::string tmp_filename = m_spill_filename + ".new";
+    FILE* file = std::fopen(tmp_filename.c_str(), "wb");
+    if (!file)
+        return;
+    const size_t written = std::fwrite(m_spill_map.GetData() + live_begin, 1, live_size, file);
+    if (std::fclose(file) != 0 || written != live_size)
+    {
+        std::remove(tmp_filename.c_str());
+        return;
+    }
+
+    m_spill_map.Close();
+    std::remove(m_spill_filename.c_str());
+    if (std::rename(tmp_filename.c_str(), m_spill_filename.c_str()) != 0)
+    {
+        // The spilled frames are lost, the replay gets shorter
+        LOG("Replay: cannot replace spill file '" + m_spill_filename + "', keeping further frames in memory");
+        std::remove(tmp_filename.c_str());
+        while (m_segments.front().spilled)
+            m_segments.pop_front();
+        m_spill_failed = true;
+        m_spill_end = 0;
+        m_spill_live_size = 0;
+        m_dec_frame = -1;
+        return;
+    }
+
+    for (Segment& segment : m_segments)
+    {
+        if (segment.spilled)
+            segment.spill_offset -= live_begin;
+    }
+    m_spill_end = live_size;
+}
@@ -0,0 +1,136 @@
+/*
+    This source file is part of Rigs of Rods
+    Copyright 2013-2017 Petr Ohlidal & contributors
+
+    For more information, see http://www.rigsofrods.org/
+
+    Rigs of Rods is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License version 3, as
+    published by the Free Software Foundation.
+
+    Rigs of Rods is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with Rigs of Rods. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+/// @file
+/// @brief Compressed frame storage of Replay.
+
+#pragma once
+
+#include "MappedFile.h"
+
+#include <OgreVector3.h>
+
+#include <cstdint>
+#include <deque>
+#include <string>
+#include <vector>
+
+struct node_simple_t
+{
+    Ogre::Vector3 position;
+    Ogre::Vector3 velocity;
+};
+
+struct beam_simple_t
+{
+    bool broken;
+    bool disabled;
+};
+
+namespace RoR {
+
+/// Keeps the most recent frames of a truck, compressed.
+///
+/// Frames are grouped into segments of KEYFRAME_INTERVAL frames. The first frame of a segment
+/// stores absolute positions and velocities plus all beam states; the others store position
+/// residuals against a linear prediction from the two previous frames (quantized to
+/// 1/POSITION_SCALE m) and the beams whose state changed. Velocities of those frames are
+/// derived from the positions. A node moving steadily costs 1 byte or less per frame.
+///
+/// Only the newest MAX_MEMORY_SEGMENTS segments are kept in memory, older ones are appended
+/// to a spill file and read back through a memory mapping. The file is only open while appending,
+/// so the mapping can be opened on any platform. Frames are decoded on demand;
+/// reading consecutive frames forward decodes each frame once.
+class ReplayRecorder
+{
+public:
+    static const int   KEYFRAME_INTERVAL = 128;
+    static const int   MAX_MEMORY_SEGMENTS = 8;
+    static const float POSITION_SCALE;           // quantization steps per meter
+    static const float VELOCITY_SCALE;           // quantization steps per m/s, keyframes only
+
+    /// @param max_frames Frames to keep at least; older segments are dropped
+    /// @param spill_filename Created when needed, deleted by the destructor
+    ReplayRecorder(int num_nodes, int num_beams, int max_frames, std::string const& spill_filename);
+    ~ReplayRecorder();
+
+    /// @param time Microseconds
+    void WriteFrame(const node_simple_t* nodes, const beam_simple_t* beams, unsigned long time);
+
+    /// Available frames are [GetFirstFrame(), GetEndFrame()); frame numbers count from the first frame ever written.
+    int GetFirstFrame() const;
+    int GetEndFrame() const;
+
+    /// @return False if the frame isn't available or its data are damaged
+    bool ReadFrame(int frame, node_simple_t* out_nodes, beam_simple_t* out_beams, unsigned long& out_time);
+
+    size_t GetMemorySize() const;
+    size_t GetSpilledSize() const { return m_spill_live_size; }
+
+private:
+    struct Segment
+    {
+        int                        first_frame;
+        std::vector<unsigned long> times;        // one per frame
+        std::vector<char>          data;         // encoded frames; released once spilled
+        size_t                     spill_offset;
+        size_t                     spill_size;
+        bool                       spilled;
+    };
+
+    ReplayRecorder(ReplayRecorder const&);            // Not copyable
+    ReplayRecorder& operator=(ReplayRecorder const&);
+
+    void EncodeKeyframe(std::vector<char>& out, const node_simple_t* nodes, const beam_simple_t* beams);
+    void EncodeDelta(std::vector<char>& out, const node_simple_t* nodes, const beam_simple_t* beams, bool second_order);
+    bool DecodeFrame(const char*& pos, const char* end, int index_in_segment, Segment const& segment, node_simple_t* out_nodes);
+    const char* GetSegmentData(Segment const& segment, size_t& out_size);
+
+    void SpillSegments();
+    void DropOldSegments();
+    void CompactSpillFile();
+
+    int m_num_nodes;
+    int m_num_beams;
+    int m_max_frames;
+
+    std::deque<Segment> m_segments;
+
+    // encoder state: quantized positions of the two previous frames, previous beam states
+    std::vector<int32_t> m_enc_pos1;
+    std::vector<int32_t> m_enc_pos2;
+    std::vector<uint8_t> m_enc_beams;
+
+    // decoder state, see ReadFrame()
+    int                  m_dec_frame;         // last decoded frame, -1 = none
+    size_t               m_dec_offset;        // in its segment's data, after that frame
+    std::vector<int32_t> m_dec_pos1;
+    std::vector<int32_t> m_dec_pos2;
+    std::vector<uint8_t> m_dec_beams;
+    std::vector<Ogre::Vector3> m_dec_velocity; // of the last decoded keyframe
+
+    // spill file
+    std::string m_spill_filename;
+    bool        m_spill_failed;
+    size_t      m_spill_end;                  // bytes written
+    size_t      m_spill_live_size;            // bytes of segments still in use
+    MappedFile  m_spill_map;
+};
+
+} // namespace RoR
@@ -55,6 +55,8 @@
 #include "OgreSubsystem.h"
 #include "OutProtocol.h"
 #include "OverlayWrapper.h"
+#include "PhysicsBenchmark.h"
+#include "PhysicsRecording.h"
 #include "Replay.h"
 #include "RoRVersion.h"
 #include "SceneMouse.h"
@@ -2443,6 +2445,31 @@ void RoRFrameListener::EnterGameplayLoop()
     App::GetOverlayWrapper()->SetSimController(this);
     gEnv->cameraManager->SetSimController(this);
 
+    if (FSETTING("Physics Benchmark", 0.f) > 0.f)
+    {
+        // Command line `-benchphysics`; measure and quit without rendering a single frame
+        PhysicsBenchmark benchmark(FSETTING("Physics Benchmark", 0.f), SSETTING("Physics Benchmark Threads", ""));
+        benchmark.Run(m_beam_factory);
+        App::SetPendingAppState(App::APP_STATE_SHUTDOWN);
+    }
+    else if (!SSETTING("Physics Playback", "").empty())
+    {
+        // Command line `-playphysics`; replay and compare without rendering, then quit
+        std::unique_ptr<PhysicsRecorder> baseline;
+        if (!SSETTING("Physics Recording", "").empty() && SSETTING("Physics Recording", "") != SSETTING("Physics Playback", ""))
+            baseline.reset(new PhysicsRecorder(SSETTING("Physics Recording", "")));
+        PhysicsPlayer player(SSETTING("Physics Playback", ""), FSETTING("Physics Playback Tolerance", 0.f));
+        if (!player.Run(m_beam_factory, baseline.get()))
+        {
+            App::SetAppExitCode(1); // Let scripted regression runs detect the divergence
+        }
+        App::SetPendingAppState(App::APP_STATE_SHUTDOWN);
+    }
+    else if (!SSETTING("Physics Recording", "").empty())
+    {
+        m_beam_factory.StartPhysicsRecording(SSETTING("Physics Recording", ""));
+    }
+
     unsigned long timeSinceLastFrame = 1;
     unsigned long startTime = 0;
     unsigned long minTimePerFrame = 0;
@@ -43,6 +43,7 @@ public:
 
     DustPool* getGroundModelDustPool(ground_model_t* g);
 
+    /// Merges the emissions queued by all threads into the particle systems; main thread, once per frame
     void update();
 
     void setVisible(bool visible);
@@ -26,18 +26,75 @@
 #include "TerrainManager.h"
 #include "Water.h"
 
+#include <cmath>
+#include <cstdint>
+
 using namespace Ogre;
 
 #ifndef _WIN32
 // This definitions is needed because the variable is declared but not defined in DustPool
   const int DustPool::MAX_DUSTS;
+  const int DustPool::MAX_EMITTING_THREADS;
+  const int DustPool::EMISSION_RING_SIZE;
 #endif // !_WIN32
 
+const float DustPool::EMISSION_CELL_SIZE = 1.f;
+
+namespace {
+
+std::atomic<uint64_t> s_emitter_slots(0); // Bit set = ring index taken by a live thread; one bit per DustPool::MAX_EMITTING_THREADS
+
+/// Ring index of the calling thread, shared by all pools; returned when the thread exits
+struct EmitterSlot
+{
+    int index;
+
+    EmitterSlot(): index(-1)
+    {
+        uint64_t taken = s_emitter_slots.load();
+        while (true)
+        {
+            int bit = 0;
+            while (bit < 64 && (taken & (uint64_t(1) << bit)))
+                bit++;
+            if (bit == 64)
+                return; // No ring for this thread
+            if (s_emitter_slots.compare_exchange_weak(taken, taken | (uint64_t(1) << bit)))
+            {
+                index = bit;
+                return;
+            }
+        }
+    }
+
+    ~EmitterSlot()
+    {
+        if (index >= 0)
+            s_emitter_slots.fetch_and(~(uint64_t(1) << index));
+    }
+};
+
+int GetEmitterSlot()
+{
+    static thread_local EmitterSlot slot;
+    return slot.index;
+}
+
+} // namespace
+
 DustPool::DustPool(Ogre::SceneManager* sm, const char* dname, int dsize):
 	allocated(0),
 	size(std::min(dsize, static_cast<int>(MAX_DUSTS))),
 	m_is_discarded(false)
 {
+    for (int i = 0; i < MAX_EMITTING_THREADS; i++)
+    {
+        m_rings[i].head.store(0);
+        m_rings[i].tail.store(0);
+        m_rings[i].last_frame = ~0u;
+    }
+    m_frame.store(0);
+
     for (int i = 0; i < size; i++)
     {
         char dename[256];
@@ -87,47 +144,56 @@ void DustPool::setVisible(bool s)
     }
 }
 
+void DustPool::emit(int type, const Vector3& pos, const Vector3& vel, const ColourValue& col, float rate)
+{
+    const int slot = GetEmitterSlot();
+    if (slot < 0 || slot >= MAX_EMITTING_THREADS)
+        return;
+    emission_ring_t& ring = m_rings[slot];
+
+    // Rate limiting: neighbouring nodes mostly emit into the same cell, one emitter per cell is enough
+    const unsigned int frame = m_frame.load(std::memory_order_relaxed);
+    const int cell_x = static_cast<int>(std::floor(pos.x / EMISSION_CELL_SIZE));
+    const int cell_z = static_cast<int>(std::floor(pos.z / EMISSION_CELL_SIZE));
+    if (ring.last_frame == frame && ring.last_type == type && ring.last_cell_x == cell_x && ring.last_cell_z == cell_z)
+        return;
+
+    const unsigned int head = ring.head.load(std::memory_order_relaxed);
+    if (head - ring.tail.load(std::memory_order_acquire) >= static_cast<unsigned int>(EMISSION_RING_SIZE))
+        return; // Full until the next update()
+
+    emission_t& e = ring.emissions[head % EMISSION_RING_SIZE];
+    e.position = pos;
+    e.velocity = vel;
+    e.colour   = col;
+    e.rate     = rate;
+    e.type     = type;
+    e.cell_x   = cell_x;
+    e.cell_z   = cell_z;
+    ring.head.store(head + 1, std::memory_order_release);
+
+    ring.last_frame  = frame;
+    ring.last_type   = type;
+    ring.last_cell_x = cell_x;
+    ring.last_cell_z = cell_z;
+}
+
 //Dust
 void DustPool::malloc(Vector3 pos, Vector3 vel, ColourValue col)
 {
-    std::lock_guard<std::mutex> lock(m_allocation_mutex);
-    if (allocated < size)
-    {
-        positions[allocated] = pos;
-        velocities[allocated] = vel;
-        colours[allocated] = col;
-        types[allocated] = DUST_NORMAL;
-        allocated++;
-    }
+    emit(DUST_NORMAL, pos, vel, col);
 }
 
 //Clumps
 void DustPool::allocClump(Vector3 pos, Vector3 vel, ColourValue col)
 {
-    std::lock_guard<std::mutex> lock(m_allocation_mutex);
-    if (allocated < size)
-    {
-        positions[allocated] = pos;
-        velocities[allocated] = vel;
-        colours[allocated] = col;
-        types[allocated] = DUST_CLUMP;
-        //visible[allocated]=true;
-        allocated++;
-    }
+    emit(DUST_CLUMP, pos, vel, col);
 }
 
 //Rubber smoke
 void DustPool::allocSmoke(Vector3 pos, Vector3 vel)
 {
-    std::lock_guard<std::mutex> lock(m_allocation_mutex);
-    if (allocated < size)
-    {
-        positions[allocated] = pos;
-        velocities[allocated] = vel;
-        types[allocated] = DUST_RUBBER;
-        //visible[allocated]=true;
-        allocated++;
-    }
+    emit(DUST_RUBBER, pos, vel);
 }
 
 //
@@ -135,75 +201,67 @@ void DustPool::allocSparks(Vector3 pos, Vector3 vel)
 {
     if (vel.length() < 0.1)
         return; // try to prevent emitting sparks while standing
-    std::lock_guard<std::mutex> lock(m_allocation_mutex);
-    if (allocated < size)
-    {
-        positions[allocated] = pos;
-        velocities[allocated] = vel;
-        types[allocated] = DUST_SPARKS;
-        //visible[allocated]=true;
-        allocated++;
-    }
+    emit(DUST_SPARKS, pos, vel);
 }
 
 //Water vapour
 void DustPool::allocVapour(Vector3 pos, Vector3 vel, float time)
 {
-    std::lock_guard<std::mutex> lock(m_allocation_mutex);
-    if (allocated < size)
-    {
-        positions[allocated] = pos;
-        velocities[allocated] = vel;
-        types[allocated] = DUST_VAPOUR;
-        rates[allocated] = 5.0 - time;
-        //visible[allocated]=true;
-        allocated++;
-    }
+    emit(DUST_VAPOUR, pos, vel, ColourValue::ZERO, 5.0 - time);
 }
 
 void DustPool::allocDrip(Vector3 pos, Vector3 vel, float time)
 {
-    std::lock_guard<std::mutex> lock(m_allocation_mutex);
-    if (allocated < size)
-    {
-        positions[allocated] = pos;
-        velocities[allocated] = vel;
-        types[allocated] = DUST_DRIP;
-        rates[allocated] = 5.0 - time;
-        //visible[allocated]=true;
-        allocated++;
-    }
+    emit(DUST_DRIP, pos, vel, ColourValue::ZERO, 5.0 - time);
 }
 
 void DustPool::allocSplash(Vector3 pos, Vector3 vel)
 {
-    std::lock_guard<std::mutex> lock(m_allocation_mutex);
-    if (allocated < size)
-    {
-        positions[allocated] = pos;
-        velocities[allocated] = vel;
-        types[allocated] = DUST_SPLASH;
-        //visible[allocated]=true;
-        allocated++;
-    }
+    emit(DUST_SPLASH, pos, vel);
 }
 
 void DustPool::allocRipple(Vector3 pos, Vector3 vel)
 {
-    std::lock_guard<std::mutex> lock(m_allocation_mutex);
-    if (allocated < size)
-    {
-        positions[allocated] = pos;
-        velocities[allocated] = vel;
-        types[allocated] = DUST_RIPPLE;
-        //visible[allocated]=true;
-        allocated++;
-    }
+    emit(DUST_RIPPLE, pos, vel);
 }
 
 void DustPool::update()
 {
-    std::lock_guard<std::mutex> lock(m_allocation_mutex);
+    // Merge the rings; emissions into a cell which already has one are redundant
+    const unsigned int frame = m_frame.fetch_add(1, std::memory_order_relaxed);
+    int cells_x[MAX_DUSTS];
+    int cells_z[MAX_DUSTS];
+    allocated = 0;
+    for (int r = 0; r < MAX_EMITTING_THREADS; r++)
+    {
+        emission_ring_t& ring = m_rings[(r + frame) % MAX_EMITTING_THREADS]; // Rotate, so no thread gets precedence
+        unsigned int tail = ring.tail.load(std::memory_order_relaxed);
+        const unsigned int head = ring.head.load(std::memory_order_acquire);
+        for (; tail != head; tail++)
+        {
+            const emission_t& e = ring.emissions[tail % EMISSION_RING_SIZE];
+            if (allocated >= size)
+                continue;
+            bool cell_taken = false;
+            for (int i = 0; i < allocated && !cell_taken; i++)
+            {
+                cell_taken = (types[i] == e.type && cells_x[i] == e.cell_x && cells_z[i] == e.cell_z);
+            }
+            if (cell_taken)
+                continue;
+
+            positions[allocated]  = e.position;
+            velocities[allocated] = e.velocity;
+            colours[allocated]    = e.colour;
+            rates[allocated]      = e.rate;
+            types[allocated]      = e.type;
+            cells_x[allocated]    = e.cell_x;
+            cells_z[allocated]    = e.cell_z;
+            allocated++;
+        }
+        ring.tail.store(tail, std::memory_order_release);
+    }
+
     for (int i = 0; i < allocated; i++)
     {
         ParticleEmitter* emit = pss[i]->getEmitter(0);
@@ -22,8 +22,10 @@
 
 #include "RoRPrerequisites.h"
 
-#include <mutex>
+#include <atomic>
 
+/// Emissions may come from any thread (see Beam::calcNodes()); each thread writes its own ring buffer
+/// without locking, update() merges them on the main thread once per frame.
 class DustPool : public ZeroedMemoryAllocator
 {
 public:
@@ -56,6 +58,9 @@ public:
 protected:
 
     static const int MAX_DUSTS = 100;
+    static const int MAX_EMITTING_THREADS = 64;   // rings per pool; further threads' emissions are dropped
+    static const int EMISSION_RING_SIZE = 32;     // per thread and frame; emissions to a full ring are dropped
+    static const float EMISSION_CELL_SIZE;        // one emission per cell, type and frame
 
     enum DustTypes
     {
@@ -81,5 +86,32 @@ protected:
     int types[MAX_DUSTS];
 	bool m_is_discarded;
 
-    std::mutex m_allocation_mutex;
+    struct emission_t
+    {
+        Ogre::Vector3 position;
+        Ogre::Vector3 velocity;
+        Ogre::ColourValue colour;
+        float rate;
+        int type;
+        int cell_x;
+        int cell_z;
+    };
+
+    /// Single producer (the thread owning the slot), single consumer (update())
+    struct emission_ring_t
+    {
+        emission_t emissions[EMISSION_RING_SIZE];
+        std::atomic<unsigned int> head; // written by the producer only
+        std::atomic<unsigned int> tail; // written by update() only
+        // producer's rate limiting
+        unsigned int last_frame;
+        int last_cell_x;
+        int last_cell_z;
+        int last_type;
+    };
+
+    void emit(int type, const Ogre::Vector3& pos, const Ogre::Vector3& vel, const Ogre::ColourValue& col = Ogre::ColourValue::ZERO, float rate = 0.f);
+
+    emission_ring_t m_rings[MAX_EMITTING_THREADS];
+    std::atomic<unsigned int> m_frame; // incremented by update()
 };
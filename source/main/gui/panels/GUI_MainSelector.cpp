@@ -700,7 +700,7 @@ void CLASS::OnSelectionDone()
     m_selection_done = true;
 
     m_selected_entry->usagecounter++;
-    // TODO: Save the modified value of the usagecounter
+    RoR::App::GetCacheSystem()->updateSingleTruckEntryCache(m_selected_entry->number, *m_selected_entry);
 
     if (m_loader_type != LT_SKIN)
     {
@@ -421,7 +421,7 @@ int main(int argc, char *argv[])
     UninstallCrashRpt();
 #endif //USE_CRASHRPT
 
-    return 0;
+    return App::GetAppExitCode();
 }
 
 #if OGRE_PLATFORM == OGRE_PLATFORM_WIN32
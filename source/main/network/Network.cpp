@@ -31,6 +31,7 @@
 #include "GUIManager.h"
 #include "GUI_TopMenubar.h"
 #include "Language.h"
+#include "LockFreeQueues.h"
 #include "RoRVersion.h"
 #include "SHA1.h"
 #include "ScriptEngine.h"
@@ -44,9 +45,10 @@
 #include <atomic>
 #include <chrono>
 #include <condition_variable>
+#include <memory>
 #include <mutex>
-#include <deque>
 #include <thread>
+#include <unordered_map>
 
 namespace RoR {
 namespace Networking {
@@ -88,8 +90,7 @@ using namespace RoRnet;
 
 struct send_packet_t
 {
-    char buffer[RORNET_MAX_MESSAGE_LENGTH];
-    int size;
+    std::vector<char> buffer; // Header + payload
 };
 
 static RoRnet::ServerInfo m_server_settings;
@@ -116,16 +117,18 @@ static std::atomic<bool> m_recv_stopped;
 static std::mutex m_users_mutex;
 static std::mutex m_userdata_mutex;
 static std::mutex m_error_message_mutex;
-static std::mutex m_recv_packetqueue_mutex;
 static std::mutex m_send_packetqueue_mutex;
 
 static std::condition_variable m_send_packet_available_cv;
 
-static std::vector<recv_packet_t> m_recv_packet_buffer;
-static std::deque <send_packet_t> m_send_packet_buffer;
+static std::vector<send_packet_t> m_send_packet_buffer;
+static std::unordered_map<uint64_t, size_t> m_send_stream_data_index; // (streamid, command) -> queued stream data packet
 
 static const unsigned int m_packet_buffer_size = 20;
 
+static unsigned long m_truck_send_interval;     // Milliseconds
+static unsigned long m_character_send_interval; // Milliseconds
+
 static std::atomic<bool> m_net_fatal_error;
 static std::atomic<bool> m_socket_broken;
 static Ogre::UTFString   m_error_message;
@@ -135,6 +138,127 @@ static Ogre::UTFString   m_error_message;
 
 static const int RECVMESSAGE_RETVAL_SHUTDOWN = -43;
 
+// ----------------------- Received packet pool -------------------------
+
+/// Header of a pooled receive buffer; the payload follows it in the same allocation.
+struct PacketBlock
+{
+    std::atomic<int> refs;
+    int              size_class;
+    RoRnet::Header   header;
+};
+
+static const size_t PACKET_SIZE_CLASSES[] = { 256, 1024, 4096, RORNET_MAX_MESSAGE_LENGTH };
+static const int    NUM_PACKET_SIZE_CLASSES = sizeof(PACKET_SIZE_CLASSES) / sizeof(size_t);
+
+static MPMCQueue<PacketBlock, 256>  m_packet_pool[NUM_PACKET_SIZE_CLASSES]; // Free blocks; filled by the main thread, used by RecvThread
+static SPSCQueue<PacketBlock, 8192> m_recv_packet_queue;                    // RecvThread -> main thread
+
+static char* GetPacketData(PacketBlock* block)
+{
+    return reinterpret_cast<char*>(block + 1);
+}
+
+/// @param capacity Minimum payload capacity, at most RORNET_MAX_MESSAGE_LENGTH
+static PacketBlock* AcquirePooledBlock(size_t capacity)
+{
+    int size_class = 0;
+    while (PACKET_SIZE_CLASSES[size_class] < capacity)
+    {
+        ++size_class;
+    }
+
+    PacketBlock* block = m_packet_pool[size_class].Pop();
+    if (block == nullptr)
+    {
+        block = new (::operator new(sizeof(PacketBlock) + PACKET_SIZE_CLASSES[size_class])) PacketBlock();
+        block->size_class = size_class;
+    }
+    block->refs.store(1, std::memory_order_relaxed);
+    return block;
+}
+
+static void ReleasePacketBlock(PacketBlock* block)
+{
+    if (block->refs.fetch_sub(1, std::memory_order_acq_rel) != 1)
+        return;
+
+    if (!m_packet_pool[block->size_class].Push(block))
+    {
+        block->~PacketBlock();
+        ::operator delete(block);
+    }
+}
+
+struct PacketBlockReleaser
+{
+    void operator()(PacketBlock* block) const { ReleasePacketBlock(block); }
+};
+
+typedef std::unique_ptr<PacketBlock, PacketBlockReleaser> PacketBlockPtr;
+
+/// Gets a block for a message with the given header; the payload area past `header.size` is zeroed.
+static PacketBlockPtr AcquirePacketBlock(RoRnet::Header const& header)
+{
+    size_t view_size = header.size + 1; // Text messages are used as C strings
+    if (header.command == MSG2_STREAM_REGISTER || header.command == MSG2_STREAM_REGISTER_RESULT)
+    {
+        view_size = std::max(view_size, sizeof(RoRnet::StreamRegister)); // Consumers cast and re-send the payload as a whole
+    }
+    view_size = std::min(view_size, size_t(RORNET_MAX_MESSAGE_LENGTH));
+
+    PacketBlockPtr block(AcquirePooledBlock(view_size));
+    block->header = header;
+    memset(GetPacketData(block.get()) + header.size, 0, view_size - header.size);
+    return block;
+}
+
+recv_packet_t::recv_packet_t():
+    buffer(nullptr),
+    m_block(nullptr)
+{
+    memset(&header, 0, sizeof(header));
+}
+
+recv_packet_t::recv_packet_t(PacketBlock* block):
+    header(block->header),
+    buffer(GetPacketData(block)),
+    m_block(block)
+{
+}
+
+recv_packet_t::recv_packet_t(recv_packet_t const& other):
+    header(other.header),
+    buffer(other.buffer),
+    m_block(other.m_block)
+{
+    if (m_block != nullptr)
+        m_block->refs.fetch_add(1, std::memory_order_relaxed);
+}
+
+recv_packet_t::recv_packet_t(recv_packet_t&& other):
+    header(other.header),
+    buffer(other.buffer),
+    m_block(other.m_block)
+{
+    other.buffer = nullptr;
+    other.m_block = nullptr;
+}
+
+recv_packet_t& recv_packet_t::operator=(recv_packet_t other)
+{
+    std::swap(header, other.header);
+    std::swap(buffer, other.buffer);
+    std::swap(m_block, other.m_block);
+    return *this;
+}
+
+recv_packet_t::~recv_packet_t()
+{
+    if (m_block != nullptr)
+        ReleasePacketBlock(m_block);
+}
+
 Ogre::ColourValue GetPlayerColor(int color_num)
 {
     int numColours = sizeof(MP_COLORS) / sizeof(Ogre::ColourValue);
@@ -254,49 +378,61 @@ bool SendNetMessage(int type, unsigned int streamid, int len, char* content)
     return SendMessageRaw(buffer, msgsize);
 }
 
-void QueueStreamData(RoRnet::Header &header, char *buffer, size_t buffer_len)
+/// Hands a packet over to the main thread, see GetIncomingStreamData()
+void QueueStreamData(PacketBlockPtr block)
 {
-    recv_packet_t packet;
-    packet.header = header;
-    memcpy(packet.buffer, buffer, std::min(buffer_len, size_t(RORNET_MAX_MESSAGE_LENGTH)));
+    // Wait for the main thread to catch up rather than dropping packets
+    while (!m_recv_packet_queue.Push(block.get()))
+    {
+        if (m_shutdown)
+            return;
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+    block.release();
+}
 
-    std::lock_guard<std::mutex> lock(m_recv_packetqueue_mutex);
-    m_recv_packet_buffer.push_back(packet);
+void QueueStreamData(RoRnet::Header &header, char *buffer, size_t buffer_len)
+{
+    PacketBlockPtr block = AcquirePacketBlock(header);
+    memcpy(GetPacketData(block.get()), buffer, std::min(buffer_len, size_t(header.size)));
+    QueueStreamData(std::move(block));
 }
 
-int ReceiveMessage(RoRnet::Header *head, char* content, int bufferlen)
+/// Reads exactly `len` bytes from the socket
+int ReceiveBytes(char* dest, int len)
 {
     SWBaseSocket::SWBaseError error;
 
-    char buffer[RORNET_MAX_MESSAGE_LENGTH] = {0};
-
-#ifdef DEBUG
-	LOG_THREAD("[RoR|Networking] ReceiveMessage() waiting...");
-#endif //DEBUG
-
-    int hlen = 0;
-    while (hlen < (int)sizeof(RoRnet::Header))
+    int pos = 0;
+    while (pos < len)
     {
-        int recvnum = socket.recv(buffer + hlen, sizeof(RoRnet::Header) - hlen, &error);
+        int recvnum = socket.recv(dest + pos, len - pos, &error);
         if (recvnum < 0 && !m_shutdown)
         {
-            LOG("NET receive error 1: " + error.get_error());
+            LOG_THREAD("NET receive error: " + error.get_error());
             return -1;
         }
         else if (m_shutdown)
         {
-            break;
+            return RECVMESSAGE_RETVAL_SHUTDOWN;
         }
-        hlen += recvnum;
+        pos += recvnum;
     }
+    return 0;
+}
+
+int ReceiveHeader(RoRnet::Header *head)
+{
+#ifdef DEBUG
+	LOG_THREAD("[RoR|Networking] ReceiveMessage() waiting...");
+#endif //DEBUG
 
-    if (m_shutdown)
+    int err = ReceiveBytes((char*)head, sizeof(RoRnet::Header));
+    if (err != 0)
     {
-        return RECVMESSAGE_RETVAL_SHUTDOWN;
+        return err;
     }
 
-    memcpy(head, buffer, sizeof(RoRnet::Header));
-
 #ifdef DEBUG
     LOG_THREAD("[RoR|Networking] ReceiveMessage() header received");
 #endif //DEBUG
@@ -305,27 +441,25 @@ int ReceiveMessage(RoRnet::Header *head, char* content, int bufferlen)
     {
         return -3;
     }
+    return 0;
+}
 
-    if (head->size > 0)
+int ReceiveMessage(RoRnet::Header *head, char* content, int bufferlen)
+{
+    int err = ReceiveHeader(head);
+    if (err != 0)
     {
-        // Read the packet content
-        while (hlen < (int)sizeof(RoRnet::Header) + (int)head->size)
-        {
-            int recvnum = socket.recv(buffer + hlen, (head->size + sizeof(RoRnet::Header)) - hlen, &error);
-            if (recvnum < 0 && !m_shutdown)
-            {
-                LOG_THREAD("NET receive error 2: "+ error.get_error());
-                return -1;
-            }
-            else if (m_shutdown)
-            {
-                break;
-            }
-            hlen += recvnum;
-        }
+        return err;
+    }
+
+    char buffer[RORNET_MAX_MESSAGE_LENGTH] = {0};
+    err = ReceiveBytes(buffer, head->size);
+    if (err != 0)
+    {
+        return err;
     }
 
-    memcpy(content, buffer + sizeof(RoRnet::Header), bufferlen);
+    memcpy(content, buffer, bufferlen);
 
 #ifdef DEBUG
     LOG_THREAD("[RoR|Networking] ReceiveMessage() body received");
@@ -337,26 +471,33 @@ int ReceiveMessage(RoRnet::Header *head, char* content, int bufferlen)
 void SendThread()
 {
     LOG("[RoR|Networking] SendThread started");
+
+    std::vector<send_packet_t> batch;
+    std::vector<char> send_buffer;
     while (!m_shutdown)
     {
-        std::unique_lock<std::mutex> queue_lock(m_send_packetqueue_mutex);
-        while (!m_shutdown && m_send_packet_buffer.empty())
-        {
-            m_send_packet_available_cv.wait(queue_lock);
+        { // Lock scope; take everything queued so far
+            std::unique_lock<std::mutex> queue_lock(m_send_packetqueue_mutex);
+            while (!m_shutdown && m_send_packet_buffer.empty())
+            {
+                m_send_packet_available_cv.wait(queue_lock);
+            }
+            batch.swap(m_send_packet_buffer);
+            m_send_stream_data_index.clear();
         }
 
-        while (!m_shutdown && !m_send_packet_buffer.empty())
+        // SocketW has no vectored send; gather the batch and write it with a single call
+        send_buffer.clear();
+        for (send_packet_t const& packet : batch)
         {
-            send_packet_t packet = m_send_packet_buffer.front();
-            m_send_packet_buffer.pop_front();
+            send_buffer.insert(send_buffer.end(), packet.buffer.begin(), packet.buffer.end());
+        }
+        batch.clear();
 
-            queue_lock.unlock();
-            SendMessageRaw(packet.buffer, packet.size);
-            queue_lock.lock();
+        if (!m_shutdown && !send_buffer.empty())
+        {
+            SendMessageRaw(send_buffer.data(), (int)send_buffer.size());
         }
-        queue_lock.unlock();
-        std::this_thread::sleep_for(std::chrono::milliseconds(200));
-        queue_lock.lock();
     }
     LOG("[RoR|Networking] SendThread stopped");
 }
@@ -367,11 +508,18 @@ void RecvThread()
 
     RoRnet::Header header;
 
-    char *buffer = (char*)malloc(RORNET_MAX_MESSAGE_LENGTH);
-
     while (!m_shutdown)
     {
-        int err = ReceiveMessage(&header, buffer, RORNET_MAX_MESSAGE_LENGTH);
+        // The payload is received straight into the pooled buffer which is handed to the main thread
+        PacketBlockPtr block;
+        char* buffer = nullptr;
+        int err = ReceiveHeader(&header);
+        if (err == 0)
+        {
+            block = AcquirePacketBlock(header);
+            buffer = GetPacketData(block.get());
+            err = ReceiveBytes(buffer, header.size);
+        }
         //LOG("Received data: " + TOSTRING(header.command) + ", source: " + TOSTRING(header.source) + ":" + TOSTRING(header.streamid) + ", size: " + TOSTRING(header.size));
         if (err != 0)
         {
@@ -495,7 +643,7 @@ void RecvThread()
         }
         //DebugPacket("receive-1", &header, buffer);
 
-        QueueStreamData(header, buffer, RORNET_MAX_MESSAGE_LENGTH);
+        QueueStreamData(std::move(block));
     }
 
     m_recv_stopped = true;
@@ -687,6 +835,9 @@ bool Connect()
     // we get our userdata back
     memcpy(&m_userdata, buffer, std::min<int>(sizeof(RoRnet::UserInfo), header.size));
 
+    m_truck_send_interval     = 1000 / std::max(1, ISETTING("Network Truck Send Rate", 20));     // Hz
+    m_character_send_interval = 1000 / std::max(1, ISETTING("Network Character Send Rate", 10)); // Hz
+
     m_shutdown = false;
 
     LOG("[RoR|Networking] Connect(): Creating Send/Recv threads");
@@ -723,8 +874,12 @@ void Disconnect()
     socket.disconnect();
 
     m_users.clear();
-    m_recv_packet_buffer.clear();
+    while (PacketBlock* block = m_recv_packet_queue.Pop())
+    {
+        ReleasePacketBlock(block);
+    }
     m_send_packet_buffer.clear();
+    m_send_stream_data_index.clear();
 
     m_shutdown = false;
     RoR::App::SetActiveMpState(RoR::App::MP_STATE_DISABLED);
@@ -733,32 +888,29 @@ void Disconnect()
     LOG("[RoR|Networking] Disconnect() done");
 }
 
-void AddPacket(int streamid, int type, int len, char *content)
+bool AddPacket(int streamid, int type, int len, char *content)
 {
     if (len > RORNET_MAX_MESSAGE_LENGTH)
     {
         LOGSTREAM << "[RoR|Networking] Discarding network packet (StreamID: "
             <<streamid<<", Type: "<<type<<"), length is " << len << ", max is " << RORNET_MAX_MESSAGE_LENGTH;
-        return;
+        return false;
     }
 
     send_packet_t packet;
-    memset(&packet, 0, sizeof(send_packet_t));
+    packet.buffer.resize(sizeof(RoRnet::Header) + len);
 
-    char *buffer = (char*)(packet.buffer);
-
-    RoRnet::Header *head = (RoRnet::Header *)buffer;
+    RoRnet::Header *head = (RoRnet::Header *)packet.buffer.data();
     head->command  = type;
     head->source   = m_uid;
     head->size     = len;
     head->streamid = streamid;
 
     // then copy the contents
-    char *bufferContent = (char *)(buffer + sizeof(RoRnet::Header));
-    memcpy(bufferContent, content, len);
-
-    // record the packet size
-    packet.size = len + sizeof(RoRnet::Header);
+    if (len > 0)
+    {
+        memcpy(packet.buffer.data() + sizeof(RoRnet::Header), content, len);
+    }
 
     { // Lock scope
         std::lock_guard<std::mutex> lock(m_send_packetqueue_mutex);
@@ -767,20 +919,23 @@ void AddPacket(int streamid, int type, int len, char *content)
             if (m_send_packet_buffer.size() > m_packet_buffer_size)
             {
                 // buffer full, discard unimportant data packets
-                return;
+                return false;
             }
-            auto search = std::find_if(m_send_packet_buffer.begin(), m_send_packet_buffer.end(), [packet](const send_packet_t& p) { return memcmp(packet.buffer, p.buffer, sizeof(RoRnet::Header)) == 0; });
-            if (search != m_send_packet_buffer.end())
+            const uint64_t key = (static_cast<uint64_t>(streamid) << 32) | static_cast<uint32_t>(type);
+            auto search = m_send_stream_data_index.find(key);
+            if (search != m_send_stream_data_index.end())
             {
-                // Found an older packet with the same header -> replace it
-                (*search) = packet;
-                return;
+                // Found an older packet of the same stream which wasn't sent yet -> replace it
+                m_send_packet_buffer[search->second] = std::move(packet);
+                return false;
             }
+            m_send_stream_data_index[key] = m_send_packet_buffer.size();
         }
-        m_send_packet_buffer.push_back(packet);
+        m_send_packet_buffer.push_back(std::move(packet));
     }
 
     m_send_packet_available_cv.notify_one();
+    return true;
 }
 
 void AddLocalStream(RoRnet::StreamRegister *reg, int size)
@@ -795,12 +950,24 @@ void AddLocalStream(RoRnet::StreamRegister *reg, int size)
     m_stream_id++;
 }
 
+unsigned long GetStreamSendInterval(int stream_type)
+{
+    switch (stream_type)
+    {
+    case 0:  return m_truck_send_interval;
+    case 1:  return m_character_send_interval;
+    default: return 0;
+    }
+}
+
 std::vector<recv_packet_t> GetIncomingStreamData()
 {
-    std::lock_guard<std::mutex> lock(m_recv_packetqueue_mutex);
-    std::vector<recv_packet_t> buf_copy = m_recv_packet_buffer;
-    m_recv_packet_buffer.clear();
-    return buf_copy;
+    std::vector<recv_packet_t> packets;
+    while (PacketBlock* block = m_recv_packet_queue.Pop())
+    {
+        packets.emplace_back(block);
+    }
+    return packets;
 }
 
 Ogre::String GetTerrainName()
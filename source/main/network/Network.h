@@ -64,22 +64,42 @@ struct CharacterMsgAttach
     int32_t position;
 };
 
+#pragma pack(pop)
+
+// ------------------------ End of network messages --------------------------
+
+struct PacketBlock; // Pooled storage, see Network.cpp
+
+/// A received message. The payload is received directly into a pooled, reference counted
+/// buffer which is shared by all copies of the packet, so handing packets around doesn't copy it.
 struct recv_packet_t
 {
-    RoRnet::Header header;
-    char buffer[RORNET_MAX_MESSAGE_LENGTH];
-};
+    recv_packet_t();
+    explicit recv_packet_t(PacketBlock* block); //!< Takes over the caller's reference
+    recv_packet_t(recv_packet_t const& other);
+    recv_packet_t(recv_packet_t&& other);
+    recv_packet_t& operator=(recv_packet_t other);
+    ~recv_packet_t();
 
-#pragma pack(pop)
+    RoRnet::Header header;
+    char*          buffer; //!< `header.size` bytes, followed by zeros
 
-// ------------------------ End of network messages --------------------------
+private:
+    PacketBlock*   m_block;
+};
 
 bool Connect();
 void Disconnect();
 
-void AddPacket(int streamid, int type, int len, char *content);
+/// @return False if this or an older queued stream data packet was discarded (too big, send queue full, or replaced)
+bool AddPacket(int streamid, int type, int len, char *content);
 void AddLocalStream(RoRnet::StreamRegister *reg, int size);
 
+/// Minimum time between stream data packets of a local stream, see settings "Network Truck/Character Send Rate".
+/// @param stream_type As in RoRnet::StreamRegister::type
+/// @return Milliseconds
+unsigned long GetStreamSendInterval(int stream_type);
+
 std::vector<recv_packet_t> GetIncomingStreamData();
 
 int GetUID();
@@ -0,0 +1,137 @@
+/*
+    This source file is part of Rigs of Rods
+    Copyright 2013-2017 Petr Ohlidal & contributors
+
+    For more information, see http://www.rigsofrods.org/
+
+    Rigs of Rods is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License version 3, as
+    published by the Free Software Foundation.
+
+    Rigs of Rods is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with Rigs of Rods. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "TruckSnapshotBuffer.h"
+
+#include <algorithm>
+#include <cmath>
+
+using namespace RoR;
+
+namespace {
+
+const float INITIAL_INTERVAL     = 100.f;  //!< Milliseconds; until measured
+const float MIN_PLAYOUT_DELAY    = 20.f;   //!< Milliseconds
+const float MAX_PLAYOUT_DELAY    = 1000.f; //!< Milliseconds
+const float JITTER_FACTOR        = 3.f;    //!< Playout delay = send interval + JITTER_FACTOR * jitter
+const float ESTIMATE_GAIN        = 1.f / 16.f;
+const float DELAY_GAIN           = 0.1f;   //!< Smooths changes of the playout delay
+const float CLOCK_OFFSET_GAIN    = 0.01f;  //!< Lets the clock offset recover from an unusually fast packet
+const float MAX_EXTRAPOLATION    = 250.f;  //!< Milliseconds; remote trucks freeze afterwards
+
+} // namespace
+
+TruckSnapshotBuffer::TruckSnapshotBuffer():
+    m_newest(0),
+    m_count(0),
+    m_clock_offset(0.0),
+    m_interval(INITIAL_INTERVAL),
+    m_jitter(0.f),
+    m_delay(INITIAL_INTERVAL)
+{
+}
+
+void TruckSnapshotBuffer::Setup(int num_nodes, int num_wheels)
+{
+    for (Snapshot& snapshot : m_slots)
+    {
+        snapshot.positions.assign(num_nodes * 3, 0.f);
+        snapshot.wheel_rp.assign(num_wheels, 0.f);
+    }
+    m_count = 0;
+}
+
+void TruckSnapshotBuffer::Push(unsigned long arrival_time)
+{
+    Snapshot& snapshot = this->GetWriteSlot();
+    snapshot.arrival_time = arrival_time;
+    const double offset = static_cast<double>(arrival_time) - snapshot.state.time;
+
+    if (m_count > 0 && snapshot.state.time <= this->GetSnapshot(0).state.time)
+    {
+        m_count = 0; // Remote clock restarted, old states are useless
+    }
+
+    if (m_count == 0)
+    {
+        m_clock_offset = offset;
+    }
+    else
+    {
+        Snapshot const& prev = this->GetSnapshot(0);
+        const float send_interval = static_cast<float>(snapshot.state.time - prev.state.time);
+        const float recv_interval = static_cast<float>(arrival_time - prev.arrival_time);
+        m_interval += (send_interval - m_interval) * ESTIMATE_GAIN;
+        m_jitter   += (std::abs(recv_interval - send_interval) - m_jitter) * ESTIMATE_GAIN;
+
+        if (offset < m_clock_offset)
+            m_clock_offset = offset;
+        else
+            m_clock_offset += (offset - m_clock_offset) * CLOCK_OFFSET_GAIN;
+    }
+
+    const float target_delay = std::max(MIN_PLAYOUT_DELAY, std::min(m_interval + JITTER_FACTOR * m_jitter, MAX_PLAYOUT_DELAY));
+    m_delay = (m_count == 0) ? target_delay : (m_delay + (target_delay - m_delay) * DELAY_GAIN);
+
+    m_newest = (m_newest + 1) % CAPACITY;
+    m_count = std::min(m_count + 1, CAPACITY - 1); // The slot after the newest is the write slot
+}
+
+TruckSnapshotBuffer::Sample TruckSnapshotBuffer::GetSample(unsigned long now) const
+{
+    const double render_time = static_cast<double>(now) - m_clock_offset - m_delay; // Remote clock
+
+    Sample sample;
+    Snapshot const& newest = this->GetSnapshot(0);
+    if (m_count == 1)
+    {
+        sample.s0 = sample.s1 = &newest;
+        sample.ratio = 0.f;
+        return sample;
+    }
+
+    if (render_time >= newest.state.time)
+    {
+        // Late; continue the motion between the last 2 states
+        Snapshot const& prev = this->GetSnapshot(1);
+        const double t = std::min(render_time, newest.state.time + static_cast<double>(MAX_EXTRAPOLATION));
+        sample.s0 = &prev;
+        sample.s1 = &newest;
+        sample.ratio = static_cast<float>((t - prev.state.time) / (newest.state.time - prev.state.time));
+        return sample;
+    }
+
+    for (int age = 1; age < m_count; age++)
+    {
+        Snapshot const& older = this->GetSnapshot(age);
+        if (render_time >= older.state.time)
+        {
+            Snapshot const& newer = this->GetSnapshot(age - 1);
+            sample.s0 = &older;
+            sample.s1 = &newer;
+            sample.ratio = static_cast<float>((render_time - older.state.time) / (newer.state.time - older.state.time));
+            return sample;
+        }
+    }
+
+    // Older than anything we have
+    sample.s0 = sample.s1 = &this->GetSnapshot(m_count - 1);
+    sample.ratio = 0.f;
+    return sample;
+}
@@ -0,0 +1,86 @@
+/*
+    This source file is part of Rigs of Rods
+    Copyright 2013-2017 Petr Ohlidal & contributors
+
+    For more information, see http://www.rigsofrods.org/
+
+    Rigs of Rods is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License version 3, as
+    published by the Free Software Foundation.
+
+    Rigs of Rods is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with Rigs of Rods. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+/// @file
+/// @brief Playout buffer for the stream data of remote trucks.
+
+#pragma once
+
+#include "RoRnet.h"
+
+#include <vector>
+
+namespace RoR {
+
+/// Keeps the last few received states of a remote truck and picks the pair to interpolate between.
+///
+/// States are played out with a delay behind the remote clock, so there's usually a newer state
+/// to interpolate towards. The delay follows the measured send interval and jitter (RFC 3550 style
+/// estimate): steady connections get a short delay, bursty ones a longer one. When the newest state
+/// is late anyway, the last two states are extrapolated linearly (constant velocity) for a while.
+class TruckSnapshotBuffer
+{
+public:
+    struct Snapshot
+    {
+        RoRnet::TruckState state;        //!< `state.time` is the remote clock, milliseconds
+        std::vector<float> positions;    //!< 3 floats per node
+        std::vector<float> wheel_rp;
+        unsigned long      arrival_time; //!< Local clock, milliseconds
+    };
+
+    /// Blend of two snapshots: `s0 + ratio * (s1 - s0)`. Ratio is above 1 when extrapolating.
+    struct Sample
+    {
+        const Snapshot* s0;
+        const Snapshot* s1;
+        float           ratio;
+    };
+
+    TruckSnapshotBuffer();
+
+    void Setup(int num_nodes, int num_wheels);
+    bool IsEmpty() const { return m_count == 0; }
+
+    /// Storage for the next received state; it's added by Push(), or overwritten next time if not pushed.
+    Snapshot& GetWriteSlot() { return m_slots[(m_newest + 1) % CAPACITY]; }
+    void      Push(unsigned long arrival_time);
+
+    /// @param now Local clock, milliseconds; must not be called while IsEmpty()
+    Sample    GetSample(unsigned long now) const;
+
+    float     GetPlayoutDelay() const { return m_delay; } //!< Milliseconds
+    float     GetJitter() const { return m_jitter; }      //!< Milliseconds
+
+private:
+    static const int CAPACITY = 8;
+
+    Snapshot const& GetSnapshot(int age) const { return m_slots[(m_newest - age + CAPACITY) % CAPACITY]; } //!< 0 = newest
+
+    Snapshot m_slots[CAPACITY];
+    int      m_newest;
+    int      m_count;
+
+    double   m_clock_offset; //!< Local minus remote clock, for the fastest packets seen
+    float    m_interval;     //!< Average remote time between packets
+    float    m_jitter;       //!< Average deviation of the arrival interval from the send interval
+    float    m_delay;        //!< Playout delay
+};
+
+} // namespace RoR
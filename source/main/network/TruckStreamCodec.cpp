@@ -0,0 +1,464 @@
+/*
+    This source file is part of Rigs of Rods
+    Copyright 2013-2017 Petr Ohlidal & contributors
+
+    For more information, see http://www.rigsofrods.org/
+
+    Rigs of Rods is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License version 3, as
+    published by the Free Software Foundation.
+
+    Rigs of Rods is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with Rigs of Rods. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "TruckStreamCodec.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
+#include <cstring>
+
+using namespace RoR;
+
+namespace {
+
+// ---------------------------- Varints ----------------------------
+
+void WriteVarint(std::vector<uint8_t>& out, uint32_t v)
+{
+    while (v >= 0x80)
+    {
+        out.push_back(static_cast<uint8_t>(v | 0x80));
+        v >>= 7;
+    }
+    out.push_back(static_cast<uint8_t>(v));
+}
+
+bool ReadVarint(const uint8_t*& pos, const uint8_t* end, uint32_t& v)
+{
+    v = 0;
+    for (int shift = 0; shift < 35; shift += 7)
+    {
+        if (pos == end)
+            return false;
+        const uint8_t byte = *pos++;
+        v |= static_cast<uint32_t>(byte & 0x7F) << shift;
+        if (!(byte & 0x80))
+            return true;
+    }
+    return false;
+}
+
+uint32_t ZigZag(int32_t v)   { return (static_cast<uint32_t>(v) << 1) ^ static_cast<uint32_t>(v >> 31); }
+int32_t  UnZigZag(uint32_t v) { return static_cast<int32_t>((v >> 1) ^ (~(v & 1) + 1)); }
+
+void WriteFloat(std::vector<uint8_t>& out, float f)
+{
+    uint8_t bytes[sizeof(float)];
+    memcpy(bytes, &f, sizeof(float));
+    out.insert(out.end(), bytes, bytes + sizeof(float));
+}
+
+bool ReadFloat(const uint8_t*& pos, const uint8_t* end, float& f)
+{
+    if (end - pos < static_cast<ptrdiff_t>(sizeof(float)))
+        return false;
+    memcpy(&f, pos, sizeof(float));
+    pos += sizeof(float);
+    return std::isfinite(f);
+}
+
+int32_t Quantize(float v)
+{
+    const float q = std::round(v * TRUCKSTREAM_POS_SCALE);
+    return static_cast<int32_t>(std::max(-2.0e9f, std::min(2.0e9f, q)));
+}
+
+int32_t Predict(int history, int32_t prev, int32_t prev2)
+{
+    // Linear extrapolation; exact for nodes moving at constant velocity relative to node 0
+    if (history < 2)
+        return prev;
+    return static_cast<int32_t>(2u * static_cast<uint32_t>(prev) - static_cast<uint32_t>(prev2));
+}
+
+// ---------------------------- Entropy stage ----------------------------
+// Adaptive binary range coder (as in LZMA) over the body bytes. Every byte is coded as 8 binary
+// decisions in a bit tree; the context is whether the previous byte was a varint continuation.
+
+const int      RC_PROB_BITS  = 11;
+const int      RC_MOVE_BITS  = 5;
+const uint32_t RC_TOP        = 1u << 24;
+
+struct ByteModel
+{
+    ByteModel() { std::fill(&probs[0][0], &probs[0][0] + 2 * 256, static_cast<uint16_t>(1 << (RC_PROB_BITS - 1))); }
+
+    uint16_t* Get(uint8_t prev_byte) { return probs[(prev_byte & 0x80) ? 1 : 0]; }
+
+    uint16_t probs[2][256];
+};
+
+class RangeEncoder
+{
+public:
+    explicit RangeEncoder(std::vector<uint8_t>& out): m_out(out), m_low(0), m_range(0xFFFFFFFF), m_cache(0), m_cache_size(1) {}
+
+    void EncodeBit(uint16_t& prob, int bit)
+    {
+        const uint32_t bound = (m_range >> RC_PROB_BITS) * prob;
+        if (bit == 0)
+        {
+            m_range = bound;
+            prob += ((1 << RC_PROB_BITS) - prob) >> RC_MOVE_BITS;
+        }
+        else
+        {
+            m_low += bound;
+            m_range -= bound;
+            prob -= prob >> RC_MOVE_BITS;
+        }
+        while (m_range < RC_TOP)
+        {
+            m_range <<= 8;
+            this->ShiftLow();
+        }
+    }
+
+    void Flush()
+    {
+        for (int i = 0; i < 5; i++)
+            this->ShiftLow();
+    }
+
+private:
+    void ShiftLow()
+    {
+        if (static_cast<uint32_t>(m_low) < 0xFF000000u || (m_low >> 32) != 0)
+        {
+            const uint8_t carry = static_cast<uint8_t>(m_low >> 32);
+            uint8_t temp = m_cache;
+            do
+            {
+                m_out.push_back(static_cast<uint8_t>(temp + carry));
+                temp = 0xFF;
+            } while (--m_cache_size != 0);
+            m_cache = static_cast<uint8_t>(m_low >> 24);
+        }
+        m_cache_size++;
+        m_low = (m_low & 0x00FFFFFF) << 8;
+    }
+
+    std::vector<uint8_t>& m_out;
+    uint64_t              m_low;
+    uint32_t              m_range;
+    uint8_t               m_cache;
+    uint64_t              m_cache_size;
+};
+
+class RangeDecoder
+{
+public:
+    RangeDecoder(const uint8_t* pos, const uint8_t* end): m_pos(pos), m_end(end), m_range(0xFFFFFFFF), m_code(0)
+    {
+        for (int i = 0; i < 5; i++)
+            m_code = (m_code << 8) | this->Next();
+    }
+
+    int DecodeBit(uint16_t& prob)
+    {
+        const uint32_t bound = (m_range >> RC_PROB_BITS) * prob;
+        int bit;
+        if (m_code < bound)
+        {
+            m_range = bound;
+            prob += ((1 << RC_PROB_BITS) - prob) >> RC_MOVE_BITS;
+            bit = 0;
+        }
+        else
+        {
+            m_code -= bound;
+            m_range -= bound;
+            prob -= prob >> RC_MOVE_BITS;
+            bit = 1;
+        }
+        while (m_range < RC_TOP)
+        {
+            m_range <<= 8;
+            m_code = (m_code << 8) | this->Next();
+        }
+        return bit;
+    }
+
+    bool IsOverrun() const { return m_overrun; }
+
+private:
+    uint8_t Next()
+    {
+        if (m_pos == m_end)
+        {
+            m_overrun = true;
+            return 0;
+        }
+        return *m_pos++;
+    }
+
+    const uint8_t* m_pos;
+    const uint8_t* m_end;
+    uint32_t       m_range;
+    uint32_t       m_code;
+    bool           m_overrun = false;
+};
+
+void EntropyEncode(const std::vector<uint8_t>& in, std::vector<uint8_t>& out)
+{
+    ByteModel model;
+    RangeEncoder rc(out);
+    uint8_t prev = 0;
+    for (const uint8_t byte : in)
+    {
+        uint16_t* probs = model.Get(prev);
+        unsigned int m = 1;
+        for (int i = 7; i >= 0; i--)
+        {
+            const int bit = (byte >> i) & 1;
+            rc.EncodeBit(probs[m], bit);
+            m = (m << 1) | bit;
+        }
+        prev = byte;
+    }
+    rc.Flush();
+}
+
+bool EntropyDecode(const uint8_t* pos, const uint8_t* end, size_t size, std::vector<uint8_t>& out)
+{
+    ByteModel model;
+    RangeDecoder rc(pos, end);
+    out.resize(size);
+    uint8_t prev = 0;
+    for (size_t k = 0; k < size; k++)
+    {
+        uint16_t* probs = model.Get(prev);
+        unsigned int m = 1;
+        while (m < 0x100)
+        {
+            m = (m << 1) | rc.DecodeBit(probs[m]);
+        }
+        out[k] = prev = static_cast<uint8_t>(m);
+    }
+    return !rc.IsOverrun();
+}
+
+} // namespace
+
+// ---------------------------- Encoder ----------------------------
+
+TruckStreamEncoder::TruckStreamEncoder():
+    m_num_nodes(0),
+    m_num_wheels(0),
+    m_sequence(0),
+    m_history(0),
+    m_keyframe_requested(true)
+{
+}
+
+void TruckStreamEncoder::Setup(int num_nodes, int num_wheels)
+{
+    m_num_nodes = num_nodes;
+    m_num_wheels = num_wheels;
+    m_prev.assign(std::max(0, num_nodes - 1) * 3, 0);
+    m_prev2.assign(m_prev.size(), 0);
+    m_prev_rp.assign(num_wheels, 0.f);
+    m_history = 0;
+    m_keyframe_requested = true;
+}
+
+size_t TruckStreamEncoder::GetMaxPayloadSize() const
+{
+    // Entropy coding is only used when it makes the body smaller
+    const size_t max_body = 3 * sizeof(float) + m_prev.size() * 5 + m_num_wheels * 5;
+    return 1 + 5 + max_body;
+}
+
+void TruckStreamEncoder::Encode(const Ogre::Vector3* positions, const float* wheel_rp, bool keyframe, std::vector<char>& out)
+{
+    keyframe = keyframe || m_keyframe_requested || m_history == 0;
+    m_keyframe_requested = false;
+    if (keyframe)
+        m_history = 0;
+    m_sequence++;
+
+    m_body.clear();
+    const Ogre::Vector3 ref = (m_num_nodes > 0) ? positions[0] : Ogre::Vector3::ZERO;
+    WriteFloat(m_body, ref.x);
+    WriteFloat(m_body, ref.y);
+    WriteFloat(m_body, ref.z);
+
+    for (int i = 1; i < m_num_nodes; i++)
+    {
+        const Ogre::Vector3 rel = positions[i] - ref;
+        const int32_t q[3] = { Quantize(rel.x), Quantize(rel.y), Quantize(rel.z) };
+        for (int a = 0; a < 3; a++)
+        {
+            const size_t k = (i - 1) * 3 + a;
+            const int32_t base = (keyframe) ? 0 : Predict(m_history, m_prev[k], m_prev2[k]);
+            WriteVarint(m_body, ZigZag(static_cast<int32_t>(static_cast<uint32_t>(q[a]) - static_cast<uint32_t>(base))));
+            m_prev2[k] = m_prev[k];
+            m_prev[k] = q[a];
+        }
+    }
+
+    for (int i = 0; i < m_num_wheels; i++)
+    {
+        if (keyframe)
+        {
+            WriteFloat(m_body, wheel_rp[i]);
+            m_prev_rp[i] = wheel_rp[i];
+        }
+        else
+        {
+            const float dq = std::round((wheel_rp[i] - m_prev_rp[i]) * TRUCKSTREAM_RP_SCALE);
+            const int32_t d = static_cast<int32_t>(std::max(-1.0e9f, std::min(1.0e9f, dq)));
+            WriteVarint(m_body, ZigZag(d));
+            // Track the value the receiver reconstructs, so rounding errors don't accumulate
+            m_prev_rp[i] += d / TRUCKSTREAM_RP_SCALE;
+        }
+    }
+    m_history = std::min(m_history + 1, 2);
+
+    m_entropy.clear();
+    EntropyEncode(m_body, m_entropy);
+    const bool use_entropy = (m_entropy.size() + 5 < m_body.size());
+
+    m_header.clear();
+    m_header.push_back(static_cast<uint8_t>((keyframe ? TRUCKSTREAM_KEYFRAME : 0) | (use_entropy ? TRUCKSTREAM_ENTROPY : 0)));
+    WriteVarint(m_header, m_sequence);
+    if (use_entropy)
+        WriteVarint(m_header, static_cast<uint32_t>(m_body.size()));
+
+    const std::vector<uint8_t>& body = (use_entropy) ? m_entropy : m_body;
+    out.clear();
+    out.insert(out.end(), m_header.begin(), m_header.end());
+    out.insert(out.end(), body.begin(), body.end());
+}
+
+// ---------------------------- Decoder ----------------------------
+
+TruckStreamDecoder::TruckStreamDecoder():
+    m_num_nodes(0),
+    m_num_wheels(0),
+    m_sequence(0),
+    m_history(0)
+{
+}
+
+void TruckStreamDecoder::Setup(int num_nodes, int num_wheels)
+{
+    m_num_nodes = num_nodes;
+    m_num_wheels = num_wheels;
+    m_prev.assign(std::max(0, num_nodes - 1) * 3, 0);
+    m_prev2.assign(m_prev.size(), 0);
+    m_current.assign(m_prev.size(), 0);
+    m_prev_rp.assign(num_wheels, 0.f);
+    m_current_rp.assign(num_wheels, 0.f);
+    m_history = 0;
+}
+
+bool TruckStreamDecoder::Decode(const char* data, size_t size, float* positions, float* wheel_rp)
+{
+    const uint8_t* pos = reinterpret_cast<const uint8_t*>(data);
+    const uint8_t* end = pos + size;
+
+    if (pos == end)
+        return false;
+    const uint8_t flags = *pos++;
+    const bool keyframe = (flags & TRUCKSTREAM_KEYFRAME) != 0;
+
+    uint32_t sequence;
+    if (!ReadVarint(pos, end, sequence))
+        return false;
+
+    // A lost packet breaks the prediction chain; wait for the next keyframe
+    if (!keyframe && (m_history == 0 || sequence != m_sequence + 1))
+    {
+        m_history = 0;
+        return false;
+    }
+
+    if (flags & TRUCKSTREAM_ENTROPY)
+    {
+        uint32_t body_size;
+        if (!ReadVarint(pos, end, body_size) || body_size > (3 * sizeof(float) + (m_current.size() + m_num_wheels) * 5))
+            return false;
+        if (!EntropyDecode(pos, end, body_size, m_body))
+            return false;
+        pos = m_body.data();
+        end = pos + m_body.size();
+    }
+
+    float ref[3];
+    for (int a = 0; a < 3; a++)
+    {
+        if (!ReadFloat(pos, end, ref[a]))
+            return false;
+    }
+
+    const int history = (keyframe) ? 0 : m_history;
+    for (size_t k = 0; k < m_current.size(); k++)
+    {
+        uint32_t v;
+        if (!ReadVarint(pos, end, v))
+            return false;
+        const int32_t base = (keyframe) ? 0 : Predict(history, m_prev[k], m_prev2[k]);
+        m_current[k] = static_cast<int32_t>(static_cast<uint32_t>(base) + static_cast<uint32_t>(UnZigZag(v)));
+    }
+
+    std::vector<float>& rp = m_current_rp;
+    for (int i = 0; i < m_num_wheels; i++)
+    {
+        if (keyframe)
+        {
+            if (!ReadFloat(pos, end, rp[i]))
+                return false;
+        }
+        else
+        {
+            uint32_t v;
+            if (!ReadVarint(pos, end, v))
+                return false;
+            rp[i] = m_prev_rp[i] + UnZigZag(v) / TRUCKSTREAM_RP_SCALE;
+        }
+    }
+
+    if (pos != end)
+        return false;
+
+    // Packet is valid, commit
+    m_prev2.swap(m_prev);
+    m_prev.swap(m_current);
+    m_prev_rp.swap(m_current_rp);
+    m_sequence = sequence;
+    m_history = std::min(history + 1, 2);
+
+    if (m_num_nodes > 0)
+    {
+        positions[0] = ref[0];
+        positions[1] = ref[1];
+        positions[2] = ref[2];
+    }
+    for (int i = 1; i < m_num_nodes; i++)
+    {
+        for (int a = 0; a < 3; a++)
+        {
+            positions[i * 3 + a] = ref[a] + m_prev[(i - 1) * 3 + a] / TRUCKSTREAM_POS_SCALE;
+        }
+    }
+    std::copy(m_prev_rp.begin(), m_prev_rp.end(), wheel_rp);
+    return true;
+}
@@ -0,0 +1,117 @@
+/*
+    This source file is part of Rigs of Rods
+    Copyright 2013-2017 Petr Ohlidal & contributors
+
+    For more information, see http://www.rigsofrods.org/
+
+    Rigs of Rods is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License version 3, as
+    published by the Free Software Foundation.
+
+    Rigs of Rods is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with Rigs of Rods. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+/// @file
+/// @brief Compressed encoding of truck stream data (MSG2_STREAM_DATA payload after RoRnet::TruckState).
+
+#pragma once
+
+#include <OgreVector3.h>
+
+#include <cstdint>
+#include <vector>
+
+namespace RoR {
+
+/// Payload layout, little-endian:
+///
+///  - 1 byte: TRUCKSTREAM_* flags
+///  - varint: sequence number of this packet
+///  - if TRUCKSTREAM_ENTROPY: varint size of the body, followed by the range-coded body
+///  - body:
+///    - 3 floats: position of node 0
+///    - for nodes 1..N-1: 3 zigzag varints; position relative to node 0 in 1/TRUCKSTREAM_POS_SCALE meters.
+///      Keyframes carry the values, other packets the difference to the value predicted from the 2 previous packets.
+///    - per wheel: keyframes carry the rotation `rp` as float, other packets the difference to the previous value
+///      in 1/TRUCKSTREAM_RP_SCALE radians, as zigzag varint.
+///
+/// Non-keyframes can only be decoded if the previous packet was received. Stream data packets may
+/// be dropped when the send queue is full, so the encoder sends keyframes periodically and
+/// after any loss; the decoder skips packets until it gets the next keyframe.
+enum TruckStreamFlags
+{
+    TRUCKSTREAM_KEYFRAME = 1 << 0,
+    TRUCKSTREAM_ENTROPY  = 1 << 1,
+};
+
+static const float TRUCKSTREAM_POS_SCALE = 300.f;  //!< Same resolution as the old `short` encoding, without its +/-109m range limit
+static const float TRUCKSTREAM_RP_SCALE  = 2048.f;
+static const unsigned long TRUCKSTREAM_KEYFRAME_INTERVAL = 1000; //!< Milliseconds
+
+/// Sending side; one per local truck.
+class TruckStreamEncoder
+{
+public:
+    TruckStreamEncoder();
+
+    void Setup(int num_nodes, int num_wheels);
+
+    /// Next Encode() writes a keyframe; call when a packet was lost or a new peer joined.
+    void RequestKeyframe() { m_keyframe_requested = true; }
+
+    /// @param positions  Absolute positions of nodes [0, num_nodes)
+    /// @param wheel_rp   Rotation of wheels [0, num_wheels)
+    /// @param keyframe   Force a keyframe
+    /// @param out        Receives the payload; cleared first
+    void Encode(const Ogre::Vector3* positions, const float* wheel_rp, bool keyframe, std::vector<char>& out);
+
+    /// Upper bound of Encode() output size
+    size_t GetMaxPayloadSize() const;
+
+private:
+    int                  m_num_nodes;
+    int                  m_num_wheels;
+    uint32_t             m_sequence;
+    int                  m_history;        //!< Number of valid previous packets (0-2) since the last keyframe
+    bool                 m_keyframe_requested;
+    std::vector<int32_t> m_prev;           //!< Quantized positions sent in the previous packet
+    std::vector<int32_t> m_prev2;          //!< ... and the one before
+    std::vector<float>   m_prev_rp;        //!< Wheel rotations as reconstructed by the receiver
+    std::vector<uint8_t> m_header;
+    std::vector<uint8_t> m_body;
+    std::vector<uint8_t> m_entropy;
+};
+
+/// Receiving side; one per remote truck.
+class TruckStreamDecoder
+{
+public:
+    TruckStreamDecoder();
+
+    void Setup(int num_nodes, int num_wheels);
+
+    /// @param positions Receives absolute positions of nodes [0, num_nodes), 3 floats each
+    /// @param wheel_rp  Receives the rotation of wheels [0, num_wheels)
+    /// @return False if the packet is malformed or can't be decoded yet (waiting for a keyframe); outputs are unchanged then.
+    bool Decode(const char* data, size_t size, float* positions, float* wheel_rp);
+
+private:
+    int                  m_num_nodes;
+    int                  m_num_wheels;
+    uint32_t             m_sequence;
+    int                  m_history;        //!< Number of valid previous packets (0-2), 0 = waiting for a keyframe
+    std::vector<int32_t> m_prev;
+    std::vector<int32_t> m_prev2;
+    std::vector<int32_t> m_current;
+    std::vector<float>   m_prev_rp;
+    std::vector<float>   m_current_rp;
+    std::vector<uint8_t> m_body;
+};
+
+} // namespace RoR
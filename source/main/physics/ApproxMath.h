@@ -63,6 +63,31 @@ inline float frand_11()
     return( *((float*)&a) - 3.0f );
 }
 
+// Same as frand(), with a caller-owned state instead of the global one
+inline float frand(unsigned int& state)
+{
+    unsigned int a;
+
+    state *= 16807;
+
+    a = (state&0x007fffff) | 0x40000000;
+
+    return( *((float*)&a) - 2.0f )*0.5f;
+}
+
+// Same as frand_11(), with a caller-owned state instead of the global one;
+// thread-safe as long as each thread uses its own state
+inline float frand_11(unsigned int& state)
+{
+    unsigned int a;
+
+    state *= 16807;
+
+    a = (state&0x007fffff) | 0x40000000;
+
+    return( *((float*)&a) - 3.0f );
+}
+
 // Calculates approximate e^x.
 // Use it in code not requiring precision
 inline float approx_exp(const float x)
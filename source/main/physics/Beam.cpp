@@ -89,6 +89,7 @@
 
 #define LOAD_RIG_PROFILE_CHECKPOINT(ENTRY) rig_loading_profiler->Checkpoint(RoR::RigLoadingProfiler::ENTRY);
 
+#include "RigDef_BinaryCache.h"
 #include "RigDef_Parser.h"
 #include "RigDef_Validator.h"
 
@@ -392,6 +393,7 @@ void Beam::scaleTruck(float value)
 
         beams[i].diameter *= value;
     }
+    m_beams_soa_dirty = true;
     // scale nodes
     Vector3 refpos = nodes[0].AbsPosition;
     Vector3 relpos = nodes[0].RelPosition;
@@ -583,147 +585,95 @@ void Beam::CreateSimpleSkeletonMaterial()
 void Beam::pushNetwork(char* data, int size)
 {
     BES_GFX_START(BES_GFX_pushNetwork);
-    if (!oob3)
-        return;
 
     // check if the size of the data matches to what we expected
-    if ((unsigned int)size == (netbuffersize + sizeof(RoRnet::TruckState)))
+    if ((unsigned int)size > sizeof(RoRnet::TruckState) && (unsigned int)size <= (netbuffersize + sizeof(RoRnet::TruckState)))
     {
-        // we walk through the incoming data and separate it a bit
-        char* ptr = data;
-
-        // put the RoRnet::TruckState in front, describes truck basics, engine state, flares, etc
-        memcpy((char*)oob3, ptr, sizeof(RoRnet::TruckState));
-        ptr += sizeof(RoRnet::TruckState);
-
-        // then copy the node data
-        memcpy((char*)netb3, ptr, nodebuffersize);
-        ptr += nodebuffersize;
-
-        // then take care of the wheel speeds
-        for (int i = 0; i < free_wheel; i++)
+        // the RoRnet::TruckState is in front, describes truck basics, engine state, flares, etc
+        // then the compressed node positions and wheel rotations
+        TruckSnapshotBuffer::Snapshot& snapshot = m_net_snapshots.GetWriteSlot();
+        if (!m_net_decoder.Decode(data + sizeof(RoRnet::TruckState), size - sizeof(RoRnet::TruckState), snapshot.positions.data(), snapshot.wheel_rp.data()))
         {
-            float wspeed = *(float*)(ptr);
-            wheels[i].rp3 = wspeed;
-
-            ptr += sizeof(float);
+            // lost packet or joined mid-stream; wait for the next keyframe
+            return;
         }
+
+        memcpy(&snapshot.state, data, sizeof(RoRnet::TruckState));
+        m_net_snapshots.Push(netTimer.getMilliseconds());
     }
     else
     {
         // TODO: show the user the problem in the GUI
-        LOG("WRONG network size: we expected " + TOSTRING(netbuffersize+sizeof(RoRnet::TruckState)) + " but got " + TOSTRING(size) + " for vehicle " + String(truckname));
+        LOG("WRONG network size: we expected at most " + TOSTRING(netbuffersize+sizeof(RoRnet::TruckState)) + " but got " + TOSTRING(size) + " for vehicle " + String(truckname));
         state = INVALID;
         return;
     }
 
-    // and the buffer switching to have linear smoothing
-    RoRnet::TruckState* ot;
-    ot = oob1;
-    oob1 = oob2;
-    oob2 = oob3;
-    oob3 = ot;
-
-    char* ft;
-    ft = netb1;
-    netb1 = netb2;
-    netb2 = netb3;
-    netb3 = ft;
-
-    for (int i = 0; i < free_wheel; i++)
-    {
-        float rp;
-        rp = wheels[i].rp1;
-        wheels[i].rp1 = wheels[i].rp2;
-        wheels[i].rp2 = wheels[i].rp3;
-        wheels[i].rp3 = rp;
-    }
-    netcounter++;
-
     BES_GFX_STOP(BES_GFX_pushNetwork);
 }
 
-void Beam::calcNetwork()
+bool Beam::IsNetworkNodeUpdateDue(TruckSnapshotBuffer::Sample const& sample)
 {
-    using namespace RoRnet;
+    // Reconstructing the nodes is most of the work in calcNetwork(); only trucks near the camera
+    // get it every frame, distant ones every few frames and ones out of view rarely.
+    static const float NET_FULL_UPDATE_DISTANCE   = 100.f; // meters
+    static const int   NET_MAX_DECIMATION         = 8;     // frames
+    static const int   NET_HIDDEN_UPDATE_INTERVAL = 30;    // frames
 
-    if (netcounter < 1)
-        return;
+    m_net_frames_since_update++;
 
-    if (netcounter == 1)
+    int interval = 1;
+    if (mCamera)
     {
-        memcpy((char*)oob1, oob2, sizeof(RoRnet::TruckState));
+        // node 0 is cheap to get; the sphere around it covers the whole truck
+        const float* np1 = sample.s0->positions.data();
+        const float* np2 = sample.s1->positions.data();
+        const Vector3 p1(np1[0], np1[1], np1[2]);
+        const Vector3 p2(np2[0], np2[1], np2[2]);
+        const Vector3 ref_pos = p1 + sample.ratio * (p2 - p1);
+
+        const float distance = ref_pos.distance(mCamera->getPosition());
+        if (distance > NET_FULL_UPDATE_DISTANCE)
+        {
+            if (mCamera->isVisible(Sphere(ref_pos, m_net_bounding_radius)))
+                interval = std::min(static_cast<int>(distance / NET_FULL_UPDATE_DISTANCE) + 1, NET_MAX_DECIMATION);
+            else
+                interval = NET_HIDDEN_UPDATE_INTERVAL;
+        }
     }
 
-    BES_GFX_START(BES_GFX_calcNetwork);
+    if (m_net_frames_since_update < interval)
+        return false;
 
-    // we must update Nodes positions from available network informations
-    int tnow = netTimer.getMilliseconds();
-    // adjust offset to match remote time
-    int rnow = tnow + net_toffset;
-    // if we receive older data from the future, we must correct the offset
-    if (oob1->time > rnow)
-    {
-        net_toffset = oob1->time - tnow;
-        rnow = tnow + net_toffset;
-    }
-    //if we receive last data from the past, we must correct the offset
-    if (oob2->time < rnow)
-    {
-        net_toffset = oob2->time - tnow;
-        rnow = tnow + net_toffset;
-    }
-    float tratio = (float)(rnow - oob1->time) / (float)(oob2->time - oob1->time);
+    m_net_frames_since_update = 0;
+    return true;
+}
 
-    short* sp1 = (short*)(netb1 + sizeof(float) * 3);
-    short* sp2 = (short*)(netb2 + sizeof(float) * 3);
-    Vector3 p1ref = Vector3::ZERO;
-    Vector3 p2ref = Vector3::ZERO;
+void Beam::UpdateNetworkNodes(const float* np1, const float* np2, const float* rp1, const float* rp2, float ratio)
+{
     Vector3 apos = Vector3::ZERO;
-    Vector3 p1 = Vector3::ZERO;
-    Vector3 p2 = Vector3::ZERO;
+    Vector3 min_pos = Vector3(np1[0], np1[1], np1[2]);
+    Vector3 max_pos = min_pos;
 
     for (int i = 0; i < first_wheel_node; i++)
     {
-        if (i == 0)
-        {
-            // first node is uncompressed
-            p1.x = ((float*)netb1)[0];
-            p1.y = ((float*)netb1)[1];
-            p1.z = ((float*)netb1)[2];
-            p1ref = p1;
-
-            p2.x = ((float*)netb2)[0];
-            p2.y = ((float*)netb2)[1];
-            p2.z = ((float*)netb2)[2];
-            p2ref = p2;
-        }
-        else
-        {
-            // all other nodes are compressed:
-            // short int compared to previous node
-            p1.x = (float)(sp1[(i - 1) * 3 + 0]) / 300.0f;
-            p1.y = (float)(sp1[(i - 1) * 3 + 1]) / 300.0f;
-            p1.z = (float)(sp1[(i - 1) * 3 + 2]) / 300.0f;
-            p1 = p1 + p1ref;
-
-            p2.x = (float)(sp2[(i - 1) * 3 + 0]) / 300.0f;
-            p2.y = (float)(sp2[(i - 1) * 3 + 1]) / 300.0f;
-            p2.z = (float)(sp2[(i - 1) * 3 + 2]) / 300.0f;
-            p2 = p2 + p2ref;
-        }
+        const Vector3 p1(np1[i * 3 + 0], np1[i * 3 + 1], np1[i * 3 + 2]);
+        const Vector3 p2(np2[i * 3 + 0], np2[i * 3 + 1], np2[i * 3 + 2]);
 
-        // linear interpolation
-        nodes[i].AbsPosition = p1 + tratio * (p2 - p1);
+        // linear interpolation, or extrapolation with constant velocity
+        nodes[i].AbsPosition = p1 + ratio * (p2 - p1);
         nodes[i].RelPosition = nodes[i].AbsPosition - origin;
 
         apos += nodes[i].AbsPosition;
+        min_pos.makeFloor(nodes[i].AbsPosition);
+        max_pos.makeCeil(nodes[i].AbsPosition);
     }
     position = apos / first_wheel_node;
+    m_net_bounding_radius = (max_pos - min_pos).length();
 
     for (int i = 0; i < free_wheel; i++)
     {
-        float rp = wheels[i].rp1 + tratio * (wheels[i].rp2 - wheels[i].rp1);
+        float rp = rp1[i] + ratio * (rp2[i] - rp1[i]);
         //compute ideal positions
         Vector3 axis = wheels[i].refnode1->RelPosition - wheels[i].refnode0->RelPosition;
         axis.normalise();
@@ -744,6 +694,28 @@ void Beam::calcNetwork()
             wheels[i].nodes[j * 2 + 1]->RelPosition = wheels[i].nodes[j * 2 + 1]->AbsPosition - origin;
         }
     }
+}
+
+void Beam::calcNetwork()
+{
+    using namespace RoRnet;
+
+    if (m_net_snapshots.IsEmpty())
+        return;
+
+    BES_GFX_START(BES_GFX_calcNetwork);
+
+    // states were decoded in pushNetwork()
+    const TruckSnapshotBuffer::Sample sample = m_net_snapshots.GetSample(netTimer.getMilliseconds());
+    const TruckState* oob1 = &sample.s0->state;
+    const TruckState* oob2 = &sample.s1->state;
+    const float pratio = sample.ratio;               // Extrapolates node positions and wheel rotations when late
+    const float tratio = std::min(sample.ratio, 1.f); // Engine and other properties are only interpolated
+
+    if (this->IsNetworkNodeUpdateDue(sample))
+    {
+        this->UpdateNetworkNodes(sample.s0->positions.data(), sample.s1->positions.data(), sample.s0->wheel_rp.data(), sample.s1->wheel_rp.data(), pratio);
+    }
 
     float engspeed = oob1->engine_speed + tratio * (oob2->engine_speed - oob1->engine_speed);
     float engforce = oob1->engine_force + tratio * (oob2->engine_force - oob1->engine_force);
@@ -852,6 +824,7 @@ bool Beam::addPressure(float v)
     {
         beams[pressure_beams[i]].k = 10000 + refpressure * 10000;
     }
+    m_beams_soa_dirty = true;
     return true;
 }
 
@@ -1667,6 +1640,7 @@ void Beam::SyncReset()
         beams[i].broken = false;
         beams[i].disabled = false;
     }
+    m_beams_soa_dirty = true;
 
     disjoinInterTruckBeams();
 
@@ -1769,7 +1743,6 @@ bool Beam::replayStep()
                 nodes[i].RelPosition = nbuff[i].position - origin;
 
                 nodes[i].Velocity = nbuff[i].velocity;
-                nodes[i].Forces = nbuff[i].forces;
             }
 
             updateSlideNodePositions();
@@ -1785,6 +1758,7 @@ bool Beam::replayStep()
                 beams[i].broken = bbuff[i].broken;
                 beams[i].disabled = bbuff[i].disabled;
             }
+            m_beams_soa_dirty = true;
         }
         oldreplaypos = replaypos;
     }
@@ -1852,26 +1826,20 @@ void Beam::sendStreamData()
 {
     using namespace RoRnet;
 
+#ifdef USE_SOCKETW
+    if (netTimer.getMilliseconds() - lastNetUpdateTime < RoR::Networking::GetStreamSendInterval(0))
+        return; // Rate limit, see setting "Network Truck Send Rate"
+#endif //SOCKETW
+
     BES_GFX_START(BES_GFX_sendStreamData);
 #ifdef USE_SOCKETW
     lastNetUpdateTime = netTimer.getMilliseconds();
 
-    //look if the packet is too big first
-    int final_packet_size = sizeof(RoRnet::TruckState) + sizeof(float) * 3 + first_wheel_node * sizeof(float) * 3 + free_wheel * sizeof(float);
-    if (final_packet_size > 8192)
-    {
-        ErrorUtils::ShowError(_L("Truck is too big to be send over the net."), _L("Network error!"));
-        exit(126);
-    }
-
-    char send_buffer[8192] = {0};
-
-    unsigned int packet_len = 0;
-
     // RoRnet::TruckState is at the beginning of the buffer
+    RoRnet::TruckState send_state;
+    memset(&send_state, 0, sizeof(RoRnet::TruckState));
     {
-        RoRnet::TruckState* send_oob = (RoRnet::TruckState *)send_buffer;
-        packet_len += sizeof(RoRnet::TruckState);
+        RoRnet::TruckState* send_oob = &send_state;
 
         send_oob->flagmask = 0;
 
@@ -1955,42 +1923,32 @@ void Beam::sendStreamData()
 
     // then process the contents
     {
-        char* ptr = send_buffer + sizeof(RoRnet::TruckState);
-        float* send_nodes = (float *)ptr;
-        packet_len += netbuffersize;
-
-        // copy data into the buffer
-        int i;
-
-        // reference node first
-        Vector3& refpos = nodes[0].AbsPosition;
-        send_nodes[0] = refpos.x;
-        send_nodes[1] = refpos.y;
-        send_nodes[2] = refpos.z;
-
-        ptr += sizeof(float) * 3;// plus 3 floats from above
-
-        // then copy the other nodes into a compressed short format
-        short* sbuf = (short*)ptr;
-        for (i = 1; i < first_wheel_node; i++)
+        m_net_positions.resize(first_wheel_node);
+        for (int i = 0; i < first_wheel_node; i++)
         {
-            Vector3 relpos = nodes[i].AbsPosition - refpos;
-            sbuf[(i - 1) * 3 + 0] = (short int)(relpos.x * 300.0f);
-            sbuf[(i - 1) * 3 + 1] = (short int)(relpos.y * 300.0f);
-            sbuf[(i - 1) * 3 + 2] = (short int)(relpos.z * 300.0f);
-
-            ptr += sizeof(short int) * 3; // increase pointer
+            m_net_positions[i] = nodes[i].AbsPosition;
         }
-
-        // then to the wheels
-        float* wfbuf = (float*)ptr;
-        for (i = 0; i < free_wheel; i++)
+        m_net_wheel_rp.resize(free_wheel);
+        for (int i = 0; i < free_wheel; i++)
         {
-            wfbuf[i] = wheels[i].rp;
+            m_net_wheel_rp[i] = wheels[i].rp;
         }
+
+        const bool keyframe = (lastNetUpdateTime - m_net_last_keyframe_time >= RoR::TRUCKSTREAM_KEYFRAME_INTERVAL);
+        m_net_encoder.Encode(m_net_positions.data(), m_net_wheel_rp.data(), keyframe, m_net_payload);
+        if (keyframe)
+            m_net_last_keyframe_time = lastNetUpdateTime;
     }
 
-    RoR::Networking::AddPacket(m_stream_id, MSG2_STREAM_DATA, packet_len, send_buffer);
+    m_net_send_buffer.resize(sizeof(RoRnet::TruckState) + m_net_payload.size());
+    memcpy(m_net_send_buffer.data(), &send_state, sizeof(RoRnet::TruckState));
+    memcpy(m_net_send_buffer.data() + sizeof(RoRnet::TruckState), m_net_payload.data(), m_net_payload.size());
+
+    if (!RoR::Networking::AddPacket(m_stream_id, MSG2_STREAM_DATA, (int)m_net_send_buffer.size(), m_net_send_buffer.data()))
+    {
+        // packet discarded, receivers can't decode the next delta
+        m_net_encoder.RequestKeyframe();
+    }
 #endif //SOCKETW
     BES_GFX_STOP(BES_GFX_sendStreamData);
 }
@@ -3512,31 +3470,8 @@ void Beam::updateFlexbodiesPrepare()
             flexbody_prepare.set(i, flexbodies[i]->flexitPrepare());
         }
 
-        // Push tasks into thread pool
-        for (int i = 0; i < free_flexbody; i++)
-        {
-            if (flexbody_prepare[i])
-            {
-                auto func = std::function<void()>([this, i]()
-                    {
-                        flexbodies[i]->flexitCompute();
-                    });
-                auto task_handle = gEnv->threadPool->RunTask(func);
-                flexbody_tasks.push_back(task_handle);
-            }
-        }
-        for (int i = 0; i < free_wheel; i++)
-        {
-            if (flexmesh_prepare[i])
-            {
-                auto func = std::function<void()>([this, i]()
-                    {
-                        vwheels[i].fm->flexitCompute();
-                    });
-                auto task_handle = gEnv->threadPool->RunTask(func);
-                flexbody_tasks.push_back(task_handle);
-            }
-        }
+        // Push tasks into thread pool; one batch for flexbodies and wheels
+        gEnv->threadPool->StartParallelFor(flexbody_tasks, 0, free_flexbody + free_wheel, 1, flexbody_compute);
     }
     else
     {
@@ -3752,11 +3687,7 @@ void Beam::joinFlexbodyTasks()
 {
     if (gEnv->threadPool)
     {
-        for (const auto& t : flexbody_tasks)
-        {
-            t->join();
-        }
-        flexbody_tasks.clear();
+        gEnv->threadPool->Join(flexbody_tasks);
     }
 }
 
@@ -5612,9 +5543,16 @@ Beam::Beam(
     , locked(0)
     , lockedold(0)
     , velocity(Ogre::Vector3::ZERO)
+    , m_beams_soa_dirty(true)
+    , m_beams_soa_enabled(BSETTING("SIMDBeams", true))
+    , m_turbulence_seed(0)
     , m_custom_camera_node(-1)
     , m_hide_own_net_label(BSETTING("HideOwnNetLabel", false))
+    , m_intra_truck_parallel(false)
     , m_is_cinecam_rotation_center(false)
+    , m_net_bounding_radius(0.f)
+    , m_net_frames_since_update(1000) // Update with the first received state
+    , m_net_last_keyframe_time(0)
     , m_preloaded_with_terrain(preloaded_with_terrain)
     , m_request_skeletonview_change(0)
     , m_reset_request(REQUEST_RESET_NONE)
@@ -5663,6 +5601,18 @@ Beam::Beam(
     , watercontactold(false)
 {
     high_res_wheelnode_collisions = BSETTING("HighResWheelNodeCollisions", false);
+    flexbody_compute = [this](int i)
+    {
+        if (i < free_flexbody)
+        {
+            if (flexbody_prepare[i])
+                flexbodies[i]->flexitCompute();
+        }
+        else if (flexmesh_prepare[i - free_flexbody])
+        {
+            vwheels[i - free_flexbody].fm->flexitCompute();
+        }
+    };
     useSkidmarks = RoR::App::GetGfxSkidmarksMode() == 1;
     LOG(" ===== LOADING VEHICLE: " + Ogre::String(fname));
 
@@ -5750,14 +5700,11 @@ Beam::Beam(
         }
     }
 
-    // network buffer layout (without RoRnet::TruckState):
-    //
-    //  - 3 floats (x,y,z) for the reference node 0
-    //  - free_node - 1 times 3 short ints (compressed position info)
-    //  - free_wheel times a float for the wheel rotation
-    //
-    nodebuffersize = sizeof(float) * 3 + (first_wheel_node - 1) * sizeof(short int) * 3;
-    netbuffersize = nodebuffersize + free_wheel * sizeof(float);
+    // network stream data (after RoRnet::TruckState): nodes [0, first_wheel_node) and the rotation of all wheels,
+    // see RoR::TruckStreamEncoder. Received data is decoded to 3 floats per node.
+    m_net_encoder.Setup(first_wheel_node, free_wheel);
+    m_net_decoder.Setup(first_wheel_node, free_wheel);
+    netbuffersize = static_cast<int>(m_net_encoder.GetMaxPayloadSize());
     updateFlexbodiesPrepare();
     updateFlexbodiesFinal();
     updateVisual();
@@ -5782,21 +5729,22 @@ Beam::Beam(
     if (_networked)
     {
         state = NETWORKED;
-        // malloc memory
-        oob1 = (RoRnet::TruckState*)malloc(sizeof(RoRnet::TruckState));
-        oob2 = (RoRnet::TruckState*)malloc(sizeof(RoRnet::TruckState));
-        oob3 = (RoRnet::TruckState*)malloc(sizeof(RoRnet::TruckState));
-        netb1 = (char*)malloc(netbuffersize);
-        netb2 = (char*)malloc(netbuffersize);
-        netb3 = (char*)malloc(netbuffersize);
-        net_toffset = 0;
-        netcounter = 0;
+        m_net_snapshots.Setup(first_wheel_node, free_wheel);
         if (engine)
         {
             engine->start();
         }
     }
 
+    // A keyframe carries every node, it must fit into one message (see RoR::Networking::AddPacket())
+    if (networking && state != NETWORKED && sizeof(RoRnet::TruckState) + netbuffersize > RORNET_MAX_MESSAGE_LENGTH)
+    {
+        LOG("[RoR|Networking] Vehicle '" + String(truckname) + "' has too many nodes to be sent over the network ("
+            + TOSTRING(netbuffersize + sizeof(RoRnet::TruckState)) + " bytes, max is " + TOSTRING(RORNET_MAX_MESSAGE_LENGTH)
+            + "), other players won't see it.");
+        networking = false;
+    }
+
     if (networking)
     {
         if (state != NETWORKED)
@@ -5912,30 +5860,25 @@ bool Beam::LoadTruck(
 
     LOG(" == Parsing vehicle file: " + file_name);
 
-    RigDef::Parser parser;
-    LOAD_RIG_PROFILE_CHECKPOINT(ENTRY_BEAM_LOADTRUCK_PARSER_CREATE);
-    parser.Prepare();
-    LOAD_RIG_PROFILE_CHECKPOINT(ENTRY_BEAM_LOADTRUCK_PARSER_PREPARE);
-    parser.ProcessOgreStream(ds.getPointer());
-    LOAD_RIG_PROFILE_CHECKPOINT(ENTRY_BEAM_LOADTRUCK_PARSER_RUN);
-    parser.Finalize();
-    LOAD_RIG_PROFILE_CHECKPOINT(ENTRY_BEAM_LOADTRUCK_PARSER_FINALIZE);
-
-    int report_num_errors = parser.GetMessagesNumErrors();
-    int report_num_warnings = parser.GetMessagesNumWarnings();
-    int report_num_other = parser.GetMessagesNumOther();
-    std::string report_text = parser.ProcessMessagesToString();
+    // Parser output is cached by file content, see RigDef::BinaryCache
+    RigDef::ParseReport parse_report;
+    std::shared_ptr<RigDef::File> rig_def = RigDef::BinaryCache::LoadOrParse(ds, parse_report);
+    LOAD_RIG_PROFILE_CHECKPOINT(ENTRY_BEAM_LOADTRUCK_PARSE);
+
+    int report_num_errors = parse_report.num_errors;
+    int report_num_warnings = parse_report.num_warnings;
+    int report_num_other = parse_report.num_other;
+    std::string report_text = parse_report.text;
     report_text += "\n\n";
     LOG(report_text);
 
-    auto* importer = parser.GetSequentialImporter();
-    if (importer->IsEnabled() && App::GetDiagRigLogMessages())
+    if (parse_report.importer_enabled && App::GetDiagRigLogMessages())
     {
-        report_num_errors += importer->GetMessagesNumErrors();
-        report_num_warnings += importer->GetMessagesNumWarnings();
-        report_num_other += importer->GetMessagesNumOther();
+        report_num_errors += parse_report.importer_num_errors;
+        report_num_warnings += parse_report.importer_num_warnings;
+        report_num_other += parse_report.importer_num_other;
 
-        std::string importer_report = importer->ProcessMessagesToString();
+        std::string importer_report = parse_report.importer_text;
         LOG(importer_report);
 
         report_text += importer_report + "\n\n";
@@ -5943,10 +5886,10 @@ bool Beam::LoadTruck(
 
     /* VALIDATING */
     LOAD_RIG_PROFILE_CHECKPOINT(ENTRY_BEAM_LOADTRUCK_POST_PARSE);
-    LOG(" == Validating vehicle: " + parser.GetFile()->name);
+    LOG(" == Validating vehicle: " + rig_def->name);
 
     RigDef::Validator validator;
-    validator.Setup(parser.GetFile());
+    validator.Setup(rig_def);
     LOAD_RIG_PROFILE_CHECKPOINT(ENTRY_BEAM_LOADTRUCK_VALIDATOR_INIT);
 
     // Workaround: Some terrains pre-load truckfiles with special purpose:
@@ -5975,14 +5918,14 @@ bool Beam::LoadTruck(
 
     /* PROCESSING */
 
-    LOG(" == Spawning vehicle: " + parser.GetFile()->name);
+    LOG(" == Spawning vehicle: " + rig_def->name);
 
     RigSpawner spawner(m_sim_controller);
-    spawner.Setup(this, parser.GetFile(), parent_scene_node, spawn_position, cache_entry_number);
+    spawner.Setup(this, rig_def, parent_scene_node, spawn_position, cache_entry_number);
     LOAD_RIG_PROFILE_CHECKPOINT(ENTRY_BEAM_LOADTRUCK_SPAWNER_SETUP);
     /* Setup modules */
-    spawner.AddModule(parser.GetFile()->root_module);
-    if (parser.GetFile()->user_modules.size() > 0) /* The vehicle-selector may return selected modules even for vehicle with no modules defined! Hence this check. */
+    spawner.AddModule(rig_def->root_module);
+    if (rig_def->user_modules.size() > 0) /* The vehicle-selector may return selected modules even for vehicle with no modules defined! Hence this check. */
     {
         std::vector<Ogre::String>::iterator itor = m_truck_config.begin();
         for (; itor != m_truck_config.end(); itor++)
@@ -6000,19 +5943,19 @@ bool Beam::LoadTruck(
     report_text += spawner.ProcessMessagesToString() + "\n\n";
 
     // Extra information to RoR.log
-    if (importer->IsEnabled())
+    if (parse_report.importer_enabled)
     {
         if (App::GetDiagRigLogNodeStats())
         {
-            LOG(importer->GetNodeStatistics());
+            LOG(parse_report.importer_node_stats);
         }
         if (App::GetDiagRigLogNodeImport())
         {
-            LOG(importer->IterateAndPrintAllNodes());
+            LOG(parse_report.importer_node_list);
         }
     }
 
-    RoR::App::GetGuiManager()->AddRigLoadingReport(parser.GetFile()->name, report_text, report_num_errors, report_num_warnings, report_num_other);
+    RoR::App::GetGuiManager()->AddRigLoadingReport(rig_def->name, report_text, report_num_errors, report_num_warnings, report_num_other);
     if (report_num_errors != 0)
     {
         if (BSETTING("AutoRigSpawnerReport", false))
@@ -6031,7 +5974,7 @@ bool Beam::LoadTruck(
     };
 
     /* Place correctly */
-    if (! parser.GetFile()->HasFixes())
+    if (! rig_def->HasFixes())
     {
         Ogre::Vector3 vehicle_position = spawn_position;
 
@@ -22,10 +22,14 @@
 #pragma once
 
 #include "BeamData.h"
+#include "BeamSoA.h"
 #include "GfxActor.h"
 #include "PerVehicleCameraContext.h"
 #include "RigDef_Prerequisites.h"
 #include "RoRPrerequisites.h"
+#include "ThreadPool.h"
+#include "TruckSnapshotBuffer.h"
+#include "TruckStreamCodec.h"
 
 #include <OgrePrerequisites.h>
 #include <OgreTimer.h>
@@ -85,10 +89,12 @@ public:
         );
 
     /**
-    * Parses network data; fills truck data buffers and flips them. Called by the network thread.
+    * Parses network data; adds a state to the playout buffer. Called by the network thread.
     */
     void pushNetwork(char* data, int size);
     void calcNetwork();
+    bool IsNetworkNodeUpdateDue(RoR::TruckSnapshotBuffer::Sample const& sample); //!< Decimates node updates of remote trucks by distance and visibility
+    void UpdateNetworkNodes(const float* np1, const float* np2, const float* rp1, const float* rp2, float ratio);
 
     void updateNetworkInfo();
 
@@ -348,10 +354,6 @@ public:
     void calcReplay(bool doUpdate, Ogre::Real dt);
     //! @}
 
-    //! @{ helper routines
-
-    void calcBeam(beam_t& beam, bool doUpdate, Ogre::Real dt, int& increased_accuracy);
-    //! @}
 
 
     /* functions to be sorted */
@@ -425,7 +427,6 @@ public:
     int wheel_node_count;
     int first_wheel_node;
     int netbuffersize;
-    int nodebuffersize;
     Ogre::SceneNode *netLabelNode;
 
     std::string getTruckName();
@@ -489,6 +490,7 @@ public:
     int getLowestNode();
 
     bool simulated;
+    bool m_intra_truck_parallel; //!< Set by BeamFactory when this truck's beams/nodes may be split across gEnv->threadPool
     int airbrakeval;
     Ogre::Vector3 cameranodeacc;
     int cameranodecount;
@@ -496,6 +498,16 @@ public:
     int m_source_id;
     int m_stream_id;
     std::map<int, int> m_stream_results;
+    RoR::TruckStreamEncoder m_net_encoder;   //!< Network; outgoing stream data
+    RoR::TruckStreamDecoder m_net_decoder;   //!< Network; incoming stream data
+    RoR::TruckSnapshotBuffer m_net_snapshots; //!< Network; incoming stream data, decoded
+    float         m_net_bounding_radius;     //!< Network; extent of the truck around node 0, for visibility tests
+    int           m_net_frames_since_update; //!< Network; frames since the nodes were reconstructed
+    unsigned long m_net_last_keyframe_time;  //!< Network; outgoing stream data
+    std::vector<Ogre::Vector3> m_net_positions;  //!< Network; scratch for sendStreamData()
+    std::vector<float>      m_net_wheel_rp;      //!< Network; scratch for sendStreamData()
+    std::vector<char>       m_net_payload;       //!< Network; scratch for sendStreamData()
+    std::vector<char>       m_net_send_buffer;   //!< Network; scratch for sendStreamData()
 
     Ogre::Timer netTimer;
     unsigned long lastNetUpdateTime;
@@ -583,6 +595,11 @@ protected:
     */
     void calcBeams(int doUpdate, Ogre::Real dt, int step, int maxsteps);
 
+    /**
+    * TIGHT LOOP; Physics & sound - single beam, scalar path (shocks, ropes, deformation, breaking)
+    */
+    void calcBeam(int beam_i, int doUpdate, Ogre::Real dt);
+
     /**
     * TIGHT LOOP; Physics & sound - only beams between multiple truck (noshock or ropes)
     */
@@ -593,6 +610,22 @@ protected:
     */
     void calcNodes(int doUpdate, Ogre::Real dt, int step, int maxsteps);
 
+    /// Outputs of calcNodesRange() which would otherwise be shared between threads
+    struct CalcNodesResult
+    {
+        bool            watercontact;
+        ground_model_t* ground_model; //!< Last contacted ground model, see `lastFuzzyGroundModel`
+        ground_batch_t  ground_batch; //!< Scratch; nodes due for a collision test this step
+    };
+
+    /**
+    * TIGHT LOOP; Physics; thread-safe for disjoint ranges unless `doUpdate` is set (particles, sounds, skidmarks)
+    */
+    void calcNodesRange(int begin, int end, int doUpdate, Ogre::Real dt, int step, int maxsteps, IWater* water, float gravity, CalcNodesResult& result);
+
+    /// Number of chunks to split `num_items` beams/nodes into; 1 = compute on this thread only
+    int getNumIntraTruckChunks(int num_items, int min_items_per_chunk) const;
+
     /**
     * TIGHT LOOP; Physics;
     */
@@ -611,6 +644,13 @@ protected:
 
     float avichatter_timer;
 
+    // SIMD spring kernel; see calcBeams()
+    RoR::BeamSoA m_beams_soa;
+    bool m_beams_soa_enabled;
+    bool m_beams_soa_dirty; //!< Rebuild the SoA mirror before next step; set when plain springs are modified outside calcBeams()
+    std::vector<CalcNodesResult> m_calc_nodes_results; //!< One per chunk; see calcNodes()
+    unsigned int m_turbulence_seed; //!< Drag turbulence noise of the current step; see calcNodes()
+
     // inter-/intra truck collision stuff
     PointColDetector* interPointCD;
     PointColDetector* intraPointCD;
@@ -618,7 +658,8 @@ protected:
     // flexable stuff
     std::bitset<MAX_WHEELS> flexmesh_prepare;
     std::bitset<MAX_FLEXBODIES> flexbody_prepare;
-    std::vector<std::shared_ptr<Task>> flexbody_tasks;
+    TaskGroup flexbody_tasks;                  //!< Joined in joinFlexbodyTasks()
+    std::function<void(int)> flexbody_compute; //!< Task body: index < free_flexbody ? flexbody : wheel
 
     // linked beams (hooks)
     std::list<Beam*> linkedBeams;
@@ -689,14 +730,6 @@ protected:
 
     std::vector<Ogre::String> m_truck_config;
 
-    RoRnet::TruckState *oob1; //!< Network; Triple buffer for incoming data (truck properties)
-    RoRnet::TruckState *oob2; //!< Network; Triple buffer for incoming data (truck properties)
-    RoRnet::TruckState *oob3; //!< Network; Triple buffer for incoming data (truck properties)
-    char *netb1; //!< Network; Triple buffer for incoming data
-    char *netb2; //!< Network; Triple buffer for incoming data
-    char *netb3; //!< Network; Triple buffer for incoming data
-    int net_toffset;
-    int netcounter;
     Ogre::MovableText *netMT; //, *netDist;
     bool m_hide_own_net_label;
 
@@ -512,6 +512,35 @@ struct ground_model_t
     float fx_particle_ttl;
 };
 
+/// Input and results of Collisions::groundCollisionBatch(); structure of arrays, reused between steps
+struct ground_batch_t
+{
+    std::vector<int> node_ids;
+    std::vector<float> x, y, z;             //!< node position when added
+    std::vector<float> height;              //!< terrain height at x/z
+    std::vector<Ogre::Vector3> normal;      //!< terrain normal; only set where the node is below `height`
+    std::vector<ground_model_t*> gm;        //!< landuse ground model, or the default one
+    std::vector<int> contacts;              //!< scratch; batch indices of nodes below ground
+
+    void clear()
+    {
+        node_ids.clear();
+        x.clear();
+        y.clear();
+        z.clear();
+    }
+
+    void add(int node_id, const Ogre::Vector3& pos)
+    {
+        node_ids.push_back(node_id);
+        x.push_back(pos.x);
+        y.push_back(pos.y);
+        z.push_back(pos.z);
+    }
+
+    int size() const { return static_cast<int>(node_ids.size()); }
+};
+
 struct authorinfo_t
 {
     int id;
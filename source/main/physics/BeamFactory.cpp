@@ -38,6 +38,7 @@
 #include "MainMenu.h"
 
 #include "Network.h"
+#include "PhysicsRecording.h"
 #include "PointColDetector.h"
 #include "RigLoadingProfiler.h"
 #include "RigLoadingProfilerControl.h"
@@ -60,7 +61,9 @@
 #include "DashBoardManager.h"
 
 #include <algorithm>
+#include <chrono>
 #include <cstring>
+#include <thread>
 
 #if OGRE_PLATFORM == OGRE_PLATFORM_WIN32
   #include <intrin.h>
@@ -145,15 +148,23 @@ unsigned int getNumberOfCPUCores()
 
 using namespace RoR;
 
+/// How long to wait for idle pool threads to join the physics job
+static const int PHYSICS_JOB_RECRUIT_TIMEOUT_US = 100;
+
 BeamFactory::BeamFactory(RoRFrameListener* sim_controller)
     : m_current_truck(-1)
     , m_dt_remainder(0.0f)
     , m_forced_active(false)
     , m_free_truck(0)
+    , m_intra_truck_threading(BSETTING("IntraTruckThreading", true))
     , m_num_cpu_cores(0)
     , m_physics_frames(0)
     , m_physics_steps(2000)
     , m_previous_truck(-1)
+    , m_sim_intra_truck_parallel(false)
+    , m_sim_job_num_joined(-1)
+    , m_sim_job_num_simulated(0)
+    , m_sim_job_ready(false)
     , m_simulated_truck(0)
     , m_simulation_speed(1.0f)
     , m_sim_controller(sim_controller)
@@ -377,17 +388,19 @@ void BeamFactory::RemoveStreamSource(int sourceid)
 }
 
 #ifdef USE_SOCKETW
-void BeamFactory::handleStreamData(std::vector<RoR::Networking::recv_packet_t> packet_buffer)
+void BeamFactory::handleStreamData(std::vector<RoR::Networking::recv_packet_t> const& packet_buffer)
 {
-    for (auto packet : packet_buffer)
+    for (auto& packet : packet_buffer)
     {
         if (packet.header.command == RoRnet::MSG2_STREAM_REGISTER)
         {
             RoRnet::StreamRegister* reg = (RoRnet::StreamRegister *)packet.buffer;
             if (reg->type == 0)
             {
-                reg->status = this->CreateRemoteInstance((RoRnet::TruckStreamRegister *)packet.buffer);
-                RoR::Networking::AddPacket(0, RoRnet::MSG2_STREAM_REGISTER_RESULT, sizeof(RoRnet::StreamRegister), (char *)reg);
+                // The packet buffer is shared with the other handlers, reply with a copy
+                RoRnet::StreamRegister result = *reg;
+                result.status = this->CreateRemoteInstance((RoRnet::TruckStreamRegister *)packet.buffer);
+                RoR::Networking::AddPacket(0, RoRnet::MSG2_STREAM_REGISTER_RESULT, sizeof(RoRnet::StreamRegister), (char *)&result);
             }
         }
         else if (packet.header.command == RoRnet::MSG2_STREAM_REGISTER_RESULT)
@@ -403,6 +416,8 @@ void BeamFactory::handleStreamData(std::vector<RoR::Networking::recv_packet_t> p
                 {
                     int sourceid = packet.header.source;
                     m_trucks[t]->m_stream_results[sourceid] = reg->status;
+                    // the new peer can only decode stream data starting from a keyframe
+                    m_trucks[t]->m_net_encoder.RequestKeyframe();
 
                     if (reg->status == 1)
                     LOG("Client " + TOSTRING(sourceid) + " successfully loaded stream " + TOSTRING(reg->origin_streamid) + " with name '" + reg->name + "', result code: " + TOSTRING(reg->status));
@@ -602,7 +617,7 @@ void BeamFactory::RecursiveActivation(int j, std::bitset<MAX_TRUCKS>& visited)
 
     visited.set(j, true);
 
-    for (int t = 0; t < m_free_truck; t++)
+    for (int t : m_activation_broadphase.GetCandidates(j))
     {
         if (t == j || !m_trucks[t] || visited[t])
             continue;
@@ -620,6 +635,51 @@ void BeamFactory::RecursiveActivation(int j, std::bitset<MAX_TRUCKS>& visited)
     }
 }
 
+static AxisAlignedBox ScaleAABB(AxisAlignedBox box, float scale)
+{
+    if (!box.isFinite())
+        return box;
+    Vector3 center = box.getCenter();
+    Vector3 half_size = box.getHalfSize();
+    box.setExtents(center - half_size * scale, center + half_size * scale);
+    return box;
+}
+
+void BeamFactory::UpdateActivationBroadphase()
+{
+    // Each truck gets one box enclosing everything RecursiveActivation() tests it with
+    m_activation_broadphase.Reset(m_free_truck);
+    for (int t = 0; t < m_free_truck; t++)
+    {
+        if (!m_trucks[t])
+            continue;
+        AxisAlignedBox box = ScaleAABB(m_trucks[t]->boundingBox, 1.2f);
+        box.merge(m_trucks[t]->predictedBoundingBox);
+        for (AxisAlignedBox const& cbox : m_trucks[t]->collisionBoundingBoxes)
+            box.merge(ScaleAABB(cbox, 1.2f));
+        for (AxisAlignedBox const& cbox : m_trucks[t]->predictedCollisionBoundingBoxes)
+            box.merge(cbox);
+        m_activation_broadphase.AddBox(t, box);
+    }
+    m_activation_broadphase.Build();
+}
+
+void BeamFactory::UpdateCollisionBroadphase()
+{
+    // PointColDetector tests `boundingBox`; the predicted box is usually a superset, but not
+    // right after updateBoundingBox() (resets), hence the merge.
+    m_collision_broadphase.Reset(m_free_truck);
+    for (int t = 0; t < m_free_truck; t++)
+    {
+        if (!m_trucks[t])
+            continue;
+        AxisAlignedBox box = m_trucks[t]->boundingBox;
+        box.merge(m_trucks[t]->predictedBoundingBox);
+        m_collision_broadphase.AddBox(t, box);
+    }
+    m_collision_broadphase.Build();
+}
+
 void BeamFactory::UpdateSleepingState(float dt)
 {
     if (!m_forced_active)
@@ -648,6 +708,8 @@ void BeamFactory::UpdateSleepingState(float dt)
         current_truck->state = SIMULATED;
     }
 
+    this->UpdateActivationBroadphase();
+
     std::bitset<MAX_TRUCKS> visited;
     // Recursivly activate all trucks which can be reached from current_truck
     if (current_truck && current_truck->state == SIMULATED)
@@ -1036,6 +1098,7 @@ void BeamFactory::update(float dt)
     gEnv->mrTime += dt;
 
     this->SyncWithSimThread();
+    this->DispatchSimulationEvents();
 
     this->UpdateSleepingState(dt);
 
@@ -1081,6 +1144,11 @@ void BeamFactory::update(float dt)
         }
     }
 
+#ifdef USE_OPENAL
+    // Sounds of the engine updates above
+    SoundScriptManager::getSingleton().flushQueuedCommands();
+#endif // USE_OPENAL
+
     m_simulated_truck = m_current_truck;
 
     if (m_simulated_truck == -1)
@@ -1110,6 +1178,8 @@ void BeamFactory::update(float dt)
         if (!m_trucks[m_simulated_truck]->replayStep())
         {
             m_trucks[m_simulated_truck]->ForceFeedbackStep(m_physics_steps);
+            if (m_physics_recorder)
+                m_physics_recorder->RecordFrame(*this, m_physics_steps);
             if (m_sim_thread_pool)
             {
                 auto func = std::function<void()>([this]()
@@ -1168,75 +1238,7 @@ void BeamFactory::UpdatePhysicsSimulation()
     }
     if (gEnv->threadPool)
     {
-        for (int i = 0; i < m_physics_steps; i++)
-        {
-            int num_simulated_trucks = 0;
-            {
-                std::vector<std::function<void()>> tasks;
-                for (int t = 0; t < m_free_truck; t++)
-                {
-                    if (m_trucks[t] && (m_trucks[t]->simulated = m_trucks[t]->calcForcesEulerPrepare(i == 0, PHYSICS_DT, i, m_physics_steps)))
-                    {
-                        num_simulated_trucks++;
-                        auto func = std::function<void()>([this, i, t]()
-                            {
-                                m_trucks[t]->calcForcesEulerCompute(i == 0, PHYSICS_DT, i, m_physics_steps);
-                                if (!m_trucks[t]->disableTruckTruckSelfCollisions)
-                                {
-                                    m_trucks[t]->IntraPointCD()->update(m_trucks[t]);
-                                    intraTruckCollisions(PHYSICS_DT,
-                                        *(m_trucks[t]->IntraPointCD()),
-                                        m_trucks[t]->free_collcab,
-                                        m_trucks[t]->collcabs,
-                                        m_trucks[t]->cabs,
-                                        m_trucks[t]->intra_collcabrate,
-                                        m_trucks[t]->nodes,
-                                        m_trucks[t]->collrange,
-                                        *(m_trucks[t]->submesh_ground_model));
-                                }
-                            });
-                        tasks.push_back(func);
-                    }
-                }
-                gEnv->threadPool->Parallelize(tasks);
-            }
-
-            for (int t = 0; t < m_free_truck; t++)
-            {
-                if (m_trucks[t] && m_trucks[t]->simulated)
-                    m_trucks[t]->calcForcesEulerFinal(i == 0, PHYSICS_DT, i, m_physics_steps);
-            }
-
-            if (num_simulated_trucks > 1)
-            {
-                std::vector<std::function<void()>> tasks;
-                for (int t = 0; t < m_free_truck; t++)
-                {
-                    if (m_trucks[t] && m_trucks[t]->simulated && !m_trucks[t]->disableTruckTruckCollisions)
-                    {
-                        auto func = std::function<void()>([this, t]()
-                            {
-                                m_trucks[t]->InterPointCD()->update(m_trucks[t], m_trucks, m_free_truck);
-                                if (m_trucks[t]->collisionRelevant)
-                                {
-                                    interTruckCollisions(PHYSICS_DT,
-                                        *(m_trucks[t]->InterPointCD()),
-                                        m_trucks[t]->free_collcab,
-                                        m_trucks[t]->collcabs,
-                                        m_trucks[t]->cabs,
-                                        m_trucks[t]->inter_collcabrate,
-                                        m_trucks[t]->nodes,
-                                        m_trucks[t]->collrange,
-                                        m_trucks, m_free_truck,
-                                        *(m_trucks[t]->submesh_ground_model));
-                                }
-                            });
-                        tasks.push_back(func);
-                    }
-                }
-                gEnv->threadPool->Parallelize(tasks);
-            }
-        }
+        this->RunPhysicsJob();
     }
     else
     {
@@ -1270,11 +1272,12 @@ void BeamFactory::UpdatePhysicsSimulation()
             if (num_simulated_trucks > 1)
             {
                 BES_START(BES_CORE_Contacters);
+                this->UpdateCollisionBroadphase();
                 for (int t = 0; t < m_free_truck; t++)
                 {
                     if (m_trucks[t] && m_trucks[t]->simulated && !m_trucks[t]->disableTruckTruckCollisions)
                     {
-                        m_trucks[t]->InterPointCD()->update(m_trucks[t], m_trucks, m_free_truck);
+                        m_trucks[t]->InterPointCD()->update(m_trucks[t], m_trucks, m_free_truck, m_collision_broadphase.GetCandidates(t));
                         if (m_trucks[t]->collisionRelevant)
                         {
                             interTruckCollisions(
@@ -1305,6 +1308,206 @@ void BeamFactory::UpdatePhysicsSimulation()
     }
 }
 
+void BeamFactory::RunPhysicsJob()
+{
+    ThreadPool* pool = gEnv->threadPool;
+
+    int num_trucks = 0;
+    for (int t = 0; t < m_free_truck; t++)
+    {
+        if (m_trucks[t])
+            num_trucks++;
+    }
+    const int max_participants = std::max(1, std::min(num_trucks, pool->GetNumThreads() + 1));
+
+    // While there are fewer trucks than threads, let trucks split their beams and nodes
+    // into nested tasks as well (see Beam::getNumIntraTruckChunks())
+    m_sim_intra_truck_parallel = m_intra_truck_threading && (num_trucks <= pool->GetNumThreads());
+
+    // Recruit helper threads. Participants must run concurrently (they meet at barriers), so the set
+    // is closed before the first step; helpers which start later return immediately.
+    m_sim_job_ready.store(false, std::memory_order_relaxed);
+    m_sim_job_num_joined.store(1, std::memory_order_release); // This thread is participant 0
+    TaskGroup helpers;
+    auto join_func = [this](int) { this->JoinPhysicsJob(); };
+    pool->StartParallelFor(helpers, 0, max_participants - 1, 1, join_func);
+
+    const auto deadline = std::chrono::steady_clock::now() + std::chrono::microseconds(PHYSICS_JOB_RECRUIT_TIMEOUT_US);
+    while (m_sim_job_num_joined.load(std::memory_order_acquire) < max_participants && std::chrono::steady_clock::now() < deadline)
+    {
+        std::this_thread::yield();
+    }
+    const int num_participants = m_sim_job_num_joined.exchange(-1, std::memory_order_acq_rel);
+
+    // Fixed truck partitions for the whole frame; balanced by node count (largest first)
+    m_sim_job_trucks.clear();
+    for (int t = 0; t < m_free_truck; t++)
+    {
+        if (m_trucks[t])
+            m_sim_job_trucks.push_back(t);
+    }
+    std::sort(m_sim_job_trucks.begin(), m_sim_job_trucks.end(), [this](int a, int b)
+        {
+            return m_trucks[a]->free_node > m_trucks[b]->free_node;
+        });
+    m_sim_job_partitions.resize(std::max(static_cast<int>(m_sim_job_partitions.size()), num_participants));
+    m_sim_job_partition_load.assign(num_participants, 0);
+    for (int p = 0; p < num_participants; p++)
+    {
+        m_sim_job_partitions[p].clear();
+    }
+    for (int t : m_sim_job_trucks)
+    {
+        const int p = static_cast<int>(std::min_element(m_sim_job_partition_load.begin(), m_sim_job_partition_load.end()) - m_sim_job_partition_load.begin());
+        m_sim_job_partitions[p].push_back(t);
+        m_sim_job_partition_load[p] += m_trucks[t]->free_node;
+    }
+
+    m_sim_job_barrier.Reset(num_participants);
+    m_sim_job_ready.store(true, std::memory_order_release);
+
+    this->RunPhysicsJobPartition(0);
+    pool->Join(helpers);
+}
+
+void BeamFactory::JoinPhysicsJob()
+{
+    int slot = m_sim_job_num_joined.load(std::memory_order_acquire);
+    do
+    {
+        if (slot < 0)
+            return; // Too late, the job is running without us
+    } while (!m_sim_job_num_joined.compare_exchange_weak(slot, slot + 1, std::memory_order_acq_rel));
+
+    while (!m_sim_job_ready.load(std::memory_order_acquire))
+    {
+        std::this_thread::yield();
+    }
+    this->RunPhysicsJobPartition(slot);
+}
+
+void BeamFactory::RunPhysicsJobPartition(int participant)
+{
+    ThreadPool* pool = gEnv->threadPool;
+    auto help = [pool]() { return pool->RunPendingTask(); }; // Keep busy with nested tasks while waiting
+    std::vector<int> const& partition = m_sim_job_partitions[participant];
+
+    for (int i = 0; i < m_physics_steps; i++)
+    {
+        // Prepare; serial, inter-truck beams apply forces to other trucks' nodes
+        if (participant == 0)
+        {
+            int num_simulated_trucks = 0;
+            for (int t = 0; t < m_free_truck; t++)
+            {
+                if (m_trucks[t] && (m_trucks[t]->simulated = m_trucks[t]->calcForcesEulerPrepare(i == 0, PHYSICS_DT, i, m_physics_steps)))
+                    num_simulated_trucks++;
+            }
+            m_sim_job_num_simulated = num_simulated_trucks;
+        }
+        m_sim_job_barrier.Wait(help);
+        const int num_simulated_trucks = m_sim_job_num_simulated; // Participant 0 rewrites it next step
+
+        // Compute + intra-truck collisions
+        for (int t : partition)
+        {
+            if (!m_trucks[t]->simulated)
+                continue;
+            m_trucks[t]->m_intra_truck_parallel = m_sim_intra_truck_parallel;
+            m_trucks[t]->calcForcesEulerCompute(i == 0, PHYSICS_DT, i, m_physics_steps);
+            m_trucks[t]->m_intra_truck_parallel = false;
+            if (!m_trucks[t]->disableTruckTruckSelfCollisions)
+            {
+                m_trucks[t]->IntraPointCD()->update(m_trucks[t]);
+                intraTruckCollisions(PHYSICS_DT,
+                    *(m_trucks[t]->IntraPointCD()),
+                    m_trucks[t]->free_collcab,
+                    m_trucks[t]->collcabs,
+                    m_trucks[t]->cabs,
+                    m_trucks[t]->intra_collcabrate,
+                    m_trucks[t]->nodes,
+                    m_trucks[t]->collrange,
+                    *(m_trucks[t]->submesh_ground_model));
+            }
+        }
+        m_sim_job_barrier.Wait(help);
+
+        // Final; serial, hooks and ropes pull on other trucks' nodes
+        if (participant == 0)
+        {
+            for (int t = 0; t < m_free_truck; t++)
+            {
+                if (m_trucks[t] && m_trucks[t]->simulated)
+                    m_trucks[t]->calcForcesEulerFinal(i == 0, PHYSICS_DT, i, m_physics_steps);
+            }
+            if (num_simulated_trucks > 1)
+                this->UpdateCollisionBroadphase();
+        }
+        m_sim_job_barrier.Wait(help);
+
+        // Inter-truck collisions
+        if (num_simulated_trucks > 1)
+        {
+            for (int t : partition)
+            {
+                if (!m_trucks[t]->simulated || m_trucks[t]->disableTruckTruckCollisions)
+                    continue;
+                m_trucks[t]->InterPointCD()->update(m_trucks[t], m_trucks, m_free_truck, m_collision_broadphase.GetCandidates(t));
+                if (m_trucks[t]->collisionRelevant)
+                {
+                    interTruckCollisions(PHYSICS_DT,
+                        *(m_trucks[t]->InterPointCD()),
+                        m_trucks[t]->free_collcab,
+                        m_trucks[t]->collcabs,
+                        m_trucks[t]->cabs,
+                        m_trucks[t]->inter_collcabrate,
+                        m_trucks[t]->nodes,
+                        m_trucks[t]->collrange,
+                        m_trucks, m_free_truck,
+                        *(m_trucks[t]->submesh_ground_model));
+                }
+            }
+            m_sim_job_barrier.Wait(help);
+        }
+    }
+}
+
+void BeamFactory::SimulateSteps(int num_steps)
+{
+    this->SimulateSteps(num_steps, gEnv->mrTime + num_steps * PHYSICS_DT);
+}
+
+void BeamFactory::SimulateSteps(int num_steps, float mr_time)
+{
+    this->SyncWithSimThread();
+
+    m_physics_steps = num_steps;
+    gEnv->mrTime = mr_time;
+
+    this->UpdatePhysicsSimulation();
+}
+
+void BeamFactory::DispatchSimulationEvents()
+{
+    this->SyncWithSimThread();
+
+    if (gEnv->collisions)
+    {
+        gEnv->collisions->dispatchQueuedEvents(); // Event boxes hit during the last simulation run
+        gEnv->collisions->updateGrid();           // Objects spawned or removed since, including by the callbacks above
+    }
+
+#ifdef USE_OPENAL
+    SoundScriptManager::getSingleton().flushQueuedCommands();
+#endif // USE_OPENAL
+}
+
+void BeamFactory::StartPhysicsRecording(std::string const& filename)
+{
+    this->SyncWithSimThread();
+    m_physics_recorder.reset(new PhysicsRecorder(filename));
+}
+
 void BeamFactory::SyncWithSimThread()
 {
     if (m_sim_task)
@@ -29,7 +29,11 @@
 #include "Beam.h"
 #include "DustManager.h" // Particle systems manager
 #include "Network.h"
+#include "PhaseBarrier.h"
 #include "Singleton.h"
+#include "TruckBroadphase.h"
+
+#include <atomic>
 
 #define PHYSICS_DT 0.0005 // fixed dt of 0.5 ms
 
@@ -37,6 +41,8 @@ class ThreadPool;
 
 namespace RoR {
 
+class PhysicsRecorder;
+
 /// Builds and manages softbody actors; Manages multithreading.
 class BeamFactory
 {
@@ -64,7 +70,7 @@ public:
     void update(float dt);
 
 #ifdef USE_SOCKETW
-    void handleStreamData(std::vector<RoR::Networking::recv_packet_t> packet);
+    void handleStreamData(std::vector<RoR::Networking::recv_packet_t> const& packet);
 #endif // USE_SOCKETW
     int checkStreamsOK(int sourceid);
     int checkStreamsRemoteOK(int sourceid);
@@ -116,6 +122,20 @@ public:
 
     void UpdatePhysicsSimulation();
 
+    /// Runs physics steps of all trucks on the calling thread (and gEnv->threadPool), without
+    /// any of the per-frame logic of update(); used by PhysicsBenchmark.
+    void SimulateSteps(int num_steps);
+
+    /// Same, at the given simulation time (gEnv->mrTime) instead of advancing it; used by PhysicsPlayer.
+    void SimulateSteps(int num_steps, float mr_time);
+
+    /// Handles what the last simulation run queued for the main thread: event box script callbacks,
+    /// collision grid changes and sounds. Called by update(); call it after each SimulateSteps() as well.
+    void DispatchSimulationEvents();
+
+    /// Records the inputs of all following simulation runs; see PhysicsRecorder.
+    void StartPhysicsRecording(std::string const& filename);
+
     inline unsigned long getPhysFrame() { return m_physics_frames; };
 
     void recalcGravityMasses();
@@ -180,6 +200,13 @@ protected:
     void LogSpawnerMessages();
 
     void RecursiveActivation(int j, std::bitset<MAX_TRUCKS>& visited);
+    void UpdateActivationBroadphase();  ///< Candidates for RecursiveActivation(); once per frame
+    void UpdateCollisionBroadphase();   ///< Candidates for inter-truck collisions; once per substep
+
+    /// Runs all physics steps of the frame on gEnv->threadPool; see UpdatePhysicsSimulation()
+    void RunPhysicsJob();
+    void JoinPhysicsJob();                           ///< Entry point for helper threads
+    void RunPhysicsJobPartition(int participant);    ///< Step loop of one participant; phases separated by `m_sim_job_barrier`
     void UpdateSleepingState(float dt);
 
     int GetMostRecentTruckSlot();
@@ -195,9 +222,23 @@ protected:
     std::map<int, std::vector<int>> m_stream_mismatches;
     std::unique_ptr<ThreadPool>     m_sim_thread_pool;
     std::shared_ptr<Task>           m_sim_task;
+    std::unique_ptr<PhysicsRecorder> m_physics_recorder;
     RoRFrameListener*               m_sim_controller;
 
     int             m_num_cpu_cores;
+    bool            m_intra_truck_threading; ///< Let trucks split their beams/nodes across the thread pool when there are idle threads
+
+    // Persistent physics job, see RunPhysicsJob()
+    PhaseBarrier                  m_sim_job_barrier;
+    std::atomic<int>              m_sim_job_num_joined;     ///< Participants so far; -1 = closed
+    std::atomic<bool>             m_sim_job_ready;          ///< Partitions are assigned
+    std::vector<std::vector<int>> m_sim_job_partitions;     ///< Truck indices per participant
+    std::vector<int>              m_sim_job_partition_load; ///< Node count per participant
+    std::vector<int>              m_sim_job_trucks;
+    int                           m_sim_job_num_simulated;
+    bool                          m_sim_intra_truck_parallel;
+    TruckBroadphase               m_activation_broadphase;
+    TruckBroadphase               m_collision_broadphase;
     Beam*           m_trucks[MAX_TRUCKS];
     int             m_free_truck;
     int             m_previous_truck;
@@ -42,10 +42,15 @@
 #include "SoundScriptManager.h"
 #include "Water.h"
 #include "TerrainManager.h"
+#include "ThreadPool.h"
 #include "VehicleAI.h"
 
 using namespace Ogre;
 
+// Intra-truck threading: smallest workload worth a separate task
+static const int INTRA_TRUCK_MIN_BEAMS_PER_CHUNK = 512;
+static const int INTRA_TRUCK_MIN_NODES_PER_CHUNK = 128;
+
 void Beam::calcForcesEulerCompute(int doUpdate, Real dt, int step, int maxsteps)
 {
     IWater* water = 0;
@@ -607,26 +612,26 @@ void Beam::calcForcesEulerCompute(int doUpdate, Real dt, int step, int maxsteps)
         if (!antilockbrake)
         {
 #ifdef USE_OPENAL
-            SoundScriptManager::getSingleton().trigStop(trucknum, SS_TRIG_ALB_ACTIVE);
+            SoundScriptManager::getSingleton().queueTrigStop(trucknum, SS_TRIG_ALB_ACTIVE);
 #endif //USE_OPENAL
         }
         else
         {
 #ifdef USE_OPENAL
-            SoundScriptManager::getSingleton().trigStart(trucknum, SS_TRIG_ALB_ACTIVE);
+            SoundScriptManager::getSingleton().queueTrigStart(trucknum, SS_TRIG_ALB_ACTIVE);
 #endif //USE_OPENAL
         }
 
         if (!tractioncontrol)
         {
 #ifdef USE_OPENAL
-            SoundScriptManager::getSingleton().trigStop(trucknum, SS_TRIG_TC_ACTIVE);
+            SoundScriptManager::getSingleton().queueTrigStop(trucknum, SS_TRIG_TC_ACTIVE);
 #endif //USE_OPENAL
         }
         else
         {
 #ifdef USE_OPENAL
-            SoundScriptManager::getSingleton().trigStart(trucknum, SS_TRIG_TC_ACTIVE);
+            SoundScriptManager::getSingleton().queueTrigStart(trucknum, SS_TRIG_TC_ACTIVE);
 #endif //USE_OPENAL
         }
     }
@@ -710,9 +715,9 @@ void Beam::calcForcesEulerCompute(int doUpdate, Real dt, int step, int maxsteps)
 
 #ifdef USE_OPENAL
         if (stabcommand && fabs(stabratio) < 0.1)
-            SoundScriptManager::getSingleton().trigStart(trucknum, SS_TRIG_AIR);
+            SoundScriptManager::getSingleton().queueTrigStart(trucknum, SS_TRIG_AIR);
         else
-            SoundScriptManager::getSingleton().trigStop(trucknum, SS_TRIG_AIR);
+            SoundScriptManager::getSingleton().queueTrigStop(trucknum, SS_TRIG_AIR);
 #endif //OPENAL
     }
 
@@ -1081,20 +1086,20 @@ void Beam::calcForcesEulerCompute(int doUpdate, Real dt, int step, int maxsteps)
                             if (vst == 1)
                             {
                                 // just started
-                                SoundScriptManager::getSingleton().trigStop(trucknum, SS_TRIG_LINKED_COMMAND, SL_COMMAND, -i);
-                                SoundScriptManager::getSingleton().trigStart(trucknum, SS_TRIG_LINKED_COMMAND, SL_COMMAND, i);
+                                SoundScriptManager::getSingleton().queueTrigStop(trucknum, SS_TRIG_LINKED_COMMAND, SL_COMMAND, -i);
+                                SoundScriptManager::getSingleton().queueTrigStart(trucknum, SS_TRIG_LINKED_COMMAND, SL_COMMAND, i);
                                 vst = 0;
                             }
                             else if (vst == -1)
                             {
                                 // just stopped
-                                SoundScriptManager::getSingleton().trigStop(trucknum, SS_TRIG_LINKED_COMMAND, SL_COMMAND, i);
+                                SoundScriptManager::getSingleton().queueTrigStop(trucknum, SS_TRIG_LINKED_COMMAND, SL_COMMAND, i);
                                 vst = 0;
                             }
                             else if (vst == 0)
                             {
                                 // already running, modulate
-                                SoundScriptManager::getSingleton().modulate(trucknum, SS_MOD_LINKED_COMMANDRATE, v, SL_COMMAND, i);
+                                SoundScriptManager::getSingleton().queueModulate(trucknum, SS_MOD_LINKED_COMMANDRATE, v, SL_COMMAND, i);
                             }
                         }
 #endif //USE_OPENAL
@@ -1164,13 +1169,13 @@ void Beam::calcForcesEulerCompute(int doUpdate, Real dt, int step, int maxsteps)
 #ifdef USE_OPENAL
             if (active > 0)
             {
-                SoundScriptManager::getSingleton().trigStart(trucknum, SS_TRIG_PUMP);
+                SoundScriptManager::getSingleton().queueTrigStart(trucknum, SS_TRIG_PUMP);
                 float pump_rpm = 660.0f * (1.0f - (work / (float)active) / 100.0f);
-                SoundScriptManager::getSingleton().modulate(trucknum, SS_MOD_PUMP, pump_rpm);
+                SoundScriptManager::getSingleton().queueModulate(trucknum, SS_MOD_PUMP, pump_rpm);
             }
             else
             {
-                SoundScriptManager::getSingleton().trigStop(trucknum, SS_TRIG_PUMP);
+                SoundScriptManager::getSingleton().queueTrigStop(trucknum, SS_TRIG_PUMP);
             }
 #endif //USE_OPENAL
         }
@@ -1265,7 +1270,6 @@ void Beam::calcForcesEulerCompute(int doUpdate, Real dt, int step, int maxsteps)
                 {
                     nbuff[i].position = nodes[i].AbsPosition;
                     nbuff[i].velocity = nodes[i].Velocity;
-                    nbuff[i].forces = nodes[i].Forces;
                 }
             }
 
@@ -1316,239 +1320,291 @@ void Beam::calcForcesEulerFinal(int doUpdate, Ogre::Real dt, int step, int maxst
 void Beam::calcBeams(int doUpdate, Ogre::Real dt, int step, int maxsteps)
 {
     BES_START(BES_CORE_Beams);
-    // Springs
-    for (int i = 0; i < free_beam; i++)
+    if (m_beams_soa_enabled)
     {
-        if (!beams[i].disabled && !beams[i].p2truck)
+        if (m_beams_soa_dirty)
         {
-            // Calculate beam length
-            Vector3 dis = beams[i].p1->RelPosition - beams[i].p2->RelPosition;
+            m_beams_soa.Build(beams, free_beam, nodes);
+            m_beams_soa_dirty = false;
+        }
 
-            Real dislen = dis.squaredLength();
-            Real inverted_dislen = fast_invSqrt(dislen);
+        // Plain springs: SIMD kernel over the SoA mirror
+        m_beams_soa.GatherNodes(nodes, free_node);
+        const int num_chunks = this->getNumIntraTruckChunks(static_cast<int>(m_beams_soa.GetNumBeams()), INTRA_TRUCK_MIN_BEAMS_PER_CHUNK);
+        if (num_chunks > 1)
+        {
+            m_beams_soa.PrepareChunks(num_chunks);
+            gEnv->threadPool->ParallelFor(0, num_chunks, 1, [this](int c) { m_beams_soa.CalcSpringsChunk(c); });
+            m_beams_soa.ReduceChunks();
+        }
+        else
+        {
+            m_beams_soa.CalcSprings();
+        }
 
-            dislen *= inverted_dislen;
+        // Before the scalar path below, which writes the final stress of exceeded springs
+        if (doUpdate)
+        {
+            m_beams_soa.WriteBackStress(beams);
+        }
 
-            // Calculate beam's deviation from normal
-            Real difftoBeamL = dislen - beams[i].L;
+        // Springs about to deform or break are re-evaluated by the scalar path
+        for (int slot : m_beams_soa.GetExceededSlots())
+        {
+            const int i = m_beams_soa.GetBeamIndex(slot);
+            calcBeam(i, doUpdate, dt);
+            m_beams_soa.UpdateBeam(slot, beams[i]);
+        }
 
-            Real k = beams[i].k;
-            Real d = beams[i].d;
+        m_beams_soa.ScatterForces(nodes, free_node);
 
-            switch (beams[i].bounded)
-            {
-            case SHOCK1:
-                {
-                    float interp_ratio;
+        // Shocks, ropes, support beams, hydros...
+        for (int i : m_beams_soa.GetScalarBeams())
+        {
+            calcBeam(i, doUpdate, dt);
+        }
+    }
+    else
+    {
+        for (int i = 0; i < free_beam; i++)
+        {
+            calcBeam(i, doUpdate, dt);
+        }
+    }
+    BES_STOP(BES_CORE_Beams);
+}
 
-                    // Following code interpolates between defined beam parameters and default beam parameters
-                    if (difftoBeamL > beams[i].longbound * beams[i].L)
-                        interp_ratio = difftoBeamL - beams[i].longbound * beams[i].L;
-                    else if (difftoBeamL < -beams[i].shortbound * beams[i].L)
-                        interp_ratio = -difftoBeamL - beams[i].shortbound * beams[i].L;
-                    else
-                        break;
+void Beam::calcBeam(int i, int doUpdate, Ogre::Real dt)
+{
+    if (!beams[i].disabled && !beams[i].p2truck)
+    {
+        // Calculate beam length
+        Vector3 dis = beams[i].p1->RelPosition - beams[i].p2->RelPosition;
 
-                    // Hard (normal) shock bump
-                    float tspring = DEFAULT_SPRING;
-                    float tdamp = DEFAULT_DAMP;
+        Real dislen = dis.squaredLength();
+        Real inverted_dislen = fast_invSqrt(dislen);
 
-                    // Skip camera, wheels or any other shocks which are not generated in a shocks or shocks2 section
-                    if (beams[i].type == BEAM_HYDRO || beams[i].type == BEAM_INVISIBLE_HYDRO)
-                    {
-                        tspring = beams[i].shock->sbd_spring;
-                        tdamp = beams[i].shock->sbd_damp;
-                    }
+        dislen *= inverted_dislen;
+
+        // Calculate beam's deviation from normal
+        Real difftoBeamL = dislen - beams[i].L;
+
+        Real k = beams[i].k;
+        Real d = beams[i].d;
 
-                    k += (tspring - k) * interp_ratio;
-                    d += (tdamp - d) * interp_ratio;
+        switch (beams[i].bounded)
+        {
+        case SHOCK1:
+            {
+                float interp_ratio;
+
+                // Following code interpolates between defined beam parameters and default beam parameters
+                if (difftoBeamL > beams[i].longbound * beams[i].L)
+                    interp_ratio = difftoBeamL - beams[i].longbound * beams[i].L;
+                else if (difftoBeamL < -beams[i].shortbound * beams[i].L)
+                    interp_ratio = -difftoBeamL - beams[i].shortbound * beams[i].L;
+                else
+                    break;
+
+                // Hard (normal) shock bump
+                float tspring = DEFAULT_SPRING;
+                float tdamp = DEFAULT_DAMP;
+
+                // Skip camera, wheels or any other shocks which are not generated in a shocks or shocks2 section
+                if (beams[i].type == BEAM_HYDRO || beams[i].type == BEAM_INVISIBLE_HYDRO)
+                {
+                    tspring = beams[i].shock->sbd_spring;
+                    tdamp = beams[i].shock->sbd_damp;
                 }
-                break;
 
-            case SHOCK2:
-                calcShocks2(i, difftoBeamL, k, d, dt, doUpdate);
-                break;
+                k += (tspring - k) * interp_ratio;
+                d += (tdamp - d) * interp_ratio;
+            }
+            break;
+
+        case SHOCK2:
+            calcShocks2(i, difftoBeamL, k, d, dt, doUpdate);
+            break;
 
-            case SUPPORTBEAM:
-                if (difftoBeamL > 0.0f)
+        case SUPPORTBEAM:
+            if (difftoBeamL > 0.0f)
+            {
+                k = 0.0f;
+                d *= 0.1f;
+                float break_limit = SUPPORT_BEAM_LIMIT_DEFAULT;
+                if (beams[i].longbound > 0.0f)
                 {
-                    k = 0.0f;
-                    d *= 0.1f;
-                    float break_limit = SUPPORT_BEAM_LIMIT_DEFAULT;
-                    if (beams[i].longbound > 0.0f)
-                    {
-                        // This is a supportbeam with a user set break limit, get the user set limit
-                        break_limit = beams[i].longbound;
-                    }
+                    // This is a supportbeam with a user set break limit, get the user set limit
+                    break_limit = beams[i].longbound;
+                }
 
-                    // If support beam is extended the originallength * break_limit, break and disable it
-                    if (difftoBeamL > beams[i].L * break_limit)
+                // If support beam is extended the originallength * break_limit, break and disable it
+                if (difftoBeamL > beams[i].L * break_limit)
+                {
+                    beams[i].broken = true;
+                    beams[i].disabled = true;
+                    if (beambreakdebug)
                     {
-                        beams[i].broken = true;
-                        beams[i].disabled = true;
-                        if (beambreakdebug)
-                        {
-                            LOG(" XXX Support-Beam " + TOSTRING(i) + " limit extended and broke. Length: " + TOSTRING(difftoBeamL) +
-                                " / max. Length: " + TOSTRING(beams[i].L*break_limit) + ". It was between nodes " + TOSTRING(beams[i].p1->id) + " and " + TOSTRING(beams[i].p2->id) + ".");
-                        }
+                        LOG(" XXX Support-Beam " + TOSTRING(i) + " limit extended and broke. Length: " + TOSTRING(difftoBeamL) +
+                            " / max. Length: " + TOSTRING(beams[i].L*break_limit) + ". It was between nodes " + TOSTRING(beams[i].p1->id) + " and " + TOSTRING(beams[i].p2->id) + ".");
                     }
                 }
-                break;
+            }
+            break;
 
-            case ROPE:
-                if (difftoBeamL < 0.0f)
-                {
-                    k = 0.0f;
-                    d *= 0.1f;
-                }
-                break;
+        case ROPE:
+            if (difftoBeamL < 0.0f)
+            {
+                k = 0.0f;
+                d *= 0.1f;
             }
+            break;
+        }
 
-            // Calculate beam's rate of change
-            Vector3 v = beams[i].p1->Velocity - beams[i].p2->Velocity;
+        // Calculate beam's rate of change
+        Vector3 v = beams[i].p1->Velocity - beams[i].p2->Velocity;
 
-            float slen = -k * (difftoBeamL) - d * v.dotProduct(dis) * inverted_dislen;
-            beams[i].stress = slen;
+        float slen = -k * (difftoBeamL) - d * v.dotProduct(dis) * inverted_dislen;
+        beams[i].stress = slen;
 
-            // Fast test for deformation
-            float len = std::abs(slen);
-            if (len > beams[i].minmaxposnegstress)
+        // Fast test for deformation
+        float len = std::abs(slen);
+        if (len > beams[i].minmaxposnegstress)
+        {
+            if ((beams[i].type == BEAM_NORMAL || beams[i].type == BEAM_INVISIBLE) && beams[i].bounded != SHOCK1 && k != 0.0f)
             {
-                if ((beams[i].type == BEAM_NORMAL || beams[i].type == BEAM_INVISIBLE) && beams[i].bounded != SHOCK1 && k != 0.0f)
+                // Actual deformation tests
+                if (slen > beams[i].maxposstress && difftoBeamL < 0.0f) // compression
                 {
-                    // Actual deformation tests
-                    if (slen > beams[i].maxposstress && difftoBeamL < 0.0f) // compression
+                    increased_accuracy = true;
+                    Real yield_length = beams[i].maxposstress / k;
+                    Real deform = difftoBeamL + yield_length * (1.0f - beams[i].plastic_coef);
+                    Real Lold = beams[i].L;
+                    beams[i].L += deform;
+                    beams[i].L = std::max(MIN_BEAM_LENGTH, beams[i].L);
+                    slen = slen - (slen - beams[i].maxposstress) * 0.5f;
+                    len = slen;
+                    if (beams[i].L > 0.0f && Lold > beams[i].L)
                     {
-                        increased_accuracy = true;
-                        Real yield_length = beams[i].maxposstress / k;
-                        Real deform = difftoBeamL + yield_length * (1.0f - beams[i].plastic_coef);
-                        Real Lold = beams[i].L;
-                        beams[i].L += deform;
-                        beams[i].L = std::max(MIN_BEAM_LENGTH, beams[i].L);
-                        slen = slen - (slen - beams[i].maxposstress) * 0.5f;
-                        len = slen;
-                        if (beams[i].L > 0.0f && Lold > beams[i].L)
-                        {
-                            beams[i].maxposstress *= Lold / beams[i].L;
-                            beams[i].minmaxposnegstress = std::min(beams[i].maxposstress, -beams[i].maxnegstress);
-                            beams[i].minmaxposnegstress = std::min(beams[i].minmaxposnegstress, beams[i].strength);
-                        }
-                        // For the compression case we do not remove any of the beam's
-                        // strength for structure stability reasons
-                        //beams[i].strength += deform * k * 0.5f;
-                        if (beamdeformdebug)
-                        {
-                            LOG(" YYY Beam " + TOSTRING(i) + " just deformed with extension force " + TOSTRING(len) +
-                                " / " + TOSTRING(beams[i].strength) + ". It was between nodes " + TOSTRING(beams[i].p1->id) + " and " + TOSTRING(beams[i].p2->id) + ".");
-                        }
+                        beams[i].maxposstress *= Lold / beams[i].L;
+                        beams[i].minmaxposnegstress = std::min(beams[i].maxposstress, -beams[i].maxnegstress);
+                        beams[i].minmaxposnegstress = std::min(beams[i].minmaxposnegstress, beams[i].strength);
                     }
-                    else if (slen < beams[i].maxnegstress && difftoBeamL > 0.0f) // expansion
+                    // For the compression case we do not remove any of the beam's
+                    // strength for structure stability reasons
+                    //beams[i].strength += deform * k * 0.5f;
+                    if (beamdeformdebug)
                     {
-                        increased_accuracy = true;
-                        Real yield_length = beams[i].maxnegstress / k;
-                        Real deform = difftoBeamL + yield_length * (1.0f - beams[i].plastic_coef);
-                        Real Lold = beams[i].L;
-                        beams[i].L += deform;
-                        slen = slen - (slen - beams[i].maxnegstress) * 0.5f;
-                        len = -slen;
-                        if (Lold > 0.0f && beams[i].L > Lold)
-                        {
-                            beams[i].maxnegstress *= beams[i].L / Lold;
-                            beams[i].minmaxposnegstress = std::min(beams[i].maxposstress, -beams[i].maxnegstress);
-                            beams[i].minmaxposnegstress = std::min(beams[i].minmaxposnegstress, beams[i].strength);
-                        }
-                        beams[i].strength -= deform * k;
-                        if (beamdeformdebug)
-                        {
-                            LOG(" YYY Beam " + TOSTRING(i) + " just deformed with extension force " + TOSTRING(len) +
-                                " / " + TOSTRING(beams[i].strength) + ". It was between nodes " + TOSTRING(beams[i].p1->id) + " and " + TOSTRING(beams[i].p2->id) + ".");
-                        }
+                        LOG(" YYY Beam " + TOSTRING(i) + " just deformed with extension force " + TOSTRING(len) +
+                            " / " + TOSTRING(beams[i].strength) + ". It was between nodes " + TOSTRING(beams[i].p1->id) + " and " + TOSTRING(beams[i].p2->id) + ".");
                     }
                 }
-
-                // Test if the beam should break
-                if (len > beams[i].strength)
+                else if (slen < beams[i].maxnegstress && difftoBeamL > 0.0f) // expansion
                 {
-                    // Sound effect.
-                    // Sound volume depends on springs stored energy
+                    increased_accuracy = true;
+                    Real yield_length = beams[i].maxnegstress / k;
+                    Real deform = difftoBeamL + yield_length * (1.0f - beams[i].plastic_coef);
+                    Real Lold = beams[i].L;
+                    beams[i].L += deform;
+                    slen = slen - (slen - beams[i].maxnegstress) * 0.5f;
+                    len = -slen;
+                    if (Lold > 0.0f && beams[i].L > Lold)
+                    {
+                        beams[i].maxnegstress *= beams[i].L / Lold;
+                        beams[i].minmaxposnegstress = std::min(beams[i].maxposstress, -beams[i].maxnegstress);
+                        beams[i].minmaxposnegstress = std::min(beams[i].minmaxposnegstress, beams[i].strength);
+                    }
+                    beams[i].strength -= deform * k;
+                    if (beamdeformdebug)
+                    {
+                        LOG(" YYY Beam " + TOSTRING(i) + " just deformed with extension force " + TOSTRING(len) +
+                            " / " + TOSTRING(beams[i].strength) + ". It was between nodes " + TOSTRING(beams[i].p1->id) + " and " + TOSTRING(beams[i].p2->id) + ".");
+                    }
+                }
+            }
+
+            // Test if the beam should break
+            if (len > beams[i].strength)
+            {
+                // Sound effect.
+                // Sound volume depends on springs stored energy
 #ifdef USE_OPENAL
-                    SoundScriptManager::getSingleton().modulate(trucknum, SS_MOD_BREAK, 0.5 * k * difftoBeamL * difftoBeamL);
-                    SoundScriptManager::getSingleton().trigOnce(trucknum, SS_TRIG_BREAK);
+                SoundScriptManager::getSingleton().queueModulate(trucknum, SS_MOD_BREAK, 0.5 * k * difftoBeamL * difftoBeamL);
+                SoundScriptManager::getSingleton().queueTrigOnce(trucknum, SS_TRIG_BREAK);
 #endif //OPENAL
-                    increased_accuracy = true;
+                increased_accuracy = true;
 
-                    //Break the beam only when it is not connected to a node
-                    //which is a part of a collision triangle and has 2 "live" beams or less
-                    //connected to it.
-                    if (!((beams[i].p1->contacter && nodeBeamConnections(beams[i].p1->pos) < 3) || (beams[i].p2->contacter && nodeBeamConnections(beams[i].p2->pos) < 3)))
-                    {
-                        slen = 0.0f;
-                        beams[i].broken = true;
-                        beams[i].disabled = true;
+                //Break the beam only when it is not connected to a node
+                //which is a part of a collision triangle and has 2 "live" beams or less
+                //connected to it.
+                if (!((beams[i].p1->contacter && nodeBeamConnections(beams[i].p1->pos) < 3) || (beams[i].p2->contacter && nodeBeamConnections(beams[i].p2->pos) < 3)))
+                {
+                    slen = 0.0f;
+                    beams[i].broken = true;
+                    beams[i].disabled = true;
+                    m_beams_soa_dirty = true; // Also covers the detacher group below
 
-                        if (beambreakdebug)
-                        {
-                            LOG(" XXX Beam " + TOSTRING(i) + " just broke with force " + TOSTRING(len) +
-                                " / " + TOSTRING(beams[i].strength) + ". It was between nodes " + TOSTRING(beams[i].p1->id) + " and " + TOSTRING(beams[i].p2->id) + ".");
-                        }
+                    if (beambreakdebug)
+                    {
+                        LOG(" XXX Beam " + TOSTRING(i) + " just broke with force " + TOSTRING(len) +
+                            " / " + TOSTRING(beams[i].strength) + ". It was between nodes " + TOSTRING(beams[i].p1->id) + " and " + TOSTRING(beams[i].p2->id) + ".");
+                    }
 
-                        // detachergroup check: beam[i] is already broken, check detacher group# == 0/default skip the check ( performance bypass for beams with default setting )
-                        // only perform this check if this is a master detacher beams (positive detacher group id > 0)
-                        if (beams[i].detacher_group > 0)
+                    // detachergroup check: beam[i] is already broken, check detacher group# == 0/default skip the check ( performance bypass for beams with default setting )
+                    // only perform this check if this is a master detacher beams (positive detacher group id > 0)
+                    if (beams[i].detacher_group > 0)
+                    {
+                        // cycle once through the other beams
+                        for (int j = 0; j < free_beam; j++)
                         {
-                            // cycle once through the other beams
-                            for (int j = 0; j < free_beam; j++)
+                            // beam[i] detacher group# == checked beams detacher group# -> delete & disable checked beam
+                            // do this with all master(positive id) and minor(negative id) beams of this detacher group
+                            if (abs(beams[j].detacher_group) == beams[i].detacher_group)
                             {
-                                // beam[i] detacher group# == checked beams detacher group# -> delete & disable checked beam
-                                // do this with all master(positive id) and minor(negative id) beams of this detacher group
-                                if (abs(beams[j].detacher_group) == beams[i].detacher_group)
+                                beams[j].broken = true;
+                                beams[j].disabled = true;
+                                if (beambreakdebug)
                                 {
-                                    beams[j].broken = true;
-                                    beams[j].disabled = true;
-                                    if (beambreakdebug)
-                                    {
-                                        LOG("Deleting Detacher BeamID: " + TOSTRING(j) + ", Detacher Group: " + TOSTRING(beams[i].detacher_group)+ ", trucknum: " + TOSTRING(trucknum));
-                                    }
+                                    LOG("Deleting Detacher BeamID: " + TOSTRING(j) + ", Detacher Group: " + TOSTRING(beams[i].detacher_group)+ ", trucknum: " + TOSTRING(trucknum));
                                 }
                             }
-                            // cycle once through all wheels
-                            for (int j = 0; j < free_wheel; j++)
+                        }
+                        // cycle once through all wheels
+                        for (int j = 0; j < free_wheel; j++)
+                        {
+                            if (wheels[j].detacher_group == beams[i].detacher_group)
                             {
-                                if (wheels[j].detacher_group == beams[i].detacher_group)
-                                {
-                                    wheels[j].detached = true;
-                                }
+                                wheels[j].detached = true;
                             }
                         }
                     }
-                    else
-                    {
-                        beams[i].strength = 2.0f * beams[i].minmaxposnegstress;
-                    }
+                }
+                else
+                {
+                    beams[i].strength = 2.0f * beams[i].minmaxposnegstress;
+                }
 
-                    // something broke, check buoyant hull
-                    for (int mk = 0; mk < free_buoycab; mk++)
+                // something broke, check buoyant hull
+                for (int mk = 0; mk < free_buoycab; mk++)
+                {
+                    int tmpv = buoycabs[mk] * 3;
+                    if (buoycabtypes[mk] == Buoyance::BUOY_DRAGONLY)
+                        continue;
+                    if ((beams[i].p1 == &nodes[cabs[tmpv]] || beams[i].p1 == &nodes[cabs[tmpv + 1]] || beams[i].p1 == &nodes[cabs[tmpv + 2]]) &&
+                        (beams[i].p2 == &nodes[cabs[tmpv]] || beams[i].p2 == &nodes[cabs[tmpv + 1]] || beams[i].p2 == &nodes[cabs[tmpv + 2]]))
                     {
-                        int tmpv = buoycabs[mk] * 3;
-                        if (buoycabtypes[mk] == Buoyance::BUOY_DRAGONLY)
-                            continue;
-                        if ((beams[i].p1 == &nodes[cabs[tmpv]] || beams[i].p1 == &nodes[cabs[tmpv + 1]] || beams[i].p1 == &nodes[cabs[tmpv + 2]]) &&
-                            (beams[i].p2 == &nodes[cabs[tmpv]] || beams[i].p2 == &nodes[cabs[tmpv + 1]] || beams[i].p2 == &nodes[cabs[tmpv + 2]]))
-                        {
-                            buoyance->setsink(1);
-                        }
+                        buoyance->setsink(1);
                     }
                 }
             }
-
-            // At last update the beam forces
-            Vector3 f = dis;
-            f *= (slen * inverted_dislen);
-            beams[i].p1->Forces += f;
-            beams[i].p2->Forces -= f;
         }
+
+        // At last update the beam forces
+        Vector3 f = dis;
+        f *= (slen * inverted_dislen);
+        beams[i].p1->Forces += f;
+        beams[i].p2->Forces -= f;
     }
-    BES_STOP(BES_CORE_Beams);
 }
 
 void Beam::calcBeamsInterTruck(int doUpdate, Ogre::Real dt, int step, int maxsteps)
@@ -1643,8 +1699,8 @@ void Beam::calcBeamsInterTruck(int doUpdate, Ogre::Real dt, int step, int maxste
                     // Sound effect.
                     // Sound volume depends on springs stored energy
 #ifdef USE_OPENAL
-                    SoundScriptManager::getSingleton().modulate(trucknum, SS_MOD_BREAK, 0.5 * k * difftoBeamL * difftoBeamL);
-                    SoundScriptManager::getSingleton().trigOnce(trucknum, SS_TRIG_BREAK);
+                    SoundScriptManager::getSingleton().queueModulate(trucknum, SS_MOD_BREAK, 0.5 * k * difftoBeamL * difftoBeamL);
+                    SoundScriptManager::getSingleton().queueTrigOnce(trucknum, SS_TRIG_BREAK);
 #endif //OPENAL
 
                     //Break the beam only when it is not connected to a node
@@ -1678,6 +1734,16 @@ void Beam::calcBeamsInterTruck(int doUpdate, Ogre::Real dt, int step, int maxste
     }
 }
 
+int Beam::getNumIntraTruckChunks(int num_items, int min_items_per_chunk) const
+{
+    if (!m_intra_truck_parallel || !gEnv->threadPool)
+        return 1;
+
+    // The calling thread processes chunks as well, see ThreadPool::ParallelFor()
+    const int max_chunks = gEnv->threadPool->GetNumThreads() + 1;
+    return std::max(1, std::min(max_chunks, num_items / min_items_per_chunk));
+}
+
 void Beam::calcNodes(int doUpdate, Ogre::Real dt, int step, int maxsteps)
 {
     IWater* water = 0;
@@ -1688,7 +1754,66 @@ void Beam::calcNodes(int doUpdate, Ogre::Real dt, int step, int maxsteps)
         gravity = gEnv->terrainManager->getGravity();
     }
 
-    for (int i = 0; i < free_node; i++)
+    // Turbulence noise is seeded from the simulation time, substep and truck rather than drawn
+    // from the global frand() state, so it doesn't depend on thread scheduling or chunking
+    unsigned int mr_time_bits;
+    memcpy(&mr_time_bits, &gEnv->mrTime, sizeof(mr_time_bits));
+    m_turbulence_seed = (mr_time_bits * 2654435761u) ^ (static_cast<unsigned int>(step) * 40503u) ^ (static_cast<unsigned int>(trucknum) * 0x85ebca6bu);
+
+    // Particles, sounds and skidmarks are only emitted on update steps; keep those on one thread
+    const int num_chunks = (doUpdate) ? 1 : this->getNumIntraTruckChunks(free_node, INTRA_TRUCK_MIN_NODES_PER_CHUNK);
+    const int chunk_size = (free_node + num_chunks - 1) / num_chunks;
+    m_calc_nodes_results.resize(std::max(static_cast<int>(m_calc_nodes_results.size()), num_chunks));
+    for (int c = 0; c < num_chunks; c++)
+    {
+        m_calc_nodes_results[c].watercontact = false;
+        m_calc_nodes_results[c].ground_model = nullptr;
+    }
+
+    if (num_chunks > 1)
+    {
+        gEnv->threadPool->ParallelFor(0, num_chunks, 1, [=](int c)
+            {
+                this->calcNodesRange(c * chunk_size, std::min(free_node, (c + 1) * chunk_size),
+                    doUpdate, dt, step, maxsteps, water, gravity, m_calc_nodes_results[c]);
+            });
+    }
+    else
+    {
+        this->calcNodesRange(0, free_node, doUpdate, dt, step, maxsteps, water, gravity, m_calc_nodes_results[0]);
+    }
+
+    // Merge in node order, same result as a single pass
+    for (int c = 0; c < num_chunks; c++)
+    {
+        if (m_calc_nodes_results[c].watercontact)
+            watercontact = true;
+        if (m_calc_nodes_results[c].ground_model)
+            lastFuzzyGroundModel = m_calc_nodes_results[c].ground_model;
+    }
+}
+
+void Beam::calcNodesRange(int begin, int end, int doUpdate, Ogre::Real dt, int step, int maxsteps, IWater* water, float gravity, CalcNodesResult& result)
+{
+    // Gather the nodes due for a collision test and query the terrain for all of them at once.
+    // Valid for the loop below as a node's position only changes after its own collision test.
+    ground_batch_t& batch = result.ground_batch;
+    batch.clear();
+    for (int i = begin; i < end; i++)
+    {
+        if (!nodes[i].contactless)
+        {
+            nodes[i].collTestTimer += dt;
+            if (nodes[i].contacted || nodes[i].collTestTimer > 0.005 || ((nodes[i].iswheel || nodes[i].wheelid != -1) && (high_res_wheelnode_collisions || nodes[i].collTestTimer > 0.0025)) || increased_accuracy)
+            {
+                batch.add(i, nodes[i].AbsPosition);
+            }
+        }
+    }
+    gEnv->collisions->groundCollisionBatch(batch);
+    int batch_pos = 0;
+
+    for (int i = begin; i < end; i++)
     {
         // wetness
         if (doUpdate)
@@ -1711,86 +1836,82 @@ void Beam::calcNodes(int doUpdate, Ogre::Real dt, int step, int maxsteps)
         }
 
         // COLLISION
-        if (!nodes[i].contactless)
+        if (batch_pos < batch.size() && batch.node_ids[batch_pos] == i)
         {
-            nodes[i].collTestTimer += dt;
-            if (nodes[i].contacted || nodes[i].collTestTimer > 0.005 || ((nodes[i].iswheel || nodes[i].wheelid != -1) && (high_res_wheelnode_collisions || nodes[i].collTestTimer > 0.0025)) || increased_accuracy)
+            float ns = 0;
+            ground_model_t* gm = 0; // this is used as result storage, so we can use it later on
+            bool contacted = gEnv->collisions->groundCollision(&nodes[i], nodes[i].collTestTimer, batch, batch_pos++, &gm, &ns);
+            // reverted this construct to the old form, don't mess with it, the binary operator is intentionally!
+            if (contacted | gEnv->collisions->nodeCollision(&nodes[i], contacted, nodes[i].collTestTimer, &ns, &gm, trucknum, step))
             {
-                float ns = 0;
-                ground_model_t* gm = 0; // this is used as result storage, so we can use it later on
-                bool contacted = gEnv->collisions->groundCollision(&nodes[i], nodes[i].collTestTimer, &gm, &ns);
-                // reverted this construct to the old form, don't mess with it, the binary operator is intentionally!
-                if (contacted | gEnv->collisions->nodeCollision(&nodes[i], contacted, nodes[i].collTestTimer, &ns, &gm))
+                // FX
+                if (gm && doUpdate && !nodes[i].disable_particles)
                 {
-                    // FX
-                    if (gm && doUpdate && !nodes[i].disable_particles)
+                    float thresold = 10.0f;
+
+                    switch (gm->fx_type)
                     {
-                        float thresold = 10.0f;
+                    case Collisions::FX_DUSTY:
+                        if (dustp)
+                            dustp->malloc(nodes[i].AbsPosition, nodes[i].Velocity / 2.0, gm->fx_colour);
+                        break;
 
-                        switch (gm->fx_type)
+                    case Collisions::FX_HARD:
+                        // smokey
+                        if (nodes[i].iswheel && ns > thresold)
                         {
-                        case Collisions::FX_DUSTY:
                             if (dustp)
-                                dustp->malloc(nodes[i].AbsPosition, nodes[i].Velocity / 2.0, gm->fx_colour);
-                            break;
-
-                        case Collisions::FX_HARD:
-                            // smokey
-                            if (nodes[i].iswheel && ns > thresold)
-                            {
-                                if (dustp)
-                                    dustp->allocSmoke(nodes[i].AbsPosition, nodes[i].Velocity);
+                                dustp->allocSmoke(nodes[i].AbsPosition, nodes[i].Velocity);
 #ifdef USE_OPENAL
-                                SoundScriptManager::getSingleton().modulate(trucknum, SS_MOD_SCREETCH, (ns - thresold) / thresold);
-                                SoundScriptManager::getSingleton().trigOnce(trucknum, SS_TRIG_SCREETCH);
+                            SoundScriptManager::getSingleton().queueModulate(trucknum, SS_MOD_SCREETCH, (ns - thresold) / thresold);
+                            SoundScriptManager::getSingleton().queueTrigOnce(trucknum, SS_TRIG_SCREETCH);
 #endif //USE_OPENAL
-                                //Shouldn't skidmarks be activated from here?
-                                if (useSkidmarks)
-                                {
-                                    wheels[nodes[i].wheelid].isSkiding = true;
-                                    if (!(nodes[i].iswheel % 2))
-                                        wheels[nodes[i].wheelid].lastContactInner = nodes[i].AbsPosition;
-                                    else
-                                        wheels[nodes[i].wheelid].lastContactOuter = nodes[i].AbsPosition;
-
-                                    wheels[nodes[i].wheelid].lastContactType = (nodes[i].iswheel % 2);
-                                    wheels[nodes[i].wheelid].lastSlip = ns;
-                                    wheels[nodes[i].wheelid].lastGroundModel = gm;
-                                }
-                            }
-                            // sparks
-                            if (!nodes[i].iswheel && ns > 1.0 && !nodes[i].disable_sparks)
+                            //Shouldn't skidmarks be activated from here?
+                            if (useSkidmarks)
                             {
-                                // friction < 10 will remove the 'f' nodes from the spark generation nodes
-                                if (sparksp)
-                                    sparksp->allocSparks(nodes[i].AbsPosition, nodes[i].Velocity);
+                                wheels[nodes[i].wheelid].isSkiding = true;
+                                if (!(nodes[i].iswheel % 2))
+                                    wheels[nodes[i].wheelid].lastContactInner = nodes[i].AbsPosition;
+                                else
+                                    wheels[nodes[i].wheelid].lastContactOuter = nodes[i].AbsPosition;
+
+                                wheels[nodes[i].wheelid].lastContactType = (nodes[i].iswheel % 2);
+                                wheels[nodes[i].wheelid].lastSlip = ns;
+                                wheels[nodes[i].wheelid].lastGroundModel = gm;
                             }
-                            if (nodes[i].iswheel && ns < thresold)
+                        }
+                        // sparks
+                        if (!nodes[i].iswheel && ns > 1.0 && !nodes[i].disable_sparks)
+                        {
+                            // friction < 10 will remove the 'f' nodes from the spark generation nodes
+                            if (sparksp)
+                                sparksp->allocSparks(nodes[i].AbsPosition, nodes[i].Velocity);
+                        }
+                        if (nodes[i].iswheel && ns < thresold)
+                        {
+                            if (useSkidmarks)
                             {
-                                if (useSkidmarks)
-                                {
-                                    wheels[nodes[i].wheelid].isSkiding = false;
-                                }
+                                wheels[nodes[i].wheelid].isSkiding = false;
                             }
-                            break;
+                        }
+                        break;
 
-                        case Collisions::FX_CLUMPY:
-                            if (nodes[i].Velocity.squaredLength() > 1.0)
-                            {
-                                if (clumpp)
-                                    clumpp->allocClump(nodes[i].AbsPosition, nodes[i].Velocity / 2.0, gm->fx_colour);
-                            }
-                            break;
-                        default:
-                            //Useless for the moment
-                            break;
+                    case Collisions::FX_CLUMPY:
+                        if (nodes[i].Velocity.squaredLength() > 1.0)
+                        {
+                            if (clumpp)
+                                clumpp->allocClump(nodes[i].AbsPosition, nodes[i].Velocity / 2.0, gm->fx_colour);
                         }
+                        break;
+                    default:
+                        //Useless for the moment
+                        break;
                     }
-
-                    lastFuzzyGroundModel = gm;
                 }
-                nodes[i].collTestTimer = 0.0;
+
+                result.ground_model = gm;
             }
+            nodes[i].collTestTimer = 0.0;
         }
 
         // record g forces on cameras
@@ -1827,7 +1948,12 @@ void Beam::calcNodes(int doUpdate, Ogre::Real dt, int step, int maxsteps)
             Vector3 drag = -defdragxspeed * nodes[i].Velocity;
             // plus: turbulences
             Real maxtur = defdragxspeed * speed * 0.005f;
-            drag += maxtur * Vector3(frand_11(), frand_11(), frand_11());
+            unsigned int rand_state = (m_turbulence_seed ^ static_cast<unsigned int>(i)) * 0x9e3779b9u; // Per node; see calcNodes()
+            rand_state = (rand_state ^ (rand_state >> 16)) | 1u;
+            const float tur_x = frand_11(rand_state);
+            const float tur_y = frand_11(rand_state);
+            const float tur_z = frand_11(rand_state);
+            drag += maxtur * Vector3(tur_x, tur_y, tur_z);
             nodes[i].Forces += drag;
         }
 
@@ -1835,7 +1961,7 @@ void Beam::calcNodes(int doUpdate, Ogre::Real dt, int step, int maxsteps)
         {
             if (water->isUnderWater(nodes[i].AbsPosition))
             {
-                watercontact = true;
+                result.watercontact = true;
                 if (free_buoycab == 0)
                 {
                     // water drag (turbulent)
@@ -1855,7 +1981,7 @@ void Beam::calcNodes(int doUpdate, Ogre::Real dt, int step, int maxsteps)
                 // engine stall
                 if (i == cinecameranodepos[0] && engine)
                 {
-                    engine->stop();
+                    engine->stop(true);
                 }
                 nodes[i].wetstate = WET;
             }
@@ -0,0 +1,322 @@
+/*
+    This source file is part of Rigs of Rods
+    Copyright 2013-2017 Petr Ohlidal & contributors
+
+    For more information, see http://www.rigsofrods.org/
+
+    Rigs of Rods is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License version 3, as
+    published by the Free Software Foundation.
+
+    Rigs of Rods is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with Rigs of Rods. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "BeamSoA.h"
+
+#include "ApproxMath.h"
+#include "BeamData.h"
+
+#include <algorithm>
+#include <cmath>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && (_M_IX86_FP >= 2))
+#   define ROR_BEAMSOA_SSE
+#   include <emmintrin.h>
+#endif
+
+using namespace RoR;
+
+bool BeamSoA::IsEligible(beam_t const& beam)
+{
+    return (beam.type == BEAM_NORMAL || beam.type == BEAM_INVISIBLE)
+        && (beam.bounded == NOSHOCK)
+        && !beam.p2truck
+        && !beam.disabled;
+}
+
+void BeamSoA::Build(beam_t* beams, int num_beams, node_t* nodes)
+{
+    m_node1.clear();
+    m_node2.clear();
+    m_k.clear();
+    m_d.clear();
+    m_L.clear();
+    m_minmaxposnegstress.clear();
+    m_beam_index.clear();
+    m_scalar_beams.clear();
+    m_chunks[0].exceeded_slots.clear();
+
+    for (int i = 0; i < num_beams; i++)
+    {
+        if (!IsEligible(beams[i]))
+        {
+            m_scalar_beams.push_back(i);
+            continue;
+        }
+
+        m_node1.push_back(static_cast<int>(beams[i].p1 - nodes));
+        m_node2.push_back(static_cast<int>(beams[i].p2 - nodes));
+        m_k.push_back(beams[i].k);
+        m_d.push_back(beams[i].d);
+        m_L.push_back(beams[i].L);
+        m_minmaxposnegstress.push_back(beams[i].minmaxposnegstress);
+        m_beam_index.push_back(i);
+    }
+
+    m_stress.assign(m_beam_index.size(), 0.f);
+}
+
+void BeamSoA::GatherNodes(node_t const* nodes, int num_nodes)
+{
+    m_node_state.resize(num_nodes * 8);
+    m_num_nodes = num_nodes;
+
+    float* state = m_node_state.data();
+    for (int i = 0; i < num_nodes; i++, state += 8)
+    {
+        state[0] = nodes[i].RelPosition.x;
+        state[1] = nodes[i].RelPosition.y;
+        state[2] = nodes[i].RelPosition.z;
+        state[3] = 0.f;
+        state[4] = nodes[i].Velocity.x;
+        state[5] = nodes[i].Velocity.y;
+        state[6] = nodes[i].Velocity.z;
+        state[7] = 0.f;
+    }
+}
+
+void BeamSoA::ScatterForces(node_t* nodes, int num_nodes) const
+{
+    const float* forces = m_chunks[0].forces.data();
+    for (int i = 0; i < num_nodes; i++, forces += 4)
+    {
+        nodes[i].Forces.x += forces[0];
+        nodes[i].Forces.y += forces[1];
+        nodes[i].Forces.z += forces[2];
+    }
+}
+
+void BeamSoA::WriteBackStress(beam_t* beams) const
+{
+    for (size_t slot = 0; slot < m_beam_index.size(); slot++)
+    {
+        beams[m_beam_index[slot]].stress = m_stress[slot];
+    }
+}
+
+void BeamSoA::UpdateBeam(size_t slot, beam_t const& beam)
+{
+    m_k[slot] = beam.k;
+    m_d[slot] = beam.d;
+    m_L[slot] = beam.L;
+    m_minmaxposnegstress[slot] = beam.minmaxposnegstress;
+}
+
+void BeamSoA::ResetAccumulator(Accumulator& acc, size_t begin, size_t end)
+{
+    acc.forces.assign(m_num_nodes * 4, 0.f);
+    acc.exceeded_slots.clear();
+    acc.begin = begin;
+    acc.end = end;
+}
+
+inline void BeamSoA::ApplySpring(size_t slot, float dx, float dy, float dz, float slen, float inv_dislen, Accumulator& acc)
+{
+    m_stress[slot] = slen;
+    if (std::abs(slen) > m_minmaxposnegstress[slot])
+    {
+        acc.exceeded_slots.push_back(static_cast<int>(slot));
+        return;
+    }
+
+    const float scale = slen * inv_dislen;
+    float* f1 = &acc.forces[m_node1[slot] * 4];
+    float* f2 = &acc.forces[m_node2[slot] * 4];
+    f1[0] += dx * scale;
+    f1[1] += dy * scale;
+    f1[2] += dz * scale;
+    f2[0] -= dx * scale;
+    f2[1] -= dy * scale;
+    f2[2] -= dz * scale;
+}
+
+void BeamSoA::CalcSpringsRange(size_t begin, size_t end, Accumulator& acc)
+{
+    for (size_t slot = begin; slot < end; slot++)
+    {
+        const float* s1 = &m_node_state[m_node1[slot] * 8];
+        const float* s2 = &m_node_state[m_node2[slot] * 8];
+
+        const float dx = s1[0] - s2[0];
+        const float dy = s1[1] - s2[1];
+        const float dz = s1[2] - s2[2];
+
+        float dislen = dx * dx + dy * dy + dz * dz;
+        const float inv_dislen = fast_invSqrt(dislen);
+        dislen *= inv_dislen;
+
+        const float difftoBeamL = dislen - m_L[slot];
+
+        const float vx = s1[4] - s2[4];
+        const float vy = s1[5] - s2[5];
+        const float vz = s1[6] - s2[6];
+
+        const float slen = -m_k[slot] * difftoBeamL - m_d[slot] * (vx * dx + vy * dy + vz * dz) * inv_dislen;
+        this->ApplySpring(slot, dx, dy, dz, slen, inv_dislen, acc);
+    }
+}
+
+void BeamSoA::CalcSpringsScalar()
+{
+    this->ResetAccumulator(m_chunks[0], 0, m_beam_index.size());
+    this->CalcSpringsRange(0, m_beam_index.size(), m_chunks[0]);
+}
+
+#if defined(ROR_BEAMSOA_SSE)
+
+void BeamSoA::CalcSpringsSSE(Accumulator& acc)
+{
+    const size_t num_packed = acc.end - ((acc.end - acc.begin) % 4);
+
+    const __m128 half       = _mm_set1_ps(0.5f);
+    const __m128 three_half = _mm_set1_ps(1.5f);
+    const __m128i magic     = _mm_set1_epi32(0x5f3759df);
+    const __m128 abs_mask   = _mm_castsi128_ps(_mm_set1_epi32(0x7fffffff));
+    const __m128 sign_mask  = _mm_castsi128_ps(_mm_set1_epi32(0x80000000));
+
+    const float* state = m_node_state.data();
+    float* forces = acc.forces.data();
+
+    for (size_t slot = acc.begin; slot < num_packed; slot += 4)
+    {
+        const int* n1 = &m_node1[slot];
+        const int* n2 = &m_node2[slot];
+
+        // One row per beam: (dx, dy, dz, 0) and (vx, vy, vz, 0)
+        const __m128 dis0 = _mm_sub_ps(_mm_loadu_ps(state + n1[0] * 8), _mm_loadu_ps(state + n2[0] * 8));
+        const __m128 dis1 = _mm_sub_ps(_mm_loadu_ps(state + n1[1] * 8), _mm_loadu_ps(state + n2[1] * 8));
+        const __m128 dis2 = _mm_sub_ps(_mm_loadu_ps(state + n1[2] * 8), _mm_loadu_ps(state + n2[2] * 8));
+        const __m128 dis3 = _mm_sub_ps(_mm_loadu_ps(state + n1[3] * 8), _mm_loadu_ps(state + n2[3] * 8));
+        __m128 vvx = _mm_sub_ps(_mm_loadu_ps(state + n1[0] * 8 + 4), _mm_loadu_ps(state + n2[0] * 8 + 4));
+        __m128 vvy = _mm_sub_ps(_mm_loadu_ps(state + n1[1] * 8 + 4), _mm_loadu_ps(state + n2[1] * 8 + 4));
+        __m128 vvz = _mm_sub_ps(_mm_loadu_ps(state + n1[2] * 8 + 4), _mm_loadu_ps(state + n2[2] * 8 + 4));
+        __m128 vvw = _mm_sub_ps(_mm_loadu_ps(state + n1[3] * 8 + 4), _mm_loadu_ps(state + n2[3] * 8 + 4));
+
+        // One lane per beam
+        __m128 vdx = dis0, vdy = dis1, vdz = dis2, vdw = dis3;
+        _MM_TRANSPOSE4_PS(vdx, vdy, vdz, vdw);
+        _MM_TRANSPOSE4_PS(vvx, vvy, vvz, vvw);
+
+        const __m128 dislen_sq = _mm_add_ps(_mm_add_ps(_mm_mul_ps(vdx, vdx), _mm_mul_ps(vdy, vdy)), _mm_mul_ps(vdz, vdz));
+
+        // fast_invSqrt(), lane by lane: same estimate and Newton-Raphson step in the same order,
+        // so results (including zero-length springs) are bit-identical to CalcSpringsRange()
+        __m128 vinv = _mm_castsi128_ps(_mm_sub_epi32(magic, _mm_srai_epi32(_mm_castps_si128(dislen_sq), 1)));
+        vinv = _mm_mul_ps(vinv, _mm_sub_ps(three_half, _mm_mul_ps(_mm_mul_ps(_mm_mul_ps(half, dislen_sq), vinv), vinv)));
+
+        const __m128 difftoBeamL = _mm_sub_ps(_mm_mul_ps(dislen_sq, vinv), _mm_loadu_ps(&m_L[slot]));
+        const __m128 vdot = _mm_add_ps(_mm_add_ps(_mm_mul_ps(vvx, vdx), _mm_mul_ps(vvy, vdy)), _mm_mul_ps(vvz, vdz));
+
+        // slen = -k * difftoBeamL - d * (v . dis) / dislen
+        const __m128 vslen = _mm_sub_ps(
+            _mm_xor_ps(_mm_mul_ps(_mm_loadu_ps(&m_k[slot]), difftoBeamL), sign_mask),
+            _mm_mul_ps(_mm_mul_ps(_mm_loadu_ps(&m_d[slot]), vdot), vinv));
+
+        _mm_storeu_ps(&m_stress[slot], vslen);
+
+        // Exceeded beams are left to the scalar path; a zero scale keeps the stores below unconditional
+        const __m128 exceeded = _mm_cmpgt_ps(_mm_and_ps(vslen, abs_mask), _mm_loadu_ps(&m_minmaxposnegstress[slot]));
+        const __m128 vscale = _mm_andnot_ps(exceeded, _mm_mul_ps(vslen, vinv));
+
+        // Scatter one beam at a time; node indices may repeat within the group
+        const __m128 f0 = _mm_mul_ps(dis0, _mm_shuffle_ps(vscale, vscale, _MM_SHUFFLE(0, 0, 0, 0)));
+        const __m128 f1 = _mm_mul_ps(dis1, _mm_shuffle_ps(vscale, vscale, _MM_SHUFFLE(1, 1, 1, 1)));
+        const __m128 f2 = _mm_mul_ps(dis2, _mm_shuffle_ps(vscale, vscale, _MM_SHUFFLE(2, 2, 2, 2)));
+        const __m128 f3 = _mm_mul_ps(dis3, _mm_shuffle_ps(vscale, vscale, _MM_SHUFFLE(3, 3, 3, 3)));
+        float* a;
+        float* b;
+        a = forces + n1[0] * 4; b = forces + n2[0] * 4;
+        _mm_storeu_ps(a, _mm_add_ps(_mm_loadu_ps(a), f0)); _mm_storeu_ps(b, _mm_sub_ps(_mm_loadu_ps(b), f0));
+        a = forces + n1[1] * 4; b = forces + n2[1] * 4;
+        _mm_storeu_ps(a, _mm_add_ps(_mm_loadu_ps(a), f1)); _mm_storeu_ps(b, _mm_sub_ps(_mm_loadu_ps(b), f1));
+        a = forces + n1[2] * 4; b = forces + n2[2] * 4;
+        _mm_storeu_ps(a, _mm_add_ps(_mm_loadu_ps(a), f2)); _mm_storeu_ps(b, _mm_sub_ps(_mm_loadu_ps(b), f2));
+        a = forces + n1[3] * 4; b = forces + n2[3] * 4;
+        _mm_storeu_ps(a, _mm_add_ps(_mm_loadu_ps(a), f3)); _mm_storeu_ps(b, _mm_sub_ps(_mm_loadu_ps(b), f3));
+
+        const int exceeded_bits = _mm_movemask_ps(exceeded);
+        if (exceeded_bits)
+        {
+            for (int lane = 0; lane < 4; lane++)
+            {
+                if (exceeded_bits & (1 << lane))
+                    acc.exceeded_slots.push_back(static_cast<int>(slot + lane));
+            }
+        }
+    }
+
+    this->CalcSpringsRange(num_packed, acc.end, acc);
+}
+
+#else // No SIMD available
+
+void BeamSoA::CalcSpringsSSE(Accumulator& acc)
+{
+    this->CalcSpringsRange(acc.begin, acc.end, acc);
+}
+
+#endif
+
+void BeamSoA::CalcSprings()
+{
+    this->ResetAccumulator(m_chunks[0], 0, m_beam_index.size());
+    this->CalcSpringsSSE(m_chunks[0]);
+}
+
+void BeamSoA::PrepareChunks(int num_chunks)
+{
+    m_num_chunks = std::max(1, num_chunks);
+    if (static_cast<int>(m_chunks.size()) < m_num_chunks)
+    {
+        m_chunks.resize(m_num_chunks); // Never shrink; keeps the buffers allocated
+    }
+
+    // Chunk boundaries are aligned to the SIMD width (4 beams)
+    const size_t num_beams = m_beam_index.size();
+    size_t chunk_size = (num_beams + m_num_chunks - 1) / m_num_chunks;
+    chunk_size = (chunk_size + 3) & ~size_t(3);
+    for (int c = 0; c < m_num_chunks; c++)
+    {
+        m_chunks[c].begin = std::min(num_beams, c * chunk_size);
+        m_chunks[c].end   = std::min(num_beams, (c + 1) * chunk_size);
+    }
+}
+
+void BeamSoA::CalcSpringsChunk(int chunk)
+{
+    Accumulator& acc = m_chunks[chunk];
+    this->ResetAccumulator(acc, acc.begin, acc.end);
+    this->CalcSpringsSSE(acc);
+}
+
+void BeamSoA::ReduceChunks()
+{
+    Accumulator& result = m_chunks[0];
+    for (int c = 1; c < m_num_chunks; c++)
+    {
+        Accumulator const& acc = m_chunks[c];
+        for (size_t i = 0; i < result.forces.size(); i++)
+        {
+            result.forces[i] += acc.forces[i];
+        }
+        result.exceeded_slots.insert(result.exceeded_slots.end(), acc.exceeded_slots.begin(), acc.exceeded_slots.end());
+    }
+    result.begin = 0;
+    result.end = m_beam_index.size();
+}
@@ -0,0 +1,123 @@
+/*
+    This source file is part of Rigs of Rods
+    Copyright 2013-2017 Petr Ohlidal & contributors
+
+    For more information, see http://www.rigsofrods.org/
+
+    Rigs of Rods is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License version 3, as
+    published by the Free Software Foundation.
+
+    Rigs of Rods is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with Rigs of Rods. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+/// @file
+/// @brief Structure-of-arrays mirror of plain springs + SIMD spring kernel.
+
+#pragma once
+
+#include "ForwardDeclarations.h"
+
+#include <cstddef>
+#include <vector>
+
+namespace RoR {
+
+/// SIM-CORE; Structure-of-arrays mirror of the hot fields of plain springs.
+///
+/// Only beams of type BEAM_NORMAL/BEAM_INVISIBLE which are not bounded (NOSHOCK) and connect
+/// two nodes of the same truck are mirrored; shocks, ropes, support beams, hydros, hooks and ties
+/// keep using the scalar path in Beam::calcBeams(). The mirror is rebuilt on demand
+/// (see Beam::m_beams_soa_dirty), node positions and velocities are gathered every step.
+///
+/// Nodes are packed rather than split per component: position and velocity of a node are
+/// one 32-byte record and forces one 16-byte record, so the kernel reads and updates a node
+/// with single 4-wide loads and stores instead of scalar gathers and scatters.
+///
+/// Beams whose stress exceeds `minmaxposnegstress` (deformation/breaking candidates) are
+/// not applied by the kernel; they're listed in GetExceededSlots() and must be re-evaluated
+/// by the scalar path, followed by UpdateBeam().
+///
+/// For large trucks, the beams can be split into chunks computed on separate threads
+/// (see CalcSpringsChunk()). Each chunk accumulates forces into its own buffers which
+/// ReduceChunks() sums up in chunk order, so the result doesn't depend on thread scheduling.
+class BeamSoA
+{
+public:
+    static bool IsEligible(beam_t const& beam);
+
+    /// Collects eligible beams; all others are listed in GetScalarBeams().
+    void Build(beam_t* beams, int num_beams, node_t* nodes);
+
+    /// Copies positions and velocities of nodes and zeroes the force accumulators.
+    void GatherNodes(node_t const* nodes, int num_nodes);
+
+    /// TIGHT LOOP; Computes spring forces of all mirrored beams (SIMD where available).
+    void CalcSprings();
+
+    /// Reference implementation of CalcSprings(), for validation and benchmarking.
+    void CalcSpringsScalar();
+
+    /// Splits beams into `num_chunks` ranges for CalcSpringsChunk(); call after GatherNodes().
+    void PrepareChunks(int num_chunks);
+
+    /// TIGHT LOOP; Thread-safe for distinct chunks. Forces go to the chunk's own accumulator.
+    void CalcSpringsChunk(int chunk);
+
+    /// Sums chunk accumulators and exceeded slots in chunk order (deterministic).
+    void ReduceChunks();
+
+    /// Adds the accumulated forces to `node_t::Forces`.
+    void ScatterForces(node_t* nodes, int num_nodes) const;
+
+    /// Copies the last computed stress to `beam_t::stress` (visuals, debug overlay).
+    void WriteBackStress(beam_t* beams) const;
+
+    /// Refreshes a mirrored beam after the scalar path modified it (deformation).
+    void UpdateBeam(size_t slot, beam_t const& beam);
+
+    std::vector<int> const& GetScalarBeams() const   { return m_scalar_beams; }
+    std::vector<int> const& GetExceededSlots() const { return m_chunks[0].exceeded_slots; }
+    int                     GetBeamIndex(size_t slot) const { return m_beam_index[slot]; }
+    size_t                  GetNumBeams() const      { return m_beam_index.size(); }
+
+private:
+    /// Per-chunk output of the kernel; chunk 0 is also the final result after ReduceChunks().
+    struct Accumulator
+    {
+        std::vector<float> forces;         //!< 4 floats per node: x, y, z, unused
+        std::vector<int>   exceeded_slots; //!< Slots to re-evaluate by the scalar path
+        size_t             begin, end;     //!< Range of slots
+    };
+
+    void CalcSpringsSSE(Accumulator& acc);
+    void CalcSpringsRange(size_t begin, size_t end, Accumulator& acc);
+    void ApplySpring(size_t slot, float dx, float dy, float dz, float slen, float inv_dislen, Accumulator& acc);
+    void ResetAccumulator(Accumulator& acc, size_t begin, size_t end);
+
+    // Nodes
+    std::vector<float> m_node_state;     //!< 8 floats per node: position x, y, z, 0, velocity x, y, z, 0
+    int                m_num_nodes = 0;
+
+    // Beams
+    std::vector<int>   m_node1;
+    std::vector<int>   m_node2;
+    std::vector<float> m_k;
+    std::vector<float> m_d;
+    std::vector<float> m_L;
+    std::vector<float> m_minmaxposnegstress;
+    std::vector<float> m_stress;
+    std::vector<int>   m_beam_index;     //!< Index into rig_t::beams
+
+    std::vector<int>   m_scalar_beams;   //!< Beams not mirrored (indices into rig_t::beams)
+    std::vector<Accumulator> m_chunks = std::vector<Accumulator>(1);
+    int                m_num_chunks = 1;
+};
+
+} // namespace RoR
@@ -194,3 +194,26 @@ void CmdKeyInertia::resetCmdKeyDelay()
         it->second.time = 0.0;
     }
 }
+
+void CmdKeyInertia::getState(std::vector<float>& out)
+{
+    out.clear();
+    for (std::map<int, cmdKeyInertia_s>::iterator it = cmdKeyInertia.begin(); it != cmdKeyInertia.end(); ++it)
+    {
+        out.push_back(static_cast<float>(it->second.lastOutput));
+        out.push_back(static_cast<float>(it->second.time));
+    }
+}
+
+bool CmdKeyInertia::setState(std::vector<float> const& state)
+{
+    if (state.size() != cmdKeyInertia.size() * 2)
+        return false;
+    size_t i = 0;
+    for (std::map<int, cmdKeyInertia_s>::iterator it = cmdKeyInertia.begin(); it != cmdKeyInertia.end(); ++it)
+    {
+        it->second.lastOutput = state[i++];
+        it->second.time = state[i++];
+    }
+    return true;
+}
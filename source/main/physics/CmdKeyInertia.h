@@ -32,6 +32,11 @@ public:
     int setCmdKeyDelay(int number, Ogre::Real startDelay, Ogre::Real stopDelay, Ogre::String startFunction, Ogre::String stopFunction);
     void resetCmdKeyDelay();
 
+    /// Progress of all keys (last output, time), for restoring a recorded simulation state
+    void getState(std::vector<float>& out);
+    /// @return False if the state was taken from a different set of keys
+    bool setState(std::vector<float> const& state);
+
 protected:
 
     struct cmdKeyInertia_s
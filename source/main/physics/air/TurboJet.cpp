@@ -216,7 +216,7 @@ void Turbojet::updateForces(float dt, int doUpdate)
     {
 #ifdef USE_OPENAL
         //sound update
-        SoundScriptManager::getSingleton().modulate(trucknum, mod_id, rpm);
+        SoundScriptManager::getSingleton().queueModulate(trucknum, mod_id, rpm);
 #endif //OPENAL
     }
     timer += dt;
@@ -260,9 +260,9 @@ void Turbojet::updateForces(float dt, int doUpdate)
         afterburner = false;
 #ifdef USE_OPENAL
     if (afterburner)
-        SoundScriptManager::getSingleton().trigStart(trucknum, ab_id);
+        SoundScriptManager::getSingleton().queueTrigStart(trucknum, ab_id);
     else
-        SoundScriptManager::getSingleton().trigStop(trucknum, ab_id);
+        SoundScriptManager::getSingleton().queueTrigStop(trucknum, ab_id);
 #endif //OPENAL
 
     nodes[nodeback].Forces += (enginethrust * 1000.0) * axis;
@@ -257,7 +257,7 @@ void Turboprop::updateForces(float dt, int doUpdate)
         airdensity = airpressure * 0.0000120896;//1.225 at sea level
 #ifdef USE_OPENAL
         //sound update
-        SoundScriptManager::getSingleton().modulate(trucknum, mod_id, rpm);
+        SoundScriptManager::getSingleton().queueModulate(trucknum, mod_id, rpm);
 #endif //OPENAL
     }
 
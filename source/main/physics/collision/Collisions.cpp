@@ -34,6 +34,10 @@
 #include "Settings.h"
 #include "TerrainManager.h"
 
+#include <algorithm>
+#include <atomic>
+#include <cstdint>
+
 // some gcc fixes
 #if OGRE_PLATFORM == OGRE_PLATFORM_LINUX
 #pragma GCC diagnostic ignored "-Wfloat-equal"
@@ -111,6 +115,8 @@ unsigned int sbox[] =
 
 using namespace Ogre;
 
+static std::atomic<unsigned int> s_collisions_instance_counter(0);
+
 Collisions::Collisions(RoRFrameListener* sim_controller)
     : m_sim_controller(sim_controller)
     , collision_count(0)
@@ -120,26 +126,19 @@ Collisions::Collisions(RoRFrameListener* sim_controller)
     , free_collision_box(0)
     , free_collision_tri(0)
     , free_eventsource(0)
+    , grid_dirty(false)
+    , grid_locked(true)
     , hashmask(0)
     , landuse(0)
     , largest_cellcount(0)
     , last_called_cbox(0)
     , last_used_ground_model(0)
     , max_col_tris(MAX_COLLISION_TRIS)
+    , m_instance_id(++s_collisions_instance_counter)
 {
     hFinder = gEnv->terrainManager->getHeightFinder();
 
     debugMode = RoR::App::GetDiagCollisions(); // TODO: make interactive
-    for (int i=0; i < HASH_POWER; i++)
-    {
-        hashmask = hashmask << 1;
-        hashmask++;
-    }
-
-    for (int i=0; i < HASH_SIZE; i++)
-    {
-        hashtable[i].cellid = UNUSED_CELLID; // conversion from 'const int' to 'unsigned int', signed/unsigned mismatch!
-    }
 
     collision_tris = (collision_tri_t*)malloc(sizeof(collision_tri_t) * MAX_COLLISION_TRIS);
 
@@ -166,6 +165,7 @@ void Collisions::resizeMemory(long newSize)
     }
 
     free_collision_tri = 0;
+    grid_dirty = true;
     max_col_tris = newSize;
     collision_tris = (collision_tri_t*)malloc(sizeof(collision_tri_t) * newSize);
 
@@ -386,7 +386,7 @@ ground_model_t *Collisions::getGroundModelByString(const String name)
     return &ground_models[name];
 }
 
-unsigned int Collisions::hashfunc(unsigned int cellid)
+unsigned int Collisions::hashfunc(unsigned int cellid) const
 {
     unsigned int hash = 0;
     for (int i=0; i < 4; i++)
@@ -401,116 +401,215 @@ int Collisions::removeCollisionTri(int number)
 {
     if (number > free_collision_tri) return -1;
 
-    Vector3 p1 = collision_tris[number].a;
-    Vector3 p2 = collision_tris[number].b;
-    Vector3 p3 = collision_tris[number].c;
+    collision_tri_t& ctri = collision_tris[number];
+    if (!ctri.indexed) return 0;
 
-    // compute tri AAB
-    AxisAlignedBox aab;
-    aab.merge(p1);
-    aab.merge(p2);
-    aab.merge(p3);
-    // register this collision tri in the index
-    int ilox, ihix, iloz, ihiz;
-    ilox=(int)(aab.getMinimum().x/(float)CELL_SIZE);
-    if (ilox<0) ilox=0; if (ilox>MAXIMUM_CELL) ilox=MAXIMUM_CELL;
-    ihix=(int)(aab.getMaximum().x/(float)CELL_SIZE);
-    if (ihix<0) ihix=0; if (ihix>MAXIMUM_CELL) ihix=MAXIMUM_CELL;
-    iloz=(int)(aab.getMinimum().z/(float)CELL_SIZE);
-    if (iloz<0) iloz=0; if (iloz>MAXIMUM_CELL) iloz=MAXIMUM_CELL;
-    ihiz=(int)(aab.getMaximum().z/(float)CELL_SIZE);
-    if (ihiz<0) ihiz=0; if (ihiz>MAXIMUM_CELL) ihiz=MAXIMUM_CELL;
-    for (int i=ilox; i <= ihix; i++)
-    {
-        for (int j=iloz; j <= ihiz; j++)
-        {
-            hash_free(i,j,number+MAX_COLLISION_BOXES);
-        }
-    }
+    ctri.indexed = false;
+    grid_unregister(number, true);
     return 0;
 }
 
-void Collisions::hash_free(int cell_x, int cell_z, int value)
+int Collisions::grid_find_index(unsigned int cellid) const
 {
-    unsigned int cellid = (cell_x << 16) + cell_z;
-    unsigned int pos    = hashfunc(cellid);
+    if (grid_index.empty())
+        return -1;
 
-    // set cell to free state
-    if (hashtable[pos].cellid != UNUSED_CELLID)
+    unsigned int pos = hashfunc(cellid);
+    while (grid_index[pos] != -1)
     {
-        cell_t *cell = hashtable[pos].cell;
-        // cell has content, search it
-        for (unsigned int i=0; i < cell->size(); i++)
-        {
-            if ((*cell)[i] == value)
-            {
-                // remove that element
-                cell->erase(cell->begin() + i);
-                break;
-            }
-        }
+        if (grid_cells[grid_index[pos]].cellid == cellid)
+            return grid_index[pos];
+        pos = (pos + 1) & hashmask;
     }
+    return -1;
 }
 
-void Collisions::hash_add(int cell_x, int cell_z, int value)
+const Collisions::grid_cell_t* Collisions::grid_find(int cell_x, int cell_z) const
 {
-    unsigned int cellid = (cell_x << 16) + cell_z;
-    unsigned int pos    = hashfunc(cellid);
+    if (cell_x < 0 || cell_x > MAXIMUM_CELL || cell_z < 0 || cell_z > MAXIMUM_CELL)
+        return NULL;
+
+    int index = grid_find_index((cell_x << 16) + cell_z);
+    return (index != -1) ? &grid_cells[index] : NULL;
+}
 
-    // Cycle through hashtable: start at pos
-    for (unsigned int i=0; i < HASH_SIZE; i++)
+void Collisions::grid_register(int number, bool tri)
+{
+    if (grid_locked)
     {
-        if (hashtable[pos].cellid == UNUSED_CELLID || hashtable[pos].cellid == cellid)
-            break;
+        grid_dirty = true; // the whole grid is built in finishLoadingTerrain()
+        return;
+    }
+
+    // physics may be reading the grid right now
+    grid_change_t change;
+    change.number = number;
+    change.tri = tri;
+    change.add = true;
+    grid_changes.push_back(change);
+}
 
-        pos++;
-        if (pos >= HASH_SIZE) pos = 0;
+void Collisions::grid_unregister(int number, bool tri)
+{
+    if (grid_locked)
+        return;
+
+    grid_change_t change;
+    change.number = number;
+    change.tri = tri;
+    change.add = false;
+    grid_changes.push_back(change);
+}
+
+void Collisions::updateGrid()
+{
+    if (grid_locked)
+        return;
+
+    for (grid_change_t const& change : grid_changes)
+    {
+        if (grid_dirty)
+            break; // the rebuild below covers all objects
+        const Ogre::Vector3& ilo = change.tri ? collision_tris[change.number].ilo : collision_boxes[change.number].ilo;
+        const Ogre::Vector3& ihi = change.tri ? collision_tris[change.number].ihi : collision_boxes[change.number].ihi;
+        if (change.add)
+            grid_insert(change.number, change.tri, ilo, ihi);
+        else
+            grid_remove(change.number, change.tri, ilo, ihi);
     }
+    grid_changes.clear();
 
-    if (hashtable[pos].cellid == UNUSED_CELLID)
+    if (grid_dirty)
     {
-        // create a new cell
-        cell_t* newcell = new cell_t;
-        
-        hashtable[pos].cellid = cellid;
-        hashtable[pos].cell = newcell;
-        newcell->push_back(value);
-        cells.push_back(newcell);
-        if (pos != hashfunc(cellid))
+        grid_rebuild();
+    }
+}
+
+void Collisions::grid_insert(int number, bool tri, const Ogre::Vector3& ilo, const Ogre::Vector3& ihi)
+{
+    // Fast path: the object fits into the free slots of existing cells
+    for (int i = ilo.x; i <= ihi.x && !grid_dirty; i++)
+    {
+        for (int j = ilo.z; j <= ihi.z && !grid_dirty; j++)
         {
-            collision_count++;
+            int index = grid_find_index((i << 16) + j);
+            if (index == -1)
+            {
+                grid_dirty = true;
+                break;
+            }
+            grid_cell_t& cell = grid_cells[index];
+            if (tri && cell.tri_count < cell.tri_capacity)
+                grid_tris[cell.tri_begin + cell.tri_count++] = number;
+            else if (!tri && cell.box_count < cell.box_capacity)
+                grid_boxes[cell.box_begin + cell.box_count++] = number;
+            else
+                grid_dirty = true;
         }
-        largest_cellcount = std::max(largest_cellcount, (int)newcell->size());
-    } else if (hashtable[pos].cellid == cellid)
-    {
-        // there is already a cell ready
-        hashtable[pos].cell->push_back(value);
-        largest_cellcount = std::max(largest_cellcount, (int)hashtable[pos].cell->size());
-    } else
-    {
-        LOG("COLL: The hashtable is full.");
     }
 }
 
-cell_t *Collisions::hash_find(int cell_x, int cell_z)
+void Collisions::grid_remove(int number, bool tri, const Ogre::Vector3& ilo, const Ogre::Vector3& ihi)
 {
-    unsigned int cellid = (cell_x << 16) + cell_z;
-    unsigned int pos    = hashfunc(cellid);
+    for (int i = ilo.x; i <= ihi.x; i++)
+    {
+        for (int j = ilo.z; j <= ihi.z; j++)
+        {
+            int index = grid_find_index((i << 16) + j);
+            if (index == -1)
+                continue;
+            grid_cell_t& cell = grid_cells[index];
+            int* list  = tri ? &grid_tris[cell.tri_begin] : &grid_boxes[cell.box_begin];
+            int& count = tri ? cell.tri_count : cell.box_count;
+            for (int k = 0; k < count; k++)
+            {
+                if (list[k] == number)
+                {
+                    // swap with the last entry, the slot becomes free for runtime additions
+                    list[k] = list[count - 1];
+                    count--;
+                    break;
+                }
+            }
+        }
+    }
+}
 
-    // Cycle through hashtable: start at pos
-    for (unsigned int i=0; i < HASH_SIZE; i++)
+void Collisions::grid_rebuild()
+{
+    // one key per (cell, object): cellid in the upper half, then tri flag, then object number;
+    // sorting groups the objects per cell, boxes before tris
+    std::vector<uint64_t> keys;
+    for (int n = 0; n < free_collision_box; n++)
+    {
+        const collision_box_t& cbox = collision_boxes[n];
+        if (!cbox.enabled)
+            continue;
+        for (int i = cbox.ilo.x; i <= cbox.ihi.x; i++)
+            for (int j = cbox.ilo.z; j <= cbox.ihi.z; j++)
+                keys.push_back((uint64_t((i << 16) + j) << 32) | uint64_t(n));
+    }
+    for (int n = 0; n < free_collision_tri; n++)
     {
-        if (hashtable[pos].cellid == UNUSED_CELLID)
-            return NULL;
+        const collision_tri_t& ctri = collision_tris[n];
+        if (!ctri.indexed)
+            continue;
+        for (int i = ctri.ilo.x; i <= ctri.ihi.x; i++)
+            for (int j = ctri.ilo.z; j <= ctri.ihi.z; j++)
+                keys.push_back((uint64_t((i << 16) + j) << 32) | 0x80000000u | uint64_t(n));
+    }
+    std::sort(keys.begin(), keys.end());
 
-        if (hashtable[pos].cellid == cellid)
-            return hashtable[pos].cell;
+    grid_cells.clear();
+    grid_boxes.clear();
+    grid_tris.clear();
+    largest_cellcount = 0;
+    for (size_t k = 0; k < keys.size(); )
+    {
+        grid_cell_t cell;
+        cell.cellid = static_cast<unsigned int>(keys[k] >> 32);
+        cell.box_begin = static_cast<int>(grid_boxes.size());
+        for (; k < keys.size() && (keys[k] >> 32) == cell.cellid && !(keys[k] & 0x80000000u); k++)
+            grid_boxes.push_back(static_cast<int>(keys[k] & 0x7FFFFFFFu));
+        cell.box_count = static_cast<int>(grid_boxes.size()) - cell.box_begin;
+        cell.box_capacity = cell.box_count + GRID_CELL_SLACK;
+        grid_boxes.resize(grid_boxes.size() + GRID_CELL_SLACK, -1);
+
+        cell.tri_begin = static_cast<int>(grid_tris.size());
+        for (; k < keys.size() && (keys[k] >> 32) == cell.cellid; k++)
+            grid_tris.push_back(static_cast<int>(keys[k] & 0x7FFFFFFFu));
+        cell.tri_count = static_cast<int>(grid_tris.size()) - cell.tri_begin;
+        cell.tri_capacity = cell.tri_count + GRID_CELL_SLACK;
+        grid_tris.resize(grid_tris.size() + GRID_CELL_SLACK, -1);
+
+        largest_cellcount = std::max(largest_cellcount, cell.box_count + cell.tri_count);
+        grid_cells.push_back(cell);
+    }
 
-        pos++;
-        if (pos >= HASH_SIZE) pos = 0;
+    // index with a load factor of at most 50%
+    unsigned int index_size = 1024;
+    while (index_size < 2 * grid_cells.size())
+    {
+        index_size <<= 1;
+    }
+    hashmask = index_size - 1;
+    grid_index.assign(index_size, -1);
+    collision_count = 0;
+    for (int c = 0; c < static_cast<int>(grid_cells.size()); c++)
+    {
+        unsigned int pos = hashfunc(grid_cells[c].cellid);
+        if (grid_index[pos] != -1)
+        {
+            collision_count++;
+        }
+        while (grid_index[pos] != -1)
+        {
+            pos = (pos + 1) & hashmask;
+        }
+        grid_index[pos] = c;
     }
 
-    return NULL;
+    grid_dirty = false;
 }
 
 int Collisions::addCollisionBox(SceneNode *tenode, bool rotating, bool virt, Vector3 pos, Ogre::Vector3 rot, Ogre::Vector3 l, Ogre::Vector3 h, Ogre::Vector3 sr, const Ogre::String &eventname, const Ogre::String &instancename, bool forcecam, Ogre::Vector3 campos, Ogre::Vector3 sc /* = Vector3::UNIT_SCALE */, Ogre::Vector3 dr /* = Vector3::ZERO */, int event_filter /* = EVENT_ALL */, int scripthandler /* = -1 */)
@@ -756,16 +855,9 @@ int Collisions::addCollisionBox(SceneNode *tenode, bool rotating, bool virt, Vec
     coll_box.ihi.makeCeil(Ogre::Vector3(0.0f));
     coll_box.ihi.makeFloor(Ogre::Vector3(MAXIMUM_CELL));
 
-    for (int i=coll_box.ilo.x; i <= coll_box.ihi.x; i++)
-    {
-        for (int j=coll_box.ilo.z; j <= coll_box.ihi.z; j++)
-        {
-            //LOG("Adding a reference to cell "+TOSTRING(i)+" "+TOSTRING(j)+" at index "+TOSTRING(collision_index_free[i*NUM_COLLISON_CELLS+j]));
-            hash_add(i,j,free_collision_box);
-        }
-    }
     int num = free_collision_box;
     free_collision_box++;
+    grid_register(num, false);
 
     return num;
 }
@@ -790,14 +882,8 @@ int Collisions::removeCollisionBox(int num)
         es.enabled = false;
     }
 
-    // then remove it from the hashtable
-    for (int i = coll_box.ilo.x; i <= coll_box.ihi.x; i++)
-    {
-        for (int j = coll_box.ilo.z; j <= coll_box.ihi.z; j++)
-        {
-            hash_free(i,j,num);
-        }
-    }
+    // then remove it from the grid
+    grid_unregister(num, false);
 
     return 0;
 }
@@ -829,22 +915,17 @@ int Collisions::addCollisionTri(Vector3 p1, Vector3 p2, Vector3 p3, ground_model
     aab.merge(p3);
     
     // register this collision tri in the index
-    Ogre::Vector3 ilo(aab.getMinimum() / Ogre::Real(CELL_SIZE));
-    Ogre::Vector3 ihi(aab.getMaximum() / Ogre::Real(CELL_SIZE));
+    Ogre::Vector3& ilo = collision_tris[free_collision_tri].ilo;
+    Ogre::Vector3& ihi = collision_tris[free_collision_tri].ihi;
+    ilo = aab.getMinimum() / Ogre::Real(CELL_SIZE);
+    ihi = aab.getMaximum() / Ogre::Real(CELL_SIZE);
     
     // clamp between 0 and MAXIMUM_CELL;
     ilo.makeCeil(Ogre::Vector3(0.0f));
     ilo.makeFloor(Ogre::Vector3(MAXIMUM_CELL));
     ihi.makeCeil(Ogre::Vector3(0.0f));
     ihi.makeFloor(Ogre::Vector3(MAXIMUM_CELL));
-    
-    for (int i = ilo.x; i <= ihi.x; i++)
-    {
-        for (int j=ilo.z; j<=ihi.z; j++)
-        {
-            hash_add(i,j,free_collision_tri+MAX_COLLISION_BOXES);
-        }
-    }
+    collision_tris[free_collision_tri].indexed=true;
     
     if (debugMode)
     {
@@ -853,14 +934,17 @@ int Collisions::addCollisionTri(Vector3 p1, Vector3 p2, Vector3 p3, ground_model
         debugmo->position(p3);
     }
 
-    return free_collision_tri++;
+    int num = free_collision_tri++;
+    grid_register(num, true);
+    return num;
 }
 
 void Collisions::printStats()
 {
     LOG("COLL: Collision system statistics:");
     LOG("COLL: Cell size: "+TOSTRING((float)CELL_SIZE)+" m");
-    LOG("COLL: Hashtable occupation: "+TOSTRING(cells.size()));
+    LOG("COLL: Grid cells: "+TOSTRING(grid_cells.size())+" (index size: "+TOSTRING(grid_index.size())+")");
+    LOG("COLL: Grid entries: "+TOSTRING(grid_boxes.size())+" box slots, "+TOSTRING(grid_tris.size())+" tri slots");
     LOG("COLL: Hashtable collisions: "+TOSTRING(collision_count));
     LOG("COLL: Largest cell: "+TOSTRING(largest_cellcount));
 }
@@ -873,12 +957,11 @@ bool Collisions::envokeScriptCallback(collision_box_t *cbox, node_t *node)
     // check if this box is active anymore
     if (!eventsources[cbox->eventsourcenum].enabled)
         return false;
-    
-    std::lock_guard<std::mutex> lock(m_scriptcallback_mutex);
+
     // this prevents that the same callback gets called at 2k FPS all the time, serious hit on FPS ...
     if (last_called_cbox != cbox)
     {
-        if (!ScriptEngine::getSingleton().envokeCallback(eventsources[cbox->eventsourcenum].scripthandler, &eventsources[cbox->eventsourcenum], node))
+        if (!ScriptEngine::getSingleton().envokeCallback(eventsources[cbox->eventsourcenum].scripthandler, &eventsources[cbox->eventsourcenum], (node) ? node->id : -1))
             handled = true;
         last_called_cbox = cbox;
     }
@@ -892,19 +975,105 @@ void Collisions::clearEventCache()
     last_called_cbox = 0;
 }
 
+Collisions::event_queue_t* Collisions::getThreadEventQueue()
+{
+    struct cached_queue_t
+    {
+        unsigned int   instance_id;
+        event_queue_t* queue;
+    };
+    static thread_local cached_queue_t cached = { 0, nullptr };
+
+    if (cached.instance_id != m_instance_id)
+    {
+        std::lock_guard<std::mutex> lock(m_event_queues_mutex);
+        m_event_queues.emplace_back(new event_queue_t());
+        cached.instance_id = m_instance_id;
+        cached.queue = m_event_queues.back().get();
+    }
+    return cached.queue;
+}
+
+void Collisions::queueScriptCallback(collision_box_t* cbox, node_t* node, int truck_num, int substep)
+{
+#ifdef USE_ANGELSCRIPT
+    std::vector<queued_event_t>& events = this->getThreadEventQueue()->events;
+    const int cbox_index = static_cast<int>(cbox - collision_boxes);
+
+    // Nodes of a truck usually hit the same box in a row, every substep; one record suffices
+    if (!events.empty() && events.back().cbox == cbox_index && events.back().truck_num == truck_num)
+        return;
+
+    queued_event_t event;
+    event.cbox      = cbox_index;
+    event.node_id   = node->id;
+    event.truck_num = truck_num;
+    event.substep   = substep;
+    events.push_back(event);
+#endif //USE_ANGELSCRIPT
+}
+
+void Collisions::dispatchQueuedEvents()
+{
+#ifdef USE_ANGELSCRIPT
+    m_dispatched_events.clear();
+    for (auto& queue : m_event_queues)
+    {
+        m_dispatched_events.insert(m_dispatched_events.end(), queue->events.begin(), queue->events.end());
+        queue->events.clear();
+    }
+    if (m_dispatched_events.empty())
+        return;
+
+    // Same order for any number of threads: as simulated
+    std::sort(m_dispatched_events.begin(), m_dispatched_events.end(), [](queued_event_t const& a, queued_event_t const& b)
+        {
+            if (a.substep != b.substep)
+                return a.substep < b.substep;
+            if (a.truck_num != b.truck_num)
+                return a.truck_num < b.truck_num;
+            if (a.node_id != b.node_id)
+                return a.node_id < b.node_id;
+            return a.cbox < b.cbox;
+        });
+
+    // One callback per box and frame, for the first node which hit it
+    size_t num_unique = 0;
+    for (queued_event_t const& event : m_dispatched_events)
+    {
+        auto end = m_dispatched_events.begin() + num_unique;
+        if (std::find_if(m_dispatched_events.begin(), end, [&event](queued_event_t const& e) { return e.cbox == event.cbox; }) == end)
+            m_dispatched_events[num_unique++] = event;
+    }
+    m_dispatched_events.resize(num_unique);
+
+    for (queued_event_t const& event : m_dispatched_events)
+    {
+        collision_box_t* cbox = &collision_boxes[event.cbox];
+        if (cbox->eventsourcenum == -1 || !eventsources[cbox->eventsourcenum].enabled || !permitEvent(cbox->event_filter))
+            continue;
+
+        if (last_called_cbox != cbox)
+        {
+            ScriptEngine::getSingleton().envokeCallback(eventsources[cbox->eventsourcenum].scripthandler, &eventsources[cbox->eventsourcenum], event.node_id);
+            last_called_cbox = cbox;
+        }
+    }
+#endif //USE_ANGELSCRIPT
+}
+
 bool Collisions::collisionCorrect(Vector3 *refpos, bool envokeScriptCallbacks)
 {
     // find the correct cell
     bool contacted=false;
     int refx, refz;
-    unsigned int k;
 
     Vector3 mapSize = gEnv->terrainManager->getMaxTerrainSize();
     if (!(refpos->x>0 && refpos->x<mapSize.x && refpos->z>0 && refpos->z<mapSize.z)) return false;
 
     refx=(int)(refpos->x/(float)CELL_SIZE);
     refz=(int)(refpos->z/(float)CELL_SIZE);
-    cell_t *cell=hash_find(refx, refz);
+    const grid_cell_t *cell=grid_find(refx, refz);
     if ( !cell ) return false;
 
     collision_tri_t *minctri=0;
@@ -913,58 +1082,24 @@ bool Collisions::collisionCorrect(Vector3 *refpos, bool envokeScriptCallbacks)
 
     bool isScriptCallbackEnvoked = false;
 
-    for (k=0; k<cell->size(); k++)
+    for (int k = cell->box_begin; k < cell->box_begin + cell->box_count; k++)
     {
-        if ((*cell)[k] != (int)UNUSED_CELLELEMENT && (*cell)[k]<MAX_COLLISION_BOXES)
-        {
-            collision_box_t *cbox=&collision_boxes[(*cell)[k]];
-            if ( !( (*refpos) > cbox->lo && (*refpos) < cbox->hi ) ) continue;
+        collision_box_t *cbox=&collision_boxes[grid_boxes[k]];
+        if ( !( (*refpos) > cbox->lo && (*refpos) < cbox->hi ) ) continue;
 
-            if (cbox->refined || cbox->selfrotated)
+        if (cbox->refined || cbox->selfrotated)
+        {
+            // we may have a collision, do a change of repere
+            Vector3 Pos=*refpos-cbox->center;
+            if (cbox->refined) Pos=cbox->unrot*Pos;
+            if (cbox->selfrotated)
             {
-                // we may have a collision, do a change of repere
-                Vector3 Pos=*refpos-cbox->center;
-                if (cbox->refined) Pos=cbox->unrot*Pos;
-                if (cbox->selfrotated)
-                {
-                    Pos=Pos-cbox->selfcenter;
-                    Pos=cbox->selfunrot*Pos;
-                    Pos=Pos+cbox->selfcenter;
-                }
-                // now test with the inner box
-                if (Pos > cbox->relo && Pos < cbox->rehi)
-                {
-                    if (cbox->eventsourcenum!=-1 && permitEvent(cbox->event_filter) && envokeScriptCallbacks)
-                    {
-                        envokeScriptCallback(cbox);
-                        isScriptCallbackEnvoked = true;
-                    }
-                    if (cbox->camforced && !forcecam)
-                    {
-                        forcecam=true;
-                        forcecampos=cbox->campos;
-                    }
-                    if (!cbox->virt)
-                    {
-                        // collision, process as usual
-                        // we have a collision
-                        contacted = true;
-                        // determine which side collided
-                        Pos = calcCollidedSide(Pos, cbox->relo, cbox->rehi);
-                        
-                        // resume repere
-                        if (cbox->selfrotated)
-                        {
-                            Pos=Pos-cbox->selfcenter;
-                            Pos=cbox->selfrot*Pos;
-                            Pos=Pos+cbox->selfcenter;
-                        }
-                        if (cbox->refined) Pos=cbox->rot*Pos;
-                        *refpos=Pos+cbox->center;
-                    }
-                }
-
-            } else
+                Pos=Pos-cbox->selfcenter;
+                Pos=cbox->selfunrot*Pos;
+                Pos=Pos+cbox->selfcenter;
+            }
+            // now test with the inner box
+            if (Pos > cbox->relo && Pos < cbox->rehi)
             {
                 if (cbox->eventsourcenum!=-1 && permitEvent(cbox->event_filter) && envokeScriptCallbacks)
                 {
@@ -978,29 +1113,62 @@ bool Collisions::collisionCorrect(Vector3 *refpos, bool envokeScriptCallbacks)
                 }
                 if (!cbox->virt)
                 {
+                    // collision, process as usual
                     // we have a collision
-                    contacted=true;
+                    contacted = true;
                     // determine which side collided
-                    (*refpos) = calcCollidedSide((*refpos), cbox->lo, cbox->hi);
+                    Pos = calcCollidedSide(Pos, cbox->relo, cbox->rehi);
+                    
+                    // resume repere
+                    if (cbox->selfrotated)
+                    {
+                        Pos=Pos-cbox->selfcenter;
+                        Pos=cbox->selfrot*Pos;
+                        Pos=Pos+cbox->selfcenter;
+                    }
+                    if (cbox->refined) Pos=cbox->rot*Pos;
+                    *refpos=Pos+cbox->center;
                 }
             }
+
         } else
         {
-            collision_tri_t *ctri=&collision_tris[(*cell)[k]-MAX_COLLISION_BOXES];
-            if (!ctri->enabled)
-                continue;
-            // check if this tri is minimal
-            // transform
-            Vector3 point=ctri->forward*(*refpos-ctri->a);
-            // test if within tri collision volume (potential cause of bug!)
-            if (point.x>=0 && point.y>=0 && (point.x+point.y)<=1.0 && point.z<0 && point.z>-0.1)
+            if (cbox->eventsourcenum!=-1 && permitEvent(cbox->event_filter) && envokeScriptCallbacks)
             {
-                if (-point.z<minctridist)
-                {
-                    minctridist=-point.z;
-                    minctri=ctri;
-                    minctripoint=point;
-                }
+                envokeScriptCallback(cbox);
+                isScriptCallbackEnvoked = true;
+            }
+            if (cbox->camforced && !forcecam)
+            {
+                forcecam=true;
+                forcecampos=cbox->campos;
+            }
+            if (!cbox->virt)
+            {
+                // we have a collision
+                contacted=true;
+                // determine which side collided
+                (*refpos) = calcCollidedSide((*refpos), cbox->lo, cbox->hi);
+            }
+        }
+    }
+
+    for (int k = cell->tri_begin; k < cell->tri_begin + cell->tri_count; k++)
+    {
+        collision_tri_t *ctri=&collision_tris[grid_tris[k]];
+        if (!ctri->enabled)
+            continue;
+        // check if this tri is minimal
+        // transform
+        Vector3 point=ctri->forward*(*refpos-ctri->a);
+        // test if within tri collision volume (potential cause of bug!)
+        if (point.x>=0 && point.y>=0 && (point.x+point.y)<=1.0 && point.z<0 && point.z>-0.1)
+        {
+            if (-point.z<minctridist)
+            {
+                minctridist=-point.z;
+                minctri=ctri;
+                minctripoint=point;
             }
         }
     }
@@ -1054,16 +1222,15 @@ int Collisions::enableCollisionTri(int number, bool enable)
     return 0;
 }
 
-bool Collisions::nodeCollision(node_t *node, bool contacted, float dt, float* nso, ground_model_t** ogm)
+bool Collisions::nodeCollision(node_t *node, bool contacted, float dt, float* nso, ground_model_t** ogm, int truck_num, int substep)
 {
     bool smoky = false;
     // float corrf=1.0;
     Vector3 oripos = node->AbsPosition;
-    unsigned int k;
     // find the correct cell
     int refx = (int)(node->AbsPosition.x/CELL_SIZE);
     int refz = (int)(node->AbsPosition.z/CELL_SIZE);
-    cell_t *cell = hash_find(refx, refz);
+    const grid_cell_t *cell = grid_find(refx, refz);
     //LOG("Checking cell "+TOSTRING(refx)+" "+TOSTRING(refz)+" total indexes: "+TOSTRING(num_cboxes_index[refp]));
 
     collision_tri_t *minctri = 0;
@@ -1072,74 +1239,28 @@ bool Collisions::nodeCollision(node_t *node, bool contacted, float dt, float* ns
 
     if (cell)
     {
-        for (k=0; k<cell->size(); k++)
+        for (int k = cell->box_begin; k < cell->box_begin + cell->box_count; k++)
         {
-            if ((*cell)[k] != (int)UNUSED_CELLELEMENT && (*cell)[k] < MAX_COLLISION_BOXES)
+            collision_box_t *cbox = &collision_boxes[grid_boxes[k]];
+            if (node->AbsPosition > cbox->lo && node->AbsPosition < cbox->hi)
             {
-                collision_box_t *cbox = &collision_boxes[(*cell)[k]];
-                if (node->AbsPosition > cbox->lo && node->AbsPosition < cbox->hi)
+                if (cbox->refined || cbox->selfrotated)
                 {
-                    if (cbox->refined || cbox->selfrotated)
+                    // we may have a collision, do a change of repere
+                    Vector3 Pos = node->AbsPosition-cbox->center;
+                    if (cbox->refined) Pos = cbox->unrot*Pos;
+                    if (cbox->selfrotated)
                     {
-                        // we may have a collision, do a change of repere
-                        Vector3 Pos = node->AbsPosition-cbox->center;
-                        if (cbox->refined) Pos = cbox->unrot*Pos;
-                        if (cbox->selfrotated)
-                        {
-                            Pos=Pos-cbox->selfcenter;
-                            Pos=cbox->selfunrot*Pos;
-                            Pos=Pos+cbox->selfcenter;
-                        }
-                        // now test with the inner box
-                        if (Pos > cbox->relo && Pos < cbox->rehi)
-                        {
-                            if (cbox->eventsourcenum!=-1 && permitEvent(cbox->event_filter))
-                            {
-                                envokeScriptCallback(cbox, node);
-                            }
-                            if (cbox->camforced && !forcecam)
-                            {
-                                forcecam=true;
-                                forcecampos=cbox->campos;
-                            }
-                            if (!cbox->virt)
-                            {
-                                // collision, process as usual
-                                // we have a collision
-                                contacted=true;
-                                // setup smoke
-                                //float ns=node->Velocity.length();
-                                smoky=true;
-                                //*nso=ns;
-                                // determine which side collided
-                                float min=Pos.z-(cbox->relo).z;
-                                Vector3 normal=Vector3(0,0,-1);
-                                float t=(cbox->rehi).z-Pos.z;
-                                if (t<min){min=t; normal=Vector3(0,0,1);}; //north
-                                t=Pos.x-(cbox->relo).x;
-                                if (t<min) {min=t; normal=Vector3(-1,0,0);}; //west
-                                t=(cbox->rehi).x-Pos.x;
-                                if (t<min) {min=t; normal=Vector3(1,0,0);}; //east
-                                t=Pos.y-(cbox->relo).y;
-                                if (t<min) {min=t; normal=Vector3(0,-1,0);}; //down
-                                t=(cbox->rehi).y-Pos.y;
-                                if (t<min) {min=t; normal=Vector3(0,1,0);}; //up
-
-                                // we need the normal, and the depth
-                                // resume repere for the normal
-                                if (cbox->selfrotated) normal=cbox->selfrot*normal;
-                                if (cbox->refined) normal=cbox->rot*normal;
-
-                                // collision boxes are always out of concrete as it seems
-                                primitiveCollision(node, node->Forces, node->Velocity, normal, dt, defaultgm, nso);
-                                if (ogm) *ogm=defaultgm;
-                                }
-                            }
-                    } else
+                        Pos=Pos-cbox->selfcenter;
+                        Pos=cbox->selfunrot*Pos;
+                        Pos=Pos+cbox->selfcenter;
+                    }
+                    // now test with the inner box
+                    if (Pos > cbox->relo && Pos < cbox->rehi)
                     {
-                        if (cbox->eventsourcenum!=-1 && permitEvent(cbox->event_filter))
+                        if (cbox->eventsourcenum!=-1)
                         {
-                            envokeScriptCallback(cbox, node);
+                            queueScriptCallback(cbox, node, truck_num, substep);
                         }
                         if (cbox->camforced && !forcecam)
                         {
@@ -1148,6 +1269,7 @@ bool Collisions::nodeCollision(node_t *node, bool contacted, float dt, float* ns
                         }
                         if (!cbox->virt)
                         {
+                            // collision, process as usual
                             // we have a collision
                             contacted=true;
                             // setup smoke
@@ -1155,43 +1277,87 @@ bool Collisions::nodeCollision(node_t *node, bool contacted, float dt, float* ns
                             smoky=true;
                             //*nso=ns;
                             // determine which side collided
-                            float min=node->AbsPosition.z-cbox->lo.z;
+                            float min=Pos.z-(cbox->relo).z;
                             Vector3 normal=Vector3(0,0,-1);
-                            float t=cbox->hi.z-node->AbsPosition.z;
-                            if (t<min) {min=t; normal=Vector3(0,0,1);}; //north
-                            t=node->AbsPosition.x-cbox->lo.x;
+                            float t=(cbox->rehi).z-Pos.z;
+                            if (t<min){min=t; normal=Vector3(0,0,1);}; //north
+                            t=Pos.x-(cbox->relo).x;
                             if (t<min) {min=t; normal=Vector3(-1,0,0);}; //west
-                            t=cbox->hi.x-node->AbsPosition.x;
+                            t=(cbox->rehi).x-Pos.x;
                             if (t<min) {min=t; normal=Vector3(1,0,0);}; //east
-                            t=node->AbsPosition.y-cbox->lo.y;
+                            t=Pos.y-(cbox->relo).y;
                             if (t<min) {min=t; normal=Vector3(0,-1,0);}; //down
-                            t=cbox->hi.y-node->AbsPosition.y;
+                            t=(cbox->rehi).y-Pos.y;
                             if (t<min) {min=t; normal=Vector3(0,1,0);}; //up
-                            // we need the normal
+
+                            // we need the normal, and the depth
                             // resume repere for the normal
                             if (cbox->selfrotated) normal=cbox->selfrot*normal;
                             if (cbox->refined) normal=cbox->rot*normal;
+
+                            // collision boxes are always out of concrete as it seems
                             primitiveCollision(node, node->Forces, node->Velocity, normal, dt, defaultgm, nso);
                             if (ogm) *ogm=defaultgm;
+                            }
                         }
+                } else
+                {
+                    if (cbox->eventsourcenum!=-1)
+                    {
+                        queueScriptCallback(cbox, node, truck_num, substep);
+                    }
+                    if (cbox->camforced && !forcecam)
+                    {
+                        forcecam=true;
+                        forcecampos=cbox->campos;
+                    }
+                    if (!cbox->virt)
+                    {
+                        // we have a collision
+                        contacted=true;
+                        // setup smoke
+                        //float ns=node->Velocity.length();
+                        smoky=true;
+                        //*nso=ns;
+                        // determine which side collided
+                        float min=node->AbsPosition.z-cbox->lo.z;
+                        Vector3 normal=Vector3(0,0,-1);
+                        float t=cbox->hi.z-node->AbsPosition.z;
+                        if (t<min) {min=t; normal=Vector3(0,0,1);}; //north
+                        t=node->AbsPosition.x-cbox->lo.x;
+                        if (t<min) {min=t; normal=Vector3(-1,0,0);}; //west
+                        t=cbox->hi.x-node->AbsPosition.x;
+                        if (t<min) {min=t; normal=Vector3(1,0,0);}; //east
+                        t=node->AbsPosition.y-cbox->lo.y;
+                        if (t<min) {min=t; normal=Vector3(0,-1,0);}; //down
+                        t=cbox->hi.y-node->AbsPosition.y;
+                        if (t<min) {min=t; normal=Vector3(0,1,0);}; //up
+                        // we need the normal
+                        // resume repere for the normal
+                        if (cbox->selfrotated) normal=cbox->selfrot*normal;
+                        if (cbox->refined) normal=cbox->rot*normal;
+                        primitiveCollision(node, node->Forces, node->Velocity, normal, dt, defaultgm, nso);
+                        if (ogm) *ogm=defaultgm;
                     }
                 }
-            } else
+            }
+        }
+
+        for (int k = cell->tri_begin; k < cell->tri_begin + cell->tri_count; k++)
+        {
+            // tri collision
+            collision_tri_t *ctri=&collision_tris[grid_tris[k]];
+            // check if this tri is minimal
+            // transform
+            Vector3 point=ctri->forward*(node->AbsPosition-ctri->a);
+            // test if within tri collision volume (potential cause of bug!)
+            if (point.x>=0 && point.y>=0 && (point.x+point.y)<=1.0 && point.z<0 && point.z>-0.1)
             {
-                // tri collision
-                collision_tri_t *ctri=&collision_tris[(*cell)[k]-MAX_COLLISION_BOXES];
-                // check if this tri is minimal
-                // transform
-                Vector3 point=ctri->forward*(node->AbsPosition-ctri->a);
-                // test if within tri collision volume (potential cause of bug!)
-                if (point.x>=0 && point.y>=0 && (point.x+point.y)<=1.0 && point.z<0 && point.z>-0.1)
+                if (-point.z<minctridist)
                 {
-                    if (-point.z<minctridist)
-                    {
-                        minctridist=-point.z;
-                        minctri=ctri;
-                        minctripoint=point;
-                    }
+                    minctridist=-point.z;
+                    minctri=ctri;
+                    minctripoint=point;
                 }
             }
         }
@@ -1373,112 +1539,47 @@ bool Collisions::groundCollision(node_t *node, float dt, ground_model_t** ogm, f
     return false;
 }
 
-void primitiveCollision(node_t *node, Vector3 &force, const Vector3 &velocity, const Vector3 &normal, float dt, ground_model_t* gm, float* nso, float penetration, float reaction)
+void Collisions::groundCollisionBatch(ground_batch_t& batch)
 {
-    // normal velocity
+    const int count = batch.size();
+    batch.height.resize(count);
+    batch.normal.resize(count);
+    batch.gm.resize(count);
+    batch.contacts.clear();
+    if (!hFinder || count == 0) return;
 
-    float Vnormal = velocity.dotProduct(normal);
+    hFinder->getHeightsAt(count, batch.x.data(), batch.z.data(), batch.height.data());
 
-    // if we are inside the fluid (solid ground is below us)
-    if (gm->solid_ground_level != 0.0f && penetration >= 0)
+    for (int k = 0; k < count; k++)
     {
-        if (nso) *nso = 0.0f;
-
-        float Vsquared = velocity.squaredLength();
-        // First of all calculate power law fluid viscosity
-        float m = gm->flow_consistency_index * approx_pow(Vsquared, (gm->flow_behavior_index - 1.0f)*0.5f);
-
-        // Then calculate drag based on above. We'are using a simplified Stokes' drag.
-        // Per node fluid drag surface coefficient set by node property applies here
-        Vector3 Fdrag = velocity * (-m * node->surface_coef);
-
-        // If we have anisotropic drag
-        if (gm->drag_anisotropy < 1.0f && Vnormal > 0)
-        {
-            float da_factor;
-            if (Vsquared > gm->va * gm->va)
-                da_factor = 1.0;
-            else
-                da_factor = Vsquared / (gm->va * gm->va);
-            Fdrag += (Vnormal * m * (1.0f - gm->drag_anisotropy) * da_factor) * normal;
-        }
-        force += Fdrag;
+        ground_model_t* gm = (landuse) ? landuse->getGroundModelAt(batch.x[k], batch.z[k]) : nullptr;
+        // when landuse fails or we don't have it, use the default value
+        batch.gm[k] = (gm) ? gm : defaultgroundgm;
 
-        // Now calculate upwards force based on a simplified boyancy equation;
-        // If the fluid is pseudoplastic then boyancy is constrained to only "stopping" a node from going downwards
-        // Buoyancy per node volume coefficient set by node property applies here
-        float Fboyancy = gm->fluid_density * penetration * (-DEFAULT_GRAVITY) * node->volume_coef;
-        if (gm->flow_behavior_index < 1.0f && Vnormal >= 0.0f)
-        {
-            float Fnormal = force.dotProduct(normal);
-            if (Fnormal < 0 && Fboyancy>-Fnormal)
-            {
-                Fboyancy = -Fnormal;
-            }
-        }
-        force += Fboyancy*normal;
+        if (batch.height[k] > batch.y[k])
+            batch.contacts.push_back(k);
     }
 
-    // if we are inside or touching the solid ground
-    if (penetration >= gm->solid_ground_level)
+    if (!batch.contacts.empty())
     {
-        Vector3 slip = velocity - Vnormal*normal;
-        float slipv = slip.squaredLength();
-        if (fabs(slipv) > 1e-08f)
-        {
-            float invslipv = fast_invSqrt(slipv);
-            slip = slip*invslipv;
-            slipv = slipv*invslipv;
-        } else
-        {
-            slipv = sqrt(slipv);
-        }
-
-        if (nso && gm->solid_ground_level == 0.0f) *nso = slipv;
-
-        float Fnormal = 0.0f;
-        float Fdnormal = 0.0f;
-        float Freaction;
-        float Greaction;
+        hFinder->getNormalsAt((int)batch.contacts.size(), batch.contacts.data(),
+            batch.x.data(), batch.height.data(), batch.z.data(), batch.normal.data());
+    }
+}
 
-        Fnormal = force.dotProduct(normal);
-        Fdnormal = Fnormal;
+bool Collisions::groundCollision(node_t* node, float dt, const ground_batch_t& batch, int k, ground_model_t** ogm, float* nso)
+{
+    if (!hFinder) return false;
+    *ogm = batch.gm[k];
+    last_used_ground_model = *ogm;
 
-        // steady force
-        if (reaction < 0)
-        {
-            Freaction = -Fnormal;
-            // impact force
-            if (Vnormal < 0)
-            {
-                Freaction += -Vnormal * node->mass / dt; // Newton's second law
-            }
-            if (Freaction < 0) Freaction = 0.0f;
-        } else
-        {
-            Freaction = reaction;
-            Fnormal = 0.0f;
-        }
-        float ff;
-        // If the velocity that we slip is lower than adhesion velocity and
-        // we have a downforce and the slip forces are lower than static friction
-        // forces then it's time to go into static friction physics mode.
-        // This code is a direct translation of textbook static friction physics
-        Greaction = (Freaction * gm->strength * node->friction_coef); //General moderated reaction, node property sets friction_coef as a pernodefriction setting
-        float msGreaction = (gm->ms) * Greaction;
-        if (slipv < (gm->va) && Greaction > 0.0f && (force - Fdnormal * normal).squaredLength() <= msGreaction * msGreaction)
-        {
-            // Static friction model (with a little smoothing to help the integrator deal with it)
-            ff = -msGreaction * (1.0f - approx_exp(-slipv / gm->va));
-            force = (Fnormal + Freaction) * normal + ff*slip;
-        } else
-        {
-            // Stribek model. It also comes directly from textbooks.
-            float g = gm->mc + (gm->ms - gm->mc) * std::min(1.0f, approx_exp(-approx_pow(slipv / gm->vs, gm->alpha)));
-            ff = -(g + gm->t2 * slipv) * Greaction;
-            force += Freaction * normal + ff*slip;
-        }
+    const float v = batch.height[k];
+    if (v > node->AbsPosition.y)
+    {
+        primitiveCollision(node, node->Forces, node->Velocity, batch.normal[k], dt, *ogm, nso, v - node->AbsPosition.y);
+        return true;
     }
+    return false;
 }
 
 int Collisions::createCollisionDebugVisualization()
@@ -1528,7 +1629,7 @@ int Collisions::createCollisionDebugVisualization()
         {
             int cellx = (int)(x/(float)CELL_SIZE);
             int cellz = (int)(z/(float)CELL_SIZE);
-            cell_t *cell=hash_find(cellx, cellz);
+            const grid_cell_t *cell=grid_find(cellx, cellz);
             if (cell)
             {
                 float groundheight = -9999;
@@ -1552,7 +1653,7 @@ int Collisions::createCollisionDebugVisualization()
                 // ground height should fit
 
                 //int deep = 0;
-                int cc = (int)cell->size();
+                int cc = cell->box_count + cell->tri_count;
                 float percent = cc / (float)CELL_BLOCKSIZE;
 
                 float percentd = percent;
@@ -1641,6 +1742,7 @@ int Collisions::addCollisionMesh(Ogre::String meshname, Ogre::Vector3 pos, Ogre:
 
     delete[] vertices;
     delete[] indices;
+
     if (!debugMode)
     {
         gEnv->sceneManager->destroyEntity(ent);
@@ -1787,6 +1889,11 @@ void Collisions::getMeshInformation(Mesh* mesh,size_t &vertex_count,Vector3* &ve
 
 void Collisions::finishLoadingTerrain()
 {
+    // from now on, objects spawned at runtime are queued for updateGrid()
+    grid_locked = false;
+    grid_rebuild();
+    printStats();
+
     if (debugMode)
     {
         SceneNode *debugsn = gEnv->sceneManager->getRootSceneNode()->createChildSceneNode();
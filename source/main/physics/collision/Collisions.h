@@ -25,6 +25,7 @@
 #include "RoRPrerequisites.h"
 
 #include "BeamData.h" // for collision_box_t
+#include "PrimitiveCollision.h"
 
 #include <OgrePrerequisites.h>
 #include <OgreString.h>
@@ -33,7 +34,9 @@
 #include <OgreSceneNode.h>
 #include <OgreQuaternion.h>
 
+#include <memory>
 #include <mutex>
+#include <vector>
 
 struct eventsource_t
 {
@@ -46,8 +49,6 @@ struct eventsource_t
     bool enabled;
 };
 
-typedef std::vector<int> cell_t;
-
 class Landusemap;
 
 class Collisions : public ZeroedMemoryAllocator
@@ -69,10 +70,16 @@ public:
 
 private:
 
-    struct hash_t
+    /// One occupied cell of the collision grid; indexes ranges of `grid_boxes` and `grid_tris`
+    struct grid_cell_t
     {
         unsigned int cellid;
-        cell_t* cell;
+        int box_begin;
+        int box_count;
+        int box_capacity; // count + free slots for objects added at runtime
+        int tri_begin;
+        int tri_count;
+        int tri_capacity;
     };
 
     struct collision_tri_t
@@ -83,23 +90,42 @@ private:
         Ogre::Matrix3 forward;
         Ogre::Matrix3 reverse;
         ground_model_t* gm;
+        Ogre::Vector3 ilo, ihi; // grid cells covered by the tri
         bool enabled;
+        bool indexed;           // false after removeCollisionTri()
+    };
+
+    /// Event box hit by a node during physics; see nodeCollision()
+    struct queued_event_t
+    {
+        int cbox;      // index into `collision_boxes`
+        int node_id;
+        int truck_num;
+        int substep;
+    };
+
+    /// Object added or removed at runtime; applied to the grid by updateGrid() while physics is paused
+    struct grid_change_t
+    {
+        int  number;   // index into `collision_boxes` or `collision_tris`
+        bool tri;
+        bool add;
+    };
+
+    /// Written by a single physics thread, drained by dispatchQueuedEvents() while physics is paused
+    struct event_queue_t
+    {
+        std::vector<queued_event_t> events;
     };
 
     static const int LATEST_GROUND_MODEL_VERSION = 3;
     static const int MAX_EVENT_SOURCE = 500;
 
-    // this is a power of two, change with caution
-    static const int HASH_POWER = 20;
-    static const int HASH_SIZE = 1 << HASH_POWER;
-
-    // how many elements per cell? power of 2 minus 2 is better
+    // how many elements per cell are considered full (debug visualization only)
     static const int CELL_BLOCKSIZE = 126;
 
-    // how many cells in the pool? Increase in case of sparse distribution of objects
-    //static const int MAX_CELLS = 10000;
-    static const int UNUSED_CELLID = 0xFFFFFFFF;
-    static const int UNUSED_CELLELEMENT = 0xFFFFFFFF;
+    // free slots per cell and object type, so that objects spawned at runtime usually don't need a grid rebuild
+    static const int GRID_CELL_SLACK = 2;
 
     // terrain size is limited to 327km x 327km:
     static const int CELL_SIZE = 2.0; // we divide through this
@@ -116,11 +142,14 @@ private:
     collision_tri_t* collision_tris;
     int free_collision_tri;
 
-    // collision hashtable
-    hash_t hashtable[HASH_SIZE];
-
-    // cell pool
-    std::vector<cell_t*> cells;
+    // collision grid: occupied cells + flat (CSR) object lists, found through an open-addressing index
+    std::vector<grid_cell_t> grid_cells;
+    std::vector<int> grid_index; // hashfunc(cellid) -> grid_cells index, -1 = unused
+    std::vector<int> grid_boxes;
+    std::vector<int> grid_tris;
+    std::vector<grid_change_t> grid_changes; // pending, see updateGrid()
+    bool grid_dirty;             // objects were added which don't fit into the grid; rebuild in updateGrid()
+    bool grid_locked;            // terrain is loading; the grid is built in finishLoadingTerrain()
 
     // ground models
     std::map<Ogre::String, ground_model_t> ground_models;
@@ -129,8 +158,16 @@ private:
     eventsource_t eventsources[MAX_EVENT_SOURCE];
     int free_eventsource;
 
+    // queued events; every thread which runs nodeCollision() gets its own queue, so recording doesn't lock
+    std::vector<std::unique_ptr<event_queue_t>> m_event_queues;
+    std::vector<queued_event_t> m_dispatched_events; // scratch for dispatchQueuedEvents()
+    std::mutex m_event_queues_mutex;                 // only taken when a thread records its first event
+    unsigned int m_instance_id;                      // tells thread-local queue pointers of previous instances apart
+
     bool permitEvent(int filter);
     bool envokeScriptCallback(collision_box_t* cbox, node_t* node = 0);
+    event_queue_t* getThreadEventQueue();
+    void queueScriptCallback(collision_box_t* cbox, node_t* node, int truck_num, int substep);
 
     IHeightFinder* hFinder;
     Landusemap* landuse;
@@ -142,20 +179,20 @@ private:
     long max_col_tris;
     unsigned int hashmask;
 
-    void hash_add(int cell_x, int cell_z, int value);
-    void hash_free(int cell_x, int cell_z, int value);
-    cell_t* hash_find(int cell_x, int cell_z);
-    unsigned int hashfunc(unsigned int cellid);
+    void grid_register(int number, bool tri);
+    void grid_unregister(int number, bool tri);
+    void grid_insert(int number, bool tri, const Ogre::Vector3& ilo, const Ogre::Vector3& ihi);
+    void grid_remove(int number, bool tri, const Ogre::Vector3& ilo, const Ogre::Vector3& ihi);
+    void grid_rebuild();
+    const grid_cell_t* grid_find(int cell_x, int cell_z) const;
+    int grid_find_index(unsigned int cellid) const;
+    unsigned int hashfunc(unsigned int cellid) const;
     void parseGroundConfig(Ogre::ConfigFile* cfg, Ogre::String groundModel = "");
 
     Ogre::Vector3 calcCollidedSide(const Ogre::Vector3& pos, const Ogre::Vector3& lo, const Ogre::Vector3& hi);
 
 public:
 
-    
-
-    std::mutex m_scriptcallback_mutex;
-
     bool forcecam;
     Ogre::Vector3 forcecampos;
     ground_model_t *defaultgm, *defaultgroundgm;
@@ -173,11 +210,20 @@ public:
 
     bool collisionCorrect(Ogre::Vector3* refpos, bool envokeScriptCallbacks = true);
     bool groundCollision(node_t* node, float dt, ground_model_t** gm, float* nso = 0);
+    /// Samples terrain height, ground model and (where in contact) normal for all nodes in `batch` at once
+    void groundCollisionBatch(ground_batch_t& batch);
+    /// Same as groundCollision(), using sample `k` of a batch prepared by groundCollisionBatch()
+    bool groundCollision(node_t* node, float dt, const ground_batch_t& batch, int k, ground_model_t** gm, float* nso = 0);
     bool isInside(Ogre::Vector3 pos, const Ogre::String& inst, const Ogre::String& box, float border = 0);
     bool isInside(Ogre::Vector3 pos, collision_box_t* cbox, float border = 0);
-    bool nodeCollision(node_t* node, bool contacted, float dt, float* nso, ground_model_t** ogm);
+    /// Thread-safe; event box hits are queued, see dispatchQueuedEvents()
+    bool nodeCollision(node_t* node, bool contacted, float dt, float* nso, ground_model_t** ogm, int truck_num, int substep);
 
     void clearEventCache();
+    /// Invokes the script callbacks of event boxes hit since the last call, once per box. Main thread only, physics must not be running.
+    void dispatchQueuedEvents();
+    /// Puts objects added or removed since the last call into the grid. Main thread only, physics must not be running.
+    void updateGrid();
     void finishLoadingTerrain();
     void printStats();
 
@@ -203,5 +249,3 @@ public:
         const Ogre::Quaternion& orient = Ogre::Quaternion::IDENTITY, const Ogre::Vector3& scale = Ogre::Vector3::UNIT_SCALE);
     void resizeMemory(long newSize);
 };
-
-void primitiveCollision(node_t* node, Ogre::Vector3& force, const Ogre::Vector3& velocity, const Ogre::Vector3& normal, float dt, ground_model_t* gm, float* nso, float penetration = 0, float reaction = -1.0f);
@@ -21,6 +21,7 @@
 #include "PointColDetector.h"
 
 #include "Beam.h"
+#include "Settings.h"
 
 // Microsoft Visual Studio 2010 doesn't have std::log2
 // Version macros: http://stackoverflow.com/a/70630
@@ -36,8 +37,14 @@
 
 using namespace Ogre;
 
+/// Full rebuild once the refitted bounds grew by this factor compared to the last full build.
+static const float REFIT_MAX_DEGRADATION = 1.5f;
+
 PointColDetector::PointColDetector()
     : object_list_size(-1)
+    , m_refit_enabled(BSETTING("PointColDetectorRefit", true))
+    , m_refit_tree_valid(false)
+    , m_refit_build_cost(0.0f)
 {
 }
 
@@ -49,9 +56,11 @@ void PointColDetector::update(Beam* truck, bool ignorestate) {
 
     if (truck && (ignorestate || truck->state < SLEEPING)) {
         m_trucks.resize(1, truck);
+        m_truck_slots.assign(1, 0);
         contacters_size += truck->free_contacter;
     } else {
         m_trucks.clear();
+        m_truck_slots.clear();
     }
 
     if (contacters_size != object_list_size) {
@@ -59,22 +68,28 @@ void PointColDetector::update(Beam* truck, bool ignorestate) {
         update_structures_for_contacters();
     }
 
-    kdtree[0].ref = NULL;
-    kdtree[0].begin = 0;
-    kdtree[0].end = -object_list_size;
+    update_kdtree();
 }
 
 void PointColDetector::update(Beam* truck, Beam** trucks, const int numtrucks, bool ignorestate) {
+    while (static_cast<int>(m_all_truck_slots.size()) < numtrucks) {
+        m_all_truck_slots.push_back(static_cast<int>(m_all_truck_slots.size()));
+    }
+    m_all_truck_slots.resize(numtrucks);
+    update(truck, trucks, numtrucks, m_all_truck_slots, ignorestate);
+}
+
+void PointColDetector::update(Beam* truck, Beam** trucks, const int numtrucks, const std::vector<int>& candidates, bool ignorestate) {
     bool update_required = false;
     int contacters_size = 0;
 
     if (truck && (ignorestate || truck->state < SLEEPING)) {
         truck->collisionRelevant = false;
-        m_trucks.resize(numtrucks);
-        for (int t = 0; t < numtrucks; t++) {
+        m_new_truck_slots.clear();
+        for (int t : candidates) {
             if (t != truck->trucknum && trucks[t] && (ignorestate || trucks[t]->state < SLEEPING) && truck->boundingBox.intersects(trucks[t]->boundingBox)) {
-                update_required = update_required || (m_trucks[t] != trucks[t]);
-                m_trucks[t] = trucks[t];
+                update_required = update_required || t >= static_cast<int>(m_trucks.size()) || (m_trucks[t] != trucks[t]);
+                m_new_truck_slots.push_back(t);
                 truck->collisionRelevant = true;
                 contacters_size += trucks[t]->free_contacter;
                 if (truck->nodes[0].Velocity.squaredDistance(trucks[t]->nodes[0].Velocity) > 25)
@@ -90,12 +105,21 @@ void PointColDetector::update(Beam* truck, Beam** trucks, const int numtrucks, b
                         trucks[t]->inter_collcabrate[i].rate = 0;
                     }
                 }
-            } else {
-                m_trucks[t] = 0;
             }
         }
+
+        update_required = update_required || (m_new_truck_slots != m_truck_slots);
+        for (int t : m_truck_slots) {
+            m_trucks[t] = 0;
+        }
+        m_trucks.resize(numtrucks);
+        for (int t : m_new_truck_slots) {
+            m_trucks[t] = trucks[t];
+        }
+        m_truck_slots.swap(m_new_truck_slots);
     } else {
         m_trucks.clear();
+        m_truck_slots.clear();
     }
 
     if (update_required || contacters_size != object_list_size) {
@@ -103,9 +127,74 @@ void PointColDetector::update(Beam* truck, Beam** trucks, const int numtrucks, b
         update_structures_for_contacters();
     }
 
-    kdtree[0].ref = NULL;
-    kdtree[0].begin = 0;
-    kdtree[0].end = -object_list_size;
+    update_kdtree();
+}
+
+void PointColDetector::update_kdtree() {
+    if (!m_refit_enabled) {
+        kdtree[0].ref = NULL;
+        kdtree[0].begin = 0;
+        kdtree[0].end = -object_list_size;
+        return;
+    }
+
+    if (object_list_size <= 0) {
+        return;
+    }
+
+    if (m_refit_tree_valid && refit_kdtree() <= m_refit_build_cost * REFIT_MAX_DEGRADATION) {
+        return;
+    }
+
+    m_refit_order.clear();
+    build_kdtree_full(0, 0, object_list_size, 0);
+    m_refit_build_cost = refit_kdtree();
+    m_refit_tree_valid = true;
+}
+
+void PointColDetector::build_kdtree_full(int index, int begin, int end, int axis) {
+    m_refit_order.push_back(index);
+    kdtree[index].begin = begin;
+    kdtree[index].end = end;
+
+    if (end - begin == 1) {
+        kdtree[index].ref = &ref_list[begin];
+        return;
+    }
+
+    int median = begin + (end - begin) / 2;
+    partintwo(begin, median, end, axis, kdtree[index].min, kdtree[index].max);
+    kdtree[index].middle = ref_list[median].point[axis];
+    kdtree[index].ref = NULL;
+
+    int newaxis = (axis + 1) % 3;
+    build_kdtree_full(2 * index + 1, begin, median, newaxis);
+    build_kdtree_full(2 * index + 2, median, end, newaxis);
+}
+
+float PointColDetector::refit_kdtree() {
+    // Children always come after their parents in m_refit_order, walk it backwards
+    float cost = 0.0f;
+    for (int i = static_cast<int>(m_refit_order.size()) - 1; i >= 0; --i) {
+        int index = m_refit_order[i];
+        kdbounds_t &bounds = m_refit_bounds[index];
+        if (kdtree[index].ref != NULL) {
+            float *point = kdtree[index].ref->point;
+            for (int k = 0; k < 3; ++k) {
+                bounds.min[k] = point[k];
+                bounds.max[k] = point[k];
+            }
+        } else {
+            const kdbounds_t &left = m_refit_bounds[2 * index + 1];
+            const kdbounds_t &right = m_refit_bounds[2 * index + 2];
+            for (int k = 0; k < 3; ++k) {
+                bounds.min[k] = std::min(left.min[k], right.min[k]);
+                bounds.max[k] = std::max(left.max[k], right.max[k]);
+                cost += bounds.max[k] - bounds.min[k];
+            }
+        }
+    }
+    return cost;
 }
 
 void PointColDetector::update_structures_for_contacters() {
@@ -135,6 +224,11 @@ void PointColDetector::update_structures_for_contacters() {
     }
 
     kdtree.resize(pow(2.f, exp_factor), kdelem);
+
+    if (m_refit_enabled) {
+        m_refit_bounds.resize(kdtree.size());
+        m_refit_tree_valid = false;
+    }
 }
 
 void PointColDetector::query(const Vector3 &vec1, const Vector3 &vec2, const Vector3 &vec3, float enlargeBB) {
@@ -167,7 +261,37 @@ void PointColDetector::query(const Vector3 &vec1, const Vector3 &vec2, const Vec
     bbmax += enlarge;
 
     hit_count = 0;
-    queryrec(0, 0);
+    if (m_refit_enabled) {
+        if (object_list_size > 0) {
+            queryrec_bounds();
+        }
+    } else {
+        queryrec(0, 0);
+    }
+}
+
+void PointColDetector::queryrec_bounds() {
+    int stack[64];
+    int stack_size = 0;
+    stack[stack_size++] = 0;
+
+    while (stack_size > 0) {
+        int kdindex = stack[--stack_size];
+        const kdbounds_t &bounds = m_refit_bounds[kdindex];
+        if (bounds.max[0] < bbmin.x || bounds.min[0] > bbmax.x ||
+            bounds.max[1] < bbmin.y || bounds.min[1] > bbmax.y ||
+            bounds.max[2] < bbmin.z || bounds.min[2] > bbmax.z) {
+            continue;
+        }
+
+        if (kdtree[kdindex].ref != NULL) {
+            hit_list[hit_count] = kdtree[kdindex].ref->pidref;
+            hit_count++;
+        } else {
+            stack[stack_size++] = 2 * kdindex + 2;
+            stack[stack_size++] = 2 * kdindex + 1;
+        }
+    }
 }
 
 void PointColDetector::queryrec(int kdindex, int axis) {
@@ -40,6 +40,8 @@ public:
 
     void update(Beam* truck, bool ignorestate = false);
     void update(Beam* truck, Beam** trucks, const int numtrucks, bool ignorestate = false);
+    /// Like above, but only considers `candidates` (ascending truck numbers, e.g. from a broadphase)
+    void update(Beam* truck, Beam** trucks, const int numtrucks, const std::vector<int>& candidates, bool ignorestate = false);
     void query(const Ogre::Vector3& vec1, const Ogre::Vector3& vec2, const Ogre::Vector3& vec3, const float enlargeBB = 0.0f);
 
 private:
@@ -60,17 +62,40 @@ private:
         int begin;
     };
 
+    /// Bounding box of a subtree; used by the refit mode instead of the split planes.
+    struct kdbounds_t
+    {
+        float min[3];
+        float max[3];
+    };
+
     int object_list_size;
     std::vector<Beam*> m_trucks;
+    std::vector<int> m_truck_slots;     //!< Non-NULL entries of m_trucks, ascending
+    std::vector<int> m_new_truck_slots;
+    std::vector<int> m_all_truck_slots; //!< 0..numtrucks-1; candidates for the update() without broadphase
 
     std::vector<refelem_t> ref_list;
     std::vector<pointid_t> pointid_list;
     std::vector<kdnode_t> kdtree;
 
+    // Refit mode: the tree is built completely once and afterwards only the subtree bounds are
+    // recomputed (refitted) from the current node positions. The topology is kept until the
+    // bounds degrade too much compared to the last full build.
+    bool m_refit_enabled;
+    bool m_refit_tree_valid;
+    float m_refit_build_cost;       //!< Sum of bounds extents right after the last full build
+    std::vector<kdbounds_t> m_refit_bounds;
+    std::vector<int> m_refit_order; //!< Used node indices; parents always precede their children
+
     Ogre::Vector3 bbmin;
     Ogre::Vector3 bbmax;
 
     void queryrec(int kdindex, int axis);
+    void queryrec_bounds();
+    void update_kdtree();
+    void build_kdtree_full(int index, int begin, int end, int axis);
+    float refit_kdtree();
     void build_kdtree_incr(int axis, int index);
     void partintwo(const int start, const int median, const int end, const int axis, float& minex, float& maxex);
     void update_structures_for_contacters();
@@ -0,0 +1,143 @@
+/*
+    This source file is part of Rigs of Rods
+    Copyright 2005-2012 Pierre-Michel Ricordel
+    Copyright 2007-2012 Thomas Fischer
+    Copyright 2013+     Petr Ohlidal & contributors
+
+    For more information, see http://www.rigsofrods.org/
+
+    Rigs of Rods is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License version 3, as
+    published by the Free Software Foundation.
+
+    Rigs of Rods is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with Rigs of Rods. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "PrimitiveCollision.h"
+
+#include "ApproxMath.h"
+#include "BeamData.h"
+
+#include <algorithm>
+#include <cmath>
+
+// some gcc fixes
+#if OGRE_PLATFORM == OGRE_PLATFORM_LINUX
+#pragma GCC diagnostic ignored "-Wfloat-equal"
+#endif //OGRE_PLATFORM_LINUX
+
+using namespace Ogre;
+
+void primitiveCollision(node_t *node, Vector3 &force, const Vector3 &velocity, const Vector3 &normal, float dt, ground_model_t* gm, float* nso, float penetration, float reaction)
+{
+    // normal velocity
+
+    float Vnormal = velocity.dotProduct(normal);
+
+    // if we are inside the fluid (solid ground is below us)
+    if (gm->solid_ground_level != 0.0f && penetration >= 0)
+    {
+        if (nso) *nso = 0.0f;
+
+        float Vsquared = velocity.squaredLength();
+        // First of all calculate power law fluid viscosity
+        float m = gm->flow_consistency_index * approx_pow(Vsquared, (gm->flow_behavior_index - 1.0f)*0.5f);
+
+        // Then calculate drag based on above. We'are using a simplified Stokes' drag.
+        // Per node fluid drag surface coefficient set by node property applies here
+        Vector3 Fdrag = velocity * (-m * node->surface_coef);
+
+        // If we have anisotropic drag
+        if (gm->drag_anisotropy < 1.0f && Vnormal > 0)
+        {
+            float da_factor;
+            if (Vsquared > gm->va * gm->va)
+                da_factor = 1.0;
+            else
+                da_factor = Vsquared / (gm->va * gm->va);
+            Fdrag += (Vnormal * m * (1.0f - gm->drag_anisotropy) * da_factor) * normal;
+        }
+        force += Fdrag;
+
+        // Now calculate upwards force based on a simplified boyancy equation;
+        // If the fluid is pseudoplastic then boyancy is constrained to only "stopping" a node from going downwards
+        // Buoyancy per node volume coefficient set by node property applies here
+        float Fboyancy = gm->fluid_density * penetration * (-DEFAULT_GRAVITY) * node->volume_coef;
+        if (gm->flow_behavior_index < 1.0f && Vnormal >= 0.0f)
+        {
+            float Fnormal = force.dotProduct(normal);
+            if (Fnormal < 0 && Fboyancy>-Fnormal)
+            {
+                Fboyancy = -Fnormal;
+            }
+        }
+        force += Fboyancy*normal;
+    }
+
+    // if we are inside or touching the solid ground
+    if (penetration >= gm->solid_ground_level)
+    {
+        Vector3 slip = velocity - Vnormal*normal;
+        float slipv = slip.squaredLength();
+        if (fabs(slipv) > 1e-08f)
+        {
+            float invslipv = fast_invSqrt(slipv);
+            slip = slip*invslipv;
+            slipv = slipv*invslipv;
+        } else
+        {
+            slipv = sqrt(slipv);
+        }
+
+        if (nso && gm->solid_ground_level == 0.0f) *nso = slipv;
+
+        float Fnormal = 0.0f;
+        float Fdnormal = 0.0f;
+        float Freaction;
+        float Greaction;
+
+        Fnormal = force.dotProduct(normal);
+        Fdnormal = Fnormal;
+
+        // steady force
+        if (reaction < 0)
+        {
+            Freaction = -Fnormal;
+            // impact force
+            if (Vnormal < 0)
+            {
+                Freaction += -Vnormal * node->mass / dt; // Newton's second law
+            }
+            if (Freaction < 0) Freaction = 0.0f;
+        } else
+        {
+            Freaction = reaction;
+            Fnormal = 0.0f;
+        }
+        float ff;
+        // If the velocity that we slip is lower than adhesion velocity and
+        // we have a downforce and the slip forces are lower than static friction
+        // forces then it's time to go into static friction physics mode.
+        // This code is a direct translation of textbook static friction physics
+        Greaction = (Freaction * gm->strength * node->friction_coef); //General moderated reaction, node property sets friction_coef as a pernodefriction setting
+        float msGreaction = (gm->ms) * Greaction;
+        if (slipv < (gm->va) && Greaction > 0.0f && (force - Fdnormal * normal).squaredLength() <= msGreaction * msGreaction)
+        {
+            // Static friction model (with a little smoothing to help the integrator deal with it)
+            ff = -msGreaction * (1.0f - approx_exp(-slipv / gm->va));
+            force = (Fnormal + Freaction) * normal + ff*slip;
+        } else
+        {
+            // Stribek model. It also comes directly from textbooks.
+            float g = gm->mc + (gm->ms - gm->mc) * std::min(1.0f, approx_exp(-approx_pow(slipv / gm->vs, gm->alpha)));
+            ff = -(g + gm->t2 * slipv) * Greaction;
+            force += Freaction * normal + ff*slip;
+        }
+    }
+}
@@ -0,0 +1,87 @@
+/*
+    This source file is part of Rigs of Rods
+    Copyright 2013-2017 Petr Ohlidal & contributors
+
+    For more information, see http://www.rigsofrods.org/
+
+    Rigs of Rods is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License version 3, as
+    published by the Free Software Foundation.
+
+    Rigs of Rods is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with Rigs of Rods. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "TruckBroadphase.h"
+
+#include <algorithm>
+
+using namespace RoR;
+
+void TruckBroadphase::Reset(int num_slots)
+{
+    m_entries.clear();
+    if (static_cast<int>(m_candidates.size()) < num_slots)
+    {
+        m_candidates.resize(num_slots);
+    }
+    for (auto& candidates : m_candidates)
+    {
+        candidates.clear();
+    }
+}
+
+void TruckBroadphase::AddBox(int slot, Ogre::AxisAlignedBox const& box)
+{
+    if (box.isNull())
+        return;
+
+    Entry entry;
+    for (int k = 0; k < 3; ++k)
+    {
+        entry.min[k] = box.getMinimum()[k];
+        entry.max[k] = box.getMaximum()[k];
+    }
+    entry.slot = slot;
+    m_entries.push_back(entry);
+}
+
+void TruckBroadphase::Build()
+{
+    std::sort(m_entries.begin(), m_entries.end(), [](Entry const& a, Entry const& b)
+        {
+            return a.min[0] < b.min[0];
+        });
+
+    m_active.clear();
+    for (int i = 0; i < static_cast<int>(m_entries.size()); ++i)
+    {
+        Entry const& e = m_entries[i];
+
+        // Drop boxes which end before this one starts along X; nothing later can reach them either
+        m_active.erase(std::remove_if(m_active.begin(), m_active.end(), [this, &e](int a)
+            {
+                return m_entries[a].max[0] < e.min[0];
+            }), m_active.end());
+
+        for (int a : m_active)
+        {
+            Entry const& o = m_entries[a];
+            if (o.max[1] < e.min[1] || o.min[1] > e.max[1] || o.max[2] < e.min[2] || o.min[2] > e.max[2])
+                continue;
+            m_candidates[e.slot].push_back(o.slot);
+            m_candidates[o.slot].push_back(e.slot);
+        }
+        m_active.push_back(i);
+    }
+
+    for (Entry const& e : m_entries)
+    {
+        std::sort(m_candidates[e.slot].begin(), m_candidates[e.slot].end());
+    }
+}
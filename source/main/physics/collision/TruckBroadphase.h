@@ -0,0 +1,59 @@
+/*
+    This source file is part of Rigs of Rods
+    Copyright 2013-2017 Petr Ohlidal & contributors
+
+    For more information, see http://www.rigsofrods.org/
+
+    Rigs of Rods is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License version 3, as
+    published by the Free Software Foundation.
+
+    Rigs of Rods is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with Rigs of Rods. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+/// @file
+/// @brief Sweep-and-prune broadphase over truck bounding boxes.
+
+#pragma once
+
+#include <OgreAxisAlignedBox.h>
+#include <vector>
+
+namespace RoR {
+
+/// SIM-CORE; Finds pairs of overlapping boxes in O(N log N + pairs) instead of testing all N^2 pairs.
+///
+/// Usage: Reset(), AddBox() for every slot which should take part, Build(), then GetCandidates().
+/// Boxes are identified by slot (truck number); candidate lists are symmetric, sorted
+/// ascending and never contain the slot itself. Build() doesn't allocate once the
+/// internal buffers have grown to the scene size.
+class TruckBroadphase
+{
+public:
+    void Reset(int num_slots);
+    void AddBox(int slot, Ogre::AxisAlignedBox const& box);
+    void Build();
+
+    /// Slots whose box overlaps the box of `slot`; empty for slots which weren't added.
+    std::vector<int> const& GetCandidates(int slot) const { return m_candidates[slot]; }
+
+private:
+    struct Entry
+    {
+        float min[3];
+        float max[3];
+        int   slot;
+    };
+
+    std::vector<Entry>            m_entries;    ///< Sorted by min.x in Build()
+    std::vector<int>              m_active;     ///< Sweep state; indices into m_entries
+    std::vector<std::vector<int>> m_candidates; ///< Per slot
+};
+
+} // namespace RoR
@@ -26,11 +26,192 @@
 #include "RigDef_File.h"
 #include "RigLoadingProfilerControl.h"
 #include "BeamData.h"
+#include "ThreadPool.h"
 
 #include <Ogre.h>
 
+#include <algorithm>
+#include <atomic>
+#include <cstddef>
+
+#if defined(__AVX2__)
+#   define ROR_FLEXBODY_AVX
+#   include <immintrin.h>
+#elif defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && (_M_IX86_FP >= 2))
+#   define ROR_FLEXBODY_SSE
+#   include <emmintrin.h>
+#endif
+
 using namespace Ogre;
 
+namespace {
+
+/// Nearest-node search for locating vertices; finds the same node as a linear scan
+/// of the candidate list which keeps the first of equally distant nodes.
+class NodeKdTree
+{
+public:
+    NodeKdTree(node_t const* nodes, std::vector<unsigned int> const& node_indices)
+    {
+        m_points.resize(node_indices.size());
+        for (size_t i = 0; i < node_indices.size(); ++i)
+        {
+            m_points[i].pos   = nodes[node_indices[i]].AbsPosition;
+            m_points[i].node  = static_cast<int>(node_indices[i]);
+            m_points[i].order = static_cast<int>(i);
+        }
+        this->Build(0, static_cast<int>(m_points.size()));
+    }
+
+    /// @param accept Filters candidates by node index; only called for nodes closer than the best so far.
+    /// @return Node index or -1 if no accepted node is closer than `max_sq_distance`.
+    template<typename F> int FindNearest(Vector3 const& pos, float max_sq_distance, F const& accept) const
+    {
+        Result result;
+        result.sq_distance = max_sq_distance;
+        result.order       = -1; // Nothing at exactly `max_sq_distance` qualifies
+        result.node        = -1;
+        this->Search(0, static_cast<int>(m_points.size()), pos, accept, result);
+        return result.node;
+    }
+
+private:
+    struct Point
+    {
+        Vector3 pos;
+        int     node;
+        int     order; //!< Position in the candidate list, breaks ties
+        int     axis;  //!< Split axis if this is the median of its range
+    };
+
+    struct Result
+    {
+        float sq_distance;
+        int   order;
+        int   node;
+    };
+
+    /// Implicit tree: the median of each range splits it along its widest axis
+    void Build(int begin, int end)
+    {
+        if (end - begin < 2)
+            return;
+
+        Vector3 lo = m_points[begin].pos;
+        Vector3 hi = m_points[begin].pos;
+        for (int i = begin + 1; i < end; ++i)
+        {
+            lo.makeFloor(m_points[i].pos);
+            hi.makeCeil(m_points[i].pos);
+        }
+        const Vector3 extent = hi - lo;
+        const int axis = (extent.x >= extent.y && extent.x >= extent.z) ? 0 : ((extent.y >= extent.z) ? 1 : 2);
+
+        const int mid = (begin + end) / 2;
+        std::nth_element(m_points.begin() + begin, m_points.begin() + mid, m_points.begin() + end,
+            [axis](Point const& a, Point const& b) { return a.pos[axis] < b.pos[axis]; });
+        m_points[mid].axis = axis;
+
+        this->Build(begin, mid);
+        this->Build(mid + 1, end);
+    }
+
+    template<typename F> void Search(int begin, int end, Vector3 const& pos, F const& accept, Result& result) const
+    {
+        if (begin >= end)
+            return;
+
+        const int mid = (begin + end) / 2;
+        Point const& point = m_points[mid];
+        const float sq_distance = pos.squaredDistance(point.pos);
+        if ((sq_distance < result.sq_distance || (sq_distance == result.sq_distance && point.order < result.order))
+            && accept(point.node))
+        {
+            result.sq_distance = sq_distance;
+            result.order       = point.order;
+            result.node        = point.node;
+        }
+        if (end - begin == 1)
+            return;
+
+        const float diff = pos[point.axis] - point.pos[point.axis];
+        const bool left_first = (diff < 0.f);
+        this->Search((left_first) ? begin : mid + 1, (left_first) ? mid : end, pos, accept, result);
+        // Equally distant nodes on the other side may come first in the candidate list
+        if (diff * diff <= result.sq_distance)
+            this->Search((left_first) ? mid + 1 : begin, (left_first) ? end : mid, pos, accept, result);
+    }
+
+    std::vector<Point> m_points;
+};
+
+#if defined(ROR_FLEXBODY_AVX) || defined(ROR_FLEXBODY_SSE)
+
+/// Same steps as fast_invSqrt()
+inline __m128 FastInvSqrt4(__m128 v)
+{
+    const __m128 y = _mm_castsi128_ps(_mm_sub_epi32(_mm_set1_epi32(0x5f3759df), _mm_srai_epi32(_mm_castps_si128(v), 1)));
+    return _mm_mul_ps(y, _mm_sub_ps(_mm_set1_ps(1.5f), _mm_mul_ps(_mm_mul_ps(_mm_mul_ps(_mm_set1_ps(0.5f), v), y), y)));
+}
+
+/// Writes 4 consecutive Vector3 in the layout of a VET_FLOAT3 vertex buffer
+inline void StoreVector3x4(Vector3* dst, __m128 x, __m128 y, __m128 z)
+{
+    const __m128 xy_lo = _mm_unpacklo_ps(x, y);                                   // x0 y0 x1 y1
+    const __m128 xy_hi = _mm_unpackhi_ps(x, y);                                   // x2 y2 x3 y3
+    const __m128 z0x1  = _mm_shuffle_ps(z, xy_lo, _MM_SHUFFLE(2, 2, 0, 0));       // z0 z0 x1 x1
+    const __m128 y1z1  = _mm_shuffle_ps(xy_lo, z, _MM_SHUFFLE(1, 1, 3, 3));       // y1 y1 z1 z1
+    const __m128 z2z3  = _mm_shuffle_ps(z, xy_hi, _MM_SHUFFLE(3, 2, 3, 2));       // z2 z3 x3 y3
+    float* out = &dst[0].x;
+    _mm_storeu_ps(out,     _mm_shuffle_ps(xy_lo, z0x1, _MM_SHUFFLE(2, 0, 1, 0))); // x0 y0 z0 x1
+    _mm_storeu_ps(out + 4, _mm_shuffle_ps(y1z1, xy_hi, _MM_SHUFFLE(1, 0, 2, 0))); // y1 z1 x2 y2
+    _mm_storeu_ps(out + 8, _mm_shuffle_ps(z2z3, z2z3, _MM_SHUFFLE(1, 3, 2, 0)));  // z2 x3 y3 z3
+}
+
+#endif // ROR_FLEXBODY_AVX || ROR_FLEXBODY_SSE
+
+#if defined(ROR_FLEXBODY_AVX)
+
+static_assert(sizeof(node_t) % sizeof(float) == 0, "node_t must be gatherable as floats");
+
+/// Same steps as fast_invSqrt()
+inline __m256 FastInvSqrt8(__m256 v)
+{
+    const __m256 y = _mm256_castsi256_ps(_mm256_sub_epi32(_mm256_set1_epi32(0x5f3759df), _mm256_srai_epi32(_mm256_castps_si256(v), 1)));
+    return _mm256_mul_ps(y, _mm256_sub_ps(_mm256_set1_ps(1.5f), _mm256_mul_ps(_mm256_mul_ps(_mm256_mul_ps(_mm256_set1_ps(0.5f), v), y), y)));
+}
+
+inline void GatherAbsPosition8(node_t const* nodes, const int* indices, __m256& x, __m256& y, __m256& z)
+{
+    const float* base = &nodes[0].AbsPosition.x;
+    const __m256i offsets = _mm256_mullo_epi32(
+        _mm256_loadu_si256(reinterpret_cast<const __m256i*>(indices)), _mm256_set1_epi32(sizeof(node_t) / sizeof(float)));
+    x = _mm256_i32gather_ps(base,     offsets, 4);
+    y = _mm256_i32gather_ps(base + 1, offsets, 4);
+    z = _mm256_i32gather_ps(base + 2, offsets, 4);
+}
+
+#elif defined(ROR_FLEXBODY_SSE)
+
+static_assert(offsetof(node_t, AbsPosition) + 4 * sizeof(float) <= sizeof(node_t), "GatherAbsPosition4() reads 4 floats");
+
+/// The 4th float read from each node is discarded
+inline void GatherAbsPosition4(node_t const* nodes, const int* indices, __m128& x, __m128& y, __m128& z)
+{
+    __m128 r0 = _mm_loadu_ps(&nodes[indices[0]].AbsPosition.x);
+    __m128 r1 = _mm_loadu_ps(&nodes[indices[1]].AbsPosition.x);
+    __m128 r2 = _mm_loadu_ps(&nodes[indices[2]].AbsPosition.x);
+    __m128 r3 = _mm_loadu_ps(&nodes[indices[3]].AbsPosition.x);
+    _MM_TRANSPOSE4_PS(r0, r1, r2, r3);
+    x = r0;
+    y = r1;
+    z = r2;
+}
+
+#endif // ROR_FLEXBODY_SSE
+
+} // namespace
+
 FlexBody::FlexBody(
     RigDef::Flexbody* def,
     RoR::FlexBodyCacheData* preloaded_from_cache,
@@ -397,80 +578,45 @@ FlexBody::FlexBody(
 
         FLEXBODY_PROFILER_ENTER("Locate nodes")
         m_locators = new Locator_t[m_vertex_count];
-        for (int i=0; i<(int)m_vertex_count; i++)
+        const NodeKdTree node_tree(m_nodes, node_indices);
+        std::atomic<int> num_missing_ref(0), num_missing_vx(0), num_missing_vy(0);
+        auto locate_vertex = [&](int i)
         {
             //search nearest node as the local origin
-            float closest_node_distance = 1000000.0;
-            int closest_node_index = -1;
-            auto end  = node_indices.end();
-            auto itor = node_indices.begin();
-            for (; itor != end; ++itor)
-            {
-                float node_distance = vertices[i].squaredDistance(m_nodes[*itor].AbsPosition);
-                if (node_distance < closest_node_distance)
-                {
-                    closest_node_distance = node_distance;
-                    closest_node_index = *itor;
-                }
-            }
+            int closest_node_index = node_tree.FindNearest(vertices[i], 1000000.f, [](int) { return true; });
             if (closest_node_index==-1)
             {
-                LOG("FLEXBODY ERROR on mesh "+def->mesh_name+": REF node not found");
+                num_missing_ref++;
                 closest_node_index = 0;
             }
-            m_locators[i].ref=closest_node_index;            
+            const int ref = closest_node_index;
+            m_locators[i].ref=ref;
 
             //search the second nearest node as the X vector
-            closest_node_distance=1000000.0;
-            closest_node_index=-1;
-            itor = node_indices.begin();
-            for (; itor != end; ++itor)
-            {
-                if (*itor == m_locators[i].ref)
-                {
-                    continue;
-                }
-                float node_distance = vertices[i].squaredDistance(m_nodes[*itor].AbsPosition);
-                if (node_distance < closest_node_distance)
-                {
-                    closest_node_distance = node_distance;
-                    closest_node_index = *itor;
-                }
-            }
+            closest_node_index = node_tree.FindNearest(vertices[i], 1000000.f, [ref](int node) { return node != ref; });
             if (closest_node_index==-1)
             {
-                LOG("FLEXBODY ERROR on mesh "+def->mesh_name+": VX node not found");
+                num_missing_vx++;
                 closest_node_index = 0;
             }
-            m_locators[i].nx=closest_node_index;
+            const int nx = closest_node_index;
+            m_locators[i].nx=nx;
 
             //search another close, orthogonal node as the Y vector
-            closest_node_distance=1000000.0;
-            closest_node_index=-1;
-            itor = node_indices.begin();
-            Vector3 vx = fast_normalise(m_nodes[m_locators[i].nx].AbsPosition - m_nodes[m_locators[i].ref].AbsPosition);
-            for (; itor != end; ++itor)
+            Vector3 vx = fast_normalise(m_nodes[nx].AbsPosition - m_nodes[ref].AbsPosition);
+            closest_node_index = node_tree.FindNearest(vertices[i], 1000000.f, [this, ref, nx, &vx](int node)
             {
-                if (*itor == m_locators[i].ref || *itor == m_locators[i].nx)
-                {
-                    continue;
-                }
-                float node_distance = vertices[i].squaredDistance(m_nodes[*itor].AbsPosition);
-                if (node_distance < closest_node_distance)
+                if (node == ref || node == nx)
                 {
-                    Vector3 vt = fast_normalise(m_nodes[*itor].AbsPosition - m_nodes[m_locators[i].ref].AbsPosition);
-                    float cost = vx.dotProduct(vt);
-                    if (cost>0.707 || cost<-0.707)
-                    {
-                        continue; //rejection, fails the orthogonality criterion (+-45 degree)
-                    }
-                    closest_node_distance = node_distance;
-                    closest_node_index = *itor;
+                    return false;
                 }
-            }
+                Vector3 vt = fast_normalise(m_nodes[node].AbsPosition - m_nodes[ref].AbsPosition);
+                float cost = vx.dotProduct(vt);
+                return !(cost>0.707 || cost<-0.707); //rejection, fails the orthogonality criterion (+-45 degree)
+            });
             if (closest_node_index==-1)
             {
-                LOG("FLEXBODY ERROR on mesh "+def->mesh_name+": VY node not found");
+                num_missing_vy++;
                 closest_node_index = 0;
             }
             m_locators[i].ny=closest_node_index;
@@ -489,7 +635,24 @@ FlexBody::FlexBody(
             m_locators[i].coords = mat * (vertices[i] - m_nodes[m_locators[i].ref].AbsPosition);
 
             // that's it!
+        };
+        if (gEnv->threadPool)
+        {
+            gEnv->threadPool->ParallelFor(0, (int)m_vertex_count, 256, locate_vertex);
+        }
+        else
+        {
+            for (int i=0; i<(int)m_vertex_count; i++)
+            {
+                locate_vertex(i);
+            }
         }
+        if (num_missing_ref > 0)
+            LOG("FLEXBODY ERROR on mesh "+def->mesh_name+": REF node not found ("+TOSTRING(num_missing_ref.load())+" vertices)");
+        if (num_missing_vx > 0)
+            LOG("FLEXBODY ERROR on mesh "+def->mesh_name+": VX node not found ("+TOSTRING(num_missing_vx.load())+" vertices)");
+        if (num_missing_vy > 0)
+            LOG("FLEXBODY ERROR on mesh "+def->mesh_name+": VY node not found ("+TOSTRING(num_missing_vy.load())+" vertices)");
         TIMER_SNAPSHOT_REF(stat_located_time);
 
     } // if (preloaded_from_cache == nullptr)
@@ -542,6 +705,8 @@ FlexBody::FlexBody(
 
     if (vertices != nullptr) { free(vertices); }
 
+    this->buildComputeArrays();
+
     TIMER_SNAPSHOT(stat_euclidean2_time);
     FLEXBODY_PROFILER_ENTER("Printing time stats");
 
@@ -671,9 +836,141 @@ bool FlexBody::flexitPrepare()
     return true;
 }	
 
+void FlexBody::buildComputeArrays()
+{
+    m_loc_ref.resize(m_vertex_count);
+    m_loc_nx.resize(m_vertex_count);
+    m_loc_ny.resize(m_vertex_count);
+    m_loc_coord_x.resize(m_vertex_count);
+    m_loc_coord_y.resize(m_vertex_count);
+    m_loc_coord_z.resize(m_vertex_count);
+    m_src_normal_x.resize(m_vertex_count);
+    m_src_normal_y.resize(m_vertex_count);
+    m_src_normal_z.resize(m_vertex_count);
+    for (size_t i = 0; i < m_vertex_count; i++)
+    {
+        m_loc_ref[i]      = m_locators[i].ref;
+        m_loc_nx[i]       = m_locators[i].nx;
+        m_loc_ny[i]       = m_locators[i].ny;
+        m_loc_coord_x[i]  = m_locators[i].coords.x;
+        m_loc_coord_y[i]  = m_locators[i].coords.y;
+        m_loc_coord_z[i]  = m_locators[i].coords.z;
+        m_src_normal_x[i] = m_src_normals[i].x;
+        m_src_normal_y[i] = m_src_normals[i].y;
+        m_src_normal_z[i] = m_src_normals[i].z;
+    }
+}
+
 void FlexBody::flexitCompute()
 {
-    for (int i=0; i<(int)m_vertex_count; i++)
+    // Same operations in the same order as flexitComputeRange(), for N vertices at once.
+    // Results go straight to m_dst_pos/m_dst_normals, which flexitFinal() uploads as they are.
+    int i = 0;
+#if defined(ROR_FLEXBODY_AVX)
+    const __m256 center_x = _mm256_set1_ps(m_flexit_center.x);
+    const __m256 center_y = _mm256_set1_ps(m_flexit_center.y);
+    const __m256 center_z = _mm256_set1_ps(m_flexit_center.z);
+    const int simd_end = (int)m_vertex_count & ~7;
+    for (; i < simd_end; i += 8)
+    {
+        __m256 ref_x, ref_y, ref_z, nx_x, nx_y, nx_z, ny_x, ny_y, ny_z;
+        GatherAbsPosition8(m_nodes, &m_loc_ref[i], ref_x, ref_y, ref_z);
+        GatherAbsPosition8(m_nodes, &m_loc_nx[i],  nx_x,  nx_y,  nx_z);
+        GatherAbsPosition8(m_nodes, &m_loc_ny[i],  ny_x,  ny_y,  ny_z);
+
+        const __m256 diffX_x = _mm256_sub_ps(nx_x, ref_x);
+        const __m256 diffX_y = _mm256_sub_ps(nx_y, ref_y);
+        const __m256 diffX_z = _mm256_sub_ps(nx_z, ref_z);
+        const __m256 diffY_x = _mm256_sub_ps(ny_x, ref_x);
+        const __m256 diffY_y = _mm256_sub_ps(ny_y, ref_y);
+        const __m256 diffY_z = _mm256_sub_ps(ny_z, ref_z);
+
+        __m256 cross_x = _mm256_sub_ps(_mm256_mul_ps(diffX_y, diffY_z), _mm256_mul_ps(diffX_z, diffY_y));
+        __m256 cross_y = _mm256_sub_ps(_mm256_mul_ps(diffX_z, diffY_x), _mm256_mul_ps(diffX_x, diffY_z));
+        __m256 cross_z = _mm256_sub_ps(_mm256_mul_ps(diffX_x, diffY_y), _mm256_mul_ps(diffX_y, diffY_x));
+        const __m256 cross_inv = FastInvSqrt8(_mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(cross_x, cross_x), _mm256_mul_ps(cross_y, cross_y)), _mm256_mul_ps(cross_z, cross_z)));
+        cross_x = _mm256_mul_ps(cross_x, cross_inv);
+        cross_y = _mm256_mul_ps(cross_y, cross_inv);
+        cross_z = _mm256_mul_ps(cross_z, cross_inv);
+
+        const __m256 coord_x = _mm256_loadu_ps(&m_loc_coord_x[i]);
+        const __m256 coord_y = _mm256_loadu_ps(&m_loc_coord_y[i]);
+        const __m256 coord_z = _mm256_loadu_ps(&m_loc_coord_z[i]);
+        const __m256 pos_x = _mm256_add_ps(_mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(diffX_x, coord_x), _mm256_mul_ps(diffY_x, coord_y)), _mm256_mul_ps(cross_x, coord_z)), _mm256_sub_ps(ref_x, center_x));
+        const __m256 pos_y = _mm256_add_ps(_mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(diffX_y, coord_x), _mm256_mul_ps(diffY_y, coord_y)), _mm256_mul_ps(cross_y, coord_z)), _mm256_sub_ps(ref_y, center_y));
+        const __m256 pos_z = _mm256_add_ps(_mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(diffX_z, coord_x), _mm256_mul_ps(diffY_z, coord_y)), _mm256_mul_ps(cross_z, coord_z)), _mm256_sub_ps(ref_z, center_z));
+
+        const __m256 src_x = _mm256_loadu_ps(&m_src_normal_x[i]);
+        const __m256 src_y = _mm256_loadu_ps(&m_src_normal_y[i]);
+        const __m256 src_z = _mm256_loadu_ps(&m_src_normal_z[i]);
+        __m256 normal_x = _mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(diffX_x, src_x), _mm256_mul_ps(diffY_x, src_y)), _mm256_mul_ps(cross_x, src_z));
+        __m256 normal_y = _mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(diffX_y, src_x), _mm256_mul_ps(diffY_y, src_y)), _mm256_mul_ps(cross_y, src_z));
+        __m256 normal_z = _mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(diffX_z, src_x), _mm256_mul_ps(diffY_z, src_y)), _mm256_mul_ps(cross_z, src_z));
+        const __m256 normal_inv = FastInvSqrt8(_mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(normal_x, normal_x), _mm256_mul_ps(normal_y, normal_y)), _mm256_mul_ps(normal_z, normal_z)));
+        normal_x = _mm256_mul_ps(normal_x, normal_inv);
+        normal_y = _mm256_mul_ps(normal_y, normal_inv);
+        normal_z = _mm256_mul_ps(normal_z, normal_inv);
+
+        StoreVector3x4(&m_dst_pos[i],         _mm256_castps256_ps128(pos_x),       _mm256_castps256_ps128(pos_y),       _mm256_castps256_ps128(pos_z));
+        StoreVector3x4(&m_dst_pos[i + 4],     _mm256_extractf128_ps(pos_x, 1),    _mm256_extractf128_ps(pos_y, 1),    _mm256_extractf128_ps(pos_z, 1));
+        StoreVector3x4(&m_dst_normals[i],     _mm256_castps256_ps128(normal_x),    _mm256_castps256_ps128(normal_y),    _mm256_castps256_ps128(normal_z));
+        StoreVector3x4(&m_dst_normals[i + 4], _mm256_extractf128_ps(normal_x, 1), _mm256_extractf128_ps(normal_y, 1), _mm256_extractf128_ps(normal_z, 1));
+    }
+#elif defined(ROR_FLEXBODY_SSE)
+    const __m128 center_x = _mm_set1_ps(m_flexit_center.x);
+    const __m128 center_y = _mm_set1_ps(m_flexit_center.y);
+    const __m128 center_z = _mm_set1_ps(m_flexit_center.z);
+    const int simd_end = (int)m_vertex_count & ~3;
+    for (; i < simd_end; i += 4)
+    {
+        __m128 ref_x, ref_y, ref_z, nx_x, nx_y, nx_z, ny_x, ny_y, ny_z;
+        GatherAbsPosition4(m_nodes, &m_loc_ref[i], ref_x, ref_y, ref_z);
+        GatherAbsPosition4(m_nodes, &m_loc_nx[i],  nx_x,  nx_y,  nx_z);
+        GatherAbsPosition4(m_nodes, &m_loc_ny[i],  ny_x,  ny_y,  ny_z);
+
+        const __m128 diffX_x = _mm_sub_ps(nx_x, ref_x);
+        const __m128 diffX_y = _mm_sub_ps(nx_y, ref_y);
+        const __m128 diffX_z = _mm_sub_ps(nx_z, ref_z);
+        const __m128 diffY_x = _mm_sub_ps(ny_x, ref_x);
+        const __m128 diffY_y = _mm_sub_ps(ny_y, ref_y);
+        const __m128 diffY_z = _mm_sub_ps(ny_z, ref_z);
+
+        __m128 cross_x = _mm_sub_ps(_mm_mul_ps(diffX_y, diffY_z), _mm_mul_ps(diffX_z, diffY_y));
+        __m128 cross_y = _mm_sub_ps(_mm_mul_ps(diffX_z, diffY_x), _mm_mul_ps(diffX_x, diffY_z));
+        __m128 cross_z = _mm_sub_ps(_mm_mul_ps(diffX_x, diffY_y), _mm_mul_ps(diffX_y, diffY_x));
+        const __m128 cross_inv = FastInvSqrt4(_mm_add_ps(_mm_add_ps(_mm_mul_ps(cross_x, cross_x), _mm_mul_ps(cross_y, cross_y)), _mm_mul_ps(cross_z, cross_z)));
+        cross_x = _mm_mul_ps(cross_x, cross_inv);
+        cross_y = _mm_mul_ps(cross_y, cross_inv);
+        cross_z = _mm_mul_ps(cross_z, cross_inv);
+
+        const __m128 coord_x = _mm_loadu_ps(&m_loc_coord_x[i]);
+        const __m128 coord_y = _mm_loadu_ps(&m_loc_coord_y[i]);
+        const __m128 coord_z = _mm_loadu_ps(&m_loc_coord_z[i]);
+        const __m128 pos_x = _mm_add_ps(_mm_add_ps(_mm_add_ps(_mm_mul_ps(diffX_x, coord_x), _mm_mul_ps(diffY_x, coord_y)), _mm_mul_ps(cross_x, coord_z)), _mm_sub_ps(ref_x, center_x));
+        const __m128 pos_y = _mm_add_ps(_mm_add_ps(_mm_add_ps(_mm_mul_ps(diffX_y, coord_x), _mm_mul_ps(diffY_y, coord_y)), _mm_mul_ps(cross_y, coord_z)), _mm_sub_ps(ref_y, center_y));
+        const __m128 pos_z = _mm_add_ps(_mm_add_ps(_mm_add_ps(_mm_mul_ps(diffX_z, coord_x), _mm_mul_ps(diffY_z, coord_y)), _mm_mul_ps(cross_z, coord_z)), _mm_sub_ps(ref_z, center_z));
+
+        const __m128 src_x = _mm_loadu_ps(&m_src_normal_x[i]);
+        const __m128 src_y = _mm_loadu_ps(&m_src_normal_y[i]);
+        const __m128 src_z = _mm_loadu_ps(&m_src_normal_z[i]);
+        __m128 normal_x = _mm_add_ps(_mm_add_ps(_mm_mul_ps(diffX_x, src_x), _mm_mul_ps(diffY_x, src_y)), _mm_mul_ps(cross_x, src_z));
+        __m128 normal_y = _mm_add_ps(_mm_add_ps(_mm_mul_ps(diffX_y, src_x), _mm_mul_ps(diffY_y, src_y)), _mm_mul_ps(cross_y, src_z));
+        __m128 normal_z = _mm_add_ps(_mm_add_ps(_mm_mul_ps(diffX_z, src_x), _mm_mul_ps(diffY_z, src_y)), _mm_mul_ps(cross_z, src_z));
+        const __m128 normal_inv = FastInvSqrt4(_mm_add_ps(_mm_add_ps(_mm_mul_ps(normal_x, normal_x), _mm_mul_ps(normal_y, normal_y)), _mm_mul_ps(normal_z, normal_z)));
+        normal_x = _mm_mul_ps(normal_x, normal_inv);
+        normal_y = _mm_mul_ps(normal_y, normal_inv);
+        normal_z = _mm_mul_ps(normal_z, normal_inv);
+
+        StoreVector3x4(&m_dst_pos[i],     pos_x,    pos_y,    pos_z);
+        StoreVector3x4(&m_dst_normals[i], normal_x, normal_y, normal_z);
+    }
+#endif
+    this->flexitComputeRange(i, (int)m_vertex_count);
+}
+
+void FlexBody::flexitComputeRange(int begin, int end)
+{
+    for (int i=begin; i<end; i++)
     {
         Vector3 diffX = m_nodes[m_locators[i].nx].AbsPosition - m_nodes[m_locators[i].ref].AbsPosition;
         Vector3 diffY = m_nodes[m_locators[i].ny].AbsPosition - m_nodes[m_locators[i].ref].AbsPosition;
@@ -691,21 +988,6 @@ void FlexBody::flexitCompute()
 
         m_dst_normals[i] = fast_normalise(m_dst_normals[i]);
     }
-#if 0
-    for (int i=0; i<(int)m_vertex_count; i++)
-    {
-        Matrix3 mat;
-        Vector3 diffX = m_nodes[m_locators[i].nx].AbsPosition - m_nodes[m_locators[i].ref].AbsPosition;
-        Vector3 diffY = m_nodes[m_locators[i].ny].AbsPosition - m_nodes[m_locators[i].ref].AbsPosition;
-
-        mat.SetColumn(0, diffX);
-        mat.SetColumn(1, diffY);
-        mat.SetColumn(2, fast_normalise(diffX.crossProduct(diffY))); // Old version: mat.SetColumn(2, m_nodes[loc.nz].AbsPosition-m_nodes[loc.ref].AbsPosition);
-
-        m_dst_pos[i] = mat * m_locators[i].coords + m_nodes[m_locators[i].ref].AbsPosition - m_flexit_center;
-        m_dst_normals[i] = fast_normalise(mat * m_src_normals[i]);
-    }
-#endif
 }
 
 Vector3 FlexBody::flexitFinal()
@@ -31,6 +31,8 @@
 #include <OgreHardwareVertexBuffer.h>
 #include <OgreMesh.h>
 
+#include <vector>
+
 // Forward decl
 namespace RoR
 {
@@ -85,6 +87,9 @@ public:
 
 private:
 
+    void buildComputeArrays();
+    void flexitComputeRange(int begin, int end); ///< Scalar version of flexitCompute()
+
     node_t*           m_nodes;
     size_t            m_vertex_count;
     Ogre::Vector3     m_flexit_center; ///< Updated per frame
@@ -95,6 +100,13 @@ private:
     Ogre::ARGB*       m_src_colors;
     Locator_t*        m_locators; ///< 1 loc per vertex
 
+    // Structure-of-arrays copy of the locators and source normals, for the SIMD path of flexitCompute()
+    std::vector<int>   m_loc_ref;
+    std::vector<int>   m_loc_nx;
+    std::vector<int>   m_loc_ny;
+    std::vector<float> m_loc_coord_x, m_loc_coord_y, m_loc_coord_z;
+    std::vector<float> m_src_normal_x, m_src_normal_y, m_src_normal_z;
+
     int               m_node_center;
     int               m_node_x;
     int               m_node_y;
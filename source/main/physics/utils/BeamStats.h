@@ -142,6 +142,7 @@ public:
     void setup(bool enabled);
     BeamThreadStats *getClient(int number, int type);
     static BeamEngineStats & getInstance();
+    Ogre::String const& getTimingDescription(int type) const { return typeDescriptions[type]; }
     ~BeamEngineStats();
 protected:
     BeamEngineStats();
@@ -0,0 +1,202 @@
+/*
+    This source file is part of Rigs of Rods
+    Copyright 2013-2017 Petr Ohlidal & contributors
+
+    For more information, see http://www.rigsofrods.org/
+
+    Rigs of Rods is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License version 3, as
+    published by the Free Software Foundation.
+
+    Rigs of Rods is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with Rigs of Rods. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "PhysicsBenchmark.h"
+
+#include "Beam.h"
+#include "BeamFactory.h"
+#include "BeamStats.h"
+#include "ThreadPool.h"
+#include "Utils.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <sstream>
+
+using namespace RoR;
+
+namespace {
+
+const int   STEPS_PER_FRAME = 33;   //!< Physics steps per call, as in a 60 FPS frame
+const float WARMUP_SECONDS  = 0.5f; //!< Simulated time before measuring; lets caches and the thread pool settle
+
+} // namespace
+
+PhysicsBenchmark::PhysicsBenchmark(float sim_seconds, std::string const& thread_counts):
+    m_sim_seconds(sim_seconds)
+{
+    std::istringstream stream(thread_counts);
+    std::string token;
+    while (std::getline(stream, token, ','))
+    {
+        if (!token.empty())
+            m_thread_counts.push_back(std::max(0, PARSEINT(token)));
+    }
+
+    if (m_thread_counts.empty())
+    {
+        m_thread_counts.push_back(0);
+        if (gEnv->threadPool)
+            m_thread_counts.push_back(gEnv->threadPool->GetMaxThreads());
+    }
+}
+
+void PhysicsBenchmark::Run(BeamFactory& beam_factory)
+{
+    if (beam_factory.getTruckCount() == 0)
+    {
+        this->Report("[RoR|PhysicsBenchmark] No trucks spawned; use -truck to select one");
+        return;
+    }
+
+    const int configured_threads = (gEnv->threadPool) ? gEnv->threadPool->GetNumThreads() : 0;
+
+    int num_nodes = 0;
+    int num_beams = 0;
+    int num_trucks = 0;
+    for (int t = 0; t < beam_factory.getTruckCount(); t++)
+    {
+        Beam* truck = beam_factory.getTruck(t);
+        if (!truck)
+            continue;
+        num_nodes += truck->free_node;
+        num_beams += truck->free_beam;
+        num_trucks++;
+    }
+    this->Report("[RoR|PhysicsBenchmark] " + TOSTRING(num_trucks) + " truck(s), " + TOSTRING(num_nodes) + " nodes, "
+        + TOSTRING(num_beams) + " beams; " + TOSTRING(m_sim_seconds) + "s simulated time per run");
+
+    beam_factory.setTrucksForcedActive(true);
+    for (int num_threads : m_thread_counts)
+    {
+        m_results.push_back(this->RunOnce(beam_factory, num_threads));
+    }
+    beam_factory.setTrucksForcedActive(false);
+
+    this->SetThreadPoolSize(beam_factory, configured_threads);
+}
+
+PhysicsBenchmark::Result PhysicsBenchmark::RunOnce(BeamFactory& beam_factory, int num_threads)
+{
+    num_threads = this->SetThreadPoolSize(beam_factory, num_threads);
+
+    for (int t = 0; t < beam_factory.getTruckCount(); t++)
+    {
+        Beam* truck = beam_factory.getTruck(t);
+        if (!truck)
+            continue;
+        truck->reset();
+        truck->handleResetRequests(0.f);
+    }
+    beam_factory.activateAllTrucks();
+
+    const int warmup_steps = static_cast<int>(WARMUP_SECONDS / PHYSICS_DT);
+    for (int i = 0; i < warmup_steps; i += STEPS_PER_FRAME)
+    {
+        beam_factory.SimulateSteps(STEPS_PER_FRAME);
+        beam_factory.DispatchSimulationEvents();
+    }
+
+#ifdef FEAT_TIMING
+    std::vector<std::vector<double>> timings_before;
+    for (int t = 0; t < beam_factory.getTruckCount(); t++)
+    {
+        std::vector<double> timings(MAX_TIMINGS, 0.0);
+        Beam* truck = beam_factory.getTruck(t);
+        if (truck && truck->statistics)
+        {
+            for (int i = 0; i < MAX_TIMINGS; i++)
+                timings[i] = truck->statistics->getTiming(i);
+        }
+        timings_before.push_back(timings);
+    }
+#endif // FEAT_TIMING
+
+    const int num_steps = static_cast<int>(m_sim_seconds / PHYSICS_DT);
+    int steps_done = 0;
+    const auto start = std::chrono::steady_clock::now();
+    while (steps_done < num_steps)
+    {
+        beam_factory.SimulateSteps(STEPS_PER_FRAME);
+        beam_factory.DispatchSimulationEvents(); // Part of every frame's cost, as in update()
+        steps_done += STEPS_PER_FRAME;
+    }
+    const std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+
+    Result result;
+    result.num_threads = num_threads;
+    result.num_steps = steps_done;
+    result.wall_seconds = elapsed.count();
+    result.steps_per_second = (elapsed.count() > 0.0) ? (steps_done / elapsed.count()) : 0.0;
+
+    char line[200];
+    snprintf(line, sizeof(line), "[RoR|PhysicsBenchmark] threads: %2d | steps: %7d | wall time: %8.3fs | steps/s: %10.1f | realtime factor: %6.2fx",
+        num_threads, steps_done, result.wall_seconds, result.steps_per_second, result.steps_per_second * PHYSICS_DT);
+    this->Report(line);
+
+#ifdef FEAT_TIMING
+    for (int t = 0; t < beam_factory.getTruckCount(); t++)
+    {
+        Beam* truck = beam_factory.getTruck(t);
+        if (!truck || !truck->statistics)
+            continue;
+
+        this->Report("[RoR|PhysicsBenchmark]   " + truck->getTruckName());
+        const double sum = truck->statistics->getTiming(BES_CORE_WholeTruckCalc) - timings_before[t][BES_CORE_WholeTruckCalc];
+        for (int i = 0; i < MAX_TIMINGS; i++)
+        {
+            const double seconds = truck->statistics->getTiming(i) - timings_before[t][i];
+            if (seconds <= 0.0)
+                continue;
+            snprintf(line, sizeof(line), "[RoR|PhysicsBenchmark]     %20s: %10.6fs %7.2f%% %10.3fus/step",
+                BES.getTimingDescription(i).c_str(), seconds, (sum > 0.0) ? (100.0 * seconds / sum) : 0.0, 1e6 * seconds / steps_done);
+            this->Report(line);
+        }
+    }
+#endif // FEAT_TIMING
+
+    return result;
+}
+
+int PhysicsBenchmark::SetThreadPoolSize(BeamFactory& beam_factory, int num_threads)
+{
+    // The pool is only resized, never replaced; trucks and flexbodies use it between frames
+    beam_factory.SyncWithSimThread();
+    beam_factory.joinFlexbodyTasks();
+
+    const int max_threads = (gEnv->threadPool) ? gEnv->threadPool->GetMaxThreads() : 0;
+    if (num_threads > max_threads)
+    {
+        this->Report("[RoR|PhysicsBenchmark] Thread pool has " + TOSTRING(max_threads) + " thread(s), can't run with "
+            + TOSTRING(num_threads) + "; see settings 'NumThreadsInThreadPool' and 'DisableThreadPool'");
+        num_threads = max_threads;
+    }
+
+    if (gEnv->threadPool)
+        gEnv->threadPool->SetNumActiveThreads(num_threads);
+    return num_threads;
+}
+
+void PhysicsBenchmark::Report(std::string const& line)
+{
+    LOG(line);
+    printf("%s\n", line.c_str());
+    fflush(stdout);
+}
@@ -0,0 +1,67 @@
+/*
+    This source file is part of Rigs of Rods
+    Copyright 2013-2017 Petr Ohlidal & contributors
+
+    For more information, see http://www.rigsofrods.org/
+
+    Rigs of Rods is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License version 3, as
+    published by the Free Software Foundation.
+
+    Rigs of Rods is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with Rigs of Rods. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+/// @file
+/// @brief Measures the speed of the physics simulation; see command line option `-benchphysics`.
+
+#pragma once
+
+#include "RoRPrerequisites.h"
+
+#include <string>
+#include <vector>
+
+namespace RoR {
+
+/// Runs the physics of all spawned trucks as fast as possible, without rendering,
+/// once per thread pool size, and reports steps per second.
+///
+/// Usage: `RoR -map <terrain> -truck <truck> -benchphysics <seconds> [-benchthreads 0,2,4]`
+/// Seconds are simulated time per run. Thread pool size 0 runs everything on the calling thread; sizes
+/// are limited to the threads of the existing pool, which is only resized (see ThreadPool::SetNumActiveThreads()).
+/// Results go to RoR.log and stdout; with FEAT_TIMING, the BES_CORE_* breakdown of each truck is included.
+class PhysicsBenchmark
+{
+public:
+    struct Result
+    {
+        int    num_threads;
+        int    num_steps;
+        double wall_seconds;
+        double steps_per_second;
+    };
+
+    PhysicsBenchmark(float sim_seconds, std::string const& thread_counts);
+
+    /// Trucks must be spawned already; they're reset to their spawn position before each run.
+    void Run(BeamFactory& beam_factory);
+
+    std::vector<Result> const& GetResults() const { return m_results; }
+
+private:
+    int    SetThreadPoolSize(BeamFactory& beam_factory, int num_threads); //!< Returns the size actually set
+    Result RunOnce(BeamFactory& beam_factory, int num_threads);
+    void   Report(std::string const& line);
+
+    float               m_sim_seconds;
+    std::vector<int>    m_thread_counts;  //!< Thread pool sizes to measure
+    std::vector<Result> m_results;
+};
+
+} // namespace RoR
@@ -0,0 +1,597 @@
+/*
+    This source file is part of Rigs of Rods
+    Copyright 2013-2017 Petr Ohlidal & contributors
+
+    For more information, see http://www.rigsofrods.org/
+
+    Rigs of Rods is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License version 3, as
+    published by the Free Software Foundation.
+
+    Rigs of Rods is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with Rigs of Rods. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "PhysicsRecording.h"
+
+#include "AeroEngine.h"
+#include "Beam.h"
+#include "BeamEngine.h"
+#include "BeamFactory.h"
+#include "CmdKeyInertia.h"
+#include "MappedFile.h"
+#include "ScrewProp.h"
+#include "Utils.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <limits>
+
+using namespace RoR;
+
+namespace {
+
+// File layout: FileHeader, TruckHeader (+ inertia states) per truck, then frames of fixed size:
+// FrameHeader, and TruckRecord (+ inputs and node positions) per truck.
+// Values are in native byte order.
+
+const char     RECORDING_MAGIC[8]  = {'R','o','R','P','H','Y','S','\0'};
+const uint32_t FILE_FORMAT_VERSION = 2;
+const int      NUM_COMMAND_KEYS    = MAX_COMMANDS + 10; //!< Size of rig_t::commandkey
+const int      NUM_INERTIAS        = 3;                 //!< cmdInertia, hydroInertia, rotaInertia
+const size_t   NUM_WORST_NODES     = 10;                //!< Listed in the report
+
+struct FileHeader
+{
+    char     magic[8];
+    uint32_t file_format_version;
+    uint32_t truck_record_size;    ///< Rejects files written by a build with a different TruckRecord
+    double   physics_dt;
+    uint32_t num_trucks;
+};
+
+/// Followed by the CmdKeyInertia states as floats
+struct TruckHeader
+{
+    char     name[128];
+    int32_t  slot;                 ///< BeamFactory index
+    int32_t  num_nodes;
+    int32_t  num_aeroengines;
+    int32_t  num_screwprops;
+    int32_t  num_inertia_values[NUM_INERTIAS];
+};
+
+struct FrameHeader
+{
+    int32_t  num_steps;
+    float    mr_time;              ///< gEnv->mrTime during the run
+};
+
+/// Followed by floats: command key player inputs, aero engine throttles,
+/// screwprop throttles and rudders, node positions
+struct TruckRecord
+{
+    int32_t  state;
+    float    hydrodircommand;
+    int32_t  hydro_speed_coupling;
+    float    hydroaileroncommand;
+    float    hydroruddercommand;
+    float    hydroelevatorcommand;
+    float    aileron;
+    float    elevator;
+    float    rudder;
+    int32_t  flap;
+    int32_t  airbrakeval;
+    float    brake;
+    int32_t  parkingbrake;
+    int32_t  alb_mode;
+    int32_t  tc_mode;
+    int32_t  has_engine;
+    BeamEngine::ControlState engine;
+};
+
+size_t GetTruckFrameSize(int num_nodes, int num_aeroengines, int num_screwprops)
+{
+    return sizeof(TruckRecord) + sizeof(float) * (NUM_COMMAND_KEYS + num_aeroengines + num_screwprops * 2 + num_nodes * 3);
+}
+
+CmdKeyInertia* GetInertia(Beam* truck, int index)
+{
+    switch (index)
+    {
+    case 0:  return truck->cmdInertia;
+    case 1:  return truck->hydroInertia;
+    default: return truck->rotaInertia;
+    }
+}
+
+/// Local trucks in BeamFactory order; remote ones aren't simulated here
+void GetLocalTrucks(BeamFactory& beam_factory, std::vector<int>& out_slots)
+{
+    out_slots.clear();
+    for (int t = 0; t < beam_factory.getTruckCount(); t++)
+    {
+        Beam* truck = beam_factory.getTruck(t);
+        if (truck && truck->state != NETWORKED)
+            out_slots.push_back(t);
+    }
+}
+
+template<typename T> void Append(std::vector<char>& out, T const& value)
+{
+    const char* bytes = reinterpret_cast<const char*>(&value);
+    out.insert(out.end(), bytes, bytes + sizeof(T));
+}
+
+/// Reads from a mapped recording; fails instead of reading past the end
+struct Reader
+{
+    const char* pos;
+    const char* end;
+
+    template<typename T> bool Read(T& out)
+    {
+        if (static_cast<size_t>(end - pos) < sizeof(T))
+            return false;
+        std::memcpy(&out, pos, sizeof(T));
+        pos += sizeof(T);
+        return true;
+    }
+};
+
+} // namespace
+
+// ----------------------------------------------------------------------------
+// PhysicsRecorder
+
+PhysicsRecorder::PhysicsRecorder(std::string const& filename):
+    m_filename(filename),
+    m_file(nullptr),
+    m_header_written(false),
+    m_num_frames(0)
+{
+    m_file = std::fopen(filename.c_str(), "wb");
+    if (!m_file)
+        LOG("[RoR|PhysicsRecorder] Cannot create '" + filename + "', nothing will be recorded");
+}
+
+PhysicsRecorder::~PhysicsRecorder()
+{
+    this->Stop("done");
+}
+
+void PhysicsRecorder::Stop(std::string const& reason)
+{
+    if (!m_file)
+        return;
+    const bool ok = (std::fclose(m_file) == 0);
+    m_file = nullptr;
+    LOG("[RoR|PhysicsRecorder] " + TOSTRING(m_num_frames) + " frames recorded to '" + m_filename + "' (" + reason + ")"
+        + ((ok) ? "" : "; writing the file failed"));
+}
+
+bool PhysicsRecorder::WriteHeader(BeamFactory& beam_factory)
+{
+    GetLocalTrucks(beam_factory, m_truck_slots);
+
+    std::vector<char> out;
+    FileHeader header;
+    std::memset(&header, 0, sizeof(header));
+    std::memcpy(header.magic, RECORDING_MAGIC, sizeof(header.magic));
+    header.file_format_version = FILE_FORMAT_VERSION;
+    header.truck_record_size = sizeof(TruckRecord);
+    header.physics_dt = PHYSICS_DT;
+    header.num_trucks = static_cast<uint32_t>(m_truck_slots.size());
+    Append(out, header);
+
+    m_truck_num_nodes.clear();
+    for (int slot : m_truck_slots)
+    {
+        Beam* truck = beam_factory.getTruck(slot);
+        std::vector<float> inertia_states[NUM_INERTIAS];
+
+        TruckHeader truck_header;
+        std::memset(&truck_header, 0, sizeof(truck_header));
+        std::strncpy(truck_header.name, truck->getTruckName().c_str(), sizeof(truck_header.name) - 1);
+        truck_header.slot = slot;
+        truck_header.num_nodes = truck->free_node;
+        truck_header.num_aeroengines = truck->free_aeroengine;
+        truck_header.num_screwprops = truck->free_screwprop;
+        for (int i = 0; i < NUM_INERTIAS; i++)
+        {
+            if (GetInertia(truck, i))
+                GetInertia(truck, i)->getState(inertia_states[i]);
+            truck_header.num_inertia_values[i] = static_cast<int32_t>(inertia_states[i].size());
+        }
+        Append(out, truck_header);
+        for (int i = 0; i < NUM_INERTIAS; i++)
+        {
+            for (float value : inertia_states[i])
+                Append(out, value);
+        }
+        m_truck_num_nodes.push_back(truck->free_node);
+    }
+
+    m_header_written = true;
+    return std::fwrite(out.data(), 1, out.size(), m_file) == out.size();
+}
+
+void PhysicsRecorder::RecordFrame(BeamFactory& beam_factory, int num_steps)
+{
+    if (!m_file)
+        return;
+
+    if (!m_header_written)
+    {
+        if (!this->WriteHeader(beam_factory))
+        {
+            this->Stop("cannot write the file");
+            return;
+        }
+    }
+    else
+    {
+        std::vector<int> slots;
+        GetLocalTrucks(beam_factory, slots);
+        bool same_trucks = (slots == m_truck_slots);
+        for (size_t i = 0; same_trucks && i < slots.size(); i++)
+        {
+            same_trucks = (beam_factory.getTruck(slots[i])->free_node == m_truck_num_nodes[i]);
+        }
+        if (!same_trucks)
+        {
+            this->Stop("a truck was spawned or removed");
+            return;
+        }
+    }
+
+    m_frame_buffer.clear();
+    FrameHeader frame_header;
+    frame_header.num_steps = num_steps;
+    frame_header.mr_time = gEnv->mrTime;
+    Append(m_frame_buffer, frame_header);
+
+    for (int slot : m_truck_slots)
+    {
+        Beam* truck = beam_factory.getTruck(slot);
+
+        TruckRecord record;
+        std::memset(&record, 0, sizeof(record));
+        record.state                = truck->state;
+        record.hydrodircommand      = truck->hydrodircommand;
+        record.hydro_speed_coupling = truck->hydroSpeedCoupling;
+        record.hydroaileroncommand  = truck->hydroaileroncommand;
+        record.hydroruddercommand   = truck->hydroruddercommand;
+        record.hydroelevatorcommand = truck->hydroelevatorcommand;
+        record.aileron              = truck->aileron;
+        record.elevator             = truck->elevator;
+        record.rudder               = truck->rudder;
+        record.flap                 = truck->flap;
+        record.airbrakeval          = truck->airbrakeval;
+        record.brake                = truck->brake;
+        record.parkingbrake         = truck->parkingbrake;
+        record.alb_mode             = truck->alb_mode;
+        record.tc_mode              = truck->tc_mode;
+        record.has_engine           = (truck->engine != nullptr);
+        if (truck->engine)
+            truck->engine->getControlState(record.engine);
+        Append(m_frame_buffer, record);
+
+        for (int i = 0; i < NUM_COMMAND_KEYS; i++)
+            Append(m_frame_buffer, truck->commandkey[i].playerInputValue);
+        for (int i = 0; i < truck->free_aeroengine; i++)
+            Append(m_frame_buffer, truck->aeroengines[i]->getThrottle());
+        for (int i = 0; i < truck->free_screwprop; i++)
+        {
+            Append(m_frame_buffer, truck->screwprops[i]->getThrottle());
+            Append(m_frame_buffer, truck->screwprops[i]->getRudder());
+        }
+        for (int i = 0; i < truck->free_node; i++)
+        {
+            Append(m_frame_buffer, truck->nodes[i].AbsPosition.x);
+            Append(m_frame_buffer, truck->nodes[i].AbsPosition.y);
+            Append(m_frame_buffer, truck->nodes[i].AbsPosition.z);
+        }
+    }
+
+    if (std::fwrite(m_frame_buffer.data(), 1, m_frame_buffer.size(), m_file) != m_frame_buffer.size())
+    {
+        this->Stop("cannot write the file");
+        return;
+    }
+    m_num_frames++;
+}
+
+// ----------------------------------------------------------------------------
+// PhysicsPlayer
+
+PhysicsPlayer::PhysicsPlayer(std::string const& filename, float tolerance):
+    m_filename(filename),
+    m_tolerance(std::max(0.f, tolerance))
+{
+}
+
+bool PhysicsPlayer::Run(BeamFactory& beam_factory, PhysicsRecorder* baseline)
+{
+    MappedFile file;
+    if (!file.Open(m_filename))
+    {
+        this->Report("[RoR|PhysicsPlayer] Cannot open '" + m_filename + "'");
+        return false;
+    }
+    Reader reader = { file.GetData(), file.GetData() + file.GetSize() };
+
+    FileHeader header;
+    if (!reader.Read(header) || std::memcmp(header.magic, RECORDING_MAGIC, sizeof(header.magic)) != 0
+        || header.file_format_version != FILE_FORMAT_VERSION || header.truck_record_size != sizeof(TruckRecord))
+    {
+        this->Report("[RoR|PhysicsPlayer] '" + m_filename + "' is not a physics recording of this version");
+        return false;
+    }
+    if (header.physics_dt != PHYSICS_DT)
+    {
+        this->Report("[RoR|PhysicsPlayer] The recording was made with PHYSICS_DT " + TOSTRING(header.physics_dt));
+        return false;
+    }
+
+    // Match the recorded trucks with the spawned ones
+    std::vector<Beam*> trucks;
+    std::vector<std::string> truck_names;
+    std::vector<int> node_offsets; // into `divergence`
+    int num_nodes = 0;
+    size_t frame_size = sizeof(FrameHeader);
+    for (uint32_t i = 0; i < header.num_trucks; i++)
+    {
+        TruckHeader truck_header;
+        if (!reader.Read(truck_header))
+        {
+            this->Report("[RoR|PhysicsPlayer] '" + m_filename + "' is damaged");
+            return false;
+        }
+        truck_header.name[sizeof(truck_header.name) - 1] = '\0';
+
+        Beam* truck = beam_factory.getTruck(truck_header.slot);
+        if (!truck || truck->state == NETWORKED || truck->getTruckName() != truck_header.name
+            || truck->free_node != truck_header.num_nodes || truck->free_aeroengine != truck_header.num_aeroengines
+            || truck->free_screwprop != truck_header.num_screwprops)
+        {
+            this->Report("[RoR|PhysicsPlayer] Truck '" + std::string(truck_header.name) + "' (" + TOSTRING(truck_header.num_nodes)
+                + " nodes) isn't spawned at index " + TOSTRING(truck_header.slot) + "; use the -map and -truck options of the recording");
+            return false;
+        }
+
+        for (int k = 0; k < NUM_INERTIAS; k++)
+        {
+            std::vector<float> state(std::max(0, truck_header.num_inertia_values[k]));
+            for (float& value : state)
+            {
+                if (!reader.Read(value))
+                {
+                    this->Report("[RoR|PhysicsPlayer] '" + m_filename + "' is damaged");
+                    return false;
+                }
+            }
+            if (GetInertia(truck, k) && !GetInertia(truck, k)->setState(state))
+                this->Report("[RoR|PhysicsPlayer] Warning: the command key inertia of '" + truck->getTruckName() + "' doesn't match the recording");
+        }
+
+        trucks.push_back(truck);
+        truck_names.push_back(truck_header.name);
+        node_offsets.push_back(num_nodes);
+        num_nodes += truck->free_node;
+        frame_size += GetTruckFrameSize(truck->free_node, truck->free_aeroengine, truck->free_screwprop);
+    }
+
+    const size_t data_size = static_cast<size_t>(reader.end - reader.pos);
+    const int num_frames = static_cast<int>(data_size / frame_size);
+    if (data_size % frame_size != 0)
+        this->Report("[RoR|PhysicsPlayer] Warning: the last frame is incomplete, the recording was cut short");
+    if (trucks.empty() || num_frames == 0)
+    {
+        this->Report("[RoR|PhysicsPlayer] '" + m_filename + "' contains no frames");
+        return false;
+    }
+
+    this->Report("[RoR|PhysicsPlayer] '" + m_filename + "': " + TOSTRING(num_frames) + " frames, " + TOSTRING(trucks.size())
+        + " truck(s), " + TOSTRING(num_nodes) + " nodes");
+
+    std::vector<NodeDivergence> divergence(num_nodes);
+    for (size_t t = 0; t < trucks.size(); t++)
+    {
+        for (int n = 0; n < trucks[t]->free_node; n++)
+        {
+            NodeDivergence& node = divergence[node_offsets[t] + n];
+            node.truck = static_cast<int>(t);
+            node.node = n;
+            node.max = 0.f;
+            node.max_frame = -1;
+            node.last = 0.f;
+        }
+    }
+    double sum_squares = 0.0;
+    int first_diverged_frame = -1;  // beyond tolerance
+    int first_changed_frame = -1;   // not bit-identical
+
+    std::vector<double> step_times; // microseconds per step, per frame
+    step_times.reserve(num_frames);
+    double total_seconds = 0.0;
+    long total_steps = 0;
+
+    beam_factory.SyncWithSimThread();
+
+    for (int f = 0; f < num_frames; f++)
+    {
+        Reader frame = { reader.pos + f * frame_size, reader.pos + (f + 1) * frame_size };
+        FrameHeader frame_header;
+        frame.Read(frame_header);
+
+        for (size_t t = 0; t < trucks.size(); t++)
+        {
+            Beam* truck = trucks[t];
+
+            // Apply the inputs
+            TruckRecord record;
+            frame.Read(record);
+            truck->state                = record.state;
+            truck->hydrodircommand      = record.hydrodircommand;
+            truck->hydroSpeedCoupling   = (record.hydro_speed_coupling != 0);
+            truck->hydroaileroncommand  = record.hydroaileroncommand;
+            truck->hydroruddercommand   = record.hydroruddercommand;
+            truck->hydroelevatorcommand = record.hydroelevatorcommand;
+            truck->aileron              = record.aileron;
+            truck->elevator             = record.elevator;
+            truck->rudder               = record.rudder;
+            truck->flap                 = record.flap;
+            truck->airbrakeval          = record.airbrakeval;
+            truck->brake                = record.brake;
+            truck->parkingbrake         = record.parkingbrake;
+            truck->alb_mode             = record.alb_mode;
+            truck->tc_mode              = record.tc_mode;
+            if (truck->engine && record.has_engine)
+                truck->engine->setControlState(record.engine);
+
+            for (int i = 0; i < NUM_COMMAND_KEYS; i++)
+                frame.Read(truck->commandkey[i].playerInputValue);
+            float value;
+            for (int i = 0; i < truck->free_aeroengine; i++)
+            {
+                frame.Read(value);
+                truck->aeroengines[i]->setThrottle(value);
+            }
+            for (int i = 0; i < truck->free_screwprop; i++)
+            {
+                frame.Read(value);
+                truck->screwprops[i]->setThrottle(value);
+                frame.Read(value);
+                truck->screwprops[i]->setRudder(value);
+            }
+
+            // Compare the positions the run starts from
+            for (int n = 0; n < truck->free_node; n++)
+            {
+                float recorded[3];
+                frame.Read(recorded);
+                const Ogre::Vector3& pos = truck->nodes[n].AbsPosition;
+                if (pos.x == recorded[0] && pos.y == recorded[1] && pos.z == recorded[2])
+                {
+                    divergence[node_offsets[t] + n].last = 0.f;
+                    continue;
+                }
+
+                const double dx = static_cast<double>(pos.x) - recorded[0];
+                const double dy = static_cast<double>(pos.y) - recorded[1];
+                const double dz = static_cast<double>(pos.z) - recorded[2];
+                double distance = std::sqrt(dx * dx + dy * dy + dz * dz);
+                if (!(distance <= std::numeric_limits<float>::max())) // NaN
+                    distance = std::numeric_limits<float>::infinity();
+
+                NodeDivergence& node = divergence[node_offsets[t] + n];
+                node.last = static_cast<float>(distance);
+                if (node.last > node.max || node.max_frame < 0)
+                {
+                    node.max = node.last;
+                    node.max_frame = f;
+                }
+                sum_squares += distance * distance;
+                if (first_changed_frame < 0)
+                    first_changed_frame = f;
+                if (first_diverged_frame < 0 && distance > m_tolerance)
+                    first_diverged_frame = f;
+            }
+        }
+
+        if (baseline)
+        {
+            gEnv->mrTime = frame_header.mr_time; // as seen by RecordFrame() in a live session
+            baseline->RecordFrame(beam_factory, frame_header.num_steps);
+        }
+
+        const auto start = std::chrono::steady_clock::now();
+        beam_factory.SimulateSteps(frame_header.num_steps, frame_header.mr_time);
+        const std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+
+        total_seconds += elapsed.count();
+        if (frame_header.num_steps > 0)
+        {
+            total_steps += frame_header.num_steps;
+            step_times.push_back(1e6 * elapsed.count() / frame_header.num_steps);
+        }
+
+        // Event box callbacks run between the frames, as in a live session
+        beam_factory.DispatchSimulationEvents();
+    }
+
+    // Time per step
+    char line[300];
+    if (!step_times.empty())
+    {
+        std::vector<double> sorted = step_times;
+        std::sort(sorted.begin(), sorted.end());
+        snprintf(line, sizeof(line), "[RoR|PhysicsPlayer] steps: %ld (%.3fs simulated) | wall time: %.3fs | us/step: mean %.3f, median %.3f, p99 %.3f, max %.3f",
+            total_steps, total_steps * PHYSICS_DT, total_seconds, 1e6 * total_seconds / total_steps,
+            sorted[sorted.size() / 2], sorted[std::min(sorted.size() - 1, sorted.size() * 99 / 100)], sorted.back());
+        this->Report(line);
+    }
+
+    // Divergence
+    std::vector<NodeDivergence> worst = divergence;
+    std::sort(worst.begin(), worst.end(), [](NodeDivergence const& a, NodeDivergence const& b) { return a.max > b.max; });
+    const int num_changed = static_cast<int>(std::count_if(divergence.begin(), divergence.end(),
+        [](NodeDivergence const& node) { return node.max_frame >= 0; }));
+    const int num_diverged = static_cast<int>(std::count_if(divergence.begin(), divergence.end(),
+        [this](NodeDivergence const& node) { return node.max > m_tolerance; }));
+    const double rms = std::sqrt(sum_squares / (static_cast<double>(num_nodes) * num_frames));
+
+    snprintf(line, sizeof(line), "[RoR|PhysicsPlayer] divergence: max %g m | rms %g m | nodes not bit-identical: %d / %d (first at frame %d) | beyond tolerance %g m: %d (first at frame %d)",
+        worst.front().max, rms, num_changed, num_nodes, first_changed_frame, m_tolerance, num_diverged, first_diverged_frame);
+    this->Report(line);
+    for (size_t i = 0; i < std::min(NUM_WORST_NODES, worst.size()) && worst[i].max_frame >= 0; i++)
+    {
+        snprintf(line, sizeof(line), "[RoR|PhysicsPlayer]   %-30s node %5d: max %g m at frame %d, last %g m",
+            truck_names[worst[i].truck].c_str(), worst[i].node, worst[i].max, worst[i].max_frame, worst[i].last);
+        this->Report(line);
+    }
+    this->WriteDivergenceTable(divergence, truck_names);
+
+    const bool passed = (num_diverged == 0);
+    if (num_changed == 0)
+        this->Report("[RoR|PhysicsPlayer] Result: bit-identical");
+    else if (passed)
+        this->Report("[RoR|PhysicsPlayer] Result: within tolerance");
+    else
+        this->Report("[RoR|PhysicsPlayer] Result: DIVERGED");
+    return passed;
+}
+
+void PhysicsPlayer::WriteDivergenceTable(std::vector<NodeDivergence> const& nodes, std::vector<std::string> const& truck_names)
+{
+    const std::string filename = m_filename + ".divergence.csv";
+    FILE* file = std::fopen(filename.c_str(), "w");
+    if (!file)
+    {
+        this->Report("[RoR|PhysicsPlayer] Cannot write '" + filename + "'");
+        return;
+    }
+    fprintf(file, "truck,node,max_divergence,max_frame,last_divergence\n");
+    for (NodeDivergence const& node : nodes)
+    {
+        fprintf(file, "\"%s\",%d,%g,%d,%g\n", truck_names[node.truck].c_str(), node.node, node.max, node.max_frame, node.last);
+    }
+    std::fclose(file);
+    this->Report("[RoR|PhysicsPlayer] Divergence per node written to '" + filename + "'");
+}
+
+void PhysicsPlayer::Report(std::string const& line)
+{
+    LOG(line);
+    printf("%s\n", line.c_str());
+    fflush(stdout);
+}
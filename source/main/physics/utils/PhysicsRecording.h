@@ -0,0 +1,102 @@
+/*
+    This source file is part of Rigs of Rods
+    Copyright 2013-2017 Petr Ohlidal & contributors
+
+    For more information, see http://www.rigsofrods.org/
+
+    Rigs of Rods is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License version 3, as
+    published by the Free Software Foundation.
+
+    Rigs of Rods is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with Rigs of Rods. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+/// @file
+/// @brief Records the inputs of the physics simulation and replays them; see command line options `-recordphysics` and `-playphysics`.
+
+#pragma once
+
+#include "RoRPrerequisites.h"
+
+#include <cstdio>
+#include <string>
+#include <vector>
+
+namespace RoR {
+
+/// Writes a physics recording: for every simulation run launched by BeamFactory::update(),
+/// the number of steps, the simulation time, and per local truck the state (simulated/sleeping),
+/// the driver controls (commands, steering, brakes, engine and gearbox, aero engines, screwprops),
+/// the engine's anti-lag random state and the node positions the run starts from.
+/// The CmdKeyInertia state is stored once, at the start.
+///
+/// Usage: `RoR -map <terrain> -truck <truck> -recordphysics <file>`; drive, then quit.
+/// The recording ends when a truck is spawned or removed. Remote trucks and their network packets
+/// aren't recorded: they aren't simulated locally and the player can't spawn them.
+class PhysicsRecorder
+{
+public:
+    PhysicsRecorder(std::string const& filename);
+    ~PhysicsRecorder();
+
+    /// Call right before the simulation run is launched; the trucks must be in sync with the simulation.
+    void RecordFrame(BeamFactory& beam_factory, int num_steps);
+
+    bool IsRecording() const { return m_file != nullptr; }
+
+private:
+    bool WriteHeader(BeamFactory& beam_factory);
+    void Stop(std::string const& reason);
+
+    std::string       m_filename;
+    FILE*             m_file;
+    bool              m_header_written;
+    int               m_num_frames;
+    std::vector<int>  m_truck_slots;      //!< Recorded trucks, BeamFactory indices
+    std::vector<int>  m_truck_num_nodes;  //!< Detects respawned trucks
+    std::vector<char> m_frame_buffer;
+};
+
+/// Replays a physics recording without rendering, at the fixed PHYSICS_DT, and compares the node
+/// positions with the recorded ones before each run. Reports the time per physics step and the
+/// position divergence per node; the per-node table goes to `<file>.divergence.csv`.
+///
+/// Usage: `RoR -map <terrain> -truck <truck> -playphysics <file> [-physicstolerance <meters>] [-recordphysics <baseline>]`
+/// The scene must be the one of the recording. With `-recordphysics`, the playback is recorded in turn;
+/// recordings made by the player are fully deterministic, unlike live ones where input handling runs
+/// concurrently with the simulation, so they make the better baseline for validating optimizations.
+/// Tolerance 0 (default) requires bit-identical positions.
+class PhysicsPlayer
+{
+public:
+    PhysicsPlayer(std::string const& filename, float tolerance);
+
+    /// Trucks must be spawned already.
+    /// @param baseline Optional, records the playback
+    /// @return False if the recording couldn't be played or the positions diverged beyond the tolerance
+    bool Run(BeamFactory& beam_factory, PhysicsRecorder* baseline);
+
+private:
+    struct NodeDivergence
+    {
+        int   truck;        //!< Index in the recording
+        int   node;
+        float max;          //!< meters
+        int   max_frame;
+        float last;         //!< at the last recorded frame
+    };
+
+    void Report(std::string const& line);
+    void WriteDivergenceTable(std::vector<NodeDivergence> const& nodes, std::vector<std::string> const& truck_names);
+
+    std::string m_filename;
+    float       m_tolerance;
+};
+
+} // namespace RoR
@@ -39,10 +39,7 @@ class RigLoadingProfiler
         ENTRY_BEAMFACTORY_CREATELOCAL_POSTPROCESS,
         ENTRY_BEAM_CTOR_PREPARE_LOADTRUCK,
         ENTRY_BEAM_LOADTRUCK_OPENFILE,
-        ENTRY_BEAM_LOADTRUCK_PARSER_CREATE,
-        ENTRY_BEAM_LOADTRUCK_PARSER_PREPARE,
-        ENTRY_BEAM_LOADTRUCK_PARSER_RUN,
-        ENTRY_BEAM_LOADTRUCK_PARSER_FINALIZE,
+        ENTRY_BEAM_LOADTRUCK_PARSE,
         ENTRY_BEAM_LOADTRUCK_POST_PARSE,
         ENTRY_BEAM_LOADTRUCK_VALIDATOR_INIT,
         ENTRY_BEAM_LOADTRUCK_VALIDATOR_RUN,
@@ -73,10 +70,7 @@ class RigLoadingProfiler
         
         dst += sprintf(dst, "\n\tBeam::Beam()                 | prepare loading: %f sec", m_entries[ENTRY_BEAM_CTOR_PREPARE_LOADTRUCK]);
         dst += sprintf(dst, "\n\tBeam::LoadTruck()            | open file:       %f sec", m_entries[ENTRY_BEAM_LOADTRUCK_OPENFILE]);
-        dst += sprintf(dst, "\n\tBeam::LoadTruck()            | create parser:   %f sec", m_entries[ENTRY_BEAM_LOADTRUCK_PARSER_CREATE]);
-        dst += sprintf(dst, "\n\tBeam::LoadTruck()            | prepare parser:  %f sec", m_entries[ENTRY_BEAM_LOADTRUCK_PARSER_PREPARE]);
-        dst += sprintf(dst, "\n\tBeam::LoadTruck()            | run parser:      %f sec", m_entries[ENTRY_BEAM_LOADTRUCK_PARSER_RUN]);
-        dst += sprintf(dst, "\n\tBeam::LoadTruck()            | finalize parser: %f sec", m_entries[ENTRY_BEAM_LOADTRUCK_PARSER_FINALIZE]);
+        dst += sprintf(dst, "\n\tBeam::LoadTruck()            | parse/load cache:%f sec", m_entries[ENTRY_BEAM_LOADTRUCK_PARSE]);
         dst += sprintf(dst, "\n\tBeam::LoadTruck()            | post-parse:      %f sec", m_entries[ENTRY_BEAM_LOADTRUCK_POST_PARSE]);
         dst += sprintf(dst, "\n\tBeam::LoadTruck()            | setup validator: %f sec", m_entries[ENTRY_BEAM_LOADTRUCK_VALIDATOR_INIT]);
         dst += sprintf(dst, "\n\tBeam::LoadTruck()            | run validator:   %f sec", m_entries[ENTRY_BEAM_LOADTRUCK_VALIDATOR_RUN]);
@@ -27,20 +27,28 @@
 
 #include <OgreFileSystem.h>
 
+#include <algorithm>
+#include <fstream>
+#include <sys/stat.h>
+#include <thread>
+
 #include "Application.h"
 #include "BeamData.h"
 #include "BeamEngine.h"
 #include "ErrorUtils.h"
 #include "GUIManager.h"
-#include "ImprovedConfigFile.h"
 #include "Language.h"
+#include "MappedFile.h"
+#include "ModCacheFile.h"
 #include "PlatformUtils.h"
+#include "RigDef_BinaryCache.h"
 #include "RigDef_Parser.h"
 #include "Settings.h"
 #include "SHA1.h"
 #include "SoundScriptManager.h"
 #include "TerrainManager.h"
 #include "Terrn2Fileformat.h"
+#include "ThreadPool.h"
 #include "Utils.h"
 
 #include "GUI_LoadingWindow.h"
@@ -48,6 +56,32 @@
 using namespace Ogre;
 using namespace RoR;
 
+static const size_t SCAN_BATCH_SIZE = 256; // Files queued before they're processed in parallel, see CacheSystem::loadSingleZip()
+
+/// Lowercase contents of the archive whose file is being parsed on this thread, see CacheSystem::runScanJob()
+static thread_local const std::set<String>* t_scanned_archive_contents = nullptr;
+
+static bool StatArchive(String const& path, std::time_t& out_filetime, Ogre::uint64& out_filesize)
+{
+    struct stat st;
+    if (stat(path.c_str(), &st) != 0)
+        return false;
+    out_filetime = st.st_mtime;
+    out_filesize = static_cast<Ogre::uint64>(st.st_size);
+    return true;
+}
+
+static String HashArchiveFile(String const& path)
+{
+    char hash[256] = {};
+
+    RoR::CSHA1 sha1;
+    sha1.HashFile(const_cast<char*>(path.c_str()));
+    sha1.Final();
+    sha1.ReportHash(hash, RoR::CSHA1::REPORT_HEX_SHORT);
+    return hash;
+}
+
 // default constructor resets the data.
 CacheEntry::CacheEntry() :
     //authors
@@ -119,6 +153,7 @@ CacheSystem::CacheSystem() :
     , deletedFiles(0)
     , newFiles(0)
     , rgcounter(0)
+    , modcounter(0)
 {
     // register the extensions
     known_extensions.push_back("machine");
@@ -222,6 +257,15 @@ String CacheSystem::getCacheConfigFilename(bool full)
 // we implement this on our own, since we cannot reply on the ogre version
 bool CacheSystem::resourceExistsInAllGroups(Ogre::String filename)
 {
+    // Scan jobs run after their archive was unloaded
+    if (t_scanned_archive_contents)
+    {
+        String lowercase_name = filename;
+        StringUtil::toLowerCase(lowercase_name);
+        if (t_scanned_archive_contents->find(lowercase_name) != t_scanned_archive_contents->end())
+            return true;
+    }
+
     try
     {
         String group = ResourceGroupManager::getSingleton().findGroupContainingResource(filename);
@@ -235,657 +279,66 @@ bool CacheSystem::resourceExistsInAllGroups(Ogre::String filename)
 
 CacheSystem::CacheValidityState CacheSystem::IsCacheValid()
 {
-    String cfgfilename = getCacheConfigFilename(false);
-    ImprovedConfigFile cfg;
-    if (!resourceExistsInAllGroups(cfgfilename))
+    String cfgfilename = getCacheConfigFilename(true);
+    RoR::MappedFile file;
+    if (!file.Open(cfgfilename))
     {
         LOG("unable to load config file: "+cfgfilename);
         return CACHE_NEEDS_UPDATE_FULL;
     }
 
-    String group = ResourceGroupManager::getSingleton().findGroupContainingResource(cfgfilename);
-    DataStreamPtr stream = ResourceGroupManager::getSingleton().openResource(cfgfilename, group);
-    cfg.load(stream, "\t:=", false);
-    String shaone = cfg.GetString("shaone");
-    String cacheformat = cfg.GetString("cacheformat");
-
-    if (shaone == "" || shaone != currentSHA1)
+    String shaone;
+    if (!RoR::ModCacheFile::ReadShaone(file.GetData(), file.GetSize(), shaone))
     {
-        LOG("* mod cache is invalid (not up to date), regenerating new one ...");
+        entries.clear();
+        LOG("* mod cache has invalid format, trying to regenerate");
         return CACHE_NEEDS_UPDATE_INCREMENTAL;
     }
-    if (cacheformat != String(CACHE_FILE_FORMAT))
+    if (shaone == "" || shaone != currentSHA1)
     {
-        entries.clear();
-        LOG("* mod cache has invalid format, trying to regenerate");
+        LOG("* mod cache is invalid (not up to date), regenerating new one ...");
         return CACHE_NEEDS_UPDATE_INCREMENTAL;
     }
     LOG("* mod cache is valid, using it.");
     return CACHE_VALID;
 }
 
-void CacheSystem::logBadTruckAttrib(const String& line, CacheEntry& t)
-{
-    LOG("Bad Mod attribute line: " + line + " in mod " + t.dname);
-}
-
-void CacheSystem::parseModAttribute(const String& line, CacheEntry& t)
-{
-    Ogre::StringVector params = StringUtil::split(line, "\x09\x0a=,");
-    String& attrib = params[0];
-    StringUtil::toLowerCase(attrib);
-    if (attrib == "number")
-    {
-        // Check params
-        if (params.size() != 2)
-        {
-            logBadTruckAttrib(line, t);
-            return;
-        }
-        // Set
-        t.number = StringConverter::parseInt(params[1]);
-    }
-    else if (attrib == "deleted")
-    {
-        // Check params
-        if (params.size() != 2)
-        {
-            logBadTruckAttrib(line, t);
-            return;
-        }
-        // Set
-        t.deleted = StringConverter::parseBool(params[1]);
-    }
-    else if (attrib == "usagecounter")
-    {
-        // Check params
-        if (params.size() != 2)
-        {
-            logBadTruckAttrib(line, t);
-            return;
-        }
-        // Set
-        t.usagecounter = StringConverter::parseInt(params[1]);
-    }
-    else if (attrib == "addtimestamp")
-    {
-        // Check params
-        if (params.size() != 2)
-        {
-            logBadTruckAttrib(line, t);
-            return;
-        }
-        // Set
-        t.addtimestamp = StringConverter::parseInt(params[1]);
-    }
-    else if (attrib == "minitype")
-    {
-        // Check params
-        if (params.size() != 2)
-        {
-            logBadTruckAttrib(line, t);
-            return;
-        }
-        // Set
-        t.minitype = params[1];
-    }
-    else if (attrib == "type")
-    {
-        // Check params
-        if (params.size() != 2)
-        {
-            logBadTruckAttrib(line, t);
-            return;
-        }
-        // Set
-        t.type = params[1];
-    }
-    else if (attrib == "dirname")
-    {
-        // Check params
-        if (params.size() != 2)
-        {
-            logBadTruckAttrib(line, t);
-            return;
-        }
-        // Set
-        t.dirname = params[1];
-    }
-    else if (attrib == "filecachename")
-    {
-        // Check params
-        if (params.size() != 2)
-        {
-            logBadTruckAttrib(line, t);
-            return;
-        }
-        // Set
-        t.filecachename = params[1];
-    }
-    else if (attrib == "fname")
-    {
-        // Check params
-        if (params.size() != 2)
-        {
-            logBadTruckAttrib(line, t);
-            return;
-        }
-        // Set
-        t.fname = params[1];
-    }
-    else if (attrib == "fname_without_uid")
-    {
-        // Check params
-        if (params.size() != 2)
-        {
-            logBadTruckAttrib(line, t);
-            return;
-        }
-        // Set
-        t.fname_without_uid = params[1];
-    }
-    else if (attrib == "fext")
-    {
-        // Check params
-        if (params.size() != 2)
-        {
-            logBadTruckAttrib(line, t);
-            return;
-        }
-        // Set
-        t.fext = params[1];
-    }
-    else if (attrib == "filetime")
-    {
-        // Check params
-        if (params.size() != 2)
-        {
-            logBadTruckAttrib(line, t);
-            return;
-        }
-        // Set
-        t.filetime = Ogre::StringConverter::parseLong(params[1]);
-    }
-    else if (attrib == "dname")
-    {
-        // Check params
-        if (params.size() < 2)
-        {
-            logBadTruckAttrib(line, t);
-            return;
-        }
-        // Set
-        t.dname = params[1];
-    }
-    else if (attrib == "hash")
-    {
-        // Check params
-        if (params.size() != 2)
-        {
-            logBadTruckAttrib(line, t);
-            return;
-        }
-        // Set
-        t.hash = params[1];
-    }
-    else if (attrib == "categoryid")
-    {
-        // Check params
-        if (params.size() != 2)
-        {
-            logBadTruckAttrib(line, t);
-            return;
-        }
-        // Set
-        t.categoryid = StringConverter::parseInt(params[1]);
-        category_usage[t.categoryid] = category_usage[t.categoryid] + 1;
-        if (categories.find(t.categoryid) != categories.end())
-        {
-            t.categoryname = categories[t.categoryid].title;
-        }
-        else
-        {
-            t.categoryid = -1;
-            t.categoryname = "Unsorted";
-        }
-    }
-    else if (attrib == "uniqueid")
-    {
-        // Check params
-        if (params.size() != 2)
-        {
-            logBadTruckAttrib(line, t);
-            return;
-        }
-        // Set
-        t.uniqueid = params[1];
-    }
-    else if (attrib == "guid")
-    {
-        // Check params
-        if (params.size() != 2)
-        {
-            logBadTruckAttrib(line, t);
-            return;
-        }
-        // Set
-        t.guid = params[1];
-        StringUtil::trim(t.guid);
-    }
-    else if (attrib == "version")
-    {
-        // Check params
-        if (params.size() != 2)
-        {
-            logBadTruckAttrib(line, t);
-            return;
-        }
-        // Set
-        t.version = StringConverter::parseInt(params[1]);
-    }
-    else if (attrib == "author")
-    {
-        // Check params
-        if (params.size() < 5)
-        {
-            logBadTruckAttrib(line, t);
-            return;
-        }
-        // Set
-        AuthorInfo ai;
-        ai.id = StringConverter::parseInt(params[2]);
-        ai.type = params[1];
-        ai.name = params[3];
-        ai.email = params[4];
-        t.authors.push_back(ai);
-    }
-    else if (attrib == "sectionconfig")
-    {
-        // Check params
-        if (params.size() < 2)
-        {
-            logBadTruckAttrib(line, t);
-            return;
-        }
-        t.sectionconfigs.push_back(params[1]);
-    }
-
-    // TRUCK detail parameters below
-    else if (attrib == "description")
-        if (params.size() < 2)
-        {
-            logBadTruckAttrib(line, t);
-            return;
-        }
-        else
-            t.description = deNormalizeText(params[1]);
-    else if (attrib == "tags")
-        if (params.size() < 2)
-        {
-            logBadTruckAttrib(line, t);
-            return;
-        }
-        else
-            t.tags = params[1];
-    else if (attrib == "fileformatversion")
-        if (params.size() != 2)
-        {
-            logBadTruckAttrib(line, t);
-            return;
-        }
-        else
-            t.fileformatversion = StringConverter::parseInt(params[1]);
-    else if (attrib == "hasSubmeshs")
-        if (params.size() != 2)
-        {
-            logBadTruckAttrib(line, t);
-            return;
-        }
-        else
-            t.hasSubmeshs = StringConverter::parseBool(params[1]);
-    else if (attrib == "nodecount")
-        if (params.size() != 2)
-        {
-            logBadTruckAttrib(line, t);
-            return;
-        }
-        else
-            t.nodecount = StringConverter::parseInt(params[1]);
-    else if (attrib == "beamcount")
-        if (params.size() != 2)
-        {
-            logBadTruckAttrib(line, t);
-            return;
-        }
-        else
-            t.beamcount = StringConverter::parseInt(params[1]);
-    else if (attrib == "shockcount")
-        if (params.size() != 2)
-        {
-            logBadTruckAttrib(line, t);
-            return;
-        }
-        else
-            t.shockcount = StringConverter::parseInt(params[1]);
-    else if (attrib == "fixescount")
-        if (params.size() != 2)
-        {
-            logBadTruckAttrib(line, t);
-            return;
-        }
-        else
-            t.fixescount = StringConverter::parseInt(params[1]);
-    else if (attrib == "hydroscount")
-        if (params.size() != 2)
-        {
-            logBadTruckAttrib(line, t);
-            return;
-        }
-        else
-            t.hydroscount = StringConverter::parseInt(params[1]);
-    else if (attrib == "wheelcount")
-        if (params.size() != 2)
-        {
-            logBadTruckAttrib(line, t);
-            return;
-        }
-        else
-            t.wheelcount = StringConverter::parseInt(params[1]);
-    else if (attrib == "propwheelcount")
-        if (params.size() != 2)
-        {
-            logBadTruckAttrib(line, t);
-            return;
-        }
-        else
-            t.propwheelcount = StringConverter::parseInt(params[1]);
-    else if (attrib == "commandscount")
-        if (params.size() != 2)
-        {
-            logBadTruckAttrib(line, t);
-            return;
-        }
-        else
-            t.commandscount = StringConverter::parseInt(params[1]);
-    else if (attrib == "flarescount")
-        if (params.size() != 2)
-        {
-            logBadTruckAttrib(line, t);
-            return;
-        }
-        else
-            t.flarescount = StringConverter::parseInt(params[1]);
-    else if (attrib == "propscount")
-        if (params.size() != 2)
-        {
-            logBadTruckAttrib(line, t);
-            return;
-        }
-        else
-            t.propscount = StringConverter::parseInt(params[1]);
-    else if (attrib == "wingscount")
-        if (params.size() != 2)
-        {
-            logBadTruckAttrib(line, t);
-            return;
-        }
-        else
-            t.wingscount = StringConverter::parseInt(params[1]);
-    else if (attrib == "turbopropscount")
-        if (params.size() != 2)
-        {
-            logBadTruckAttrib(line, t);
-            return;
-        }
-        else
-            t.turbopropscount = StringConverter::parseInt(params[1]);
-    else if (attrib == "turbojetcount")
-        if (params.size() != 2)
-        {
-            logBadTruckAttrib(line, t);
-            return;
-        }
-        else
-            t.turbojetcount = StringConverter::parseInt(params[1]);
-    else if (attrib == "rotatorscount")
-        if (params.size() != 2)
-        {
-            logBadTruckAttrib(line, t);
-            return;
-        }
-        else
-            t.rotatorscount = StringConverter::parseInt(params[1]);
-    else if (attrib == "exhaustscount")
-        if (params.size() != 2)
-        {
-            logBadTruckAttrib(line, t);
-            return;
-        }
-        else
-            t.exhaustscount = StringConverter::parseInt(params[1]);
-    else if (attrib == "flexbodiescount")
-        if (params.size() != 2)
-        {
-            logBadTruckAttrib(line, t);
-            return;
-        }
-        else
-            t.flexbodiescount = StringConverter::parseInt(params[1]);
-    else if (attrib == "materialflarebindingscount")
-        if (params.size() != 2)
-        {
-            logBadTruckAttrib(line, t);
-            return;
-        }
-        else
-            t.materialflarebindingscount = StringConverter::parseInt(params[1]);
-    else if (attrib == "soundsourcescount")
-        if (params.size() != 2)
-        {
-            logBadTruckAttrib(line, t);
-            return;
-        }
-        else
-            t.soundsourcescount = StringConverter::parseInt(params[1]);
-    else if (attrib == "managedmaterialscount")
-        if (params.size() != 2)
-        {
-            logBadTruckAttrib(line, t);
-            return;
-        }
-        else
-            t.managedmaterialscount = StringConverter::parseInt(params[1]);
-    else if (attrib == "truckmass")
-        if (params.size() != 2)
-        {
-            logBadTruckAttrib(line, t);
-            return;
-        }
-        else
-            t.truckmass = StringConverter::parseReal(params[1]);
-    else if (attrib == "loadmass")
-        if (params.size() != 2)
-        {
-            logBadTruckAttrib(line, t);
-            return;
-        }
-        else
-            t.loadmass = StringConverter::parseReal(params[1]);
-    else if (attrib == "minrpm")
-        if (params.size() != 2)
-        {
-            logBadTruckAttrib(line, t);
-            return;
-        }
-        else
-            t.minrpm = StringConverter::parseReal(params[1]);
-    else if (attrib == "maxrpm")
-        if (params.size() != 2)
-        {
-            logBadTruckAttrib(line, t);
-            return;
-        }
-        else
-            t.maxrpm = StringConverter::parseReal(params[1]);
-    else if (attrib == "torque")
-        if (params.size() != 2)
-        {
-            logBadTruckAttrib(line, t);
-            return;
-        }
-        else
-            t.torque = StringConverter::parseReal(params[1]);
-    else if (attrib == "customtach")
-        if (params.size() != 2)
-        {
-            logBadTruckAttrib(line, t);
-            return;
-        }
-        else
-            t.customtach = StringConverter::parseBool(params[1]);
-    else if (attrib == "custom_particles")
-        if (params.size() != 2)
-        {
-            logBadTruckAttrib(line, t);
-            return;
-        }
-        else
-            t.custom_particles = StringConverter::parseBool(params[1]);
-    else if (attrib == "forwardcommands")
-        if (params.size() != 2)
-        {
-            logBadTruckAttrib(line, t);
-            return;
-        }
-        else
-            t.forwardcommands = StringConverter::parseBool(params[1]);
-    else if (attrib == "rollon")
-        if (params.size() != 2)
-        {
-            logBadTruckAttrib(line, t);
-            return;
-        }
-        else
-            t.rollon = StringConverter::parseBool(params[1]);
-    else if (attrib == "rescuer")
-        if (params.size() != 2)
-        {
-            logBadTruckAttrib(line, t);
-            return;
-        }
-        else
-            t.rescuer = StringConverter::parseBool(params[1]);
-    else if (attrib == "driveable")
-        if (params.size() != 2)
-        {
-            logBadTruckAttrib(line, t);
-            return;
-        }
-        else
-            t.driveable = StringConverter::parseInt(params[1]);
-    else if (attrib == "numgears")
-        if (params.size() != 2)
-        {
-            logBadTruckAttrib(line, t);
-            return;
-        }
-        else
-            t.numgears = StringConverter::parseInt(params[1]);
-    else if (attrib == "enginetype")
-        if (params.size() != 2)
-        {
-            logBadTruckAttrib(line, t);
-            return;
-        }
-        else
-            t.enginetype = StringConverter::parseInt(params[1]);
-    else if (attrib == "materials")
-    {
-        if (params.size() < 2)
-        {
-            logBadTruckAttrib(line, t);
-            return;
-        }
-        else
-        {
-            String mat = params[1];
-            Ogre::StringVector ar = StringUtil::split(mat, " ");
-            for (Ogre::StringVector::iterator it = ar.begin(); it != ar.end(); it++)
-            {
-                t.materials.insert(*it);
-            }
-        }
-    }
-}
-
 bool CacheSystem::loadCache()
 {
     // Clear existing entries
     entries.clear();
 
-    String cfgfilename = getCacheConfigFilename(false);
-
-    if (!resourceExistsInAllGroups(cfgfilename))
+    String cfgfilename = getCacheConfigFilename(true);
+    RoR::MappedFile file;
+    if (!file.Open(cfgfilename))
     {
         LOG("unable to load config file: "+cfgfilename);
         return false;
     }
 
-    String group = ResourceGroupManager::getSingleton().findGroupContainingResource(String(cfgfilename));
-    DataStreamPtr stream = ResourceGroupManager::getSingleton().openResource(cfgfilename, group);
-
     LOG("CacheSystem::loadCache");
 
-    CacheEntry t;
-    String line = "";
-    int mode = 0;
-
-    while (!stream->eof())
+    if (!RoR::ModCacheFile::Deserialize(file.GetData(), file.GetSize(), entries, category_usage))
     {
-        line = stream->getLine();
-
-        // Ignore blanks & comments
-        if (line.empty() || line.substr(0, 2) == "//")
-        {
-            continue;
-        }
+        LOG("mod cache is outdated or damaged: "+cfgfilename);
+        entries.clear();
+        return false;
+    }
 
-        // Skip these
-        if (StringUtil::startsWith(line, "shaone=") || StringUtil::startsWith(line, "modcount=") || StringUtil::startsWith(line, "cacheformat="))
-        {
-            continue;
-        }
+    for (CacheEntry& entry : entries)
+    {
+        // Numbers are kept across cache writes; new entries get unused ones
+        modcounter = std::max(modcounter, entry.number + 1);
 
-        if (mode == 0)
+        auto found = categories.find(entry.categoryid);
+        if (found != categories.end())
         {
-            // No current entry
-            if (line == "mod")
-            {
-                mode = 1;
-                t = CacheEntry();
-                t.resourceLoaded = false;
-                t.deleted = false;
-                t.changedornew = false; // default upon loading
-                // Skip to and over next {
-                stream->skipLine("{");
-            }
+            entry.categoryname = found->second.title;
         }
-        else if (mode == 1)
+        else
         {
-            // Already in mod
-            if (line == "}")
-            {
-                // Finished
-                if (!t.deleted)
-                {
-                    entries.push_back(t);
-                }
-                mode = 0;
-            }
-            else
-            {
-                parseModAttribute(line, t);
-            }
+            entry.categoryid = -1;
+            entry.categoryname = "Unsorted";
         }
     }
     return true;
@@ -928,6 +381,17 @@ int CacheSystem::incrementalCacheUpdate()
     UTFString tmp = "";
     String fn = "";
     int counter = 0;
+
+    // Hash all archives up front, in parallel; the archive index skips those with unchanged size and filetime
+    std::vector<String> archives;
+    std::set<String> archives_seen;
+    for (std::vector<CacheEntry>::iterator it = entries.begin(); it != entries.end(); it++)
+    {
+        if (it->type == "Zip" && archives_seen.insert(getVirtualPath(it->dirname)).second)
+            archives.push_back(it->dirname);
+    }
+    this->hashArchives(archives);
+
     for (std::vector<CacheEntry>::iterator it = entries.begin(); it != entries.end(); it++ , counter++)
     {
         int progress = ((float)counter / (float)(entries.size())) * 100;
@@ -950,30 +414,15 @@ int CacheSystem::incrementalCacheUpdate()
             deletedFiles++;
             continue;
         }
-        // check whether it changed
+        // check whether it changed; compare contents, so touched or copied archives needn't be reloaded
         if (it->type == "Zip")
         {
-            // check file time, if that fails, fall back to sha1 (needed for platforms where filetime is not yet implemented!
-            bool check = false;
-            std::time_t ft = fileTime(fn);
-            if (!ft)
+            const String virtual_path = getVirtualPath(it->dirname);
+            if (zipHashes[virtual_path] == it->hash)
             {
-                // slow sha1 check
-                char hash[256] = {};
-
-                RoR::CSHA1 sha1;
-                sha1.HashFile(const_cast<char*>(fn.c_str()));
-                sha1.Final();
-                sha1.ReportHash(hash, RoR::CSHA1::REPORT_HEX_SHORT);
-                check = (it->hash != String(hash));
+                it->filetime = archive_index[virtual_path].filetime;
             }
             else
-            {
-                // faster file time check
-                check = (it->filetime != ft);
-            }
-
-            if (check)
             {
                 changedFiles++;
                 LOG("- "+fn+" changed");
@@ -1006,6 +455,7 @@ int CacheSystem::incrementalCacheUpdate()
             reloaded_zips.push_back(it->dirname);
         }
     }
+    this->finishScanJobs();
     LOG("* incremental check (3/5): new content ...");
     loading_win->setProgress(60, _L("incremental check: new content\n"));
     checkForNewContent();
@@ -1120,6 +570,20 @@ void CacheSystem::generateCache(bool forcefull)
 {
     this->modcounter = 0;
 
+    // Archives are hashed and files parsed in parallel; BeamFactory's thread pool doesn't exist yet
+    const int num_threads = static_cast<int>(std::thread::hardware_concurrency()) - 1; // The main thread helps
+    if (RoR::App::GetAppMultithread() && !BSETTING("DisableThreadPool", false) && (num_threads > 0))
+    {
+        // Workers may only read settings; create those they use (see Settings::getBooleanSetting())
+        BSETTING("RigDef Binary Cache", true);
+        BSETTING("RigDef Regex Keywords", false);
+
+        scan_pool = std::unique_ptr<ThreadPool>(new ThreadPool(num_threads));
+        LOG("Cache: scanning with " + TOSTRING(num_threads + 1) + " threads");
+    }
+    zipHashes.clear();
+    this->loadArchiveIndex();
+
     // see if we can avoid a full regeneration
     if (forcefull || incrementalCacheUpdate())
     {
@@ -1127,194 +591,93 @@ void CacheSystem::generateCache(bool forcefull)
 
         writeGeneratedCache();
     }
-}
 
-Ogre::String CacheSystem::formatInnerEntry(int counter, CacheEntry t)
-{
-    String result = "";
-    result += "\tnumber=" + TOSTRING(counter) + "\n"; // always count linear!
-    result += "\tdeleted=" + TOSTRING(t.deleted) + "\n";
-    if (!t.deleted)
-    {
-        // this ensures that we wont break the format with empty ("") values
-        if (t.minitype.empty())
-            t.minitype = "unknown";
-        if (t.type.empty())
-            t.type = "unknown";
-        if (t.dirname.empty())
-            t.dirname = "unknown";
-        if (t.fname.empty())
-            t.fname = "unknown";
-        if (t.fext.empty())
-            t.fext = "unknown";
-        if (t.dname.empty())
-            t.dname = "unknown";
-        if (t.hash.empty())
-            t.hash = "none";
-        if (t.uniqueid.empty())
-            t.uniqueid = "no-uid";
-        if (t.guid.empty())
-            t.guid = "no-guid";
-        if (t.fname_without_uid.empty())
-            t.fname_without_uid = "unknown";
-        if (t.filecachename.empty())
-            t.filecachename = "none";
-
-        result += "\tusagecounter=" + TOSTRING(t.usagecounter) + "\n";
-        result += "\taddtimestamp=" + TOSTRING(t.addtimestamp) + "\n";
-        result += "\tminitype=" + t.minitype + "\n";
-        result += "\ttype=" + t.type + "\n";
-        result += "\tdirname=" + t.dirname + "\n";
-        result += "\tfname=" + t.fname + "\n";
-        result += "\tfname_without_uid=" + t.fname_without_uid + "\n";
-        result += "\tfext=" + t.fext + "\n";
-        result += "\tfiletime=" + TOSTRING((long)t.filetime) + "\n";
-        result += "\tdname=" + t.dname + "\n";
-        result += "\thash=" + t.hash + "\n";
-        result += "\tcategoryid=" + TOSTRING(t.categoryid) + "\n";
-        result += "\tuniqueid=" + t.uniqueid + "\n";
-        result += "\tguid=" + t.guid + "\n";
-        result += "\tversion=" + TOSTRING(t.version) + "\n";
-        result += "\tfilecachename=" + t.filecachename + "\n";
-        //result += "\tnumauthors="+TOSTRING(t.authors.size())+"\n";
-
-        if (t.authors.size() > 0)
-        {
-            for (int i = 0; i < (int)t.authors.size(); i++)
-            {
-                if (t.authors[i].type.empty())
-                    t.authors[i].type = "unknown";
-                if (t.authors[i].name.empty())
-                    t.authors[i].name = "unknown";
-                if (t.authors[i].email.empty())
-                    t.authors[i].email = "unknown";
-                result += "\tauthor=" + (t.authors[i].type) +
-                    "," + TOSTRING(t.authors[i].id) +
-                    "," + (t.authors[i].name) + "," + (t.authors[i].email) + "\n";
-            }
-        }
+    this->saveArchiveIndex();
+    scan_pool.reset();
 
-        // now add the truck details if existing
-        if (t.description != "")
-            result += "\tdescription=" + normalizeText(t.description) + "\n";
-        if (t.tags != "")
-            result += "\ttags=" + t.tags + "\n";
-        if (t.fileformatversion != 0)
-            result += "\tfileformatversion=" + TOSTRING(t.fileformatversion) + "\n";
-        if (t.hasSubmeshs)
-            result += "\thasSubmeshs=1\n";
-        if (t.nodecount != 0)
-            result += "\tnodecount=" + TOSTRING(t.nodecount) + "\n";
-        if (t.beamcount != 0)
-            result += "\tbeamcount=" + TOSTRING(t.beamcount) + "\n";
-        if (t.shockcount != 0)
-            result += "\tshockcount=" + TOSTRING(t.shockcount) + "\n";
-        if (t.fixescount != 0)
-            result += "\tfixescount=" + TOSTRING(t.fixescount) + "\n";
-        if (t.hydroscount != 0)
-            result += "\thydroscount=" + TOSTRING(t.hydroscount) + "\n";
-        if (t.wheelcount != 0)
-            result += "\twheelcount=" + TOSTRING(t.wheelcount) + "\n";
-        if (t.propwheelcount != 0)
-            result += "\tpropwheelcount=" + TOSTRING(t.propwheelcount) + "\n";
-        if (t.commandscount != 0)
-            result += "\tcommandscount=" + TOSTRING(t.commandscount) + "\n";
-        if (t.flarescount != 0)
-            result += "\tflarescount=" + TOSTRING(t.flarescount) + "\n";
-        if (t.propscount != 0)
-            result += "\tpropscount=" + TOSTRING(t.propscount) + "\n";
-        if (t.wingscount != 0)
-            result += "\twingscount=" + TOSTRING(t.wingscount) + "\n";
-        if (t.turbopropscount != 0)
-            result += "\tturbopropscount=" + TOSTRING(t.turbopropscount) + "\n";
-        if (t.turbojetcount != 0)
-            result += "\tturbojetcount=" + TOSTRING(t.turbojetcount) + "\n";
-        if (t.rotatorscount != 0)
-            result += "\trotatorscount=" + TOSTRING(t.rotatorscount) + "\n";
-        if (t.exhaustscount != 0)
-            result += "\texhaustscount=" + TOSTRING(t.exhaustscount) + "\n";
-        if (t.flexbodiescount != 0)
-            result += "\tflexbodiescount=" + TOSTRING(t.flexbodiescount) + "\n";
-        if (t.materialflarebindingscount != 0)
-            result += "\tmaterialflarebindingscount=" + TOSTRING(t.materialflarebindingscount) + "\n";
-        if (t.soundsourcescount != 0)
-            result += "\tsoundsourcescount=" + TOSTRING(t.soundsourcescount) + "\n";
-        if (t.managedmaterialscount != 0)
-            result += "\tmanagedmaterialscount=" + TOSTRING(t.managedmaterialscount) + "\n";
-        if (t.truckmass > 1)
-            result += "\ttruckmass=" + TOSTRING(t.truckmass) + "\n";
-        if (t.loadmass > 1)
-            result += "\tloadmass=" + TOSTRING(t.loadmass) + "\n";
-        if (t.minrpm > 1)
-            result += "\tminrpm=" + TOSTRING(t.minrpm) + "\n";
-        if (t.maxrpm > 1)
-            result += "\tmaxrpm=" + TOSTRING(t.maxrpm) + "\n";
-        if (t.torque > 1)
-            result += "\ttorque=" + TOSTRING(t.torque) + "\n";
-        if (t.customtach)
-            result += "\tcustomtach=1\n";
-        if (t.custom_particles)
-            result += "\tcustom_particles=1\n";
-        if (t.forwardcommands)
-            result += "\tforwardcommands=1\n";
-        if (t.importcommands)
-            result += "\timportcommands=1\n";
-        if (t.rollon)
-            result += "\trollon=1\n";
-        if (t.rescuer)
-            result += "\trescuer=1\n";
-        if (t.driveable != 0)
-            result += "\tdriveable=" + TOSTRING(t.driveable) + "\n";
-        if (t.numgears != 0)
-            result += "\tnumgears=" + TOSTRING(t.numgears) + "\n";
-        if (t.enginetype != 0)
-            result += "\tenginetype=" + TOSTRING(t.enginetype) + "\n";
-        if (t.materials.size())
-        {
-            String matStr = "";
-            for (std::set<Ogre::String>::iterator it = t.materials.begin(); it != t.materials.end(); it++)
-            {
-                matStr += *it + " ";
-            }
-            result += "\tmaterials=" + matStr + "\n";
-        }
+    if (BSETTING("RigDef Binary Cache", true))
+        RigDef::BinaryCache::TrimCacheDir();
+}
 
-        if (t.sectionconfigs.size() > 0)
-        {
-            for (int i = 0; i < (int)t.sectionconfigs.size(); i++)
-                result += "\tsectionconfig=" + t.sectionconfigs[i] + "\n";
-        }
-    }
+void CacheSystem::loadArchiveIndex()
+{
+    archive_index.clear();
 
-    return result;
+    // Line format: <hash> <filetime> <filesize> <virtual path>
+    std::ifstream file(location + ARCHIVE_INDEX_FILE);
+    std::string line;
+    while (std::getline(file, line))
+    {
+        std::istringstream fields(line);
+        ArchiveIndexEntry entry;
+        long long filetime = 0;
+        std::string path;
+        if (!(fields >> entry.hash >> filetime >> entry.filesize) || !std::getline(fields >> std::ws, path) || path.empty())
+            continue;
+        entry.filetime = static_cast<std::time_t>(filetime);
+        archive_index[path] = entry;
+    }
 }
 
-Ogre::String CacheSystem::normalizeText(Ogre::String text)
+void CacheSystem::saveArchiveIndex()
 {
-    String result = "";
-    Ogre::StringVector str = Ogre::StringUtil::split(text, "\n");
-    for (Ogre::StringVector::iterator it = str.begin(); it != str.end(); it++)
-        result += *it + "$";
-    return result;
+    String path = location + ARCHIVE_INDEX_FILE;
+    std::ofstream file(path);
+    if (!file.is_open())
+    {
+        LOG("Cache: unable to write archive index: " + path);
+        return;
+    }
+    for (auto& itor : archive_index)
+    {
+        if (itor.second.seen)
+            file << itor.second.hash << " " << static_cast<long long>(itor.second.filetime) << " " << itor.second.filesize << " " << itor.first << "\n";
+    }
 }
 
-Ogre::String CacheSystem::deNormalizeText(Ogre::String text)
+void CacheSystem::hashArchives(std::vector<String> const& paths)
 {
-    String result = "";
-    Ogre::StringVector str = Ogre::StringUtil::split(text, "$");
-    for (Ogre::StringVector::iterator it = str.begin(); it != str.end(); it++)
-        result += *it + "\n";
-    return result;
+    // Workers only read the index; results are merged on this thread
+    std::vector<ArchiveIndexEntry> results(paths.size());
+    auto hash_archive = [this, &paths, &results](int i)
+    {
+        const String real_path = this->getRealPath(paths[i]);
+        ArchiveIndexEntry& result = results[i];
+        result.seen = StatArchive(real_path, result.filetime, result.filesize);
+        auto found = archive_index.find(this->getVirtualPath(paths[i]));
+        if (result.seen && found != archive_index.end() && found->second.filetime == result.filetime && found->second.filesize == result.filesize)
+            result.hash = found->second.hash;
+        else
+            result.hash = HashArchiveFile(real_path);
+    };
+
+    if (scan_pool)
+    {
+        scan_pool->ParallelFor(0, static_cast<int>(paths.size()), 1, hash_archive);
+    }
+    else
+    {
+        for (int i = 0; i < static_cast<int>(paths.size()); ++i)
+            hash_archive(i);
+    }
+
+    for (size_t i = 0; i < paths.size(); ++i)
+    {
+        const String virtual_path = getVirtualPath(paths[i]);
+        zipHashes[virtual_path] = results[i].hash;
+        if (results[i].seen)
+            archive_index[virtual_path] = results[i];
+    }
 }
 
-Ogre::String CacheSystem::formatEntry(int counter, CacheEntry t)
+Ogre::String CacheSystem::getArchiveHash(String path)
 {
-    String result = "mod\n";
-    result += "{\n";
-    result += formatInnerEntry(counter, t);
-    result += "}\n\n";
+    auto found = zipHashes.find(getVirtualPath(path));
+    if (found != zipHashes.end())
+        return found->second;
 
-    return result;
+    this->hashArchives(std::vector<String>(1, path));
+    return zipHashes[getVirtualPath(path)];
 }
 
 void CacheSystem::writeGeneratedCache()
@@ -1322,35 +685,29 @@ void CacheSystem::writeGeneratedCache()
     String path = getCacheConfigFilename(true);
     LOG("writing cache to file ("+path+")...");
 
-    FILE* f = fopen(path.c_str(), "w");
-    if (!f)
+    std::vector<char> data;
+    RoR::ModCacheFile::Serialize(entries, currentSHA1, data);
+    if (!RoR::ModCacheFile::WriteFile(path, data))
     {
         ErrorUtils::ShowError(_L("Fatal Error: Unable to write cache to disk"), _L("Unable to write file.\nPlease ensure the parent directories exists and that you have write access to this location:\n") + path);
         exit(1337);
     }
-    fprintf(f, "shaone=%s\n", const_cast<char*>(currentSHA1.c_str()));
-    fprintf(f, "modcount=%d\n", (int)entries.size());
-    fprintf(f, "cacheformat=%s\n", CACHE_FILE_FORMAT);
-
-    // mods
-    std::vector<CacheEntry>::iterator it;
-    int counter = 0;
-    for (it = entries.begin(); it != entries.end(); it++)
-    {
-        if (it->deleted)
-            continue;
-        fprintf(f, "%s", formatEntry(counter, *it).c_str());
-        counter++;
-    }
-
-    // close
-    fclose(f);
     LOG("...done!");
 }
 
 void CacheSystem::updateSingleTruckEntryCache(int number, CacheEntry t)
 {
-    // todo: to be implemented
+    CacheEntry* entry = getEntry(number);
+    if (!entry)
+        return;
+    *entry = t;
+
+    // Only the entry's record is rewritten
+    if (!RoR::ModCacheFile::UpdateEntry(getCacheConfigFilename(true), *entry))
+    {
+        LOG("unable to update mod " + TOSTRING(number) + " in cache file, rewriting it");
+        writeGeneratedCache();
+    }
 }
 
 char* CacheSystem::replacesSpaces(char* str)
@@ -1401,7 +758,7 @@ Ogre::String CacheSystem::getUIDfromString(Ogre::String uidstr)
     return "";
 }
 
-void CacheSystem::addFile(Ogre::FileInfo f, String ext)
+void CacheSystem::addFile(Ogre::FileInfo f, String ext, String group)
 {
     String archiveType = "FileSystem";
     String archiveDirectory = "";
@@ -1411,35 +768,25 @@ void CacheSystem::addFile(Ogre::FileInfo f, String ext)
         archiveDirectory = f.archive->getName();
     }
 
-    addFile(f.filename, archiveType, archiveDirectory, ext);
+    addFile(f.filename, archiveType, archiveDirectory, ext, group);
 }
 
-void CacheSystem::addFile(String filename, String archiveType, String archiveDirectory, String ext)
+void CacheSystem::addFile(String filename, String archiveType, String archiveDirectory, String ext, String group)
 {
     LOG("Preparing to add " + filename);
 
-    //read first line
     CacheEntry entry;
-    if (!resourceExistsInAllGroups(filename))
-        return;
-
-    String group = ResourceGroupManager::getSingleton().findGroupContainingResource(filename);
     if (ResourceGroupManager::getSingleton().resourceExists(group, filename))
     {
         try
         {
-            //LOG("Read to add "+String(entry.dname)+" filename "+String(filename));
+            // Read everything while the archive is loaded; parsing is left to runScanJob()
             DataStreamPtr ds = ResourceGroupManager::getSingleton().openResource(filename, group);
-
-            if (ext == "terrn2")
-            {
-                fillTerrainDetailInfo(entry, ds, filename);
-            }
-            else
-            {
-                entry.dname = ds->getLine();
-                fillTruckDetailInfo(entry, ds, filename);
-            }
+            ScanJob job;
+            job.filename = filename;
+            job.ext = ext;
+            job.stream = DataStreamPtr(OGRE_NEW MemoryDataStream(filename, ds));
+            job.archive_contents = scan_archive_contents;
 
             // ds closes automatically, so do _not_ close it explicitly below
             entry.fname = filename;
@@ -1455,17 +802,19 @@ void CacheSystem::addFile(String filename, String archiveType, String archiveDir
             String basen;
             String fnextension;
             StringUtil::splitBaseFilename(entry.fname, basen, fnextension);
-            entry.minitype = detectFilesMiniType(basen + "-mini");
+            entry.minitype = detectFilesMiniType(basen + "-mini", group);
             entry.hash = "none";
             entry.changedornew = true;
-            generateFileCache(entry);
+            generateFileCache(entry, group, job);
             if (archiveType == "Zip")
                 entry.hash = zipHashes[getVirtualPath(archiveDirectory)];
             if (entry.hash == "")
             // fallback if no hash was found
                 entry.hash = "none";
-            // read in author and category
+            // author, category etc. are filled in by the job
+            job.entry_index = entries.size();
             entries.push_back(entry);
+            scan_jobs.push_back(job);
         }
         catch (Ogre::Exception& e)
         {
@@ -1482,55 +831,106 @@ void CacheSystem::addFile(String filename, String archiveType, String archiveDir
             }
         }
     }
+
+    // Without the thread pool, files are processed right away
+    if (!scan_pool)
+        this->finishScanJobs();
 }
 
-void CacheSystem::fillTruckDetailInfo(CacheEntry& entry, Ogre::DataStreamPtr stream, Ogre::String file_name)
+void CacheSystem::runScanJob(ScanJob& job)
 {
-    /* LOAD AND PARSE THE VEHICLE */
-    RigDef::Parser parser;
-    parser.Prepare();
-    parser.ProcessOgreStream(stream.getPointer());
-    parser.Finalize();
+    // `entries` doesn't grow while jobs run
+    CacheEntry& entry = entries[job.entry_index];
 
-    /* Report messages */
-    if (parser.GetMessages().size() > 0)
+    t_scanned_archive_contents = job.archive_contents.get();
+    try
     {
-        std::stringstream report;
-        report << "Cache: Parsing vehicle '" << file_name << "' yielded following messages:" << std::endl << std::endl;
+        if (job.ext == "terrn2")
+        {
+            fillTerrainDetailInfo(entry, job.stream, job.filename);
+        }
+        else
+        {
+            entry.dname = job.stream->getLine();
+            fillTruckDetailInfo(entry, job.stream, job.filename, job.messages);
+        }
+    }
+    catch (Ogre::Exception& e)
+    {
+        job.messages += "error while opening resource: " + e.getFullDescription() + "\n";
+        job.messages += "error opening file '" + job.filename + "'. Is it corrupt? trying to continue ...";
+        entry.deleted = true;
+    }
+    catch (std::exception& e)
+    {
+        job.messages += "error while parsing '" + job.filename + "': " + e.what() + "; trying to continue ...";
+        entry.deleted = true;
+    }
+    t_scanned_archive_contents = nullptr;
+    job.stream = DataStreamPtr();
 
-        std::list<RigDef::Parser::Message>::const_iterator iter = parser.GetMessages().begin();
-        for (; iter != parser.GetMessages().end(); iter++)
+    // Extract the preview image
+    if (!job.mini.empty())
+    {
+        FILE* f = fopen(job.mini_dst.c_str(), "wb");
+        bool written = false;
+        if (f)
         {
-            switch (iter->type)
-            {
-            case (RigDef::Parser::Message::TYPE_FATAL_ERROR):
-                report << "FATAL_ERROR";
-                break;
+            written = (fwrite(&job.mini[0], 1, job.mini.size(), f) == job.mini.size());
+            written = (fclose(f) == 0) && written;
+        }
+        if (!written)
+        {
+            remove(job.mini_dst.c_str());
+            job.messages += "\nerror writing file cache: " + job.mini_dst;
+        }
+        std::vector<char>().swap(job.mini);
+    }
+}
 
-            case (RigDef::Parser::Message::TYPE_ERROR):
-                report << "ERROR";
-                break;
+void CacheSystem::finishScanJobs()
+{
+    if (scan_jobs.empty())
+        return;
 
-            case (RigDef::Parser::Message::TYPE_WARNING):
-                report << "WARNING";
-                break;
+    // The main thread waits for the jobs (and helps), so the workers can read the resource system safely
+    if (scan_pool)
+    {
+        scan_pool->ParallelFor(0, static_cast<int>(scan_jobs.size()), 1, [this](int i) { this->runScanJob(scan_jobs[i]); });
+    }
+    else
+    {
+        for (ScanJob& job : scan_jobs)
+            this->runScanJob(job);
+    }
 
-            default:
-                report << "INFO";
-                break;
-            }
-            report << " (Section " << RigDef::File::SectionToString(iter->section) << ")" << std::endl;
-            report << "\tLine (# " << iter->line_number << "): " << iter->line << std::endl;
-            report << "\tMessage: " << iter->message << std::endl;
-        }
+    for (ScanJob& job : scan_jobs)
+    {
+        if (!job.messages.empty())
+            LOG(job.messages);
+    }
+    scan_jobs.clear();
+}
+
+void CacheSystem::fillTruckDetailInfo(CacheEntry& entry, Ogre::DataStreamPtr stream, Ogre::String file_name, Ogre::String& out_messages)
+{
+    /* LOAD AND PARSE THE VEHICLE */
+    // The whole file is parsed (the stream is rewound), so the result is shared with Beam::LoadTruck() via RigDef::BinaryCache
+    RigDef::ParseReport parse_report;
+    std::shared_ptr<RigDef::File> def = RigDef::BinaryCache::LoadOrParse(stream, parse_report);
+
+    /* Report messages */
+    if (parse_report.num_errors + parse_report.num_warnings + parse_report.num_other > 0)
+    {
+        std::stringstream report;
+        report << "Cache: Parsing vehicle '" << file_name << "' yielded following messages:" << std::endl << std::endl;
+        report << parse_report.text;
 
-        Ogre::LogManager::getSingleton().logMessage(report.str());
+        out_messages += report.str(); // May run on a worker thread, see runScanJob()
     }
 
     /* RETRIEVE DATA */
 
-    std::shared_ptr<RigDef::File> def = parser.GetFile();
-
     /* Description */
     std::vector<Ogre::String>::iterator desc_itor = def->description.begin();
     for (; desc_itor != def->description.end(); desc_itor++)
@@ -1712,15 +1112,16 @@ void CacheSystem::deleteFileCache(char* filename)
     }
 }
 
-Ogre::String CacheSystem::detectFilesMiniType(String filename)
+Ogre::String CacheSystem::detectFilesMiniType(String filename, String group)
 {
-    if (resourceExistsInAllGroups(filename + ".dds"))
+    ResourceGroupManager& rgm = ResourceGroupManager::getSingleton();
+    if (rgm.resourceExists(group, filename + ".dds"))
         return "dds";
 
-    if (resourceExistsInAllGroups(filename + ".png"))
+    if (rgm.resourceExists(group, filename + ".png"))
         return "png";
 
-    if (resourceExistsInAllGroups(filename + ".jpg"))
+    if (rgm.resourceExists(group, filename + ".jpg"))
         return "jpg";
 
     return "none";
@@ -1735,13 +1136,10 @@ void CacheSystem::removeFileFromFileCache(std::vector<CacheEntry>::iterator iter
     }
 }
 
-void CacheSystem::generateFileCache(CacheEntry& entry, Ogre::String directory)
+void CacheSystem::generateFileCache(CacheEntry& entry, Ogre::String group, ScanJob& job)
 {
     try
     {
-        if (directory.empty() && !entry.changedornew)
-            return;
-
         if (entry.fname == "")
             return;
 
@@ -1756,11 +1154,6 @@ void CacheSystem::generateFileCache(CacheEntry& entry, Ogre::String directory)
         String outPath = "";
         StringUtil::splitFilename(entry.dirname, outBasename, outPath);
 
-        if (directory.empty())
-            directory = location;
-
-        String dst = directory + outBasename + "_" + entry.fname + ".mini." + entry.minitype;
-
         // no path info in the cache file name ...
         entry.filecachename = outBasename + "_" + entry.fname + ".mini." + entry.minitype;
 
@@ -1768,67 +1161,22 @@ void CacheSystem::generateFileCache(CacheEntry& entry, Ogre::String directory)
         StringUtil::splitBaseFilename(entry.fname, fbase, fext);
         String minifn = fbase + "-mini." + entry.minitype;
 
-        String group = "";
-        bool exists = ResourceGroupManager::getSingleton().resourceExistsInAnyGroup(minifn);
-        if (!exists)
+        if (!ResourceGroupManager::getSingleton().resourceExists(group, minifn))
         {
-            String base, ext;
-            StringUtil::splitBaseFilename(entry.fname, base, ext);
-            entry.minitype = detectFilesMiniType(base + "-mini");
-            exists = ResourceGroupManager::getSingleton().resourceExistsInAnyGroup(minifn);
-            if (!exists)
-            {
-                // no minipic found
-                entry.filecachename = "none";
-                return;
-            }
-            else
-            {
-                group = ResourceGroupManager::getSingleton().findGroupContainingResource(minifn);
-            }
-        }
-        else
-        {
-            group = ResourceGroupManager::getSingleton().findGroupContainingResource(minifn);
-        }
-
-        FileInfoListPtr files = ResourceGroupManager::getSingleton().findResourceFileInfo(group, minifn);
-        if (files->empty())
-        {
-            deleteFileCache(const_cast<char*>(dst.c_str()));
-        }
-
-        size_t fsize = 0;
-        char* buffer = 0;
-        {
-            DataStreamPtr ds = ResourceGroupManager::getSingleton().openResource(minifn, group);
-            fsize = ds->size();
-            buffer = (char*)malloc(fsize);
-            memset(buffer, 0, fsize);
-            size_t read = ds->read(buffer, fsize);
-            if (read != fsize)
-            {
-                free(buffer);
-                return;
-            }
+            // no minipic found
+            entry.filecachename = "none";
+            return;
         }
 
-        bool written = false;
-        if (buffer)
+        // The file is written by runScanJob()
+        DataStreamPtr ds = ResourceGroupManager::getSingleton().openResource(minifn, group);
+        job.mini.resize(ds->size());
+        if (job.mini.empty() || ds->read(&job.mini[0], job.mini.size()) != job.mini.size())
         {
-            FILE* f = fopen(dst.c_str(), "wb");
-            if (f)
-            {
-                fwrite(buffer, 1, fsize, f);
-                fclose(f);
-                written = true;
-            }
-            free(buffer);
-        }
-        if (!written)
-        {
-            deleteFileCache(const_cast<char*>(dst.c_str()));
+            job.mini.clear();
+            return;
         }
+        job.mini_dst = location + entry.filecachename;
     }
     catch (Ogre::Exception& e)
     {
@@ -1875,7 +1223,7 @@ void CacheSystem::parseKnownFilesOneRGDirectory(Ogre::String rg, Ogre::String di
             String dira = getVirtualPath(iterFiles->archive->getName());
 
             if (dira == dirb)
-                addFile(*iterFiles, *it);
+                addFile(*iterFiles, *it, rg);
         }
     }
 }
@@ -1885,7 +1233,7 @@ void CacheSystem::parseFilesOneRG(Ogre::String ext, Ogre::String rg)
     FileInfoListPtr files = ResourceGroupManager::getSingleton().findResourceFileInfo(rg, "*." + ext);
     for (FileInfoList::iterator iterFiles = files->begin(); iterFiles != files->end(); ++iterFiles)
     {
-        addFile(*iterFiles, ext);
+        addFile(*iterFiles, ext, rg);
     }
 }
 
@@ -1938,6 +1286,7 @@ void CacheSystem::checkForNewKnownFiles()
 {
     for (std::vector<Ogre::String>::iterator it = known_extensions.begin(); it != known_extensions.end(); ++it)
         checkForNewFiles(*it);
+    this->finishScanJobs();
 }
 
 void CacheSystem::checkForNewFiles(Ogre::String ext)
@@ -1959,7 +1308,7 @@ void CacheSystem::checkForNewFiles(Ogre::String ext)
                 else
                 LOG("- " + fn + " is new");
                 newFiles++;
-                addFile(*iterFiles, ext);
+                addFile(*iterFiles, ext, *it);
             }
         }
     }
@@ -2268,20 +1617,14 @@ void CacheSystem::loadSingleZip(String zippath, int cfactor, bool unload, bool o
 #endif
 
     String realzipPath = getRealPath(zippath);
-    char hash[256] = {};
-
-    RoR::CSHA1 sha1;
-    sha1.HashFile(const_cast<char*>(realzipPath.c_str()));
-    sha1.Final();
-    sha1.ReportHash(hash, RoR::CSHA1::REPORT_HEX_SHORT);
-    zipHashes[getVirtualPath(zippath)] = hash;
+    String hash = this->getArchiveHash(zippath); // Usually hashed ahead, in parallel
 
     String compr = "";
     if (cfactor > 99)
         compr = "(No Compression)";
     else if (cfactor > 0)
         compr = "(Compression: " + TOSTRING(cfactor) + ")";
-    LOG("Adding archive " + realzipPath + " (hash: "+String(hash)+") " + compr);
+    LOG("Adding archive " + realzipPath + " (hash: "+hash+") " + compr);
 
     rgcounter++;
     String rgname = "General-" + TOSTRING(rgcounter);
@@ -2301,8 +1644,22 @@ void CacheSystem::loadSingleZip(String zippath, int cfactor, bool unload, bool o
         rgm.addResourceLocation(realzipPath, "Zip", rgname);
         rgm.initialiseResourceGroup(rgname);
 
+        // Scan jobs may run after the archive is unloaded, see resourceExistsInAllGroups()
+        if (unload)
+        {
+            std::shared_ptr<std::set<String>> contents = std::make_shared<std::set<String>>();
+            StringVectorPtr names = rgm.listResourceNames(rgname);
+            for (String name : *names)
+            {
+                StringUtil::toLowerCase(name);
+                contents->insert(name);
+            }
+            scan_archive_contents = contents;
+        }
+
         // parse everything
         parseKnownFilesOneRG(rgname);
+        scan_archive_contents.reset();
 
         // unload it again
         if (unload)
@@ -2332,6 +1689,11 @@ void CacheSystem::loadSingleZip(String zippath, int cfactor, bool unload, bool o
             LOG("trying to continue ...");
         }
     }
+    scan_archive_contents.reset();
+
+    // Only between archives, so the jobs see no other archive than their own
+    if (scan_jobs.size() >= SCAN_BATCH_SIZE)
+        this->finishScanJobs();
 }
 
 void CacheSystem::loadAllZipsInResourceGroup(String group)
@@ -2339,6 +1701,15 @@ void CacheSystem::loadAllZipsInResourceGroup(String group)
     std::map<String, bool> loadedZips;
     ResourceGroupManager& rgm = ResourceGroupManager::getSingleton();
     FileInfoListPtr files = rgm.findResourceFileInfo(group, "*.zip");
+
+    // Hash all archives in parallel first, see loadSingleZip()
+    std::vector<String> zippaths;
+    for (FileInfoList::iterator itor = files->begin(); itor != files->end(); ++itor)
+    {
+        zippaths.push_back(itor->archive->getName() + "/" + itor->filename);
+    }
+    this->hashArchives(zippaths);
+
     FileInfoList::iterator iterFiles = files->begin();
     size_t i = 0, filecount = files->size();
     for (; iterFiles != files->end(); ++iterFiles , i++)
@@ -2358,6 +1729,7 @@ void CacheSystem::loadAllZipsInResourceGroup(String group)
         loadSingleZip((Ogre::FileInfo)*iterFiles);
         loadedZips[iterFiles->filename] = true;
     }
+    this->finishScanJobs();
     // hide loader again
     RoR::App::GetGuiManager()->SetVisible_LoadingWindow(false);
 }
@@ -2376,6 +1748,7 @@ void CacheSystem::loadAllDirectoriesInResourceGroup(String group)
         RoR::App::GetGuiManager()->GetLoadingWindow()->setProgress(progress, _L("Loading directory\n") + listitem->filename);
         loadSingleDirectory(dirname, group, true);
     }
+    this->finishScanJobs();
     // hide loader again
     RoR::App::GetGuiManager()->SetVisible_LoadingWindow(false);
 }
@@ -2399,6 +1772,17 @@ void CacheSystem::loadAllZips()
 void CacheSystem::checkForNewZipsInResourceGroup(String group)
 {
     FileInfoListPtr files = ResourceGroupManager::getSingleton().findResourceFileInfo(group, "*.zip");
+
+    // Hash the new archives in parallel first, see loadSingleZip()
+    std::vector<String> zippaths;
+    for (FileInfoList::iterator itor = files->begin(); itor != files->end(); ++itor)
+    {
+        String zippath = itor->archive->getName() + "/" + itor->filename;
+        if (!isZipUsedInEntries(zippath))
+            zippaths.push_back(zippath);
+    }
+    this->hashArchives(zippaths);
+
     FileInfoList::iterator iterFiles = files->begin();
     size_t i = 0, filecount = files->size();
     for (; iterFiles != files->end(); ++iterFiles , i++)
@@ -2426,6 +1810,7 @@ void CacheSystem::checkForNewZipsInResourceGroup(String group)
             loadSingleZip((Ogre::FileInfo)*iterFiles);
         }
     }
+    this->finishScanJobs();
     RoR::App::GetGuiManager()->SetVisible_LoadingWindow(false);
 }
 
@@ -2447,6 +1832,7 @@ void CacheSystem::checkForNewDirectoriesInResourceGroup(String group)
             loadSingleDirectory(dirname, group, true);
         }
     }
+    this->finishScanJobs();
     RoR::App::GetGuiManager()->SetVisible_LoadingWindow(false);
 }
 
@@ -30,8 +30,10 @@
 
 #include <Ogre.h>
 
-#define CACHE_FILE "mods.cache"
-#define CACHE_FILE_FORMAT "6"
+#include <memory>
+
+#define CACHE_FILE "mods.cache" // see RoR::ModCacheFile
+#define ARCHIVE_INDEX_FILE "archives.index"
 
 // 60*60*24 = one day
 #define CACHE_FILE_FRESHNESS 86400
@@ -129,6 +131,8 @@ public:
 
 };
 
+class ThreadPool;
+
 class CacheSystem : public ZeroedMemoryAllocator
 {
 public:
@@ -171,6 +175,7 @@ public:
 
     int getCategoryUsage(int category);
     CacheEntry *getEntry(int modid);
+    void updateSingleTruckEntryCache(int number, CacheEntry t); // saves changes of a loaded entry, i.e. the usage counter
 
     int getTimeStamp();
 
@@ -190,6 +195,30 @@ public:
 
 protected:
 
+    /// Work of addFile() which doesn't need the resource system; runs on the thread pool during cache generation.
+    struct ScanJob
+    {
+        size_t              entry_index;  //!< position in `entries`, which doesn't grow while jobs run
+        Ogre::String        filename;
+        Ogre::String        ext;
+        Ogre::DataStreamPtr stream;       //!< file contents, read on the main thread
+        std::vector<char>   mini;         //!< preview image, read on the main thread
+        Ogre::String        mini_dst;     //!< where to extract the preview image
+        Ogre::String        messages;     //!< logged on the main thread
+        std::shared_ptr<const std::set<Ogre::String>> archive_contents; //!< lowercase; the archive may be unloaded when the job runs
+    };
+
+    /// Per-archive content hash, so unchanged archives are neither hashed nor re-parsed again.
+    struct ArchiveIndexEntry
+    {
+        ArchiveIndexEntry(): filetime(0), filesize(0), seen(false) {}
+
+        Ogre::String hash;                //!< SHA1 of the archive file
+        std::time_t  filetime;
+        Ogre::uint64 filesize;
+        bool         seen;                //!< checked during this run; unseen archives are dropped from the index
+    };
+
     // ================================================================================
     // Functions
     // ================================================================================
@@ -205,21 +234,31 @@ protected:
 
     void checkForNewKnownFiles();
 
-    void addFile(Ogre::FileInfo f, Ogre::String ext);	// adds a file to entries
-    void addFile(Ogre::String filename, Ogre::String archiveType, Ogre::String archiveDirectory, Ogre::String ext);
+    void addFile(Ogre::FileInfo f, Ogre::String ext, Ogre::String group);	// adds a file to entries
+    void addFile(Ogre::String filename, Ogre::String archiveType, Ogre::String archiveDirectory, Ogre::String ext, Ogre::String group);
 
     // reads all advanced information out of the entry's file
     void fillTerrainDetailInfo(CacheEntry &entry, Ogre::DataStreamPtr ds, Ogre::String fname);
-    void fillTruckDetailInfo(CacheEntry &entry, Ogre::DataStreamPtr ds, Ogre::String fname);
+    void fillTruckDetailInfo(CacheEntry &entry, Ogre::DataStreamPtr ds, Ogre::String fname, Ogre::String &out_messages);
+
+    // parallel scan, see generateCache()
+    void runScanJob(ScanJob &job);            // parses the file and extracts the preview image; thread-safe
+    void finishScanJobs();                    // runs queued jobs and completes their entries
+
+    // archive index, see ArchiveIndexEntry
+    void loadArchiveIndex();
+    void saveArchiveIndex();
+    void hashArchives(std::vector<Ogre::String> const &paths); // fills zipHashes; uses the thread pool if available
+    Ogre::String getArchiveHash(Ogre::String path);
 
     /// Checks if update is needed
     CacheValidityState IsCacheValid();
     Ogre::String filenamesSHA1();             // generates the hash over the whole content
-    bool loadCache();                         // loads cache config file, new format
+    bool loadCache();                         // loads the cache file, see RoR::ModCacheFile
     Ogre::String getCacheConfigFilename(bool full); // returns filename of the cache file
     int incrementalCacheUpdate();             // tries to update parts of the Cache only
 
-    void generateFileCache(CacheEntry &entry, Ogre::String directory=Ogre::String());	// generates a new cache
+    void generateFileCache(CacheEntry &entry, Ogre::String group, ScanJob &job); // reads the preview image for runScanJob()
     void deleteFileCache(char *filename); // removed files from cache
     void writeGeneratedCache();
     
@@ -227,14 +266,9 @@ protected:
     void loadSingleZip(Ogre::FileInfo f, bool unload=true, bool ownGroup=true);
     void loadSingleZip(CacheEntry e, bool unload=true, bool ownGroup=true);
 
-    Ogre::String detectFilesMiniType(Ogre::String filename);
+    Ogre::String detectFilesMiniType(Ogre::String filename, Ogre::String group);
     void removeFileFromFileCache(std::vector<CacheEntry>::iterator it);
     void generateCache(bool forcefull=false);
-    Ogre::String formatEntry(int counter, CacheEntry t);
-    Ogre::String formatInnerEntry(int counter, CacheEntry t);
-    void updateSingleTruckEntryCache(int number, CacheEntry t);
-    void parseModAttribute(const Ogre::String& line, CacheEntry& t);
-    void logBadTruckAttrib(const Ogre::String& line, CacheEntry& t);
 
     void readCategoryTitles();
 
@@ -247,9 +281,6 @@ protected:
     Ogre::String getRealPath(Ogre::String path);
     Ogre::String getVirtualPath(Ogre::String path);
 
-    Ogre::String normalizeText(Ogre::String text);
-    Ogre::String deNormalizeText(Ogre::String text);
-    
     void checkForNewFiles(Ogre::String ext);
 
     void checkForNewContent();
@@ -281,6 +312,11 @@ protected:
     std::vector<CacheEntry> entries; //!< this holds all files
 
     std::map<Ogre::String, Ogre::String> zipHashes;
+    std::map<Ogre::String, ArchiveIndexEntry> archive_index; //!< key: virtual path of the archive
+
+    std::unique_ptr<ThreadPool> scan_pool;   //!< only exists during cache generation
+    std::vector<ScanJob> scan_jobs;          //!< queued by addFile()
+    std::shared_ptr<const std::set<Ogre::String>> scan_archive_contents; //!< archive being scanned by loadSingleZip()
 
     // categories
     std::map<int, Category_Entry> categories;
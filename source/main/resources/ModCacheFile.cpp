@@ -0,0 +1,650 @@
+/*
+    This source file is part of Rigs of Rods
+    Copyright 2013-2017 Petr Ohlidal & contributors
+
+    For more information, see http://www.rigsofrods.org/
+
+    Rigs of Rods is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License version 3, as
+    published by the Free Software Foundation.
+
+    Rigs of Rods is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with Rigs of Rods. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "ModCacheFile.h"
+
+#include "CacheSystem.h"
+#include "MappedFile.h"
+
+#include <algorithm>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <unordered_map>
+
+using namespace RoR;
+
+namespace {
+
+const char CACHE_MAGIC[8] = {'R','o','R','M','O','D','S','\0'};
+
+struct CacheHeader
+{
+    char     magic[8];
+    uint32_t file_format_version;
+    uint32_t record_size;          ///< Rejects files written by a build with a different EntryRecord
+    char     shaone[40];           ///< CacheSystem::filenamesSHA1(), hex
+    uint32_t num_entries;
+    uint32_t entries_offset;
+    uint32_t num_authors;
+    uint32_t authors_offset;
+    uint32_t num_list_items;
+    uint32_t list_items_offset;
+    uint32_t num_categories;
+    uint32_t categories_offset;
+    uint32_t strings_offset;
+    uint32_t strings_size;
+};
+
+/// Position in the authors or list items section
+struct ListRef
+{
+    uint32_t first;
+    uint32_t count;
+};
+
+enum EntryFlags
+{
+    FLAG_HAS_SUBMESHS      = 1 << 0,
+    FLAG_CUSTOM_TACH       = 1 << 1,
+    FLAG_CUSTOM_PARTICLES  = 1 << 2,
+    FLAG_FORWARD_COMMANDS  = 1 << 3,
+    FLAG_IMPORT_COMMANDS   = 1 << 4,
+    FLAG_ROLLON            = 1 << 5,
+    FLAG_RESCUER           = 1 << 6,
+};
+
+/// CacheEntry without the runtime state. Strings are offsets into the string table, 0 is the empty string.
+/// Records are grouped by category.
+struct EntryRecord
+{
+    int64_t  filetime;
+    int32_t  number;               ///< CacheEntry::number, independent of the record's index
+
+    uint32_t minitype;
+    uint32_t fname;
+    uint32_t fname_without_uid;
+    uint32_t dname;
+    uint32_t uniqueid;
+    uint32_t guid;
+    uint32_t fext;
+    uint32_t type;
+    uint32_t dirname;
+    uint32_t hash;
+    uint32_t filecachename;
+    uint32_t description;
+    uint32_t tags;
+
+    int32_t  categoryid;
+    int32_t  addtimestamp;
+    int32_t  version;
+    int32_t  usagecounter;
+    int32_t  fileformatversion;
+
+    int32_t  nodecount;
+    int32_t  beamcount;
+    int32_t  shockcount;
+    int32_t  fixescount;
+    int32_t  hydroscount;
+    int32_t  wheelcount;
+    int32_t  propwheelcount;
+    int32_t  commandscount;
+    int32_t  flarescount;
+    int32_t  propscount;
+    int32_t  wingscount;
+    int32_t  turbopropscount;
+    int32_t  turbojetcount;
+    int32_t  rotatorscount;
+    int32_t  exhaustscount;
+    int32_t  flexbodiescount;
+    int32_t  materialflarebindingscount;
+    int32_t  soundsourcescount;
+    int32_t  managedmaterialscount;
+
+    float    truckmass;
+    float    loadmass;
+    float    minrpm;
+    float    maxrpm;
+    float    torque;
+
+    int32_t  driveable;
+    int32_t  numgears;
+    int32_t  enginetype;
+    uint32_t flags;                ///< EntryFlags
+
+    ListRef  authors;
+    ListRef  sectionconfigs;       ///< list items
+    ListRef  materials;            ///< list items
+};
+
+struct AuthorRecord
+{
+    int32_t  id;
+    uint32_t type;
+    uint32_t name;
+    uint32_t email;
+};
+
+/// Entries with this category are records [first, first + count)
+struct CategoryRecord
+{
+    int32_t  categoryid;
+    uint32_t first;
+    uint32_t count;
+};
+
+class StringTable
+{
+public:
+    /// @param base_offset Size of the existing table this one is appended to; 0 starts a new table.
+    explicit StringTable(uint32_t base_offset = 0):
+        m_base_offset(base_offset)
+    {
+        if (base_offset == 0)
+            m_data.push_back('\0');
+    }
+
+    uint32_t Add(std::string const& str)
+    {
+        if (str.empty())
+            return 0;
+        auto found = m_offsets.find(str);
+        if (found != m_offsets.end())
+            return found->second;
+        const uint32_t offset = m_base_offset + static_cast<uint32_t>(m_data.size());
+        m_data.insert(m_data.end(), str.c_str(), str.c_str() + strlen(str.c_str()) + 1);
+        m_offsets.insert(std::make_pair(str, offset));
+        return offset;
+    }
+
+    std::vector<char> const& GetData() const { return m_data; }
+
+private:
+    uint32_t                                  m_base_offset;
+    std::vector<char>                         m_data;
+    std::unordered_map<std::string, uint32_t> m_offsets;
+};
+
+// Same placeholders as the former text format, which couldn't store empty values; code checks for them.
+std::string OrPlaceholder(std::string const& str, const char* placeholder)
+{
+    return (str.empty()) ? std::string(placeholder) : str;
+}
+
+/// Fills everything but the list refs
+template<typename F> void FillRecord(EntryRecord& record, CacheEntry const& entry, F add_string)
+{
+    memset(&record, 0, sizeof(record));
+    record.filetime                   = static_cast<int64_t>(entry.filetime);
+    record.number                     = entry.number;
+
+    record.minitype                   = add_string(OrPlaceholder(entry.minitype, "unknown"));
+    record.fname                      = add_string(OrPlaceholder(entry.fname, "unknown"));
+    record.fname_without_uid          = add_string(OrPlaceholder(entry.fname_without_uid, "unknown"));
+    record.dname                      = add_string(OrPlaceholder(entry.dname, "unknown"));
+    record.uniqueid                   = add_string(OrPlaceholder(entry.uniqueid, "no-uid"));
+    record.guid                       = add_string(OrPlaceholder(entry.guid, "no-guid"));
+    record.fext                       = add_string(OrPlaceholder(entry.fext, "unknown"));
+    record.type                       = add_string(OrPlaceholder(entry.type, "unknown"));
+    record.dirname                    = add_string(OrPlaceholder(entry.dirname, "unknown"));
+    record.hash                       = add_string(OrPlaceholder(entry.hash, "none"));
+    record.filecachename              = add_string(OrPlaceholder(entry.filecachename, "none"));
+    record.description                = add_string(entry.description);
+    record.tags                       = add_string(entry.tags);
+
+    record.categoryid                 = entry.categoryid;
+    record.addtimestamp               = entry.addtimestamp;
+    record.version                    = entry.version;
+    record.usagecounter               = entry.usagecounter;
+    record.fileformatversion          = entry.fileformatversion;
+
+    record.nodecount                  = entry.nodecount;
+    record.beamcount                  = entry.beamcount;
+    record.shockcount                 = entry.shockcount;
+    record.fixescount                 = entry.fixescount;
+    record.hydroscount                = entry.hydroscount;
+    record.wheelcount                 = entry.wheelcount;
+    record.propwheelcount             = entry.propwheelcount;
+    record.commandscount              = entry.commandscount;
+    record.flarescount                = entry.flarescount;
+    record.propscount                 = entry.propscount;
+    record.wingscount                 = entry.wingscount;
+    record.turbopropscount            = entry.turbopropscount;
+    record.turbojetcount              = entry.turbojetcount;
+    record.rotatorscount              = entry.rotatorscount;
+    record.exhaustscount              = entry.exhaustscount;
+    record.flexbodiescount            = entry.flexbodiescount;
+    record.materialflarebindingscount = entry.materialflarebindingscount;
+    record.soundsourcescount          = entry.soundsourcescount;
+    record.managedmaterialscount      = entry.managedmaterialscount;
+
+    record.truckmass                  = entry.truckmass;
+    record.loadmass                   = entry.loadmass;
+    record.minrpm                     = entry.minrpm;
+    record.maxrpm                     = entry.maxrpm;
+    record.torque                     = entry.torque;
+
+    record.driveable                  = entry.driveable;
+    record.numgears                   = entry.numgears;
+    record.enginetype                 = entry.enginetype;
+    record.flags                      = (entry.hasSubmeshs      ? FLAG_HAS_SUBMESHS     : 0)
+                                      | (entry.customtach       ? FLAG_CUSTOM_TACH      : 0)
+                                      | (entry.custom_particles ? FLAG_CUSTOM_PARTICLES : 0)
+                                      | (entry.forwardcommands  ? FLAG_FORWARD_COMMANDS : 0)
+                                      | (entry.importcommands   ? FLAG_IMPORT_COMMANDS  : 0)
+                                      | (entry.rollon           ? FLAG_ROLLON           : 0)
+                                      | (entry.rescuer          ? FLAG_RESCUER          : 0);
+}
+
+/// Checks the header and that all sections lie within the data; string offsets are checked by the user.
+bool ReadHeader(const char* data, size_t size, CacheHeader& header)
+{
+    if (size < sizeof(header))
+        return false;
+    memcpy(&header, data, sizeof(header));
+
+    return memcmp(header.magic, CACHE_MAGIC, sizeof(header.magic)) == 0 &&
+        header.file_format_version == ModCacheFile::FILE_FORMAT_VERSION &&
+        header.record_size == sizeof(EntryRecord);
+}
+
+bool SectionFits(uint32_t offset, uint32_t count, size_t item_size, size_t size)
+{
+    return offset <= size && count <= (size - offset) / item_size;
+}
+
+/// Bytes past the string table are ignored; they're left behind by an interrupted ModCacheFile::UpdateEntry().
+bool SectionsFit(const char* data, size_t size, CacheHeader const& header)
+{
+    return SectionFits(header.entries_offset,    header.num_entries,    sizeof(EntryRecord),    size) &&
+        SectionFits(header.authors_offset,       header.num_authors,    sizeof(AuthorRecord),   size) &&
+        SectionFits(header.list_items_offset,    header.num_list_items, sizeof(uint32_t),       size) &&
+        SectionFits(header.categories_offset,    header.num_categories, sizeof(CategoryRecord), size) &&
+        SectionFits(header.strings_offset,       header.strings_size,   1,                      size) &&
+        header.strings_size > 0 &&
+        // Every offset into the table then yields a terminated string
+        data[header.strings_offset + header.strings_size - 1] == '\0';
+}
+
+template<typename T> T ReadItem(const char* data, uint32_t offset, uint32_t index)
+{
+    T item;
+    memcpy(&item, data + offset + index * sizeof(T), sizeof(T));
+    return item;
+}
+
+bool ListFits(ListRef const& list, uint32_t num_items)
+{
+    return list.first <= num_items && list.count <= num_items - list.first;
+}
+
+} // namespace
+
+void ModCacheFile::Serialize(std::vector<CacheEntry> const& entries, std::string const& shaone, std::vector<char>& out)
+{
+    // Grouped by category for the index
+    std::vector<CacheEntry const*> sorted_entries;
+    for (CacheEntry const& entry : entries)
+    {
+        if (!entry.deleted)
+            sorted_entries.push_back(&entry);
+    }
+    std::stable_sort(sorted_entries.begin(), sorted_entries.end(),
+        [](CacheEntry const* a, CacheEntry const* b) { return a->categoryid < b->categoryid; });
+
+    StringTable strings;
+    std::vector<EntryRecord>    records(sorted_entries.size());
+    std::vector<AuthorRecord>   authors;
+    std::vector<uint32_t>       list_items;
+    std::vector<CategoryRecord> categories;
+    for (size_t i = 0; i < sorted_entries.size(); ++i)
+    {
+        CacheEntry const& entry = *sorted_entries[i];
+        EntryRecord& record = records[i];
+        FillRecord(record, entry, [&strings](std::string const& str) { return strings.Add(str); });
+
+        record.authors.first = static_cast<uint32_t>(authors.size());
+        for (AuthorInfo const& author : entry.authors)
+        {
+            AuthorRecord author_record;
+            author_record.id    = author.id;
+            author_record.type  = strings.Add(OrPlaceholder(author.type, "unknown"));
+            author_record.name  = strings.Add(OrPlaceholder(author.name, "unknown"));
+            author_record.email = strings.Add(OrPlaceholder(author.email, "unknown"));
+            authors.push_back(author_record);
+        }
+        record.authors.count = static_cast<uint32_t>(authors.size()) - record.authors.first;
+
+        record.sectionconfigs.first = static_cast<uint32_t>(list_items.size());
+        for (std::string const& config : entry.sectionconfigs)
+            list_items.push_back(strings.Add(config));
+        record.sectionconfigs.count = static_cast<uint32_t>(list_items.size()) - record.sectionconfigs.first;
+
+        record.materials.first = static_cast<uint32_t>(list_items.size());
+        for (std::string const& material : entry.materials)
+            list_items.push_back(strings.Add(material));
+        record.materials.count = static_cast<uint32_t>(list_items.size()) - record.materials.first;
+
+        if (categories.empty() || categories.back().categoryid != entry.categoryid)
+        {
+            CategoryRecord category;
+            category.categoryid = entry.categoryid;
+            category.first      = static_cast<uint32_t>(i);
+            category.count      = 0;
+            categories.push_back(category);
+        }
+        ++categories.back().count;
+    }
+
+    CacheHeader header;
+    memset(&header, 0, sizeof(header));
+    memcpy(header.magic, CACHE_MAGIC, sizeof(header.magic));
+    header.file_format_version = FILE_FORMAT_VERSION;
+    header.record_size         = sizeof(EntryRecord);
+    strncpy(header.shaone, shaone.c_str(), sizeof(header.shaone));
+    header.num_entries         = static_cast<uint32_t>(records.size());
+    header.entries_offset      = sizeof(CacheHeader);
+    header.num_authors         = static_cast<uint32_t>(authors.size());
+    header.authors_offset      = header.entries_offset + header.num_entries * sizeof(EntryRecord);
+    header.num_list_items      = static_cast<uint32_t>(list_items.size());
+    header.list_items_offset   = header.authors_offset + header.num_authors * sizeof(AuthorRecord);
+    header.num_categories      = static_cast<uint32_t>(categories.size());
+    header.categories_offset   = header.list_items_offset + header.num_list_items * sizeof(uint32_t);
+    header.strings_offset      = header.categories_offset + header.num_categories * sizeof(CategoryRecord);
+    header.strings_size        = static_cast<uint32_t>(strings.GetData().size());
+
+    out.clear();
+    out.reserve(header.strings_offset + header.strings_size);
+    auto append = [&out](const void* bytes, size_t size)
+    {
+        if (size > 0)
+            out.insert(out.end(), static_cast<const char*>(bytes), static_cast<const char*>(bytes) + size);
+    };
+    append(&header, sizeof(header));
+    append(records.data(),    records.size()    * sizeof(EntryRecord));
+    append(authors.data(),    authors.size()    * sizeof(AuthorRecord));
+    append(list_items.data(), list_items.size() * sizeof(uint32_t));
+    append(categories.data(), categories.size() * sizeof(CategoryRecord));
+    append(strings.GetData().data(), strings.GetData().size());
+}
+
+bool ModCacheFile::ReadShaone(const char* data, size_t size, std::string& out_shaone)
+{
+    CacheHeader header;
+    if (!ReadHeader(data, size, header))
+        return false;
+
+    out_shaone.assign(header.shaone, strnlen(header.shaone, sizeof(header.shaone)));
+    return true;
+}
+
+bool ModCacheFile::Deserialize(const char* data, size_t size, std::vector<CacheEntry>& out_entries, std::map<int, int>& out_category_usage)
+{
+    CacheHeader header;
+    if (!ReadHeader(data, size, header) || !SectionsFit(data, size, header))
+        return false;
+
+    const char* strings = data + header.strings_offset;
+    bool strings_ok = true;
+    auto get_string = [strings, &header, &strings_ok](uint32_t offset) -> const char*
+    {
+        if (offset >= header.strings_size)
+        {
+            strings_ok = false;
+            return "";
+        }
+        return strings + offset;
+    };
+
+    std::vector<CacheEntry> entries(header.num_entries);
+    for (uint32_t i = 0; i < header.num_entries; ++i)
+    {
+        const EntryRecord record = ReadItem<EntryRecord>(data, header.entries_offset, i);
+        if (!ListFits(record.authors, header.num_authors) ||
+            !ListFits(record.sectionconfigs, header.num_list_items) ||
+            !ListFits(record.materials, header.num_list_items))
+        {
+            return false;
+        }
+
+        CacheEntry& entry = entries[i];
+        entry.number                     = record.number;
+        entry.filetime                   = static_cast<std::time_t>(record.filetime);
+
+        entry.minitype                   = get_string(record.minitype);
+        entry.fname                      = get_string(record.fname);
+        entry.fname_without_uid          = get_string(record.fname_without_uid);
+        entry.dname                      = get_string(record.dname);
+        entry.uniqueid                   = get_string(record.uniqueid);
+        entry.guid                       = get_string(record.guid);
+        entry.fext                       = get_string(record.fext);
+        entry.type                       = get_string(record.type);
+        entry.dirname                    = get_string(record.dirname);
+        entry.hash                       = get_string(record.hash);
+        entry.filecachename              = get_string(record.filecachename);
+        entry.description                = get_string(record.description);
+        entry.tags                       = get_string(record.tags);
+
+        entry.categoryid                 = record.categoryid;
+        entry.addtimestamp               = record.addtimestamp;
+        entry.version                    = record.version;
+        entry.usagecounter               = record.usagecounter;
+        entry.fileformatversion          = record.fileformatversion;
+
+        entry.nodecount                  = record.nodecount;
+        entry.beamcount                  = record.beamcount;
+        entry.shockcount                 = record.shockcount;
+        entry.fixescount                 = record.fixescount;
+        entry.hydroscount                = record.hydroscount;
+        entry.wheelcount                 = record.wheelcount;
+        entry.propwheelcount             = record.propwheelcount;
+        entry.commandscount              = record.commandscount;
+        entry.flarescount                = record.flarescount;
+        entry.propscount                 = record.propscount;
+        entry.wingscount                 = record.wingscount;
+        entry.turbopropscount            = record.turbopropscount;
+        entry.turbojetcount              = record.turbojetcount;
+        entry.rotatorscount              = record.rotatorscount;
+        entry.exhaustscount              = record.exhaustscount;
+        entry.flexbodiescount            = record.flexbodiescount;
+        entry.materialflarebindingscount = record.materialflarebindingscount;
+        entry.soundsourcescount          = record.soundsourcescount;
+        entry.managedmaterialscount      = record.managedmaterialscount;
+
+        entry.truckmass                  = record.truckmass;
+        entry.loadmass                   = record.loadmass;
+        entry.minrpm                     = record.minrpm;
+        entry.maxrpm                     = record.maxrpm;
+        entry.torque                     = record.torque;
+
+        entry.driveable                  = record.driveable;
+        entry.numgears                   = record.numgears;
+        entry.enginetype                 = static_cast<char>(record.enginetype);
+        entry.hasSubmeshs                = (record.flags & FLAG_HAS_SUBMESHS) != 0;
+        entry.customtach                 = (record.flags & FLAG_CUSTOM_TACH) != 0;
+        entry.custom_particles           = (record.flags & FLAG_CUSTOM_PARTICLES) != 0;
+        entry.forwardcommands            = (record.flags & FLAG_FORWARD_COMMANDS) != 0;
+        entry.importcommands             = (record.flags & FLAG_IMPORT_COMMANDS) != 0;
+        entry.rollon                     = (record.flags & FLAG_ROLLON) != 0;
+        entry.rescuer                    = (record.flags & FLAG_RESCUER) != 0;
+
+        entry.authors.resize(record.authors.count);
+        for (uint32_t a = 0; a < record.authors.count; ++a)
+        {
+            const AuthorRecord author_record = ReadItem<AuthorRecord>(data, header.authors_offset, record.authors.first + a);
+            entry.authors[a].id    = author_record.id;
+            entry.authors[a].type  = get_string(author_record.type);
+            entry.authors[a].name  = get_string(author_record.name);
+            entry.authors[a].email = get_string(author_record.email);
+        }
+        for (uint32_t s = 0; s < record.sectionconfigs.count; ++s)
+            entry.sectionconfigs.push_back(get_string(ReadItem<uint32_t>(data, header.list_items_offset, record.sectionconfigs.first + s)));
+        for (uint32_t m = 0; m < record.materials.count; ++m)
+            entry.materials.insert(get_string(ReadItem<uint32_t>(data, header.list_items_offset, record.materials.first + m)));
+    }
+
+    // The index must cover all records, in order
+    std::map<int, int> category_usage;
+    uint32_t num_indexed = 0;
+    for (uint32_t c = 0; c < header.num_categories; ++c)
+    {
+        const CategoryRecord category = ReadItem<CategoryRecord>(data, header.categories_offset, c);
+        if (category.first != num_indexed || category.count > header.num_entries - num_indexed)
+            return false;
+        for (uint32_t i = category.first; i < category.first + category.count; ++i)
+        {
+            if (entries[i].categoryid != category.categoryid)
+                return false;
+        }
+        category_usage[category.categoryid] += static_cast<int>(category.count);
+        num_indexed += category.count;
+    }
+    if (!strings_ok || num_indexed != header.num_entries)
+        return false;
+
+    out_entries.swap(entries);
+    out_category_usage.swap(category_usage);
+    return true;
+}
+
+bool ModCacheFile::UpdateEntry(std::string const& filename, CacheEntry const& entry)
+{
+    CacheHeader header;
+    EntryRecord record;
+    uint32_t record_index = 0;
+    std::vector<char> appended_strings;
+    {
+        MappedFile file;
+        if (!file.Open(filename))
+            return false;
+        const char* data = file.GetData();
+        if (!ReadHeader(data, file.GetSize(), header) || !SectionsFit(data, file.GetSize(), header))
+            return false;
+        for (record_index = 0; record_index < header.num_entries; ++record_index)
+        {
+            if (ReadItem<EntryRecord>(data, header.entries_offset, record_index).number == entry.number)
+                break;
+        }
+        if (record_index == header.num_entries)
+            return false;
+
+        const EntryRecord old_record = ReadItem<EntryRecord>(data, header.entries_offset, record_index);
+        // Records are grouped by category, so a new category means a new index
+        if (old_record.categoryid != entry.categoryid)
+            return false;
+        const char* strings = data + header.strings_offset;
+        auto string_equals = [strings, &header](uint32_t offset, std::string const& str)
+        {
+            return offset < header.strings_size && str == strings + offset;
+        };
+
+        // Lists can't grow in place
+        if (!ListFits(old_record.authors, header.num_authors) || old_record.authors.count != entry.authors.size() ||
+            !ListFits(old_record.sectionconfigs, header.num_list_items) || old_record.sectionconfigs.count != entry.sectionconfigs.size() ||
+            !ListFits(old_record.materials, header.num_list_items) || old_record.materials.count != entry.materials.size())
+        {
+            return false;
+        }
+        for (uint32_t a = 0; a < old_record.authors.count; ++a)
+        {
+            const AuthorRecord author_record = ReadItem<AuthorRecord>(data, header.authors_offset, old_record.authors.first + a);
+            AuthorInfo const& author = entry.authors[a];
+            if (author_record.id != author.id ||
+                !string_equals(author_record.type, OrPlaceholder(author.type, "unknown")) ||
+                !string_equals(author_record.name, OrPlaceholder(author.name, "unknown")) ||
+                !string_equals(author_record.email, OrPlaceholder(author.email, "unknown")))
+            {
+                return false;
+            }
+        }
+        for (uint32_t s = 0; s < old_record.sectionconfigs.count; ++s)
+        {
+            if (!string_equals(ReadItem<uint32_t>(data, header.list_items_offset, old_record.sectionconfigs.first + s), entry.sectionconfigs[s]))
+                return false;
+        }
+        auto material_itor = entry.materials.begin();
+        for (uint32_t m = 0; m < old_record.materials.count; ++m, ++material_itor)
+        {
+            if (!string_equals(ReadItem<uint32_t>(data, header.list_items_offset, old_record.materials.first + m), *material_itor))
+                return false;
+        }
+
+        // Unchanged strings keep their offsets, others are appended
+        std::unordered_map<std::string, uint32_t> old_strings;
+        const uint32_t old_string_offsets[] = {
+            old_record.minitype, old_record.fname, old_record.fname_without_uid, old_record.dname, old_record.uniqueid,
+            old_record.guid, old_record.fext, old_record.type, old_record.dirname, old_record.hash,
+            old_record.filecachename, old_record.description, old_record.tags };
+        for (uint32_t offset : old_string_offsets)
+        {
+            if (offset >= header.strings_size)
+                return false;
+            old_strings.insert(std::make_pair(std::string(strings + offset), offset));
+        }
+        StringTable new_strings(header.strings_size);
+        FillRecord(record, entry, [&old_strings, &new_strings](std::string const& str)
+        {
+            auto found = old_strings.find(str);
+            return (found != old_strings.end()) ? found->second : new_strings.Add(str);
+        });
+        record.authors        = old_record.authors;
+        record.sectionconfigs = old_record.sectionconfigs;
+        record.materials      = old_record.materials;
+
+        if (memcmp(&record, &old_record, sizeof(record)) == 0)
+            return true;
+        appended_strings = new_strings.GetData();
+    } // The file is unmapped before it's written
+
+    FILE* file = fopen(filename.c_str(), "r+b");
+    if (!file)
+        return false;
+
+    // Strings first and the record last, so an interrupted update leaves the old record in effect
+    bool ok = true;
+    if (!appended_strings.empty())
+    {
+        ok = fseek(file, static_cast<long>(header.strings_offset + header.strings_size), SEEK_SET) == 0 &&
+            fwrite(appended_strings.data(), 1, appended_strings.size(), file) == appended_strings.size();
+        header.strings_size += static_cast<uint32_t>(appended_strings.size());
+        ok = ok && fseek(file, 0, SEEK_SET) == 0 && fwrite(&header, sizeof(header), 1, file) == 1;
+    }
+    const long record_offset = static_cast<long>(header.entries_offset + record_index * sizeof(EntryRecord));
+    ok = ok && fseek(file, record_offset, SEEK_SET) == 0 && fwrite(&record, sizeof(record), 1, file) == 1;
+    ok = (fclose(file) == 0) && ok;
+    return ok;
+}
+
+bool ModCacheFile::WriteFile(std::string const& filename, std::vector<char> const& data)
+{
+    const std::string tmp_filename = filename + ".tmp";
+    FILE* file = fopen(tmp_filename.c_str(), "wb");
+    if (!file)
+        return false;
+    bool ok = (fwrite(data.data(), 1, data.size(), file) == data.size());
+    ok = (fclose(file) == 0) && ok;
+    if (ok)
+    {
+        remove(filename.c_str()); // Windows doesn't replace on rename
+        ok = (rename(tmp_filename.c_str(), filename.c_str()) == 0);
+    }
+    if (!ok)
+        remove(tmp_filename.c_str());
+    return ok;
+}
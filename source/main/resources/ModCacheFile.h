@@ -0,0 +1,64 @@
+/*
+    This source file is part of Rigs of Rods
+    Copyright 2013-2017 Petr Ohlidal & contributors
+
+    For more information, see http://www.rigsofrods.org/
+
+    Rigs of Rods is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License version 3, as
+    published by the Free Software Foundation.
+
+    Rigs of Rods is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with Rigs of Rods. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+/// @file
+/// @brief Binary format of the mod cache file (mods.cache), see CacheSystem.
+
+#pragma once
+
+#include <cstddef>
+#include <map>
+#include <string>
+#include <vector>
+
+class CacheEntry;
+
+namespace RoR {
+
+/// Sections: header, fixed-size entry records, authors, string lists (section configs
+/// and materials), category index, string table. Every string is stored once in the
+/// string table, records refer to it by offset. The string table comes last so that
+/// UpdateEntry() can append to it. Values are in native byte order; the cache is local.
+///
+/// IMPORTANT! If you add/change a member of CacheEntry, update the EntryRecord in
+/// ModCacheFile.cpp and increase FILE_FORMAT_VERSION.
+class ModCacheFile
+{
+public:
+    static const unsigned int FILE_FORMAT_VERSION = 8; // 1-6 were text files
+
+    /// Entries marked deleted are left out. Entry numbers are stored as they are.
+    static void Serialize(std::vector<CacheEntry> const& entries, std::string const& shaone, std::vector<char>& out);
+
+    /// @return False if the data aren't a cache file of this FILE_FORMAT_VERSION.
+    static bool ReadShaone(const char* data, size_t size, std::string& out_shaone);
+
+    /// @param out_category_usage Filled from the category index; counts entries per category ID as stored.
+    /// @return False if the data are outdated or damaged.
+    static bool Deserialize(const char* data, size_t size, std::vector<CacheEntry>& out_entries, std::map<int, int>& out_category_usage);
+
+    /// Rewrites the record of entry.number in place; changed strings are appended to the string table.
+    /// @return False if the file needs to be written again, i.e. it's missing, damaged, or the entry's category or lists have changed.
+    static bool UpdateEntry(std::string const& filename, CacheEntry const& entry);
+
+    /// Writes aside and renames, so a failed write never leaves a truncated file behind.
+    static bool WriteFile(std::string const& filename, std::vector<char> const& data);
+};
+
+} // namespace RoR
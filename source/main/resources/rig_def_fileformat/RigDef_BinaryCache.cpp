@@ -0,0 +1,1447 @@
+/*
+    This source file is part of Rigs of Rods
+    Copyright 2013-2017 Petr Ohlidal & contributors
+
+    For more information, see http://www.rigsofrods.org/
+
+    Rigs of Rods is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License version 3, as
+    published by the Free Software Foundation.
+
+    Rigs of Rods is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with Rigs of Rods. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "RigDef_BinaryCache.h"
+
+#include "Application.h"
+#include "CacheSystem.h"
+#include "MappedFile.h"
+#include "RigDef_Parser.h"
+#include "RigDef_SequentialImporter.h"
+#include "RoRPrerequisites.h"
+#include "Settings.h"
+#include "SHA1.h"
+
+#include <OgreFileSystem.h>
+
+#include <algorithm>
+#include <atomic>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <ctime>
+#include <list>
+#include <map>
+#include <type_traits>
+#include <unordered_map>
+
+#ifdef _WIN32
+#   include <process.h>
+#else
+#   include <unistd.h>
+#endif
+
+using namespace RigDef;
+
+namespace {
+
+const char CACHE_MAGIC[8] = {'R','o','R','R','I','G','D','\0'};
+
+/// File layout: header, ParseReport, File. Values are in native byte order; the cache is local.
+struct CacheHeader
+{
+    char     magic[8];
+    uint32_t file_format_version;
+    char     source_hash[40];  ///< SHA1 of the rig-def text, hex
+    uint64_t payload_size;
+};
+
+// ----------------------------------------------------------------------------
+// Archives; Io() functions below are shared by reading and writing.
+
+class Writer
+{
+public:
+    static const bool READING = false;
+
+    explicit Writer(std::vector<char>& out): m_out(out) {}
+
+    bool IsOk() const { return true; }
+
+    template<typename T> void Raw(T& value)
+    {
+        const char* bytes = reinterpret_cast<const char*>(&value);
+        m_out.insert(m_out.end(), bytes, bytes + sizeof(T));
+    }
+
+    bool Count(uint32_t& count) { this->Raw(count); return true; }
+
+    void String(std::string& str)
+    {
+        uint32_t len = static_cast<uint32_t>(str.size());
+        this->Raw(len);
+        m_out.insert(m_out.end(), str.begin(), str.end());
+    }
+
+    /// Objects referenced by multiple shared_ptrs (node/beam/inertia defaults) are written once.
+    /// @return True if the object's fields follow.
+    template<typename T> bool BeginShared(std::shared_ptr<T>& ptr)
+    {
+        uint32_t index = 0;
+        if (!ptr)
+        {
+            this->Raw(index);
+            return false;
+        }
+        auto found = m_shared.find(ptr.get());
+        if (found != m_shared.end())
+        {
+            index = found->second;
+            this->Raw(index);
+            return false;
+        }
+        index = static_cast<uint32_t>(m_shared.size()) + 1;
+        m_shared.insert(std::make_pair(ptr.get(), index));
+        this->Raw(index);
+        return true;
+    }
+
+private:
+    std::vector<char>&                          m_out;
+    std::unordered_map<const void*, uint32_t>   m_shared;
+};
+
+template<typename T> struct TypeKey { static const char key; };
+template<typename T> const char TypeKey<T>::key = 0;
+
+/// Default-constructed values to read into
+template<typename T> struct Blank { static T Make() { return T(); } };
+template<> struct Blank<Node::Range>  { static Node::Range  Make() { return Node::Range(Node::Ref()); } };
+template<> struct Blank<File::Module> { static File::Module Make() { return File::Module(""); } };
+
+class Reader
+{
+public:
+    static const bool READING = true;
+
+    Reader(const char* data, size_t size): m_pos(data), m_end(data + size), m_ok(true) {}
+
+    bool IsOk() const       { return m_ok; }
+    bool IsAtEnd() const    { return m_pos == m_end; }
+
+    template<typename T> void Raw(T& value)
+    {
+        if (!m_ok || static_cast<size_t>(m_end - m_pos) < sizeof(T))
+        {
+            m_ok = false;
+            return;
+        }
+        memcpy(&value, m_pos, sizeof(T));
+        m_pos += sizeof(T);
+    }
+
+    /// Every element takes at least 1 byte, larger counts mean damaged data.
+    bool Count(uint32_t& count)
+    {
+        this->Raw(count);
+        if (m_ok && count > static_cast<size_t>(m_end - m_pos))
+            m_ok = false;
+        if (!m_ok)
+            count = 0;
+        return m_ok;
+    }
+
+    void String(std::string& str)
+    {
+        uint32_t len = 0;
+        if (this->Count(len))
+        {
+            str.assign(m_pos, len);
+            m_pos += len;
+        }
+    }
+
+    template<typename T> bool BeginShared(std::shared_ptr<T>& ptr)
+    {
+        uint32_t index = 0;
+        this->Raw(index);
+        ptr.reset();
+        if (!m_ok || index == 0)
+            return false;
+
+        if (index <= m_shared.size())
+        {
+            SharedObject& obj = m_shared[index - 1];
+            if (obj.type_key != &TypeKey<T>::key)
+            {
+                m_ok = false;
+                return false;
+            }
+            ptr = std::static_pointer_cast<T>(obj.ptr);
+            return false;
+        }
+        if (index != m_shared.size() + 1)
+        {
+            m_ok = false;
+            return false;
+        }
+        ptr = std::make_shared<T>(Blank<T>::Make());
+        SharedObject obj;
+        obj.ptr = ptr;
+        obj.type_key = &TypeKey<T>::key;
+        m_shared.push_back(obj);
+        return true;
+    }
+
+private:
+    struct SharedObject
+    {
+        std::shared_ptr<void> ptr;
+        const char*           type_key;
+    };
+
+    const char*               m_pos;
+    const char*               m_end;
+    bool                      m_ok;
+    std::vector<SharedObject> m_shared;
+};
+
+// ----------------------------------------------------------------------------
+// Generic types
+
+template<class A, typename T>
+typename std::enable_if<std::is_arithmetic<T>::value || std::is_enum<T>::value>::type
+    Io(A& ar, T& value)
+{
+    ar.Raw(value);
+}
+
+template<class A> void Io(A& ar, std::string& str)           { ar.String(str); }
+template<class A> void Io(A& ar, Ogre::Vector3& v)           { Io(ar, v.x); Io(ar, v.y); Io(ar, v.z); }
+template<class A> void Io(A& ar, Ogre::ColourValue& c)       { Io(ar, c.r); Io(ar, c.g); Io(ar, c.b); Io(ar, c.a); }
+
+template<class A, typename T, size_t N> void Io(A& ar, T (&items)[N])
+{
+    for (size_t i = 0; i < N; ++i)
+        Io(ar, items[i]);
+}
+
+template<class A, typename T> void Io(A& ar, std::shared_ptr<T>& ptr)
+{
+    if (ar.BeginShared(ptr))
+        Io(ar, *ptr);
+}
+
+template<class A, typename C> void IoSequence(A& ar, C& items)
+{
+    uint32_t count = static_cast<uint32_t>(items.size());
+    if (!ar.Count(count))
+        return;
+    if (A::READING)
+    {
+        items.clear();
+        for (uint32_t i = 0; i < count && ar.IsOk(); ++i)
+        {
+            items.push_back(Blank<typename C::value_type>::Make());
+            Io(ar, items.back());
+        }
+    }
+    else
+    {
+        for (auto& item : items)
+            Io(ar, item);
+    }
+}
+
+template<class A, typename T> void Io(A& ar, std::vector<T>& items) { IoSequence(ar, items); }
+template<class A, typename T> void Io(A& ar, std::list<T>& items)   { IoSequence(ar, items); }
+
+template<class A, typename T> void Io(A& ar, std::map<std::string, T>& items)
+{
+    uint32_t count = static_cast<uint32_t>(items.size());
+    if (!ar.Count(count))
+        return;
+    if (A::READING)
+    {
+        items.clear();
+        for (uint32_t i = 0; i < count && ar.IsOk(); ++i)
+        {
+            std::string key;
+            Io(ar, key);
+            Io(ar, items[key]);
+        }
+    }
+    else
+    {
+        for (auto& item : items)
+        {
+            std::string key = item.first;
+            Io(ar, key);
+            Io(ar, item.second);
+        }
+    }
+}
+
+// ----------------------------------------------------------------------------
+// Nodes
+
+template<class A> void Io(A& ar, Node::Id& id)
+{
+    uint8_t type = (!id.IsValid()) ? 0 : (id.IsTypeNumbered() ? 1 : 2);
+    unsigned int num = id.Num();
+    std::string str = id.Str();
+    Io(ar, type);
+    if (type == 1)
+        Io(ar, num);
+    else if (type == 2)
+        Io(ar, str);
+
+    if (A::READING)
+    {
+        if (type == 1)
+            id.SetNum(num);
+        else if (type == 2)
+            id.SetStr(str);
+        else
+            id.Invalidate();
+    }
+}
+
+template<class A> void Io(A& ar, Node::Ref& ref)
+{
+    std::string  id      = ref.Str();
+    unsigned int id_num  = ref.Num();
+    unsigned int flags   = ref.GetFlags();
+    unsigned int line    = ref.GetLineNumber();
+    Io(ar, id);
+    Io(ar, id_num);
+    Io(ar, flags);
+    Io(ar, line);
+    if (A::READING)
+        ref = Node::Ref(id, id_num, flags, line);
+}
+
+template<class A> void Io(A& ar, Node::Range& x)
+{
+    Io(ar, x.start);
+    Io(ar, x.end);
+}
+
+template<class A> void Io(A& ar, Node& x)
+{
+    Io(ar, x.id);
+    Io(ar, x.position);
+    Io(ar, x.options);
+    Io(ar, x.load_weight_override);
+    Io(ar, x._has_load_weight_override);
+    Io(ar, x.node_defaults);
+    Io(ar, x.beam_defaults);
+    Io(ar, x.detacher_group);
+}
+
+// ----------------------------------------------------------------------------
+// Presets
+
+template<class A> void Io(A& ar, CameraSettings& x)
+{
+    Io(ar, x.mode);
+    Io(ar, x.cinecam_index);
+}
+
+template<class A> void Io(A& ar, NodeDefaults& x)
+{
+    Io(ar, x.load_weight);
+    Io(ar, x.friction);
+    Io(ar, x.volume);
+    Io(ar, x.surface);
+    Io(ar, x.options);
+}
+
+template<class A> void Io(A& ar, BeamDefaultsScale& x)
+{
+    Io(ar, x.springiness);
+    Io(ar, x.damping_constant);
+    Io(ar, x.deformation_threshold_constant);
+    Io(ar, x.breaking_threshold_constant);
+}
+
+template<class A> void Io(A& ar, BeamDefaults& x)
+{
+    Io(ar, x.springiness);
+    Io(ar, x.damping_constant);
+    Io(ar, x.deformation_threshold);
+    Io(ar, x.breaking_threshold);
+    Io(ar, x.visual_beam_diameter);
+    Io(ar, x.beam_material_name);
+    Io(ar, x.plastic_deform_coef);
+    Io(ar, x._enable_advanced_deformation);
+    Io(ar, x._is_plastic_deform_coef_user_defined);
+    Io(ar, x._is_user_defined);
+    Io(ar, x.scale);
+}
+
+template<class A> void Io(A& ar, Inertia& x)
+{
+    Io(ar, x.start_delay_factor);
+    Io(ar, x.stop_delay_factor);
+    Io(ar, x.start_function);
+    Io(ar, x.stop_function);
+}
+
+template<class A> void Io(A& ar, ManagedMaterialsOptions& x)
+{
+    Io(ar, x.double_sided);
+}
+
+// ----------------------------------------------------------------------------
+// Sections
+
+template<class A> void Io(A& ar, Globals& x)
+{
+    Io(ar, x.dry_mass);
+    Io(ar, x.cargo_mass);
+    Io(ar, x.material_name);
+}
+
+template<class A> void Io(A& ar, GuiSettings& x)
+{
+    Io(ar, x.tacho_material);
+    Io(ar, x.speedo_material);
+    Io(ar, x.speedo_highest_kph);
+    Io(ar, x.use_max_rpm);
+    Io(ar, x.help_material);
+    Io(ar, x.interactive_overview_map_mode);
+    Io(ar, x.dashboard_layouts);
+    Io(ar, x.rtt_dashboard_layouts);
+}
+
+template<class A> void Io(A& ar, Airbrake& x)
+{
+    Io(ar, x.reference_node);
+    Io(ar, x.x_axis_node);
+    Io(ar, x.y_axis_node);
+    Io(ar, x.aditional_node);
+    Io(ar, x.offset);
+    Io(ar, x.width);
+    Io(ar, x.height);
+    Io(ar, x.max_inclination_angle);
+    Io(ar, x.texcoord_x1);
+    Io(ar, x.texcoord_x2);
+    Io(ar, x.texcoord_y1);
+    Io(ar, x.texcoord_y2);
+    Io(ar, x.lift_coefficient);
+}
+
+template<class A> void Io(A& ar, Animation::MotorSource& x)
+{
+    Io(ar, x.source);
+    Io(ar, x.motor);
+}
+
+template<class A> void Io(A& ar, Animation& x)
+{
+    Io(ar, x.ratio);
+    Io(ar, x.lower_limit);
+    Io(ar, x.upper_limit);
+    Io(ar, x.source);
+    Io(ar, x.motor_sources);
+    Io(ar, x.mode);
+    Io(ar, x.event);
+}
+
+template<class A> void Io(A& ar, Axle& x)
+{
+    Io(ar, x.wheels);
+    Io(ar, x.options);
+}
+
+template<class A> void Io(A& ar, Beam& x)
+{
+    Io(ar, x.nodes);
+    Io(ar, x.options);
+    Io(ar, x.extension_break_limit);
+    Io(ar, x._has_extension_break_limit);
+    Io(ar, x.detacher_group);
+    Io(ar, x.defaults);
+}
+
+template<class A> void Io(A& ar, Camera& x)
+{
+    Io(ar, x.center_node);
+    Io(ar, x.back_node);
+    Io(ar, x.left_node);
+}
+
+template<class A> void Io(A& ar, CameraRail& x)
+{
+    Io(ar, x.nodes);
+}
+
+template<class A> void Io(A& ar, Cinecam& x)
+{
+    Io(ar, x.position);
+    Io(ar, x.nodes);
+    Io(ar, x.spring);
+    Io(ar, x.damping);
+    Io(ar, x.node_mass);
+    Io(ar, x.beam_defaults);
+    Io(ar, x.node_defaults);
+}
+
+template<class A> void Io(A& ar, CollisionBox& x)
+{
+    Io(ar, x.nodes);
+}
+
+template<class A> void Io(A& ar, CruiseControl& x)
+{
+    Io(ar, x.min_speed);
+    Io(ar, x.autobrake);
+}
+
+template<class A> void Io(A& ar, Author& x)
+{
+    Io(ar, x.type);
+    Io(ar, x.forum_account_id);
+    Io(ar, x.name);
+    Io(ar, x.email);
+    Io(ar, x._has_forum_account);
+}
+
+template<class A> void Io(A& ar, Fileinfo& x)
+{
+    Io(ar, x.unique_id);
+    Io(ar, x.category_id);
+    Io(ar, x.file_version);
+}
+
+template<class A> void Io(A& ar, Engine& x)
+{
+    Io(ar, x.shift_down_rpm);
+    Io(ar, x.shift_up_rpm);
+    Io(ar, x.torque);
+    Io(ar, x.global_gear_ratio);
+    Io(ar, x.reverse_gear_ratio);
+    Io(ar, x.neutral_gear_ratio);
+    Io(ar, x.gear_ratios);
+}
+
+template<class A> void Io(A& ar, Engoption& x)
+{
+    Io(ar, x.inertia);
+    Io(ar, x.type);
+    Io(ar, x.clutch_force);
+    Io(ar, x.shift_time);
+    Io(ar, x.clutch_time);
+    Io(ar, x.post_shift_time);
+    Io(ar, x.idle_rpm);
+    Io(ar, x.stall_rpm);
+    Io(ar, x.max_idle_mixture);
+    Io(ar, x.min_idle_mixture);
+}
+
+template<class A> void Io(A& ar, Engturbo& x)
+{
+    Io(ar, x.version);
+    Io(ar, x.tinertiaFactor);
+    Io(ar, x.nturbos);
+    Io(ar, x.param1);
+    Io(ar, x.param2);
+    Io(ar, x.param3);
+    Io(ar, x.param4);
+    Io(ar, x.param5);
+    Io(ar, x.param6);
+    Io(ar, x.param7);
+    Io(ar, x.param8);
+    Io(ar, x.param9);
+    Io(ar, x.param10);
+    Io(ar, x.param11);
+}
+
+template<class A> void Io(A& ar, Exhaust& x)
+{
+    Io(ar, x.reference_node);
+    Io(ar, x.direction_node);
+    Io(ar, x.material_name);
+}
+
+template<class A> void Io(A& ar, ExtCamera& x)
+{
+    Io(ar, x.mode);
+    Io(ar, x.node);
+}
+
+template<class A> void Io(A& ar, Brakes& x)
+{
+    Io(ar, x.default_braking_force);
+    Io(ar, x.parking_brake_force);
+}
+
+template<class A> void Io(A& ar, AntiLockBrakes& x)
+{
+    Io(ar, x.regulation_force);
+    Io(ar, x.min_speed);
+    Io(ar, x.pulse_per_sec);
+    Io(ar, x.attr_is_on);
+    Io(ar, x.attr_no_dashboard);
+    Io(ar, x.attr_no_toggle);
+}
+
+template<class A> void Io(A& ar, TractionControl& x)
+{
+    Io(ar, x.regulation_force);
+    Io(ar, x.wheel_slip);
+    Io(ar, x.fade_speed);
+    Io(ar, x.pulse_per_sec);
+    Io(ar, x.attr_is_on);
+    Io(ar, x.attr_no_dashboard);
+    Io(ar, x.attr_no_toggle);
+}
+
+template<class A> void Io(A& ar, SlopeBrake& x)
+{
+    Io(ar, x.regulating_force);
+    Io(ar, x.attach_angle);
+    Io(ar, x.release_angle);
+}
+
+template<class A> void Io(A& ar, WheelDetacher& x)
+{
+    Io(ar, x.wheel_id);
+    Io(ar, x.detacher_group);
+}
+
+template<class A> void Io(A& ar, BaseWheel& x)
+{
+    Io(ar, x.width);
+    Io(ar, x.num_rays);
+    Io(ar, x.nodes);
+    Io(ar, x.rigidity_node);
+    Io(ar, x.braking);
+    Io(ar, x.propulsion);
+    Io(ar, x.reference_arm_node);
+    Io(ar, x.mass);
+    Io(ar, x.node_defaults);
+    Io(ar, x.beam_defaults);
+}
+
+template<class A> void Io(A& ar, Wheel& x)
+{
+    Io(ar, static_cast<BaseWheel&>(x));
+    Io(ar, x.radius);
+    Io(ar, x.springiness);
+    Io(ar, x.damping);
+    Io(ar, x.face_material_name);
+    Io(ar, x.band_material_name);
+}
+
+template<class A> void Io(A& ar, BaseWheel2& x)
+{
+    Io(ar, static_cast<BaseWheel&>(x));
+    Io(ar, x.rim_radius);
+    Io(ar, x.tyre_radius);
+    Io(ar, x.tyre_springiness);
+    Io(ar, x.tyre_damping);
+}
+
+template<class A> void Io(A& ar, Wheel2& x)
+{
+    Io(ar, static_cast<BaseWheel2&>(x));
+    Io(ar, x.face_material_name);
+    Io(ar, x.band_material_name);
+    Io(ar, x.rim_springiness);
+    Io(ar, x.rim_damping);
+}
+
+template<class A> void Io(A& ar, MeshWheel& x)
+{
+    Io(ar, static_cast<BaseWheel&>(x));
+    Io(ar, x.side);
+    Io(ar, x.mesh_name);
+    Io(ar, x.material_name);
+    Io(ar, x.rim_radius);
+    Io(ar, x.tyre_radius);
+    Io(ar, x.spring);
+    Io(ar, x.damping);
+    Io(ar, x._is_meshwheel2);
+}
+
+template<class A> void Io(A& ar, Flare2& x)
+{
+    Io(ar, x.reference_node);
+    Io(ar, x.node_axis_x);
+    Io(ar, x.node_axis_y);
+    Io(ar, x.offset);
+    Io(ar, x.type);
+    Io(ar, x.control_number);
+    Io(ar, x.blink_delay_milis);
+    Io(ar, x.size);
+    Io(ar, x.material_name);
+}
+
+template<class A> void Io(A& ar, Flexbody& x)
+{
+    Io(ar, x.reference_node);
+    Io(ar, x.x_axis_node);
+    Io(ar, x.y_axis_node);
+    Io(ar, x.offset);
+    Io(ar, x.rotation);
+    Io(ar, x.mesh_name);
+    Io(ar, x.animations);
+    Io(ar, x.node_list_to_import);
+    Io(ar, x.node_list);
+    Io(ar, x.camera_settings);
+}
+
+template<class A> void Io(A& ar, FlexBodyWheel& x)
+{
+    Io(ar, static_cast<BaseWheel2&>(x));
+    Io(ar, x.side);
+    Io(ar, x.rim_springiness);
+    Io(ar, x.rim_damping);
+    Io(ar, x.rim_mesh_name);
+    Io(ar, x.tyre_mesh_name);
+}
+
+template<class A> void Io(A& ar, Fusedrag& x)
+{
+    Io(ar, x.autocalc);
+    Io(ar, x.front_node);
+    Io(ar, x.rear_node);
+    Io(ar, x.approximate_width);
+    Io(ar, x.airfoil_name);
+    Io(ar, x.area_coefficient);
+}
+
+template<class A> void Io(A& ar, Hook& x)
+{
+    Io(ar, x.node);
+    Io(ar, x.flags);
+    Io(ar, x.option_hook_range);
+    Io(ar, x.option_speed_coef);
+    Io(ar, x.option_max_force);
+    Io(ar, x.option_hookgroup);
+    Io(ar, x.option_lockgroup);
+    Io(ar, x.option_timer);
+    Io(ar, x.option_min_range_meters);
+}
+
+template<class A> void Io(A& ar, Shock& x)
+{
+    Io(ar, x.nodes);
+    Io(ar, x.spring_rate);
+    Io(ar, x.damping);
+    Io(ar, x.short_bound);
+    Io(ar, x.long_bound);
+    Io(ar, x.precompression);
+    Io(ar, x.options);
+    Io(ar, x.beam_defaults);
+    Io(ar, x.detacher_group);
+}
+
+template<class A> void Io(A& ar, Shock2& x)
+{
+    Io(ar, x.nodes);
+    Io(ar, x.spring_in);
+    Io(ar, x.damp_in);
+    Io(ar, x.progress_factor_spring_in);
+    Io(ar, x.progress_factor_damp_in);
+    Io(ar, x.spring_out);
+    Io(ar, x.damp_out);
+    Io(ar, x.progress_factor_spring_out);
+    Io(ar, x.progress_factor_damp_out);
+    Io(ar, x.short_bound);
+    Io(ar, x.long_bound);
+    Io(ar, x.precompression);
+    Io(ar, x.options);
+    Io(ar, x.beam_defaults);
+    Io(ar, x.detacher_group);
+}
+
+template<class A> void Io(A& ar, SkeletonSettings& x)
+{
+    Io(ar, x.visibility_range_meters);
+    Io(ar, x.beam_thickness_meters);
+}
+
+template<class A> void Io(A& ar, Hydro& x)
+{
+    Io(ar, x.nodes);
+    Io(ar, x.lenghtening_factor);
+    Io(ar, x.options);
+    Io(ar, x.inertia);
+    Io(ar, x.inertia_defaults);
+    Io(ar, x.beam_defaults);
+    Io(ar, x.detacher_group);
+}
+
+template<class A> void Io(A& ar, AeroAnimator& x)
+{
+    Io(ar, x.flags);
+    Io(ar, x.motor);
+}
+
+template<class A> void Io(A& ar, Animator& x)
+{
+    Io(ar, x.nodes);
+    Io(ar, x.lenghtening_factor);
+    Io(ar, x.flags);
+    Io(ar, x.short_limit);
+    Io(ar, x.long_limit);
+    Io(ar, x.aero_animator);
+    Io(ar, x.inertia_defaults);
+    Io(ar, x.beam_defaults);
+    Io(ar, x.detacher_group);
+}
+
+template<class A> void Io(A& ar, Command2& x)
+{
+    Io(ar, x._format_version);
+    Io(ar, x.nodes);
+    Io(ar, x.shorten_rate);
+    Io(ar, x.lengthen_rate);
+    Io(ar, x.max_contraction);
+    Io(ar, x.max_extension);
+    Io(ar, x.contract_key);
+    Io(ar, x.extend_key);
+    Io(ar, x.description);
+    Io(ar, x.inertia);
+    Io(ar, x.affect_engine);
+    Io(ar, x.needs_engine);
+    Io(ar, x.plays_sound);
+    Io(ar, x.beam_defaults);
+    Io(ar, x.inertia_defaults);
+    Io(ar, x.detacher_group);
+    Io(ar, x.option_i_invisible);
+    Io(ar, x.option_r_rope);
+    Io(ar, x.option_c_auto_center);
+    Io(ar, x.option_f_not_faster);
+    Io(ar, x.option_p_1press);
+    Io(ar, x.option_o_1press_center);
+}
+
+template<class A> void Io(A& ar, Rotator& x)
+{
+    Io(ar, x.axis_nodes);
+    Io(ar, x.base_plate_nodes);
+    Io(ar, x.rotating_plate_nodes);
+    Io(ar, x.rate);
+    Io(ar, x.spin_left_key);
+    Io(ar, x.spin_right_key);
+    Io(ar, x.inertia);
+    Io(ar, x.inertia_defaults);
+    Io(ar, x.engine_coupling);
+    Io(ar, x.needs_engine);
+}
+
+template<class A> void Io(A& ar, Rotator2& x)
+{
+    Io(ar, static_cast<Rotator&>(x));
+    Io(ar, x.rotating_force);
+    Io(ar, x.tolerance);
+    Io(ar, x.description);
+}
+
+template<class A> void Io(A& ar, Trigger& x)
+{
+    Io(ar, x.nodes);
+    Io(ar, x.contraction_trigger_limit);
+    Io(ar, x.expansion_trigger_limit);
+    Io(ar, x.options);
+    Io(ar, x.boundary_timer);
+    Io(ar, x.beam_defaults);
+    Io(ar, x.detacher_group);
+    Io(ar, x.shortbound_trigger_action);
+    Io(ar, x.longbound_trigger_action);
+}
+
+template<class A> void Io(A& ar, Lockgroup& x)
+{
+    Io(ar, x.number);
+    Io(ar, x.nodes);
+}
+
+template<class A> void Io(A& ar, ManagedMaterial& x)
+{
+    Io(ar, x.name);
+    Io(ar, x.type);
+    Io(ar, x.options);
+    Io(ar, x.diffuse_map);
+    Io(ar, x.damaged_diffuse_map);
+    Io(ar, x.specular_map);
+}
+
+template<class A> void Io(A& ar, MaterialFlareBinding& x)
+{
+    Io(ar, x.flare_number);
+    Io(ar, x.material_name);
+}
+
+template<class A> void Io(A& ar, NodeCollision& x)
+{
+    Io(ar, x.node);
+    Io(ar, x.radius);
+}
+
+template<class A> void Io(A& ar, Particle& x)
+{
+    Io(ar, x.emitter_node);
+    Io(ar, x.reference_node);
+    Io(ar, x.particle_system_name);
+}
+
+template<class A> void Io(A& ar, Pistonprop& x)
+{
+    Io(ar, x.reference_node);
+    Io(ar, x.axis_node);
+    Io(ar, x.blade_tip_nodes);
+    Io(ar, x.couple_node);
+    Io(ar, x.turbine_power_kW);
+    Io(ar, x.pitch);
+    Io(ar, x.airfoil);
+}
+
+template<class A> void Io(A& ar, Prop::DashboardSpecial& x)
+{
+    Io(ar, x.offset);
+    Io(ar, x._offset_is_set);
+    Io(ar, x.rotation_angle);
+    Io(ar, x.mesh_name);
+}
+
+template<class A> void Io(A& ar, Prop::BeaconSpecial& x)
+{
+    Io(ar, x.flare_material_name);
+    Io(ar, x.color);
+}
+
+template<class A> void Io(A& ar, Prop& x)
+{
+    Io(ar, x.reference_node);
+    Io(ar, x.x_axis_node);
+    Io(ar, x.y_axis_node);
+    Io(ar, x.offset);
+    Io(ar, x.rotation);
+    Io(ar, x.mesh_name);
+    Io(ar, x.animations);
+    Io(ar, x.camera_settings);
+    Io(ar, x.special);
+    Io(ar, x.special_prop_beacon);
+    Io(ar, x.special_prop_dashboard);
+}
+
+template<class A> void Io(A& ar, RailGroup& x)
+{
+    Io(ar, x.id);
+    Io(ar, x.node_list);
+}
+
+template<class A> void Io(A& ar, Ropable& x)
+{
+    Io(ar, x.node);
+    Io(ar, x.group);
+    Io(ar, x.has_multilock);
+}
+
+template<class A> void Io(A& ar, Rope& x)
+{
+    Io(ar, x.root_node);
+    Io(ar, x.end_node);
+    Io(ar, x.invisible);
+    Io(ar, x.beam_defaults);
+    Io(ar, x.detacher_group);
+}
+
+template<class A> void Io(A& ar, Screwprop& x)
+{
+    Io(ar, x.prop_node);
+    Io(ar, x.back_node);
+    Io(ar, x.top_node);
+    Io(ar, x.power);
+}
+
+template<class A> void Io(A& ar, SlideNode& x)
+{
+    Io(ar, x.slide_node);
+    Io(ar, x.rail_node_ranges);
+    Io(ar, x.spring_rate);
+    Io(ar, x.break_force);
+    Io(ar, x.tolerance);
+    Io(ar, x.railgroup_id);
+    Io(ar, x._railgroup_id_set);
+    Io(ar, x.attachment_rate);
+    Io(ar, x.max_attachment_distance);
+    Io(ar, x._break_force_set);
+    Io(ar, x.constraint_flags);
+}
+
+template<class A> void Io(A& ar, SoundSource& x)
+{
+    Io(ar, x.node);
+    Io(ar, x.sound_script_name);
+}
+
+template<class A> void Io(A& ar, SoundSource2& x)
+{
+    Io(ar, static_cast<SoundSource&>(x));
+    Io(ar, x.mode);
+    Io(ar, x.cinecam_index);
+}
+
+template<class A> void Io(A& ar, SpeedLimiter& x)
+{
+    Io(ar, x.max_speed);
+    Io(ar, x.is_enabled);
+}
+
+template<class A> void Io(A& ar, Cab& x)
+{
+    Io(ar, x.nodes);
+    Io(ar, x.options);
+}
+
+template<class A> void Io(A& ar, Texcoord& x)
+{
+    Io(ar, x.node);
+    Io(ar, x.u);
+    Io(ar, x.v);
+}
+
+template<class A> void Io(A& ar, Submesh& x)
+{
+    Io(ar, x.backmesh);
+    Io(ar, x.texcoords);
+    Io(ar, x.cab_triangles);
+}
+
+template<class A> void Io(A& ar, Tie& x)
+{
+    Io(ar, x.root_node);
+    Io(ar, x.max_reach_length);
+    Io(ar, x.auto_shorten_rate);
+    Io(ar, x.min_length);
+    Io(ar, x.max_length);
+    Io(ar, x.is_invisible);
+    Io(ar, x.max_stress);
+    Io(ar, x.beam_defaults);
+    Io(ar, x.detacher_group);
+    Io(ar, x.group);
+}
+
+template<class A> void Io(A& ar, TorqueCurve::Sample& x)
+{
+    Io(ar, x.power);
+    Io(ar, x.torque_percent);
+}
+
+template<class A> void Io(A& ar, TorqueCurve& x)
+{
+    Io(ar, x.samples);
+    Io(ar, x.predefined_func_name);
+}
+
+template<class A> void Io(A& ar, Turbojet& x)
+{
+    Io(ar, x.front_node);
+    Io(ar, x.back_node);
+    Io(ar, x.side_node);
+    Io(ar, x.is_reversable);
+    Io(ar, x.dry_thrust);
+    Io(ar, x.wet_thrust);
+    Io(ar, x.front_diameter);
+    Io(ar, x.back_diameter);
+    Io(ar, x.nozzle_length);
+}
+
+template<class A> void Io(A& ar, Turboprop2& x)
+{
+    Io(ar, x.reference_node);
+    Io(ar, x.axis_node);
+    Io(ar, x.blade_tip_nodes);
+    Io(ar, x.turbine_power_kW);
+    Io(ar, x.airfoil);
+    Io(ar, x.couple_node);
+    Io(ar, x._format_version);
+}
+
+template<class A> void Io(A& ar, VideoCamera& x)
+{
+    Io(ar, x.reference_node);
+    Io(ar, x.left_node);
+    Io(ar, x.bottom_node);
+    Io(ar, x.alt_reference_node);
+    Io(ar, x.alt_orientation_node);
+    Io(ar, x.offset);
+    Io(ar, x.rotation);
+    Io(ar, x.field_of_view);
+    Io(ar, x.texture_width);
+    Io(ar, x.texture_height);
+    Io(ar, x.min_clip_distance);
+    Io(ar, x.max_clip_distance);
+    Io(ar, x.camera_role);
+    Io(ar, x.camera_mode);
+    Io(ar, x.material_name);
+    Io(ar, x.camera_name);
+}
+
+template<class A> void Io(A& ar, Wing& x)
+{
+    Io(ar, x.nodes);
+    Io(ar, x.tex_coords);
+    Io(ar, x.control_surface);
+    Io(ar, x.chord_point);
+    Io(ar, x.min_deflection);
+    Io(ar, x.max_deflection);
+    Io(ar, x.airfoil);
+    Io(ar, x.efficacy_coef);
+}
+
+// ----------------------------------------------------------------------------
+// Root document
+
+template<class A> void Io(A& ar, File::Module& x)
+{
+    Io(ar, x.name);
+    Io(ar, x.help_panel_material_name);
+    Io(ar, x.contacter_nodes);
+    Io(ar, x.airbrakes);
+    Io(ar, x.animators);
+    Io(ar, x.anti_lock_brakes);
+    Io(ar, x.axles);
+    Io(ar, x.beams);
+    Io(ar, x.brakes);
+    Io(ar, x.cameras);
+    Io(ar, x.camera_rails);
+    Io(ar, x.collision_boxes);
+    Io(ar, x.cinecam);
+    Io(ar, x.commands_2);
+    Io(ar, x.cruise_control);
+    Io(ar, x.contacters);
+    Io(ar, x.engine);
+    Io(ar, x.engoption);
+    Io(ar, x.engturbo);
+    Io(ar, x.exhausts);
+    Io(ar, x.ext_camera);
+    Io(ar, x.fixes);
+    Io(ar, x.flares_2);
+    Io(ar, x.flexbodies);
+    Io(ar, x.flex_body_wheels);
+    Io(ar, x.fusedrag);
+    Io(ar, x.globals);
+    Io(ar, x.gui_settings);
+    Io(ar, x.hooks);
+    Io(ar, x.hydros);
+    Io(ar, x.lockgroups);
+    Io(ar, x.managed_materials);
+    Io(ar, x.material_flare_bindings);
+    Io(ar, x.mesh_wheels);
+    Io(ar, x.nodes);
+    Io(ar, x.node_collisions);
+    Io(ar, x.particles);
+    Io(ar, x.pistonprops);
+    Io(ar, x.props);
+    Io(ar, x.railgroups);
+    Io(ar, x.ropables);
+    Io(ar, x.ropes);
+    Io(ar, x.rotators);
+    Io(ar, x.rotators_2);
+    Io(ar, x.screwprops);
+    Io(ar, x.shocks);
+    Io(ar, x.shocks_2);
+    Io(ar, x.skeleton_settings);
+    Io(ar, x.slidenodes);
+    Io(ar, x.slope_brake);
+    Io(ar, x.soundsources);
+    Io(ar, x.soundsources2);
+    Io(ar, x.speed_limiter);
+    Io(ar, x.submeshes_ground_model_name);
+    Io(ar, x.submeshes);
+    Io(ar, x.ties);
+    Io(ar, x.torque_curve);
+    Io(ar, x.traction_control);
+    Io(ar, x.triggers);
+    Io(ar, x.turbojets);
+    Io(ar, x.turboprops_2);
+    Io(ar, x.videocameras);
+    Io(ar, x.wheeldetachers);
+    Io(ar, x.wheels);
+    Io(ar, x.wheels_2);
+    Io(ar, x.wings);
+}
+
+template<class A> void Io(A& ar, File& x)
+{
+    Io(ar, x.file_format_version);
+    Io(ar, x.guid);
+    Io(ar, x.description);
+    Io(ar, x.hide_in_chooser);
+    Io(ar, x.enable_advanced_deformation);
+    Io(ar, x.slide_nodes_connect_instantly);
+    Io(ar, x.rollon);
+    Io(ar, x.forward_commands);
+    Io(ar, x.import_commands);
+    Io(ar, x.lockgroup_default_nolock);
+    Io(ar, x.rescuer);
+    Io(ar, x.disable_default_sounds);
+    Io(ar, x.name);
+    Io(ar, x.collision_range);
+    Io(ar, x.minimum_mass);
+    Io(ar, x._minimum_mass_set);
+    Io(ar, x.root_module);
+    Io(ar, x.user_modules);
+    Io(ar, x.authors);
+    Io(ar, x.file_info);
+}
+
+template<class A> void Io(A& ar, ParseReport& x)
+{
+    Io(ar, x.num_errors);
+    Io(ar, x.num_warnings);
+    Io(ar, x.num_other);
+    Io(ar, x.text);
+    Io(ar, x.importer_enabled);
+    Io(ar, x.importer_num_errors);
+    Io(ar, x.importer_num_warnings);
+    Io(ar, x.importer_num_other);
+    Io(ar, x.importer_text);
+    Io(ar, x.resource_checks);
+}
+
+// ----------------------------------------------------------------------------
+
+std::string HashText(std::string const& text)
+{
+    RoR::CSHA1 sha1;
+    sha1.UpdateHash(reinterpret_cast<uint8_t*>(const_cast<char*>(text.data())), static_cast<uint32_t>(text.size()));
+    sha1.Final();
+    char hash[41] = {};
+    sha1.ReportHash(hash, RoR::CSHA1::REPORT_HEX_SHORT);
+    return std::string(hash);
+}
+
+/// The parse result depends on which textures were found; see Parser::GetResourceChecks()
+bool ResourcesUnchanged(std::map<std::string, bool> const& resource_checks)
+{
+    for (auto& check : resource_checks)
+    {
+        if (RoR::CacheSystem::resourceExistsInAllGroups(check.first) != check.second)
+            return false;
+    }
+    return true;
+}
+
+int CurrentProcessId()
+{
+#ifdef _WIN32
+    return _getpid();
+#else
+    return static_cast<int>(getpid());
+#endif
+}
+
+bool WriteCacheFile(std::string const& filename, std::vector<char> const& data)
+{
+    // Write aside and rename, so a concurrent or crashed write never leaves a truncated cache file behind.
+    // The temporary name is unique per process and call; game instances and scan threads share the directory.
+    static std::atomic<unsigned int> tmp_counter(0);
+    const std::string tmp_filename = filename + "." + TOSTRING(CurrentProcessId()) + "-" + TOSTRING(tmp_counter++) + ".tmp";
+    FILE* file = fopen(tmp_filename.c_str(), "wb");
+    if (!file)
+        return false;
+    bool ok = (fwrite(data.data(), 1, data.size(), file) == data.size());
+    ok = (fclose(file) == 0) && ok;
+    if (ok)
+    {
+        remove(filename.c_str()); // Windows doesn't replace on rename
+        ok = (rename(tmp_filename.c_str(), filename.c_str()) == 0);
+    }
+    if (!ok)
+        remove(tmp_filename.c_str());
+    return ok;
+}
+
+} // namespace
+
+ParseReport::ParseReport():
+    num_errors(0),
+    num_warnings(0),
+    num_other(0),
+    importer_enabled(false),
+    importer_num_errors(0),
+    importer_num_warnings(0),
+    importer_num_other(0)
+{}
+
+void BinaryCache::Serialize(File const& file, ParseReport const& report, std::string const& source_hash, std::vector<char>& out)
+{
+    out.clear();
+    out.resize(sizeof(CacheHeader));
+
+    // The Io() functions take mutable references for the sake of reading; Writer doesn't modify anything.
+    Writer writer(out);
+    Io(writer, const_cast<ParseReport&>(report));
+    Io(writer, const_cast<File&>(file));
+
+    CacheHeader header;
+    memset(&header, 0, sizeof(header));
+    memcpy(header.magic, CACHE_MAGIC, sizeof(header.magic));
+    header.file_format_version = FILE_FORMAT_VERSION;
+    strncpy(header.source_hash, source_hash.c_str(), sizeof(header.source_hash));
+    header.payload_size = out.size() - sizeof(CacheHeader);
+    memcpy(out.data(), &header, sizeof(header));
+}
+
+std::shared_ptr<File> BinaryCache::Deserialize(const char* data, size_t size, std::string const& source_hash, ParseReport& report)
+{
+    CacheHeader header;
+    if (size < sizeof(header))
+        return nullptr;
+    memcpy(&header, data, sizeof(header));
+
+    char expected_hash[sizeof(header.source_hash)] = {};
+    strncpy(expected_hash, source_hash.c_str(), sizeof(expected_hash));
+    if (memcmp(header.magic, CACHE_MAGIC, sizeof(header.magic)) != 0 ||
+        header.file_format_version != FILE_FORMAT_VERSION ||
+        memcmp(header.source_hash, expected_hash, sizeof(expected_hash)) != 0 ||
+        header.payload_size != size - sizeof(header))
+    {
+        return nullptr;
+    }
+
+    ParseReport loaded_report;
+    std::shared_ptr<File> file = std::make_shared<File>();
+    Reader reader(data + sizeof(header), size - sizeof(header));
+    Io(reader, loaded_report);
+    Io(reader, *file);
+    if (!reader.IsOk() || !reader.IsAtEnd() || !file->root_module)
+        return nullptr;
+
+    report = loaded_report;
+    return file;
+}
+
+void BinaryCache::TrimCacheDir()
+{
+    const size_t max_size = static_cast<size_t>(std::max(0, ISETTING("RigDef Binary Cache Size", 256))) * 1024 * 1024;
+    const std::string cache_dir = RoR::App::GetSysCacheDir();
+
+    Ogre::FileSystemArchiveFactory factory;
+#ifdef ROR_USE_OGRE_1_9
+    Ogre::Archive* archive = factory.createInstance(cache_dir, true);
+#else
+    Ogre::Archive* archive = factory.createInstance(cache_dir);
+#endif
+
+    // Leftovers of crashed writes; anything this old isn't being written anymore
+    const std::time_t now = std::time(nullptr);
+    Ogre::StringVectorPtr tmp_files = archive->find("*.rigdef.*.tmp", false, false);
+    for (std::string const& tmp_file : *tmp_files)
+    {
+        if (now - archive->getModifiedTime(tmp_file) > 60 * 60)
+            remove((cache_dir + PATH_SLASH + tmp_file).c_str());
+    }
+
+    struct CacheFile
+    {
+        std::string  filename;
+        std::time_t  modified;
+        size_t       size;
+    };
+    std::vector<CacheFile> files;
+    size_t total_size = 0;
+    Ogre::FileInfoListPtr file_infos = archive->findFileInfo("*.rigdef", false, false);
+    for (Ogre::FileInfo const& info : *file_infos)
+    {
+        CacheFile file;
+        file.filename = info.filename;
+        file.modified = archive->getModifiedTime(info.filename);
+        file.size     = info.uncompressedSize;
+        files.push_back(file);
+        total_size += file.size;
+    }
+    factory.destroyInstance(archive);
+
+    if (total_size <= max_size)
+        return;
+
+    // Oldest first. Cache hits don't touch the files, so this evicts by write time.
+    std::sort(files.begin(), files.end(), [](CacheFile const& a, CacheFile const& b) { return a.modified < b.modified; });
+    size_t num_removed = 0;
+    for (CacheFile const& file : files)
+    {
+        if (total_size <= max_size)
+            break;
+        if (remove((cache_dir + PATH_SLASH + file.filename).c_str()) == 0)
+        {
+            total_size -= file.size;
+            ++num_removed;
+        }
+    }
+    LOG("[RoR|RigDef] Removed " + TOSTRING(num_removed) + " old file(s) from the binary cache");
+}
+
+std::shared_ptr<File> BinaryCache::LoadOrParse(Ogre::DataStreamPtr stream, ParseReport& report)
+{
+    std::string text = stream->getAsString();
+    const std::string source_hash = HashText(text);
+    const std::string cache_filename = RoR::App::GetSysCacheDir() + PATH_SLASH + source_hash + ".rigdef";
+
+    // The importer diagnostics need a live SequentialImporter
+    const bool use_cache = BSETTING("RigDef Binary Cache", true);
+    const bool fresh_parse = RoR::App::GetDiagRigLogNodeStats() || RoR::App::GetDiagRigLogNodeImport();
+
+    if (use_cache && !fresh_parse)
+    {
+        RoR::MappedFile cache_file;
+        if (cache_file.Open(cache_filename))
+        {
+            std::shared_ptr<File> file = BinaryCache::Deserialize(cache_file.GetData(), cache_file.GetSize(), source_hash, report);
+            if (file && ResourcesUnchanged(report.resource_checks))
+                return file;
+            LOG("[RoR|RigDef] Ignoring outdated or damaged cache file: " + cache_filename);
+        }
+    }
+
+    Parser parser;
+    parser.Prepare();
+    Ogre::MemoryDataStream text_stream(&text[0], text.size(), false, true);
+    parser.ProcessOgreStream(&text_stream);
+    parser.Finalize();
+
+    report = ParseReport();
+    report.num_errors   = parser.GetMessagesNumErrors();
+    report.num_warnings = parser.GetMessagesNumWarnings();
+    report.num_other    = parser.GetMessagesNumOther();
+    report.text         = parser.ProcessMessagesToString();
+    report.resource_checks = parser.GetResourceChecks();
+
+    SequentialImporter* importer = parser.GetSequentialImporter();
+    report.importer_enabled = importer->IsEnabled();
+    if (importer->IsEnabled())
+    {
+        report.importer_num_errors   = importer->GetMessagesNumErrors();
+        report.importer_num_warnings = importer->GetMessagesNumWarnings();
+        report.importer_num_other    = importer->GetMessagesNumOther();
+        report.importer_text         = importer->ProcessMessagesToString();
+        if (RoR::App::GetDiagRigLogNodeStats())
+            report.importer_node_stats = importer->GetNodeStatistics();
+        if (RoR::App::GetDiagRigLogNodeImport())
+            report.importer_node_list = importer->IterateAndPrintAllNodes();
+    }
+
+    if (use_cache)
+    {
+        std::vector<char> data;
+        BinaryCache::Serialize(*parser.GetFile(), report, source_hash, data);
+        if (!WriteCacheFile(cache_filename, data))
+            LOG("[RoR|RigDef] Failed to write cache file: " + cache_filename);
+    }
+
+    return parser.GetFile();
+}
@@ -0,0 +1,86 @@
+/*
+    This source file is part of Rigs of Rods
+    Copyright 2013-2017 Petr Ohlidal & contributors
+
+    For more information, see http://www.rigsofrods.org/
+
+    Rigs of Rods is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License version 3, as
+    published by the Free Software Foundation.
+
+    Rigs of Rods is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with Rigs of Rods. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+/// @file
+/// @brief Binary cache of parsed rig-def files, so vehicles can be loaded without running the Parser.
+
+#pragma once
+
+#include "RigDef_File.h"
+
+#include <OgreDataStream.h>
+
+#include <map>
+#include <memory>
+#include <string>
+#include <vector>
+
+namespace RigDef
+{
+
+/// Messages of the Parser and SequentialImporter. Stored with the cached File,
+/// so a cached load reports the same as parsing.
+struct ParseReport
+{
+    ParseReport();
+
+    int         num_errors;
+    int         num_warnings;
+    int         num_other;
+    std::string text;                  ///< Parser::ProcessMessagesToString()
+
+    bool        importer_enabled;
+    int         importer_num_errors;
+    int         importer_num_warnings;
+    int         importer_num_other;
+    std::string importer_text;         ///< SequentialImporter::ProcessMessagesToString()
+
+    std::map<std::string, bool> resource_checks; ///< Parser::GetResourceChecks(); a cached File is only valid while these hold
+
+    // Only filled by a fresh parse with the 'RigImporter_*' diagnostic options; these bypass the cache.
+    std::string importer_node_stats;   ///< SequentialImporter::GetNodeStatistics()
+    std::string importer_node_list;    ///< SequentialImporter::IterateAndPrintAllNodes()
+};
+
+/// Versioned binary image of a parsed File.
+///
+/// Files are keyed by SHA1 of the rig-def text, so the key is the same for loose files
+/// and zipped mods and any edit invalidates it. The image is memory-mapped and decoded
+/// field by field; there's no regex matching or node resolving involved.
+///
+/// IMPORTANT! If you add/change a member of any struct in RigDef_File.h, update its
+/// Io() function in RigDef_BinaryCache.cpp and increase FILE_FORMAT_VERSION.
+class BinaryCache
+{
+public:
+    static const unsigned int FILE_FORMAT_VERSION = 2;
+
+    /// Parses the stream, or loads the result of an earlier parse of identical text from the cache directory.
+    /// Newly parsed files are saved to the cache. Setting 'RigDef Binary Cache' (default Yes) turns this off.
+    static std::shared_ptr<File> LoadOrParse(Ogre::DataStreamPtr stream, ParseReport& report);
+
+    /// Removes the oldest cache files once the directory exceeds setting 'RigDef Binary Cache Size' (MB, default 256).
+    static void                  TrimCacheDir();
+
+    static void                  Serialize(File const& file, ParseReport const& report, std::string const& source_hash, std::vector<char>& out);
+    /// @return nullptr if the data were written by a different FILE_FORMAT_VERSION, for different source text, or are damaged.
+    static std::shared_ptr<File> Deserialize(const char* data, size_t size, std::string const& source_hash, ParseReport& report);
+};
+
+} // namespace RigDef
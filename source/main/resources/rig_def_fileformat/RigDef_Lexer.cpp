@@ -0,0 +1,377 @@
+/*
+    This source file is part of Rigs of Rods
+    Copyright 2013-2017 Petr Ohlidal & contributors
+
+    For more information, see http://www.rigsofrods.org/
+
+    Rigs of Rods is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License version 3, as
+    published by the Free Software Foundation.
+
+    Rigs of Rods is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with Rigs of Rods. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "RigDef_Lexer.h"
+
+#include <cstdint>
+#include <cstring>
+
+using namespace RigDef;
+
+namespace {
+
+/// How the rest of the line must look; see E_KEYWORD_* in RigDef_Regexes.h
+enum KeywordForm
+{
+    FORM_BLOCK,           ///< Keyword on its own line, trailing blanks allowed
+    FORM_INLINE,          ///< Keyword, blank(s), anything
+    FORM_INLINE_TOLERANT, ///< Keyword, blank(s) or comma(s), anything
+};
+
+struct KeywordDef
+{
+    const char*   name;
+    File::Keyword keyword;
+    KeywordForm   form;
+};
+
+// IMPORTANT! Keep in sync with IDENTIFY_KEYWORD_REGEX_STRING in RigDef_Regexes.h
+const KeywordDef KEYWORDS[] =
+{
+    { "add_animation",                File::KEYWORD_ADD_ANIMATION,            FORM_INLINE_TOLERANT },
+    { "airbrakes",                    File::KEYWORD_AIRBRAKES,                FORM_BLOCK  },
+    { "animators",                    File::KEYWORD_ANIMATORS,                FORM_BLOCK  },
+    { "AntiLockBrakes",               File::KEYWORD_ANTI_LOCK_BRAKES,         FORM_INLINE },
+    { "axles",                        File::KEYWORD_AXLES,                    FORM_BLOCK  },
+    { "author",                       File::KEYWORD_AUTHOR,                   FORM_INLINE },
+    { "backmesh",                     File::KEYWORD_BACKMESH,                 FORM_BLOCK  },
+    { "beams",                        File::KEYWORD_BEAMS,                    FORM_BLOCK  },
+    { "brakes",                       File::KEYWORD_BRAKES,                   FORM_BLOCK  },
+    { "cab",                          File::KEYWORD_CAB,                      FORM_BLOCK  },
+    { "camerarail",                   File::KEYWORD_CAMERARAIL,               FORM_BLOCK  },
+    { "cameras",                      File::KEYWORD_CAMERAS,                  FORM_BLOCK  },
+    { "cinecam",                      File::KEYWORD_CINECAM,                  FORM_BLOCK  },
+    { "collisionboxes",               File::KEYWORD_COLLISIONBOXES,           FORM_BLOCK  },
+    { "commands",                     File::KEYWORD_COMMANDS,                 FORM_BLOCK  },
+    { "commands2",                    File::KEYWORD_COMMANDS2,                FORM_BLOCK  },
+    { "contacters",                   File::KEYWORD_CONTACTERS,               FORM_BLOCK  },
+    { "cruisecontrol",                File::KEYWORD_CRUISECONTROL,            FORM_INLINE },
+    { "description",                  File::KEYWORD_DESCRIPTION,              FORM_BLOCK  },
+    { "detacher_group",               File::KEYWORD_DETACHER_GROUP,           FORM_INLINE },
+    { "disabledefaultsounds",         File::KEYWORD_DISABLEDEFAULTSOUNDS,     FORM_BLOCK  },
+    { "enable_advanced_deformation",  File::KEYWORD_ENABLE_ADVANCED_DEFORM,   FORM_BLOCK  },
+    { "end",                          File::KEYWORD_END,                      FORM_BLOCK  },
+    { "end_section",                  File::KEYWORD_END_SECTION,              FORM_BLOCK  },
+    { "engine",                       File::KEYWORD_ENGINE,                   FORM_BLOCK  },
+    { "engoption",                    File::KEYWORD_ENGOPTION,                FORM_BLOCK  },
+    { "engturbo",                     File::KEYWORD_ENGTURBO,                 FORM_BLOCK  },
+    { "envmap",                       File::KEYWORD_ENVMAP,                   FORM_BLOCK  },
+    { "exhausts",                     File::KEYWORD_EXHAUSTS,                 FORM_BLOCK  },
+    { "extcamera",                    File::KEYWORD_EXTCAMERA,                FORM_INLINE },
+    { "fileformatversion",            File::KEYWORD_FILEFORMATVERSION,        FORM_INLINE },
+    { "fileinfo",                     File::KEYWORD_FILEINFO,                 FORM_INLINE },
+    { "fixes",                        File::KEYWORD_FIXES,                    FORM_BLOCK  },
+    { "flares",                       File::KEYWORD_FLARES,                   FORM_BLOCK  },
+    { "flares2",                      File::KEYWORD_FLARES2,                  FORM_BLOCK  },
+    { "flexbodies",                   File::KEYWORD_FLEXBODIES,               FORM_BLOCK  },
+    { "flexbody_camera_mode",         File::KEYWORD_FLEXBODY_CAMERA_MODE,     FORM_INLINE },
+    { "flexbodywheels",               File::KEYWORD_FLEXBODYWHEELS,           FORM_BLOCK  },
+    { "forwardcommands",              File::KEYWORD_FORWARDCOMMANDS,          FORM_BLOCK  },
+    { "fusedrag",                     File::KEYWORD_FUSEDRAG,                 FORM_BLOCK  },
+    { "globals",                      File::KEYWORD_GLOBALS,                  FORM_BLOCK  },
+    { "guid",                         File::KEYWORD_GUID,                     FORM_INLINE },
+    { "guisettings",                  File::KEYWORD_GUISETTINGS,              FORM_BLOCK  },
+    { "help",                         File::KEYWORD_HELP,                     FORM_BLOCK  },
+    { "hideInChooser",                File::KEYWORD_HIDE_IN_CHOOSER,          FORM_BLOCK  },
+    { "hookgroup",                    File::KEYWORD_HOOKGROUP,                FORM_BLOCK  },
+    { "hooks",                        File::KEYWORD_HOOKS,                    FORM_BLOCK  },
+    { "hydros",                       File::KEYWORD_HYDROS,                   FORM_BLOCK  },
+    { "importcommands",               File::KEYWORD_IMPORTCOMMANDS,           FORM_BLOCK  },
+    { "lockgroups",                   File::KEYWORD_LOCKGROUPS,               FORM_BLOCK  },
+    { "lockgroup_default_nolock",     File::KEYWORD_LOCKGROUP_DEFAULT_NOLOCK, FORM_BLOCK  },
+    { "managedmaterials",             File::KEYWORD_MANAGEDMATERIALS,         FORM_BLOCK  },
+    { "materialflarebindings",        File::KEYWORD_MATERIALFLAREBINDINGS,    FORM_BLOCK  },
+    { "meshwheels",                   File::KEYWORD_MESHWHEELS,               FORM_BLOCK  },
+    { "meshwheels2",                  File::KEYWORD_MESHWHEELS2,              FORM_BLOCK  },
+    { "minimass",                     File::KEYWORD_MINIMASS,                 FORM_BLOCK  },
+    { "nodecollision",                File::KEYWORD_NODECOLLISION,            FORM_BLOCK  },
+    { "nodes",                        File::KEYWORD_NODES,                    FORM_BLOCK  },
+    { "nodes2",                       File::KEYWORD_NODES2,                   FORM_BLOCK  },
+    { "particles",                    File::KEYWORD_PARTICLES,                FORM_BLOCK  },
+    { "pistonprops",                  File::KEYWORD_PISTONPROPS,              FORM_BLOCK  },
+    { "prop_camera_mode",             File::KEYWORD_PROP_CAMERA_MODE,         FORM_INLINE },
+    { "props",                        File::KEYWORD_PROPS,                    FORM_BLOCK  },
+    { "railgroups",                   File::KEYWORD_RAILGROUPS,               FORM_BLOCK  },
+    { "rescuer",                      File::KEYWORD_RESCUER,                  FORM_BLOCK  },
+    { "rigidifiers",                  File::KEYWORD_RIGIDIFIERS,              FORM_BLOCK  },
+    { "rollon",                       File::KEYWORD_ROLLON,                   FORM_BLOCK  },
+    { "ropables",                     File::KEYWORD_ROPABLES,                 FORM_BLOCK  },
+    { "ropes",                        File::KEYWORD_ROPES,                    FORM_BLOCK  },
+    { "rotators",                     File::KEYWORD_ROTATORS,                 FORM_BLOCK  },
+    { "rotators2",                    File::KEYWORD_ROTATORS2,                FORM_BLOCK  },
+    { "screwprops",                   File::KEYWORD_SCREWPROPS,               FORM_BLOCK  },
+    { "section",                      File::KEYWORD_SECTION,                  FORM_INLINE },
+    { "sectionconfig",                File::KEYWORD_SECTIONCONFIG,            FORM_INLINE },
+    { "set_beam_defaults",            File::KEYWORD_SET_BEAM_DEFAULTS,        FORM_INLINE },
+    { "set_beam_defaults_scale",      File::KEYWORD_SET_BEAM_DEFAULTS_SCALE,  FORM_INLINE },
+    { "set_collision_range",          File::KEYWORD_SET_COLLISION_RANGE,      FORM_INLINE },
+    { "set_inertia_defaults",         File::KEYWORD_SET_INERTIA_DEFAULTS,     FORM_INLINE },
+    { "set_managedmaterials_options", File::KEYWORD_SET_MANAGEDMATS_OPTIONS,  FORM_INLINE },
+    { "set_node_defaults",            File::KEYWORD_SET_NODE_DEFAULTS,        FORM_INLINE },
+    { "set_shadows",                  File::KEYWORD_SET_SHADOWS,              FORM_BLOCK  },
+    { "set_skeleton_settings",        File::KEYWORD_SET_SKELETON_SETTINGS,    FORM_INLINE },
+    { "shocks",                       File::KEYWORD_SHOCKS,                   FORM_BLOCK  },
+    { "shocks2",                      File::KEYWORD_SHOCKS2,                  FORM_BLOCK  },
+    { "slidenode_connect_instantly",  File::KEYWORD_SLIDENODE_CONNECT_INSTANT,FORM_BLOCK  },
+    { "slidenodes",                   File::KEYWORD_SLIDENODES,               FORM_BLOCK  },
+    { "SlopeBrake",                   File::KEYWORD_SLOPE_BRAKE,              FORM_INLINE },
+    { "soundsources",                 File::KEYWORD_SOUNDSOURCES,             FORM_BLOCK  },
+    { "soundsources2",                File::KEYWORD_SOUNDSOURCES2,            FORM_BLOCK  },
+    { "speedlimiter",                 File::KEYWORD_SPEEDLIMITER,             FORM_INLINE },
+    { "submesh",                      File::KEYWORD_SUBMESH,                  FORM_BLOCK  },
+    { "submesh_groundmodel",          File::KEYWORD_SUBMESH_GROUNDMODEL,      FORM_INLINE },
+    { "texcoords",                    File::KEYWORD_TEXCOORDS,                FORM_BLOCK  },
+    { "ties",                         File::KEYWORD_TIES,                     FORM_BLOCK  },
+    { "torquecurve",                  File::KEYWORD_TORQUECURVE,              FORM_BLOCK  },
+    { "TractionControl",              File::KEYWORD_TRACTION_CONTROL,         FORM_INLINE },
+    { "triggers",                     File::KEYWORD_TRIGGERS,                 FORM_BLOCK  },
+    { "turbojets",                    File::KEYWORD_TURBOJETS,                FORM_BLOCK  },
+    { "turboprops",                   File::KEYWORD_TURBOPROPS,               FORM_BLOCK  },
+    { "turboprops2",                  File::KEYWORD_TURBOPROPS2,              FORM_BLOCK  },
+    { "videocamera",                  File::KEYWORD_VIDEOCAMERA,              FORM_BLOCK  },
+    { "wheeldetachers",               File::KEYWORD_WHEELDETACHERS,           FORM_BLOCK  },
+    { "wheels",                       File::KEYWORD_WHEELS,                   FORM_BLOCK  },
+    { "wheels2",                      File::KEYWORD_WHEELS2,                  FORM_BLOCK  },
+    { "wings",                        File::KEYWORD_WINGS,                    FORM_BLOCK  },
+};
+
+const int NUM_KEYWORDS = sizeof(KEYWORDS) / sizeof(KeywordDef);
+const int KEYWORD_MAX_LENGTH = 28; // "set_managedmaterials_options"
+const int HASH_TABLE_SIZE = 4096;  // Power of 2; sparse enough to find a collision-free seed quickly
+
+inline bool IsBlank(char c)       { return (c == ' ') || (c == '\t'); }
+inline bool IsDigit(char c)       { return (c >= '0') && (c <= '9'); }
+inline char ToLowerAscii(char c)  { return ((c >= 'A') && (c <= 'Z')) ? (c + ('a' - 'A')) : c; }
+
+/// FNV-1a of the lowercased word, mixed with a seed
+inline uint32_t HashWord(const char* word, int len, uint32_t seed)
+{
+    uint32_t hash = 2166136261u ^ seed;
+    for (int i = 0; i < len; ++i)
+    {
+        hash ^= static_cast<uint8_t>(ToLowerAscii(word[i]));
+        hash *= 16777619u;
+    }
+    return (hash ^ (hash >> 15)) & (HASH_TABLE_SIZE - 1);
+}
+
+/// Keyword table without collisions; the seed is searched once, on first use.
+struct KeywordHashTable
+{
+    KeywordHashTable(): seed(0)
+    {
+        for (;; ++seed)
+        {
+            memset(slots, 0, sizeof(slots));
+            bool collision = false;
+            for (int i = 0; (i < NUM_KEYWORDS) && !collision; ++i)
+            {
+                uint8_t& slot = slots[HashWord(KEYWORDS[i].name, static_cast<int>(strlen(KEYWORDS[i].name)), seed)];
+                collision = (slot != 0);
+                slot = static_cast<uint8_t>(i + 1);
+            }
+            if (!collision)
+                return;
+        }
+    }
+
+    uint32_t seed;
+    uint8_t  slots[HASH_TABLE_SIZE]; ///< Index into KEYWORDS + 1; 0 = empty
+};
+
+KeywordHashTable const& GetKeywordHashTable()
+{
+    static KeywordHashTable table; // Thread-safe init (C++11)
+    return table;
+}
+
+} // namespace
+
+File::Keyword Lexer::IdentifyKeyword(const char* line, bool& out_lettercase_ok)
+{
+    out_lettercase_ok = true;
+
+    // Keyword names contain no delimiters, so the first word decides
+    int len = 0;
+    while ((line[len] != '\0') && !IsBlank(line[len]) && (line[len] != ','))
+    {
+        if (++len > KEYWORD_MAX_LENGTH)
+            return File::KEYWORD_INVALID;
+    }
+    if (len == 0)
+        return File::KEYWORD_INVALID;
+
+    KeywordHashTable const& table = GetKeywordHashTable();
+    const uint8_t slot = table.slots[HashWord(line, len, table.seed)];
+    if (slot == 0)
+        return File::KEYWORD_INVALID;
+    KeywordDef const& def = KEYWORDS[slot - 1];
+
+    bool exact_case = true;
+    for (int i = 0; i < len; ++i)
+    {
+        if (def.name[i] == '\0')
+            return File::KEYWORD_INVALID;
+        if (line[i] != def.name[i])
+        {
+            exact_case = false;
+            if (ToLowerAscii(line[i]) != ToLowerAscii(def.name[i]))
+                return File::KEYWORD_INVALID;
+        }
+    }
+    if (def.name[len] != '\0')
+        return File::KEYWORD_INVALID;
+
+    // Check the rest of line like the regex would
+    const char* rest = line + len;
+    switch (def.form)
+    {
+    case FORM_BLOCK:
+        while (IsBlank(*rest))
+            ++rest;
+        if (*rest != '\0')
+            return File::KEYWORD_INVALID;
+        break;
+
+    case FORM_INLINE:
+    case FORM_INLINE_TOLERANT:
+        if (!IsBlank(*rest) && !((def.form == FORM_INLINE_TOLERANT) && (*rest == ',')))
+            return File::KEYWORD_INVALID;
+        if (strpbrk(rest, "\r\n") != nullptr) // Regex '.' doesn't match line terminators
+            return File::KEYWORD_INVALID;
+        break;
+    }
+
+    out_lettercase_ok = exact_case;
+    return def.keyword;
+}
+
+bool Lexer::ParseReal(const char* str, int len, double& out_value)
+{
+    // Exact conversion: mantissa fits 53 bits and power of 10 is exactly representable
+    // (Clinger's fast path), so the result equals strtod()'s correctly rounded one.
+    static const double POW10[] =
+    {
+        1e0,  1e1,  1e2,  1e3,  1e4,  1e5,  1e6,  1e7,  1e8,  1e9,  1e10, 1e11,
+        1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22
+    };
+    const uint64_t MAX_EXACT_MANTISSA = (uint64_t(1) << 53);
+    const int MAX_DIGITS = 19; // Fits uint64_t without overflow checks
+
+    const char* pos = str;
+    const char* end = str + len;
+    bool negative = false;
+    if ((pos != end) && ((*pos == '-') || (*pos == '+')))
+    {
+        negative = (*pos == '-');
+        ++pos;
+    }
+
+    uint64_t mantissa = 0;
+    int num_digits = 0; // Significant digits
+    int exponent = 0;
+    bool any_digit = false;
+    for (; (pos != end) && IsDigit(*pos); ++pos)
+    {
+        any_digit = true;
+        if ((mantissa == 0) && (*pos == '0'))
+            continue;
+        if (++num_digits > MAX_DIGITS)
+            return false;
+        mantissa = (mantissa * 10) + (*pos - '0');
+    }
+    if ((pos != end) && (*pos == '.'))
+    {
+        for (++pos; (pos != end) && IsDigit(*pos); ++pos)
+        {
+            any_digit = true;
+            --exponent;
+            if ((mantissa == 0) && (*pos == '0'))
+                continue;
+            if (++num_digits > MAX_DIGITS)
+                return false;
+            mantissa = (mantissa * 10) + (*pos - '0');
+        }
+    }
+    if (!any_digit)
+        return false;
+
+    if ((pos != end) && ((*pos == 'e') || (*pos == 'E')))
+    {
+        ++pos;
+        bool exp_negative = false;
+        if ((pos != end) && ((*pos == '-') || (*pos == '+')))
+        {
+            exp_negative = (*pos == '-');
+            ++pos;
+        }
+        if ((pos == end) || !IsDigit(*pos))
+            return false; // strtod() would stop before the 'e'
+        int exp_value = 0;
+        for (; (pos != end) && IsDigit(*pos); ++pos)
+        {
+            if (exp_value > 1000)
+                return false;
+            exp_value = (exp_value * 10) + (*pos - '0');
+        }
+        exponent += (exp_negative) ? -exp_value : exp_value;
+    }
+
+    if (pos != end)
+        return false;
+
+    if (mantissa == 0)
+    {
+        out_value = (negative) ? -0.0 : 0.0;
+        return true;
+    }
+    if ((mantissa > MAX_EXACT_MANTISSA) || (exponent < -22) || (exponent > 22))
+        return false;
+
+    double value = static_cast<double>(mantissa);
+    value = (exponent < 0) ? (value / POW10[-exponent]) : (value * POW10[exponent]);
+    out_value = (negative) ? -value : value;
+    return true;
+}
+
+bool Lexer::ParseInt(const char* str, int len, int& out_value)
+{
+    const int MAX_DIGITS = 9;
+
+    const char* pos = str;
+    const char* end = str + len;
+    bool negative = false;
+    if ((pos != end) && ((*pos == '-') || (*pos == '+')))
+    {
+        negative = (*pos == '-');
+        ++pos;
+    }
+    if ((pos == end) || (end - pos > MAX_DIGITS))
+        return false;
+
+    int value = 0;
+    for (; pos != end; ++pos)
+    {
+        if (!IsDigit(*pos))
+            return false;
+        value = (value * 10) + (*pos - '0');
+    }
+    out_value = (negative) ? -value : value;
+    return true;
+}
@@ -0,0 +1,52 @@
+/*
+    This source file is part of Rigs of Rods
+    Copyright 2013-2017 Petr Ohlidal & contributors
+
+    For more information, see http://www.rigsofrods.org/
+
+    Rigs of Rods is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License version 3, as
+    published by the Free Software Foundation.
+
+    Rigs of Rods is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with Rigs of Rods. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+/// @file
+/// @brief Allocation-free keyword and number scanning for the rig-def Parser.
+
+#pragma once
+
+#include "RigDef_File.h"
+
+namespace RigDef
+{
+
+/// Replaces std::regex in the per-line work of the Parser.
+///
+/// Keywords are looked up in a perfect hash table. Number parsing only handles plain
+/// decimal notation which it can convert exactly; for anything else (hexadecimal, inf/nan,
+/// too many digits, trailing garbage) it returns false and the caller uses strtod()/strtol(),
+/// so results and error reporting are identical to the C library.
+class Lexer
+{
+public:
+    /// Matches the line against Regexes::IDENTIFY_KEYWORD_*; the line must be trimmed of leading whitespace.
+    /// @param out_lettercase_ok Set to false if the keyword only matched when ignoring lettercase.
+    static File::Keyword IdentifyKeyword(const char* line, bool& out_lettercase_ok);
+
+    /// Parses "[+-]digits[.digits][(e|E)[+-]digits]" spanning exactly `len` characters.
+    /// @return False if the text needs strtod().
+    static bool ParseReal(const char* str, int len, double& out_value);
+
+    /// Parses "[+-]digits" spanning exactly `len` characters; up to 9 digits, so the value fits any int/long.
+    /// @return False if the text needs strtol().
+    static bool ParseInt(const char* str, int len, int& out_value);
+};
+
+} // namespace RigDef
@@ -29,9 +29,11 @@
 #include "BeamConstants.h"
 #include "CacheSystem.h"
 #include "RigDef_File.h"
+#include "RigDef_Lexer.h"
 #include "RigDef_Regexes.h"
 #include "BitFlags.h"
 #include "RoRPrerequisites.h"
+#include "Settings.h"
 #include "Utils.h"
 
 #include <OgreException.h>
@@ -2250,7 +2252,11 @@ Node::Ref Parser::_ParseNodeRef(std::string const & node_id_str)
     if (m_sequential_importer.IsEnabled())
     {
         // Import of legacy fileformatversion
-        int node_id_num = STR_PARSE_INT(node_id_str);
+        int node_id_num = 0;
+        if (!Lexer::ParseInt(node_id_str.c_str(), static_cast<int>(node_id_str.size()), node_id_num))
+        {
+            node_id_num = STR_PARSE_INT(node_id_str);
+        }
         if (node_id_num < 0)
         {
             std::stringstream msg;
@@ -2747,16 +2753,16 @@ void Parser::ParseManagedMaterials()
         return;
     }
 
-    if (!RoR::App::GetCacheSystem()->resourceExistsInAllGroups(managed_mat.diffuse_map))
+    if (!this->CheckResourceExists(managed_mat.diffuse_map))
     {
         this->AddMessage(Message::TYPE_WARNING, "Missing texture file: " + managed_mat.diffuse_map);
     }
-    if (managed_mat.HasDamagedDiffuseMap() && !RoR::App::GetCacheSystem()->resourceExistsInAllGroups(managed_mat.damaged_diffuse_map))
+    if (managed_mat.HasDamagedDiffuseMap() && !this->CheckResourceExists(managed_mat.damaged_diffuse_map))
     {
         this->AddMessage(Message::TYPE_WARNING, "Missing texture file: " + managed_mat.damaged_diffuse_map);
         managed_mat.damaged_diffuse_map = "-";
     }
-    if (managed_mat.HasSpecularMap() && !RoR::App::GetCacheSystem()->resourceExistsInAllGroups(managed_mat.specular_map))
+    if (managed_mat.HasSpecularMap() && !this->CheckResourceExists(managed_mat.specular_map))
     {
         this->AddMessage(Message::TYPE_WARNING, "Missing texture file: " + managed_mat.specular_map);
         managed_mat.specular_map = "-";
@@ -3001,6 +3007,32 @@ File::Keyword Parser::IdentifyKeywordInCurrentLine()
         return File::KEYWORD_INVALID;
     }
 
+    bool lettercase_ok = true;
+    File::Keyword keyword = Lexer::IdentifyKeyword(m_current_line, lettercase_ok);
+    if (m_use_regex_keywords)
+    {
+        // Validation mode: the regexes decide, the lexer is checked against them
+        File::Keyword regex_keyword = this->IdentifyKeywordInCurrentLineRegex();
+        if (regex_keyword != keyword)
+        {
+            char msg[200];
+            snprintf(msg, 200, "Lexer mismatch: keyword identified by lexer: '%s', by regex: '%s'",
+                File::KeywordToString(keyword), File::KeywordToString(regex_keyword));
+            this->AddMessage(Message::TYPE_WARNING, msg);
+        }
+        return regex_keyword;
+    }
+
+    if (!lettercase_ok)
+    {
+        this->AddMessage(Message::TYPE_WARNING,
+            "Keyword has invalid lettercase. Correct form is: " + std::string(File::KeywordToString(keyword)));
+    }
+    return keyword;
+}
+
+File::Keyword Parser::IdentifyKeywordInCurrentLineRegex()
+{
     // Search with correct lettercase
     std::smatch results;
     std::string line(m_current_line);
@@ -3050,6 +3082,7 @@ void Parser::Prepare()
     m_any_named_node_defined = false;
     m_last_flexbody.reset(); // Set to nullptr
     m_current_detacher_group = 0; // Global detacher group 
+    m_use_regex_keywords = BSETTING("RigDef Regex Keywords", false);
 
     m_user_default_inertia = m_ror_default_inertia;
     m_user_node_defaults = m_ror_node_defaults;
@@ -3070,6 +3103,7 @@ void Parser::Prepare()
     m_messages_num_errors = 0;
     m_messages_num_warnings = 0;
     m_messages_num_other = 0;
+    m_resource_checks.clear();
 }
 
 void Parser::ChangeSection(RigDef::File::Section new_section)
@@ -3258,6 +3292,12 @@ MeshWheel::Side Parser::GetArgWheelSide(int index)
 
 long Parser::GetArgLong(int index)
 {
+    int fast_res = 0;
+    if (Lexer::ParseInt(m_args[index].start, m_args[index].length, fast_res))
+    {
+        return fast_res;
+    }
+
     errno = 0;
     char* out_end = nullptr;
     const int MSG_LEN = 200;
@@ -3330,6 +3370,11 @@ Node::Ref Parser::GetArgNodeRef(int index)
 
 Node::Ref Parser::GetArgNullableNode(int index)
 {
+    int node_num = 0;
+    if (Lexer::ParseInt(m_args[index].start, m_args[index].length, node_num))
+    {
+        return (node_num != -1) ? this->GetArgNodeRef(index) : Node::Ref();
+    }
     if (! (Ogre::StringConverter::parseReal(this->GetArgStr(index)) == -1.f))
     {
         return this->GetArgNodeRef(index);
@@ -3358,6 +3403,12 @@ Flare2::Type Parser::GetArgFlareType(int index)
 
 float Parser::GetArgFloat(int index)
 {
+    double fast_res = 0;
+    if (Lexer::ParseReal(m_args[index].start, m_args[index].length, fast_res))
+    {
+        return static_cast<float>(fast_res);
+    }
+
     errno = 0;
     char* out_end = nullptr;
     float res = std::strtod(m_args[index].start, &out_end);
@@ -3463,6 +3514,13 @@ std::string Parser::GetArgManagedTex(int index)
     return (tex_name.at(0) != '-') ? tex_name : "";
 }
 
+bool Parser::CheckResourceExists(std::string const& filename)
+{
+    bool exists = RoR::App::GetCacheSystem()->resourceExistsInAllGroups(filename);
+    m_resource_checks[filename] = exists;
+    return exists;
+}
+
 int Parser::TokenizeCurrentLine()
 {
     int cur_arg = 0;
@@ -3537,10 +3595,9 @@ void Parser::ProcessRawLine(const char* raw_line_buf)
         return;
     }
 
-    // Sanitize UTF-8
-    memset(m_current_line, 0, LINE_BUFFER_LENGTH);
-    char* out_start = m_current_line;
-    utf8::replace_invalid(raw_start, raw_end, out_start, '?');
+    // Sanitize UTF-8; the output is never longer than the input
+    char* out_end = utf8::replace_invalid(raw_start, raw_end, m_current_line, '?');
+    *out_end = '\0';
 
     // Process
     this->ProcessCurrentLine();
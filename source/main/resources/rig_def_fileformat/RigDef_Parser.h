@@ -29,6 +29,7 @@
 #include "RigDef_File.h"
 #include "RigDef_SequentialImporter.h"
 
+#include <map>
 #include <memory>
 #include <string>
 #include <regex>
@@ -110,6 +111,9 @@ public:
     int GetMessagesNumWarnings() const { return m_messages_num_warnings; }
     int GetMessagesNumOther()    const { return m_messages_num_other;    }
 
+    /// Resource lookups the parse result depends on: name -> existed at parse time.
+    std::map<std::string, bool> const& GetResourceChecks() const { return m_resource_checks; }
+
 private:
 
 // --------------------------------------------------------------------------
@@ -234,6 +238,8 @@ private:
     Flare2::Type       GetArgFlareType    (int index);
     std::string        GetArgManagedTex   (int index);
 
+    bool               CheckResourceExists(std::string const& filename); ///< Records the result, see GetResourceChecks()
+
     float              ParseArgFloat      (const char* str);
     int                ParseArgInt        (const char* str);
     unsigned           ParseArgUint       (const char* str);
@@ -246,6 +252,9 @@ private:
     /// Keyword scan function. 
     File::Keyword IdentifyKeywordInCurrentLine();
 
+    /// Keyword scan function, legacy. Used to validate the Lexer, see setting 'RigDef Regex Keywords'.
+    File::Keyword IdentifyKeywordInCurrentLineRegex();
+
     /// Keyword scan utility function. 
     File::Keyword FindKeywordMatch(std::smatch& search_results);
 
@@ -302,6 +311,7 @@ private:
     bool                                 m_in_block_comment;       ///< Parser state.
     bool                                 m_in_description_section; ///< Parser state.
     bool                                 m_any_named_node_defined; ///< Parser state.
+    bool                                 m_use_regex_keywords;     ///< Config: BOOL 'RigDef Regex Keywords'
     std::shared_ptr<Submesh>             m_current_submesh;        ///< Parser state.
     std::shared_ptr<CameraRail>          m_current_camera_rail;    ///< Parser state.
     std::shared_ptr<Flexbody>            m_last_flexbody;
@@ -313,6 +323,7 @@ private:
     int                                  m_messages_num_errors;
     int                                  m_messages_num_warnings;
     int                                  m_messages_num_other;
+    std::map<std::string, bool>          m_resource_checks;
 };
 
 } // namespace RigDef
@@ -643,7 +643,7 @@ int ScriptEngine::fireEvent(std::string instanceName, float intensity)
     return 0;
 }
 
-int ScriptEngine::envokeCallback(int functionPtr, eventsource_t *source, node_t *node, int type)
+int ScriptEngine::envokeCallback(int functionPtr, eventsource_t *source, int node_id, int type)
 {
     if (!engine) return 0;
     if (functionPtr <= 0 && defaultEventCallbackFunctionPtr > 0)
@@ -658,16 +658,13 @@ int ScriptEngine::envokeCallback(int functionPtr, eventsource_t *source, node_t
     if (!context) context = engine->CreateContext();
     context->Prepare(functionPtr);
 
-    // Set the function arguments
-    std::string *instance_name = new std::string(source->instancename);
-    std::string *boxname = new std::string(source->boxname);
+    // Set the function arguments; strings are passed by value, the context copies them
+    std::string instance_name(source->instancename);
+    std::string boxname(source->boxname);
     context->SetArgDWord (0, type);
-    context->SetArgObject(1, instance_name);
-    context->SetArgObject(2, boxname);
-    if (node)
-        context->SetArgDWord (3, node->id);
-    else
-        context->SetArgDWord (3, -1); // conversion from 'int' to 'AngelScript::asDWORD', signed/unsigned mismatch!
+    context->SetArgObject(1, &instance_name);
+    context->SetArgObject(2, &boxname);
+    context->SetArgDWord (3, static_cast<AngelScript::asDWORD>(node_id));
 
     int r = context->Execute();
     if ( r == AngelScript::asEXECUTION_FINISHED )
@@ -675,8 +672,6 @@ int ScriptEngine::envokeCallback(int functionPtr, eventsource_t *source, node_t
       // The return value is only valid if the execution finished successfully
         AngelScript::asDWORD ret = context->GetReturnDWord();
     }
-    delete(instance_name);
-    delete(boxname);
 
     return 0;
 }
@@ -136,7 +136,7 @@ public:
 
     int fireEvent(std::string instanceName, float intensity);
 
-    int envokeCallback(int functionPtr, eventsource_t* source, node_t* node = 0, int type = 0);
+    int envokeCallback(int functionPtr, eventsource_t* source, int node_id = -1, int type = 0);
 
     AngelScript::asIScriptEngine* getEngine() { return engine; };
 
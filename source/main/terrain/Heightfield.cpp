@@ -0,0 +1,286 @@
+/*
+    This source file is part of Rigs of Rods
+    Copyright 2013-2017 Petr Ohlidal & contributors
+
+    For more information, see http://www.rigsofrods.org/
+
+    Rigs of Rods is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License version 3, as
+    published by the Free Software Foundation.
+
+    Rigs of Rods is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with Rigs of Rods. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "Heightfield.h"
+
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && (_M_IX86_FP >= 2))
+#   define ROR_HEIGHTFIELD_SSE
+#   include <emmintrin.h>
+#endif
+
+using namespace RoR;
+
+namespace {
+
+const char     CACHE_MAGIC[8] = {'R','o','R','H','F','L','D','\0'};
+const uint32_t CACHE_VERSION  = 2;
+
+/// Cache file layout: header, heights[cols * rows], normals[(cols - 1) * (rows - 1) * 2 * 3]
+struct CacheHeader
+{
+    char     magic[8];
+    uint32_t version;
+    uint32_t cols;
+    uint32_t rows;
+    float    x0;
+    float    z0;
+    float    spacing;
+    uint64_t revision; // Also keeps the float arrays 8-byte aligned
+};
+
+size_t GetNumHeights(int cols, int rows) { return static_cast<size_t>(cols) * rows; }
+size_t GetNumNormalFloats(int cols, int rows) { return static_cast<size_t>(cols - 1) * (rows - 1) * 2 * 3; }
+
+} // namespace
+
+Heightfield::Heightfield():
+    m_cols(0),
+    m_rows(0),
+    m_x0(0.f),
+    m_z0(0.f),
+    m_spacing(1.f),
+    m_inv_spacing(1.f),
+    m_max_col(0.f),
+    m_max_row(0.f),
+    m_heights(nullptr),
+    m_normals(nullptr)
+{
+}
+
+Heightfield::~Heightfield()
+{
+    this->Clear();
+}
+
+void Heightfield::Clear()
+{
+    m_mapped_file.Close();
+    m_storage.clear();
+    m_storage.shrink_to_fit();
+    m_heights = nullptr;
+    m_normals = nullptr;
+    m_cols = 0;
+    m_rows = 0;
+}
+
+void Heightfield::SetLayout(int cols, int rows, float x0, float z0, float spacing)
+{
+    m_cols        = cols;
+    m_rows        = rows;
+    m_x0          = x0;
+    m_z0          = z0;
+    m_spacing     = spacing;
+    m_inv_spacing = 1.f / spacing;
+    m_max_col     = static_cast<float>(cols - 1);
+    m_max_row     = static_cast<float>(rows - 1);
+}
+
+void Heightfield::Build(const float* heights, int cols, int rows, float x0, float z0, float spacing)
+{
+    this->Clear();
+    if (cols < 2 || rows < 2)
+        return;
+
+    this->SetLayout(cols, rows, x0, z0, spacing);
+
+    const size_t num_heights = GetNumHeights(cols, rows);
+    m_storage.resize(num_heights + GetNumNormalFloats(cols, rows));
+    std::copy(heights, heights + num_heights, m_storage.begin());
+    this->ComputeNormals(m_storage.data() + num_heights);
+
+    m_heights = m_storage.data();
+    m_normals = m_storage.data() + num_heights;
+}
+
+void Heightfield::ComputeNormals(float* normals) const
+{
+    // Plane of each triangle is `height = base + xp * dx + yp * dy`, see Locate().
+    // With xp = (x - x0) / spacing and yp = (z0 - z) / spacing, the normal is (-dx / spacing, 1, dy / spacing).
+    const float* h = m_storage.data();
+    for (int row = 0; row < m_rows - 1; row++)
+    {
+        const bool odd = (row & 1) != 0;
+        for (int col = 0; col < m_cols - 1; col++)
+        {
+            const float* c = h + row * m_cols + col;
+            const float h0 = c[0];
+            const float h1 = c[1];
+            const float h2 = c[m_cols + 1];
+            const float h3 = c[m_cols];
+
+            for (int tri = 0; tri < 2; tri++)
+            {
+                const bool upper = (tri == 0);
+                const float dx = (odd == upper) ? (h1 - h0) : (h2 - h3);
+                const float dy = (upper) ? (h3 - h0) : (h2 - h1);
+                Ogre::Vector3 n(-dx * m_inv_spacing, 1.f, dy * m_inv_spacing);
+                n.normalise();
+
+                float* out = normals + ((row * (m_cols - 1) + col) * 2 + tri) * 3;
+                out[0] = n.x;
+                out[1] = n.y;
+                out[2] = n.z;
+            }
+        }
+    }
+}
+
+void Heightfield::GetHeightsAt(int count, const float* x, const float* z, float* heights) const
+{
+    int i = 0;
+#ifdef ROR_HEIGHTFIELD_SSE
+    // Same arithmetic as Locate() and GetHeightAt(), 4 points at a time; only the corner heights
+    // are fetched per point (SSE2 has no gather). Results are identical to the scalar path.
+    const __m128 x0          = _mm_set1_ps(m_x0);
+    const __m128 z0          = _mm_set1_ps(m_z0);
+    const __m128 inv_spacing = _mm_set1_ps(m_inv_spacing);
+    const __m128 max_col     = _mm_set1_ps(m_max_col);
+    const __m128 max_row     = _mm_set1_ps(m_max_row);
+    const __m128 last_col    = _mm_set1_ps(static_cast<float>(m_cols - 2));
+    const __m128 last_row    = _mm_set1_ps(static_cast<float>(m_rows - 2));
+    const __m128 zero        = _mm_setzero_ps();
+    const __m128 one         = _mm_set1_ps(1.0f);
+    const __m128i int_one    = _mm_set1_epi32(1);
+
+    for (; i + 4 <= count; i += 4)
+    {
+        const __m128 fx = _mm_mul_ps(_mm_sub_ps(_mm_loadu_ps(x + i), x0), inv_spacing);
+        const __m128 fy = _mm_mul_ps(_mm_sub_ps(z0, _mm_loadu_ps(z + i)), inv_spacing);
+        const __m128 inside = _mm_and_ps(
+            _mm_and_ps(_mm_cmpgt_ps(fx, zero), _mm_cmpgt_ps(fy, zero)),
+            _mm_and_ps(_mm_cmplt_ps(fx, max_col), _mm_cmplt_ps(fy, max_row)));
+
+        // Clamped so the fetches stay in bounds (NaN -> max); the result isn't used when outside
+        const __m128 cx = _mm_max_ps(zero, _mm_min_ps(fx, max_col));
+        const __m128 cy = _mm_max_ps(zero, _mm_min_ps(fy, max_row));
+        const __m128i col = _mm_cvttps_epi32(_mm_min_ps(cx, last_col));
+        const __m128i row = _mm_cvttps_epi32(_mm_min_ps(cy, last_row));
+        const __m128 xp = _mm_sub_ps(cx, _mm_cvtepi32_ps(col));
+        const __m128 yp = _mm_sub_ps(cy, _mm_cvtepi32_ps(row));
+
+        int32_t cols[4], rows[4];
+        float h0[4], h1[4], h2[4], h3[4];
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(cols), col);
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(rows), row);
+        for (int k = 0; k < 4; k++)
+        {
+            const float* h = m_heights + rows[k] * m_cols + cols[k];
+            h0[k] = h[0];
+            h1[k] = h[1];
+            h2[k] = h[m_cols + 1];
+            h3[k] = h[m_cols];
+        }
+        const __m128 vh0 = _mm_loadu_ps(h0);
+        const __m128 vh1 = _mm_loadu_ps(h1);
+        const __m128 vh2 = _mm_loadu_ps(h2);
+        const __m128 vh3 = _mm_loadu_ps(h3);
+
+        const __m128 odd = _mm_castsi128_ps(_mm_cmpeq_epi32(_mm_and_si128(row, int_one), int_one));
+        const __m128 upper = _mm_or_ps(
+            _mm_and_ps(odd, _mm_cmplt_ps(_mm_add_ps(xp, yp), one)),
+            _mm_andnot_ps(odd, _mm_cmpgt_ps(yp, xp)));
+        const __m128 odd_lower = _mm_andnot_ps(upper, odd);
+        const __m128 dx_near = _mm_xor_ps(_mm_xor_ps(odd, upper), _mm_castsi128_ps(_mm_set1_epi32(-1))); // odd == upper
+
+        const __m128 base = _mm_or_ps(
+            _mm_and_ps(odd_lower, _mm_sub_ps(_mm_add_ps(vh1, vh3), vh2)),
+            _mm_andnot_ps(odd_lower, vh0));
+        const __m128 dx = _mm_or_ps(
+            _mm_and_ps(dx_near, _mm_sub_ps(vh1, vh0)),
+            _mm_andnot_ps(dx_near, _mm_sub_ps(vh2, vh3)));
+        const __m128 dy = _mm_or_ps(
+            _mm_and_ps(upper, _mm_sub_ps(vh3, vh0)),
+            _mm_andnot_ps(upper, _mm_sub_ps(vh2, vh1)));
+
+        const __m128 height = _mm_add_ps(_mm_add_ps(base, _mm_mul_ps(xp, dx)), _mm_mul_ps(yp, dy));
+        _mm_storeu_ps(heights + i, _mm_and_ps(inside, height));
+    }
+#endif // ROR_HEIGHTFIELD_SSE
+
+    for (; i < count; i++)
+    {
+        heights[i] = this->GetHeightAt(x[i], z[i]);
+    }
+}
+
+bool Heightfield::SaveCache(std::string const& filename, uint64_t revision) const
+{
+    if (!this->IsValid())
+        return false;
+
+    FILE* file = fopen(filename.c_str(), "wb");
+    if (!file)
+        return false;
+
+    CacheHeader header;
+    memcpy(header.magic, CACHE_MAGIC, sizeof(header.magic));
+    header.version  = CACHE_VERSION;
+    header.cols     = static_cast<uint32_t>(m_cols);
+    header.rows     = static_cast<uint32_t>(m_rows);
+    header.x0       = m_x0;
+    header.z0       = m_z0;
+    header.spacing  = m_spacing;
+    header.revision = revision;
+
+    const size_t num_heights = GetNumHeights(m_cols, m_rows);
+    const size_t num_normal_floats = GetNumNormalFloats(m_cols, m_rows);
+    bool ok = (fwrite(&header, sizeof(header), 1, file) == 1);
+    ok = ok && (fwrite(m_heights, sizeof(float), num_heights, file) == num_heights);
+    ok = ok && (fwrite(m_normals, sizeof(float), num_normal_floats, file) == num_normal_floats);
+    ok = (fclose(file) == 0) && ok;
+    if (!ok)
+        remove(filename.c_str());
+    return ok;
+}
+
+bool Heightfield::LoadCache(std::string const& filename, uint64_t revision, int cols, int rows, float x0, float z0, float spacing)
+{
+    this->Clear();
+    if (cols < 2 || rows < 2)
+        return false;
+
+    const size_t expected_size = sizeof(CacheHeader) + (GetNumHeights(cols, rows) + GetNumNormalFloats(cols, rows)) * sizeof(float);
+
+    if (!m_mapped_file.Open(filename) || m_mapped_file.GetSize() != expected_size)
+    {
+        m_mapped_file.Close();
+        return false;
+    }
+
+    const CacheHeader* header = reinterpret_cast<const CacheHeader*>(m_mapped_file.GetData());
+    if (memcmp(header->magic, CACHE_MAGIC, sizeof(header->magic)) != 0 ||
+        header->version != CACHE_VERSION ||
+        header->cols != static_cast<uint32_t>(cols) || header->rows != static_cast<uint32_t>(rows) ||
+        header->x0 != x0 || header->z0 != z0 || header->spacing != spacing ||
+        header->revision != revision) // Stale cache
+    {
+        m_mapped_file.Close();
+        return false;
+    }
+
+    this->SetLayout(cols, rows, x0, z0, spacing);
+    m_heights = reinterpret_cast<const float*>(header + 1);
+    m_normals = m_heights + GetNumHeights(cols, rows);
+    return true;
+}
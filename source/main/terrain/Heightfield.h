@@ -0,0 +1,153 @@
+/*
+    This source file is part of Rigs of Rods
+    Copyright 2013-2017 Petr Ohlidal & contributors
+
+    For more information, see http://www.rigsofrods.org/
+
+    Rigs of Rods is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License version 3, as
+    published by the Free Software Foundation.
+
+    Rigs of Rods is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with Rigs of Rods. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+/// @file
+/// @brief Physics-side snapshot of the terrain heightmap.
+
+#pragma once
+
+#include "MappedFile.h"
+
+#include <OgreVector3.h>
+
+#include <algorithm>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+namespace RoR {
+
+/// SIM-CORE; Read-only copy of a heightmap with precomputed triangle normals.
+///
+/// Built once at terrain load, afterwards it's safe to query from any thread; it doesn't
+/// touch Ogre's terrain structures. Grid point [col, row] lies at world position
+/// (x0 + col * spacing, height, z0 - row * spacing), which is the layout of an
+/// Ogre::Terrain with ALIGN_X_Z; the pages of a TerrainGroup join into one such grid.
+/// Every cell is split into 2 triangles like Ogre's terrain mesh (the diagonal alternates
+/// by row), so heights match the rendered terrain.
+///
+/// The data can be saved to a cache file and memory-mapped from it on next load.
+class Heightfield
+{
+public:
+    Heightfield();
+    ~Heightfield();
+
+    /// Copies `cols` x `rows` heights (row-major) and computes the normals.
+    void Build(const float* heights, int cols, int rows, float x0, float z0, float spacing);
+
+    /// Maps a file written by SaveCache(); fails if the file doesn't match the layout or the `revision`.
+    /// @param revision Identifies the terrain data the cache was built from, see TerrainGeometryManager.
+    bool LoadCache(std::string const& filename, uint64_t revision, int cols, int rows, float x0, float z0, float spacing);
+    bool SaveCache(std::string const& filename, uint64_t revision) const;
+
+    void Clear();
+    bool IsValid() const { return m_heights != nullptr; }
+
+    /// Terrain height at world x/z; 0 outside of the heightmap.
+    float GetHeightAt(float x, float z) const;
+    /// Normal of the terrain triangle at world x/z; up outside of the heightmap.
+    Ogre::Vector3 GetNormalAt(float x, float z) const;
+    /// GetHeightAt() for `count` points; processes 4 at a time with SSE2 where available.
+    void GetHeightsAt(int count, const float* x, const float* z, float* heights) const;
+
+private:
+    /// Triangle at world x/z, as plane `height = base + xp * dx + yp * dy` over the cell.
+    struct Sample
+    {
+        bool  inside;
+        int   cell;
+        int   tri;
+        float xp, yp;
+        float base, dx, dy;
+    };
+
+    Sample Locate(float x, float z) const;
+    void   ComputeNormals(float* normals) const;
+
+    void   SetLayout(int cols, int rows, float x0, float z0, float spacing);
+
+    int          m_cols;
+    int          m_rows;
+    float        m_x0;
+    float        m_z0;
+    float        m_spacing;
+    float        m_inv_spacing;
+    float        m_max_col;     ///< cols - 1, in grid units
+    float        m_max_row;     ///< rows - 1, in grid units
+
+    const float* m_heights;     ///< [row * cols + col]
+    const float* m_normals;     ///< [(row * (cols - 1) + col) * 2 + tri] * 3
+
+    std::vector<float> m_storage; ///< Backs `m_heights`/`m_normals` unless mapped from the cache
+    MappedFile   m_mapped_file;
+};
+
+inline Heightfield::Sample Heightfield::Locate(float x, float z) const
+{
+    Sample s;
+    const float fx = (x - m_x0) * m_inv_spacing;
+    const float fy = (m_z0 - z) * m_inv_spacing;
+    s.inside = (fx > 0.0f) & (fy > 0.0f) & (fx < m_max_col) & (fy < m_max_row);
+
+    // Clamped so the fetches stay in bounds; the result isn't used when outside
+    const float cx = std::max(0.0f, std::min(fx, m_max_col)); // NaN -> 0
+    const float cy = std::max(0.0f, std::min(fy, m_max_row));
+    const int col = std::min(static_cast<int>(cx), m_cols - 2);
+    const int row = std::min(static_cast<int>(cy), m_rows - 2);
+    s.xp = cx - col;
+    s.yp = cy - row;
+
+    /* For even / odd tri strip rows, triangles are this shape:
+    even     odd
+    3---2   3---2
+    | / |   | \ |
+    0---1   0---1
+    */
+    const float* h = m_heights + row * m_cols + col;
+    const float h0 = h[0];
+    const float h1 = h[1];
+    const float h2 = h[m_cols + 1];
+    const float h3 = h[m_cols];
+    const bool odd = (row & 1) != 0;
+    const bool upper = odd ? (s.xp + s.yp < 1.0f) : (s.yp > s.xp); // 0-1-3 (odd) or 0-2-3 (even)
+
+    s.base = (odd && !upper) ? (h1 + h3 - h2) : h0;
+    s.dx   = (odd == upper) ? (h1 - h0) : (h2 - h3);
+    s.dy   = (upper) ? (h3 - h0) : (h2 - h1);
+    s.cell = row * (m_cols - 1) + col;
+    s.tri  = (upper) ? 0 : 1;
+    return s;
+}
+
+inline float Heightfield::GetHeightAt(float x, float z) const
+{
+    const Sample s = this->Locate(x, z);
+    const float height = s.base + s.xp * s.dx + s.yp * s.dy;
+    return (s.inside) ? height : 0.0f;
+}
+
+inline Ogre::Vector3 Heightfield::GetNormalAt(float x, float z) const
+{
+    const Sample s = this->Locate(x, z);
+    const float* n = m_normals + (s.cell * 2 + s.tri) * 3;
+    return (s.inside) ? Ogre::Vector3(n[0], n[1], n[2]) : Ogre::Vector3::UNIT_Y;
+}
+
+} // namespace RoR
@@ -32,5 +32,24 @@ public:
 
     virtual float getHeightAt(float x, float z) = 0;
     virtual Ogre::Vector3 getNormalAt(float x, float y, float z, float precision = 0.1f) = 0;
+
+    /// Batched getHeightAt()
+    virtual void getHeightsAt(int count, const float* x, const float* z, float* heights)
+    {
+        for (int i = 0; i < count; i++)
+        {
+            heights[i] = getHeightAt(x[i], z[i]);
+        }
+    }
+
+    /// Batched getNormalAt() (default precision) for the samples listed in `ids`
+    virtual void getNormalsAt(int count, const int* ids, const float* x, const float* y, const float* z, Ogre::Vector3* normals)
+    {
+        for (int k = 0; k < count; k++)
+        {
+            const int i = ids[k];
+            normals[i] = getNormalAt(x[i], y[i], z[i]);
+        }
+    }
 };
 
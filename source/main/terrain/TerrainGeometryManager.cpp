@@ -38,7 +38,6 @@ using namespace Ogre;
 
 TerrainGeometryManager::TerrainGeometryManager(TerrainManager* terrainManager) :
     m_terrn_disable_caching(false)
-    , mHeightData(nullptr)
     , m_was_new_geometry_generated(false)
     , m_terrain_is_flat(true)
     , m_terrain_mgr(terrainManager)
@@ -50,135 +49,40 @@ TerrainGeometryManager::~TerrainGeometryManager()
     m_ogre_terrain_group->removeAllTerrains();
 }
 
-/// @author Ported from OGRE engine, www.ogre3d.org, file OgreTerrain.cpp
-void TerrainGeometryManager::getTerrainPositionAlign(Real x, Real y, Real z, Terrain::Alignment align, Vector3* outTSpos)
+float TerrainGeometryManager::getHeightAt(float x, float z)
 {
-    switch (align)
-    {
-    case Terrain::ALIGN_X_Z:
-        outTSpos->x = (x - mBase - mPos.x) / ((mSize - 1) * mScale);
-        outTSpos->y = (z + mBase - mPos.z) / ((mSize - 1) * -mScale);
-        outTSpos->z = y;
-        break;
-    case Terrain::ALIGN_Y_Z:
-        outTSpos->x = (z - mBase - mPos.z) / ((mSize - 1) * -mScale);
-        outTSpos->y = (y + mBase - mPos.y) / ((mSize - 1) * mScale);
-        outTSpos->z = x;
-        break;
-    case Terrain::ALIGN_X_Y:
-        outTSpos->x = (x - mBase - mPos.x) / ((mSize - 1) * mScale);
-        outTSpos->y = (y - mBase - mPos.y) / ((mSize - 1) * mScale);
-        outTSpos->z = z;
-        break;
-    };
+    if (!m_heightfield.IsValid())
+        return 0.0f; // flat terrain
+
+    return m_heightfield.GetHeightAt(x, z);
 }
 
-/// @author Ported from OGRE engine, www.ogre3d.org, file OgreTerrain.cpp
-float TerrainGeometryManager::getHeightAtPoint(long x, long y)
+Ogre::Vector3 TerrainGeometryManager::getNormalAt(float x, float y, float z, float precision)
 {
-    // clamp
-    x = std::min(x, (long)mSize - 1L);
-    x = std::max(x, 0L);
-    y = std::min(y, (long)mSize - 1L);
-    y = std::max(y, 0L);
+    if (!m_heightfield.IsValid())
+        return Vector3::UNIT_Y;
 
-    return mHeightData[y * mSize + x];
+    return m_heightfield.GetNormalAt(x, z);
 }
 
-/// @author Ported from OGRE engine, www.ogre3d.org, file OgreTerrain.cpp
-float TerrainGeometryManager::getHeightAtTerrainPosition(Real x, Real y)
+void TerrainGeometryManager::getHeightsAt(int count, const float* x, const float* z, float* heights)
 {
-    // get left / bottom points (rounded down)
-    Real factor = (Real)mSize - 1.0f;
-    Real invFactor = 1.0f / factor;
-
-    long startX = static_cast<long>(x * factor);
-    long startY = static_cast<long>(y * factor);
-    long endX = startX + 1;
-    long endY = startY + 1;
-
-    // now get points in terrain space (effectively rounding them to boundaries)
-    // note that we do not clamp! We need a valid plane
-    Real startXTS = startX * invFactor;
-    Real startYTS = startY * invFactor;
-    Real endXTS = endX * invFactor;
-    Real endYTS = endY * invFactor;
-
-    // now clamp
-    endX = std::min(endX, (long)mSize - 1);
-    endY = std::min(endY, (long)mSize - 1);
-
-    // get parametric from start coord to next point
-    Real xParam = (x - startXTS) / invFactor;
-    Real yParam = (y - startYTS) / invFactor;
-
-    /* For even / odd tri strip rows, triangles are this shape:
-    even     odd
-    3---2   3---2
-    | / |   | \ |
-    0---1   0---1
-    */
-
-    // Build all 4 positions in terrain space, using point-sampled height
-    Vector3 v0(startXTS, startYTS, getHeightAtPoint(startX, startY));
-    Vector3 v1(endXTS, startYTS, getHeightAtPoint(endX, startY));
-    Vector3 v2(endXTS, endYTS, getHeightAtPoint(endX, endY));
-    Vector3 v3(startXTS, endYTS, getHeightAtPoint(startX, endY));
-    // define this plane in terrain space
-    Plane plane;
-    if (startY % 2)
+    if (!m_heightfield.IsValid())
     {
-        // odd row
-        bool secondTri = ((1.0 - yParam) > xParam);
-        if (secondTri)
-            plane.redefine(v0, v1, v3);
-        else
-            plane.redefine(v1, v2, v3);
-    }
-    else
-    {
-        // even row
-        bool secondTri = (yParam > xParam);
-        if (secondTri)
-            plane.redefine(v0, v2, v3);
-        else
-            plane.redefine(v0, v1, v2);
+        std::fill(heights, heights + count, 0.0f);
+        return;
     }
 
-    // Solve plane equation for z
-    return (-plane.normal.x * x
-            - plane.normal.y * y
-            - plane.d) / plane.normal.z;
-}
-
-/// @author Ported from OGRE engine, www.ogre3d.org, file OgreTerrain.cpp
-float TerrainGeometryManager::getHeightAtWorldPosition(float x, float z)
-{
-    Vector3 terrPos;
-    getTerrainPositionAlign(x, 0.0f, z, mAlign, &terrPos);
-
-    if (terrPos.x <= 0.0f || terrPos.y <= 0.0f || terrPos.x >= 1.0f || terrPos.y >= 1.0f)
-        return 0.0f;
-
-    return getHeightAtTerrainPosition(terrPos.x, terrPos.y);
+    m_heightfield.GetHeightsAt(count, x, z, heights);
 }
 
-float TerrainGeometryManager::getHeightAt(float x, float z)
+void TerrainGeometryManager::getNormalsAt(int count, const int* ids, const float* x, const float* y, const float* z, Ogre::Vector3* normals)
 {
-    if (m_terrain_is_flat)
-        return 0.0f;
-    else
-    //return m_ogre_terrain_group->getHeightAtWorldPosition(x, 1000, z);
-        return getHeightAtWorldPosition(x, z);
-}
-
-Ogre::Vector3 TerrainGeometryManager::getNormalAt(float x, float y, float z, float precision)
-{
-    Ogre::Vector3 left(-precision, getHeightAt(x - precision, z) - y, 0.0f);
-    Ogre::Vector3 down(0.0f, getHeightAt(x, z + precision) - y, precision);
-    down = left.crossProduct(down);
-    down.normalise();
-    return down;
+    for (int k = 0; k < count; k++)
+    {
+        const int i = ids[k];
+        normals[i] = (m_heightfield.IsValid()) ? m_heightfield.GetNormalAt(x[i], z[i]) : Vector3::UNIT_Y;
+    }
 }
 
 void TerrainGeometryManager::loadOgreTerrainConfig(String filename)
@@ -307,15 +211,6 @@ void TerrainGeometryManager::initTerrain()
     loading_win->setProgress(23, _L("loading terrain pages"));
     m_ogre_terrain_group->loadAllTerrains(true);
 
-    Terrain* terrain = m_ogre_terrain_group->getTerrain(0, 0);
-    mHeightData = terrain->getHeightData();
-    mAlign = terrain->getAlignment();
-    mSize = terrain->getSize();
-    const float world_size = terrain->getWorldSize();
-    mBase = -world_size * 0.5f;
-    mScale = world_size / (Real)(mSize - 1);
-    mPos = terrain->getPosition();
-
     // update the blend maps
     if (m_was_new_geometry_generated)
     {
@@ -345,9 +240,91 @@ void TerrainGeometryManager::initTerrain()
         LOG(" *** Terrain loaded from cache ***");
     }
 
+    // After saving, so the heightfield cache refers to the saved pages
+    if (!m_terrain_is_flat)
+    {
+        loading_win->setProgress(23, _L("preparing terrain collisions"));
+        this->initHeightfield(pageMaxX - pageMinX + 1, pageMaxZ - pageMinZ + 1);
+    }
+
     m_ogre_terrain_group->freeTemporaryResources();
 }
 
+void TerrainGeometryManager::initHeightfield(int pages_x, int pages_z)
+{
+    // Grid layout of Ogre::Terrain with ALIGN_X_Z, see Terrain::getPoint(); the pages of the group join
+    // into one grid, page [x, z] lies x pages towards +X and z pages towards -Z from page [0, 0].
+    const int page_size = static_cast<int>(m_terrain_page_size);
+    const float world_size = static_cast<float>(m_terrain_world_size);
+    Vector3 pos;
+    m_ogre_terrain_group->convertTerrainSlotToWorldPosition(0, 0, &pos);
+    const float x0 = pos.x - world_size * 0.5f;
+    const float z0 = pos.z + world_size * 0.5f;
+    const float spacing = world_size / (float)(page_size - 1);
+    const int cols = pages_x * (page_size - 1) + 1;
+    const int rows = pages_z * (page_size - 1) + 1;
+
+    const uint64_t revision = this->getPageCacheRevision(pages_x, pages_z);
+    const std::string cache_path = RoR::App::GetSysCacheDir() + PATH_SLASH + m_terrn_base_name + ".heightfield";
+    if (revision != 0 && m_heightfield.LoadCache(cache_path, revision, cols, rows, x0, z0, spacing))
+    {
+        LOG(" *** Terrain heightfield mapped from cache ***");
+        return;
+    }
+
+    std::vector<float> heights(static_cast<size_t>(cols) * rows, 0.f); // Missing pages stay flat
+    for (int x = 0; x < pages_x; x++)
+    {
+        for (int z = 0; z < pages_z; z++)
+        {
+            Terrain* terrain = m_ogre_terrain_group->getTerrain(x, z);
+            if (!terrain)
+                continue;
+            const float* src = terrain->getHeightData();
+            for (int row = 0; row < page_size; row++)
+            {
+                float* dst = &heights[(z * (page_size - 1) + row) * cols + x * (page_size - 1)];
+                std::copy(src + row * page_size, src + (row + 1) * page_size, dst);
+            }
+        }
+    }
+
+    m_heightfield.Build(heights.data(), cols, rows, x0, z0, spacing);
+    if (revision != 0 && !m_heightfield.SaveCache(cache_path, revision))
+    {
+        LOG("Failed to write terrain heightfield cache: " + cache_path);
+    }
+}
+
+uint64_t TerrainGeometryManager::getPageCacheRevision(int pages_x, int pages_z)
+{
+    // The heights come from Ogre's page cache (*.mapbin); Ogre only rewrites it when a page is imported
+    // again, so the modification times of the page files identify the heights without reading them.
+    // Returns 0 (don't cache) if any page isn't in Ogre's cache.
+    if (m_terrn_disable_caching)
+        return 0;
+
+    ResourceGroupManager& rgm = ResourceGroupManager::getSingleton();
+    const String& group = m_ogre_terrain_group->getResourceGroup();
+    uint64_t revision = 14695981039346656037ull; // FNV-1a
+    for (int x = 0; x < pages_x; x++)
+    {
+        for (int z = 0; z < pages_z; z++)
+        {
+            const String filename = m_ogre_terrain_group->generateFilename(x, z);
+            if (!rgm.resourceExists(group, filename))
+                return 0;
+            const uint64_t mtime = static_cast<uint64_t>(rgm.resourceModifiedTime(group, filename));
+            for (int i = 0; i < 8; i++)
+            {
+                revision ^= (mtime >> (i * 8)) & 0xff;
+                revision *= 1099511628211ull;
+            }
+        }
+    }
+    return (revision != 0) ? revision : 1;
+}
+
 void TerrainGeometryManager::updateLightMap()
 {
     TerrainGroup::TerrainIterator ti = m_ogre_terrain_group->getTerrainIterator();
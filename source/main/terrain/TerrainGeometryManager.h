@@ -23,6 +23,7 @@
 
 #include "RoRPrerequisites.h"
 #include "ConfigFile.h"
+#include "Heightfield.h"
 #include "IHeightFinder.h"
 
 #include <OgreTerrain.h>
@@ -40,13 +41,13 @@ public:
     Ogre::TerrainGroup* getTerrainGroup() { return m_ogre_terrain_group; };
 
     float getHeightAt(float x, float z);
-    float getHeightAtPoint(long x, long z);
-    float getHeightAtTerrainPosition(float x, float z);
-    float getHeightAtWorldPosition(float x, float z);
-    void getTerrainPositionAlign(Ogre::Real x, Ogre::Real y, Ogre::Real z, Ogre::Terrain::Alignment align, Ogre::Vector3* outWSpos);
 
+    /// Exact normal of the terrain triangle at x/z; `y` and `precision` are not needed.
     Ogre::Vector3 getNormalAt(float x, float y, float z, float precision = 0.1f);
 
+    void getHeightsAt(int count, const float* x, const float* z, float* heights) override;
+    void getNormalsAt(int count, const int* ids, const float* x, const float* y, const float* z, Ogre::Vector3* normals) override;
+
     Ogre::Vector3 getMaxTerrainSize();
 
     bool update(float dt);
@@ -67,6 +68,8 @@ private:
     void defineTerrain(int x, int y, bool flat = false);
     void initBlendMaps(int x, int y, Ogre::Terrain* t);
     void initTerrain();
+    void initHeightfield(int pages_x, int pages_z);
+    uint64_t getPageCacheRevision(int pages_x, int pages_z);
     void loadLayers(int x, int y, Ogre::Terrain* terrain = 0);
     Ogre::String getPageConfigFilename(int x, int z);
     Ogre::String getPageHeightmap(int x, int z);
@@ -86,14 +89,7 @@ private:
     size_t            m_terrain_world_size;
     Ogre::TerrainGroup*  m_ogre_terrain_group;
     std::vector<TerrnBlendLayerDef>  m_terrn_blend_layers;
-
-    // Terrn position lookup - ported from OGRE engine.
-    Ogre::Terrain::Alignment mAlign;
-    Ogre::Vector3 mPos;
-    Ogre::Real mBase;
-    Ogre::Real mScale;
-    Ogre::uint16 mSize;
-    float* mHeightData;
+    RoR::Heightfield     m_heightfield;                ///< Physics lookups; all pages.
 
 };
 
@@ -0,0 +1,266 @@
+/*
+    This source file is part of Rigs of Rods
+    Copyright 2013-2017 Petr Ohlidal & contributors
+
+    For more information, see http://www.rigsofrods.org/
+
+    Rigs of Rods is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License version 3, as
+    published by the Free Software Foundation.
+
+    Rigs of Rods is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with Rigs of Rods. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+
+/// Size of a cache line; used to keep frequently written atomics apart (avoid false sharing).
+static const size_t LOCKFREE_CACHELINE_SIZE = 64;
+
+/** \brief Bounded work-stealing deque (Chase-Lev) of pointers.
+ *
+ * The owner thread pushes and pops at the bottom (LIFO, cache friendly), any other thread
+ * may steal from the top (FIFO). No locks and no allocations after construction.
+ * Memory orderings follow Le et al., "Correct and Efficient Work-Stealing for Weak Memory Models" (2013).
+ *
+ * @tparam T        Element type; pointed-to objects are owned by the caller.
+ * @tparam CAPACITY Must be a power of two. Push() fails when the deque is full.
+ */
+template<typename T, size_t CAPACITY = 1024>
+class WorkStealingDeque
+{
+    static_assert((CAPACITY & (CAPACITY - 1)) == 0, "Capacity must be a power of two.");
+
+public:
+    WorkStealingDeque()
+    {
+        for (auto& slot : m_buffer) { slot.store(nullptr, std::memory_order_relaxed); }
+    }
+
+    /// Owner thread only.
+    bool Push(T* item)
+    {
+        const int64_t b = m_bottom.load(std::memory_order_relaxed);
+        const int64_t t = m_top.load(std::memory_order_acquire);
+        if (b - t >= static_cast<int64_t>(CAPACITY)) { return false; }
+
+        m_buffer[b & MASK].store(item, std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_release);
+        m_bottom.store(b + 1, std::memory_order_relaxed);
+        return true;
+    }
+
+    /// Owner thread only. Returns nullptr when empty.
+    T* Pop()
+    {
+        const int64_t b = m_bottom.load(std::memory_order_relaxed) - 1;
+        m_bottom.store(b, std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        int64_t t = m_top.load(std::memory_order_relaxed);
+
+        if (t > b)
+        {
+            // Empty
+            m_bottom.store(b + 1, std::memory_order_relaxed);
+            return nullptr;
+        }
+
+        T* item = m_buffer[b & MASK].load(std::memory_order_relaxed);
+        if (t == b)
+        {
+            // Last item; race against thieves
+            if (!m_top.compare_exchange_strong(t, t + 1, std::memory_order_seq_cst, std::memory_order_relaxed))
+            {
+                item = nullptr;
+            }
+            m_bottom.store(b + 1, std::memory_order_relaxed);
+        }
+        return item;
+    }
+
+    /// Any thread. Returns nullptr when empty or when the race against another thief/the owner was lost.
+    T* Steal()
+    {
+        int64_t t = m_top.load(std::memory_order_acquire);
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        const int64_t b = m_bottom.load(std::memory_order_acquire);
+        if (t >= b) { return nullptr; }
+
+        T* item = m_buffer[t & MASK].load(std::memory_order_relaxed);
+        if (!m_top.compare_exchange_strong(t, t + 1, std::memory_order_seq_cst, std::memory_order_relaxed))
+        {
+            return nullptr;
+        }
+        return item;
+    }
+
+    /// Approximate; for sleep/wake-up decisions only.
+    bool IsEmpty() const
+    {
+        return m_bottom.load(std::memory_order_relaxed) <= m_top.load(std::memory_order_relaxed);
+    }
+
+private:
+    static const int64_t MASK = static_cast<int64_t>(CAPACITY) - 1;
+
+    std::atomic<int64_t> m_top{0};
+    char                 m_pad0[LOCKFREE_CACHELINE_SIZE - sizeof(std::atomic<int64_t>)];
+    std::atomic<int64_t> m_bottom{0};
+    char                 m_pad1[LOCKFREE_CACHELINE_SIZE - sizeof(std::atomic<int64_t>)];
+    std::atomic<T*>      m_buffer[CAPACITY];
+};
+
+/** \brief Bounded multi-producer/multi-consumer queue of pointers (D. Vyukov's algorithm).
+ *
+ * Used to hand work to a thread pool from threads which don't own a WorkStealingDeque.
+ * No locks and no allocations after construction.
+ *
+ * @tparam CAPACITY Must be a power of two. Push() fails when the queue is full.
+ */
+template<typename T, size_t CAPACITY = 1024>
+class MPMCQueue
+{
+    static_assert((CAPACITY & (CAPACITY - 1)) == 0, "Capacity must be a power of two.");
+
+public:
+    MPMCQueue()
+    {
+        for (size_t i = 0; i < CAPACITY; ++i) { m_cells[i].sequence.store(i, std::memory_order_relaxed); }
+    }
+
+    bool Push(T* item)
+    {
+        Cell* cell;
+        size_t pos = m_enqueue_pos.load(std::memory_order_relaxed);
+        while (true)
+        {
+            cell = &m_cells[pos & MASK];
+            const size_t seq = cell->sequence.load(std::memory_order_acquire);
+            const intptr_t diff = static_cast<intptr_t>(seq) - static_cast<intptr_t>(pos);
+            if (diff == 0)
+            {
+                if (m_enqueue_pos.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed)) { break; }
+            }
+            else if (diff < 0)
+            {
+                return false; // Full
+            }
+            else
+            {
+                pos = m_enqueue_pos.load(std::memory_order_relaxed);
+            }
+        }
+        cell->data = item;
+        cell->sequence.store(pos + 1, std::memory_order_release);
+        return true;
+    }
+
+    /// Returns nullptr when empty.
+    T* Pop()
+    {
+        Cell* cell;
+        size_t pos = m_dequeue_pos.load(std::memory_order_relaxed);
+        while (true)
+        {
+            cell = &m_cells[pos & MASK];
+            const size_t seq = cell->sequence.load(std::memory_order_acquire);
+            const intptr_t diff = static_cast<intptr_t>(seq) - static_cast<intptr_t>(pos + 1);
+            if (diff == 0)
+            {
+                if (m_dequeue_pos.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed)) { break; }
+            }
+            else if (diff < 0)
+            {
+                return nullptr; // Empty
+            }
+            else
+            {
+                pos = m_dequeue_pos.load(std::memory_order_relaxed);
+            }
+        }
+        T* item = cell->data;
+        cell->sequence.store(pos + MASK + 1, std::memory_order_release);
+        return item;
+    }
+
+    /// Approximate; for sleep/wake-up decisions only.
+    bool IsEmpty() const
+    {
+        return m_dequeue_pos.load(std::memory_order_relaxed) >= m_enqueue_pos.load(std::memory_order_relaxed);
+    }
+
+private:
+    static const size_t MASK = CAPACITY - 1;
+
+    struct Cell
+    {
+        std::atomic<size_t> sequence;
+        T*                  data;
+    };
+
+    Cell                m_cells[CAPACITY];
+    std::atomic<size_t> m_enqueue_pos{0};
+    char                m_pad0[LOCKFREE_CACHELINE_SIZE - sizeof(std::atomic<size_t>)];
+    std::atomic<size_t> m_dequeue_pos{0};
+    char                m_pad1[LOCKFREE_CACHELINE_SIZE - sizeof(std::atomic<size_t>)];
+};
+
+/** \brief Bounded single-producer/single-consumer ring of pointers.
+ *
+ * Cheapest of the queues here: no CAS, each side only writes its own index.
+ * Used to hand received network packets from the receive thread to the main thread.
+ *
+ * @tparam CAPACITY Must be a power of two. Push() fails when the queue is full.
+ */
+template<typename T, size_t CAPACITY = 1024>
+class SPSCQueue
+{
+    static_assert((CAPACITY & (CAPACITY - 1)) == 0, "Capacity must be a power of two.");
+
+public:
+    /// Producer thread only.
+    bool Push(T* item)
+    {
+        const size_t head = m_head.load(std::memory_order_relaxed);
+        if (head - m_tail.load(std::memory_order_acquire) >= CAPACITY) { return false; } // Full
+
+        m_buffer[head & MASK] = item;
+        m_head.store(head + 1, std::memory_order_release);
+        return true;
+    }
+
+    /// Consumer thread only. Returns nullptr when empty.
+    T* Pop()
+    {
+        const size_t tail = m_tail.load(std::memory_order_relaxed);
+        if (tail == m_head.load(std::memory_order_acquire)) { return nullptr; } // Empty
+
+        T* item = m_buffer[tail & MASK];
+        m_tail.store(tail + 1, std::memory_order_release);
+        return item;
+    }
+
+    /// Approximate; for sleep/wake-up decisions only.
+    bool IsEmpty() const
+    {
+        return m_tail.load(std::memory_order_relaxed) >= m_head.load(std::memory_order_relaxed);
+    }
+
+private:
+    static const size_t MASK = CAPACITY - 1;
+
+    T*                  m_buffer[CAPACITY];
+    std::atomic<size_t> m_head{0};
+    char                m_pad0[LOCKFREE_CACHELINE_SIZE - sizeof(std::atomic<size_t>)];
+    std::atomic<size_t> m_tail{0};
+    char                m_pad1[LOCKFREE_CACHELINE_SIZE - sizeof(std::atomic<size_t>)];
+};
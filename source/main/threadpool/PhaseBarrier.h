@@ -0,0 +1,81 @@
+/*
+    This source file is part of Rigs of Rods
+    Copyright 2013-2017 Petr Ohlidal & contributors
+
+    For more information, see http://www.rigsofrods.org/
+
+    Rigs of Rods is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License version 3, as
+    published by the Free Software Foundation.
+
+    Rigs of Rods is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with Rigs of Rods. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#pragma once
+
+#include <atomic>
+#include <thread>
+
+/** \brief Reusable spinning barrier for a fixed group of threads running phases in lockstep.
+ *
+ * Much cheaper than a fork/join per phase when phases are short (i.e. physics substeps),
+ * but all participants must be running concurrently - never use it with more participants
+ * than threads actually executing (see BeamFactory::UpdatePhysicsSimulation()).
+ * Threads don't sleep; while waiting, they may do other work (see Wait()).
+ */
+class PhaseBarrier
+{
+public:
+    /// Not thread-safe; call before the participants start.
+    void Reset(int num_participants)
+    {
+        m_num_participants = num_participants;
+        m_num_arrived.store(0, std::memory_order_relaxed);
+    }
+
+    /** \brief Blocks until all participants have arrived.
+     *
+     * @param while_waiting Called repeatedly while waiting; returns true if it did some useful work.
+     *                      Must not wait for this barrier itself.
+     */
+    template<typename Func>
+    void Wait(const Func& while_waiting)
+    {
+        const int generation = m_generation.load(std::memory_order_acquire);
+        if (m_num_arrived.fetch_add(1, std::memory_order_acq_rel) + 1 == m_num_participants)
+        {
+            // Last one in; release the others
+            m_num_arrived.store(0, std::memory_order_relaxed);
+            m_generation.fetch_add(1, std::memory_order_release);
+            return;
+        }
+
+        int idle_rounds = 0;
+        while (m_generation.load(std::memory_order_acquire) == generation)
+        {
+            if (while_waiting())
+            {
+                idle_rounds = 0;
+            }
+            else if (++idle_rounds > SPIN_ROUNDS)
+            {
+                std::this_thread::yield();
+            }
+        }
+    }
+
+    void Wait() { this->Wait([]{ return false; }); }
+
+private:
+    static const int SPIN_ROUNDS = 100;
+
+    int              m_num_participants = 1;
+    std::atomic<int> m_num_arrived{0};
+    std::atomic<int> m_generation{0};
+};
@@ -19,22 +19,59 @@ along with Rigs of Rods.  If not, see <http://www.gnu.org/licenses/>.
 
 #pragma once
 
+#include "LockFreeQueues.h"
+
+#include <algorithm>
 #include <atomic>
 #include <condition_variable>
 #include <functional>
 #include <memory>
 #include <mutex>
-#include <queue>
 #include <thread>
 #include <stdexcept>
 #include <vector>
 
+class ThreadPool;
+class Task;
+
+/** \brief Counter-based fork/join barrier for a batch of work submitted to ThreadPool.
+ *
+ * Holds the index range of one ParallelFor() batch; threads grab chunks of `grain` indices
+ * until the range is exhausted. The group is finished when all chunks are done and the
+ * pool holds no more references to it (see ThreadPool::Join()).
+ * Owned by the caller and must outlive the join - usually it simply lives on the stack.
+ *
+ * \see ThreadPool
+ */
+class TaskGroup
+{
+    friend class ThreadPool;
+public:
+    TaskGroup() {}
+
+    /// Non-blocking check; use ThreadPool::Join() to wait.
+    bool IsFinished() const { return m_outstanding.load(std::memory_order_acquire) == 0; }
+
+private:
+    TaskGroup(TaskGroup &) = delete;
+    TaskGroup & operator=(TaskGroup &) = delete;
+
+    std::atomic<int> m_outstanding{0};  ///< Unfinished chunks + queued references in the pool.
+    std::atomic<int> m_next{0};         ///< First index of the next chunk to grab.
+    int              m_end = 0;
+    int              m_grain = 1;
+    const void*      m_func = nullptr;  ///< Callable object; invoked through `m_invoke`.
+    void           (*m_invoke)(const void* func, int begin, int end) = nullptr;
+    Task*            m_task = nullptr;  ///< Owning task if submitted by RunTask(); released when the group finishes.
+};
 
 /** /brief Handle for a task executed by ThreadPool
  *
  * Returned by ThreadPool instance when submitting a new task to run.
  * Provides a thin wrapper around the callable object which implements the actual task.
  * Allows for synchronization, i.e. to wait for the associated task to finish (see join()).
+ * The pool holds a reference to the task until it has finished, so the handle may be dropped
+ * or reassigned at any time.
  *
  * \see ThreadPool
  */
@@ -43,43 +80,29 @@ class Task
     friend class ThreadPool;
     public:
     /// Block the current thread and wait for the associated task to finish.
-    void join() const
-    {
-        // Wait until the tasks is_finished property is set to true by the ThreadPool instance.
-        // Three possible scenarios:
-        // 1) Execution of task has not started yet
-        //    - locks task_mutex
-        //    - is_finished will be false
-        //    - therefore unlocks task_mutex again and waits until signaled by thread pool
-        //    - then is_finished will be true (except in case of spurious wakeups for which the waiting continues)
-        // 2) Task is being executed
-        //    - will try to lock task_mutex, but will fail
-        //    - task_mutex is locked while the task is still running
-        //    - is_finished will be true after aquiring the lock
-        // 3) Task has already finished execution
-        //    - locks task_mutex
-        //    - is_finished will be true
-        std::unique_lock<std::mutex> lock(m_task_mutex);
-        m_finish_cv.wait(lock, [this]{ return m_is_finished; });
-    }
+    void join() const;
 
     private:
     // Only constructable by friend class ThreadPool
-    Task(std::function<void()> task_func) : m_task_func(task_func) {}
+    Task(ThreadPool* pool, std::function<void()> task_func) : m_pool(pool), m_task_func([task_func](int) { task_func(); }) {}
     Task(Task &) = delete;
     Task & operator=(Task &) = delete;
 
-    bool m_is_finished = false;                   ///< Indicates whether the task execution has finished.
-    mutable std::condition_variable m_finish_cv;  ///< Used to signal the current thread when the task has finished.
-    mutable std::mutex m_task_mutex;              ///< Mutex which is locked while the task is running.
-    const std::function<void()> m_task_func;      ///< Callable object which implements the task to execute.
+    ThreadPool* const m_pool;                     ///< Pool which executes the task.
+    mutable TaskGroup m_group;                    ///< Single-chunk group; tracks completion.
+    const std::function<void(int)> m_task_func;   ///< Callable object which implements the task to execute.
+    std::shared_ptr<Task> m_pool_ref;             ///< Keeps the task alive while queued or running; see ThreadPool::Release().
 };
 
 /** \brief Facilitates execution of (small) tasks on separate threads.
  *
- * Implements a "rent-a-thread" model where each submitted task is assigned to one of several worker threads managed by the thread pool instance.
- * This is especially useful for short running tasks as it avoids the runtime cost of creating and launching a new thread. Notice, there
- * still is a certain overhead present due to the synchronization of threads required in the internal implementation.
+ * Work-stealing scheduler: every worker thread owns a lock-free deque, threads outside the pool
+ * submit through a shared lock-free queue. Idle workers steal from each other, spin briefly and
+ * only then go to sleep. Waiting for a batch (Join()) is a single counter per batch; the waiting
+ * thread helps executing work in the meantime, so batches may be nested (i.e. submitted from within a task).
+ *
+ * The fast path (ParallelFor(), StartParallelFor()) doesn't allocate; RunTask() allocates
+ * a Task handle and remains for long-running jobs which need a shareable handle.
  *
  * Usage example 1:
  * \code
@@ -92,12 +115,18 @@ class Task
  * Usage example 2:
  * \code
  *  ThreadPool tp;
- *  auto task1 = []{ ... };
- *  auto task2 = std::bind(my_func, arg1, arg2);
- *  tp.Parallelize({task1, task2});  // Run tasks in parallel and wait until all have finished
+ *  tp.ParallelFor(0, num_items, 16, [&](int i){ Process(items[i]); }); // Blocks until all items are processed
+ * \endcode
+ *
+ * Usage example 3:
+ * \code
+ *  TaskGroup group; // Must outlive Join()
+ *  tp.StartParallelFor(group, 0, num_items, 1, my_func); // `my_func` must outlive Join() as well
+ *  SomeOtherWork();
+ *  tp.Join(group);
  * \endcode
  *
- * \see Task
+ * \see TaskGroup, Task
  */
 class ThreadPool {
 public:
@@ -109,60 +138,131 @@ public:
     {
         if (num_threads < 1) { throw std::invalid_argument("Number of threads is zero or negative."); }
 
-        // Generic function (to be run on a separate thread) within which submitted tasks
-        // are executed. It implements an endless loop (only returning when the ThreadPool
-        // instance itself is destructed) which constantly checks the task queue, grabbing
-        // and executing the frontmost task while the queue is not empty.
-        auto thread_body = [this]{ 
-            while (true) {
-                // Get next task from queue (synchronized access via taskqueue_mutex).
-                // If the queue is empty wait until either
-                //   - being signaled about an available task.
-                //   - the terminate flag is true (i.e. the ThreadPool instance is being destructed).
-                //     In this case return from the running thread.
-                std::unique_lock<std::mutex> queue_lock(m_taskqueue_mutex);
-                while (m_taskqueue.empty()) {
-                    if (m_terminate.load()) { return; }
-                    m_task_available_cv.wait(queue_lock);
-                }
-                const auto current_task = m_taskqueue.front();
-                m_taskqueue.pop();
-                queue_lock.unlock();
-
-                // Execute the actual task and signal the associated Task instance when finished.
-                {
-                    std::lock_guard<std::mutex> task_lock(current_task->m_task_mutex);
-                    current_task->m_task_func();
-                    current_task->m_is_finished = true;
-                }
-                current_task->m_finish_cv.notify_all();
-            }
-        };
-
-        // Launch the specified number of threads
+        // All deques must exist before any worker starts stealing
+        for (int i = 0; i < num_threads; ++i) {
+            m_deques.emplace_back(new Deque());
+        }
+        m_num_active.store(num_threads, std::memory_order_relaxed);
         for (int i = 0; i < num_threads; ++i) {
-            m_threads.emplace_back(thread_body);
+            m_threads.emplace_back([this, i]{ this->WorkerMain(i); });
         }
     }
 
     ~ThreadPool() {
-        // Indicate termination and signal potential waiting threads to wake up.
+        // Indicate termination and signal potential sleeping threads to wake up.
         // Then wait for all threads to finish their work and return properly.
-        m_terminate = true;
-        m_task_available_cv.notify_all();
+        {
+            std::lock_guard<std::mutex> lock(m_sleep_mutex);
+            m_terminate = true;
+        }
+        m_work_available_cv.notify_all();
         for (auto &t : m_threads) { t.join(); }
     }
 
+    /// Number of worker threads which take work; see SetNumActiveThreads().
+    int GetNumThreads() const { return m_num_active.load(std::memory_order_acquire); }
+
+    /// Number of worker threads the pool was created with.
+    int GetMaxThreads() const { return static_cast<int>(m_threads.size()); }
+
+    /** \brief Lets only the first `num_threads` workers take work, the others sleep until reactivated.
+     *
+     * For measuring or limiting parallelism without recreating the pool (users may hold on to it).
+     * With 0, all work runs on the threads which submit and join it.
+     * Must not be called while work is in flight.
+     */
+    void SetNumActiveThreads(int num_threads)
+    {
+        {
+            std::lock_guard<std::mutex> lock(m_sleep_mutex);
+            m_num_active.store(std::max(0, std::min(num_threads, this->GetMaxThreads())), std::memory_order_release);
+        }
+        m_work_available_cv.notify_all();
+    }
+
+    /** \brief Run `func(i)` for every `i` in [begin, end) in parallel; blocks until all calls have finished.
+     *
+     * The range is processed in chunks of `grain` indices, the calling thread participates. No allocations.
+     */
+    template<typename Func>
+    void ParallelFor(int begin, int end, int grain, const Func& func)
+    {
+        if (end <= begin) return;
+        if (end - begin <= grain)
+        {
+            for (int i = begin; i < end; ++i) { func(i); }
+            return;
+        }
+
+        TaskGroup group;
+        this->StartParallelFor(group, begin, end, grain, func);
+        this->Join(group);
+    }
+
+    /** \brief Asynchronous variant of ParallelFor(); call Join() to wait for completion.
+     *
+     * Both `group` and `func` are referenced until Join() returns.
+     */
+    template<typename Func>
+    void StartParallelFor(TaskGroup& group, int begin, int end, int grain, const Func& func)
+    {
+        grain = std::max(1, grain);
+        const int num_chunks = (end > begin) ? ((end - begin + grain - 1) / grain) : 0;
+
+        group.m_next.store(begin, std::memory_order_relaxed);
+        group.m_end = end;
+        group.m_grain = grain;
+        group.m_func = &func;
+        group.m_invoke = &ThreadPool::InvokeRange<Func>;
+
+        // The joining thread processes chunks as well, hence one helper less
+        const int num_helpers = std::max(0, std::min(num_chunks - 1, this->GetNumThreads()));
+        group.m_outstanding.store(num_chunks + num_helpers, std::memory_order_release);
+        this->Submit(group, num_helpers);
+    }
+
+    /// Wait until the group is finished; helps executing work meanwhile.
+    void Join(TaskGroup& group)
+    {
+        const int worker = this->GetCurrentWorkerIndex();
+        int idle_rounds = 0;
+        while (!group.IsFinished())
+        {
+            if (this->RunChunks(group) || this->TryRunOne(worker))
+            {
+                idle_rounds = 0;
+                continue;
+            }
+            if (this->Backoff(idle_rounds++))
+            {
+                continue;
+            }
+
+            // Nothing to do but wait for other threads to finish their chunks
+            std::unique_lock<std::mutex> lock(m_sleep_mutex);
+            m_num_sleeping_joiners.fetch_add(1, std::memory_order_seq_cst);
+            if (!group.IsFinished())
+            {
+                m_group_finished_cv.wait(lock);
+            }
+            m_num_sleeping_joiners.fetch_sub(1, std::memory_order_seq_cst);
+            idle_rounds = 0;
+        }
+    }
+
     /// Submit new asynchronous task to thread pool and return Task handle to allow for synchronization.
     std::shared_ptr<Task> RunTask(const std::function<void()> &task_func) {
-        // Wrap provided task callable object in task handle. Then append it to the task queue and
-        // notify a waiting worker thread (if any) about the newly available task
-        auto task = std::shared_ptr<Task>(new Task(task_func));
+        auto task = std::shared_ptr<Task>(new Task(this, task_func));
+        task->m_pool_ref = task;
+        task->m_group.m_task = task.get();
+        this->StartParallelFor(task->m_group, 0, 1, 1, task->m_task_func);
+
+        // A single chunk never gets a helper (see StartParallelFor()), so queue the task explicitly
+        task->m_group.m_outstanding.fetch_add(1, std::memory_order_relaxed);
+        if (this->Submit(task->m_group, 1) == 0)
         {
-            std::lock_guard<std::mutex> lock(m_taskqueue_mutex);
-            m_taskqueue.push(task);
+            this->RunChunks(task->m_group); // Queue full; nobody may ever join, so run it right away
         }
-        m_task_available_cv.notify_one();
 
         // Return task handle for later synchronization
         return task;
@@ -171,27 +271,227 @@ public:
     /// Run collection of tasks in parallel and wait until all have finished.
     void Parallelize(const std::vector<std::function<void()>> &task_funcs)
     {
-        if (task_funcs.empty()) return;
+        this->ParallelFor(0, static_cast<int>(task_funcs.size()), 1, [&task_funcs](int i) { task_funcs[i](); });
+    }
+
+    /// Executes one queued piece of work, if any. For threads waiting on their own synchronization (see PhaseBarrier).
+    bool RunPendingTask()
+    {
+        return this->TryRunOne(this->GetCurrentWorkerIndex());
+    }
 
-        // Launch all provided tasks (except for the first) in parallel and store the associated handles
-        auto it = begin(task_funcs);
-        const auto first_task = it++;
-        std::vector<std::shared_ptr<Task>> handles;
-        for(; it != end(task_funcs); ++it)
-        { 
-            handles.push_back(RunTask(*it));
+private:
+    typedef WorkStealingDeque<TaskGroup> Deque;
+
+    /// Spin-then-yield; returns false when it's time to sleep.
+    static bool Backoff(int idle_rounds)
+    {
+        if (idle_rounds < SPIN_ROUNDS)
+        {
+            for (int i = 0; i < 32; ++i) { std::atomic_signal_fence(std::memory_order_seq_cst); } // Short busy-wait
+            return true;
+        }
+        if (idle_rounds < SPIN_ROUNDS + YIELD_ROUNDS)
+        {
+            std::this_thread::yield();
+            return true;
+        }
+        return false;
+    }
+
+    template<typename Func>
+    static void InvokeRange(const void* func, int begin, int end)
+    {
+        const Func& f = *static_cast<const Func*>(func);
+        for (int i = begin; i < end; ++i) { f(i); }
+    }
+
+    /// Pushes `count` references to the group; the group's counter must already include them.
+    /// Returns the number of references actually queued.
+    int Submit(TaskGroup& group, int count)
+    {
+        const int worker = this->GetCurrentWorkerIndex();
+        int pushed = 0;
+        for (; pushed < count; ++pushed)
+        {
+            const bool ok = (worker >= 0) ? m_deques[worker]->Push(&group) : m_injection_queue.Push(&group);
+            if (!ok) break;
+        }
+        if (pushed < count)
+        {
+            // Queue full; the joining thread will do the work instead
+            this->Release(group, count - pushed);
+        }
+        if (pushed > 0 && m_num_sleeping_workers.load(std::memory_order_seq_cst) > 0)
+        {
+            std::lock_guard<std::mutex> lock(m_sleep_mutex);
+            m_work_available_cv.notify_all();
+        }
+        return pushed;
+    }
+
+    /// Processes chunks of the group until the range is exhausted. Returns true if any chunk was processed.
+    bool RunChunks(TaskGroup& group)
+    {
+        int num_done = 0;
+        while (true)
+        {
+            const int begin = group.m_next.fetch_add(group.m_grain, std::memory_order_relaxed);
+            if (begin >= group.m_end) break;
+            group.m_invoke(group.m_func, begin, std::min(begin + group.m_grain, group.m_end));
+            ++num_done;
+        }
+        if (num_done > 0)
+        {
+            this->Release(group, num_done);
+        }
+        return num_done > 0;
+    }
+
+    /// Decrements the group's counter; the group must not be touched afterwards (the owner may destroy it).
+    void Release(TaskGroup& group, int count)
+    {
+        Task* const task = group.m_task; // Read while the group is guaranteed to exist
+        if (group.m_outstanding.fetch_sub(count, std::memory_order_seq_cst) == count)
+        {
+            if (m_num_sleeping_joiners.load(std::memory_order_seq_cst) > 0)
+            {
+                std::lock_guard<std::mutex> lock(m_sleep_mutex);
+                m_group_finished_cv.notify_all();
+            }
+            if (task)
+            {
+                // The pool is done with the task; destroys it if the handle is gone already
+                std::shared_ptr<Task> pool_ref = std::move(task->m_pool_ref);
+            }
+        }
+    }
+
+    /// Grabs one queued group reference (own deque, then shared queue, then steal) and processes it.
+    bool TryRunOne(int worker)
+    {
+        TaskGroup* group = nullptr;
+        if (worker >= 0)
+        {
+            group = m_deques[worker]->Pop();
+        }
+        if (!group)
+        {
+            group = m_injection_queue.Pop();
+        }
+        const int num_deques = static_cast<int>(m_deques.size());
+        for (int i = 1; !group && i <= num_deques; ++i)
+        {
+            group = m_deques[(std::max(worker, 0) + i) % num_deques]->Steal();
+        }
+        if (!group)
+        {
+            return false;
         }
 
-        // Run the first task locally on the current thread
-        (*first_task)();
+        this->RunChunks(*group);
+        this->Release(*group, 1); // The queued reference
+        return true;
+    }
 
-        // Synchronize, i.e. wait for all parallelized tasks to complete
-        for(const auto &h : handles) { h->join(); }
+    bool HasQueuedWork() const
+    {
+        if (!m_injection_queue.IsEmpty()) return true;
+        for (auto& deque : m_deques)
+        {
+            if (!deque->IsEmpty()) return true;
+        }
+        return false;
     }
 
-    std::atomic_bool m_terminate{false};            ///< Indicates destruction of ThreadPool instance to worker threads
-    std::vector<std::thread> m_threads;             ///< Collection of worker threads to run tasks
-    std::queue<std::shared_ptr<Task>> m_taskqueue;  ///< Queue of submitted tasks pending for execution
-    std::mutex m_taskqueue_mutex;                   ///< Protects task queue from concurrent access.
-    std::condition_variable m_task_available_cv;    ///< Used to signal threads that a new task was submitted and is ready to run.
+    void WorkerMain(int index)
+    {
+        this->SetCurrentWorkerIndex(index);
+        int idle_rounds = 0;
+        while (true)
+        {
+            if (index >= m_num_active.load(std::memory_order_acquire))
+            {
+                // Deactivated, see SetNumActiveThreads(); own deque is empty as no work was in flight
+                std::unique_lock<std::mutex> lock(m_sleep_mutex);
+                m_work_available_cv.wait(lock, [this, index] { return m_terminate || index < m_num_active.load(std::memory_order_relaxed); });
+                if (m_terminate)
+                {
+                    return;
+                }
+                idle_rounds = 0;
+                continue;
+            }
+
+            if (this->TryRunOne(index))
+            {
+                idle_rounds = 0;
+                continue;
+            }
+            if (this->Backoff(idle_rounds++))
+            {
+                continue;
+            }
+
+            // Sleep until new work is submitted. The counter is raised before re-checking the queues,
+            // submitters check it after pushing - one of both always sees the other.
+            std::unique_lock<std::mutex> lock(m_sleep_mutex);
+            m_num_sleeping_workers.fetch_add(1, std::memory_order_seq_cst);
+            if (!m_terminate && !this->HasQueuedWork())
+            {
+                m_work_available_cv.wait(lock);
+            }
+            m_num_sleeping_workers.fetch_sub(1, std::memory_order_seq_cst);
+            if (m_terminate && !this->HasQueuedWork())
+            {
+                return;
+            }
+            idle_rounds = 0;
+        }
+    }
+
+    /// Index of the calling worker thread in this pool, or -1 for outside threads.
+    int GetCurrentWorkerIndex() const
+    {
+        const WorkerId& id = CurrentWorkerId();
+        return (id.pool == this) ? id.index : -1;
+    }
+
+    void SetCurrentWorkerIndex(int index)
+    {
+        WorkerId& id = CurrentWorkerId();
+        id.pool = this;
+        id.index = index;
+    }
+
+    struct WorkerId
+    {
+        const ThreadPool* pool;
+        int               index;
+    };
+
+    static WorkerId& CurrentWorkerId()
+    {
+        static thread_local WorkerId id = { nullptr, -1 };
+        return id;
+    }
+
+    static const int SPIN_ROUNDS = 200;   ///< Busy-wait rounds before yielding
+    static const int YIELD_ROUNDS = 50;   ///< Yield rounds before sleeping
+
+    std::vector<std::thread> m_threads;                     ///< Collection of worker threads to run tasks
+    std::vector<std::unique_ptr<Deque>> m_deques;           ///< One per worker thread; owner pushes/pops, others steal
+    MPMCQueue<TaskGroup> m_injection_queue;                 ///< Work submitted by threads outside the pool
+    std::atomic<int> m_num_active{0};                       ///< Workers with a lower index take work; written under `m_sleep_mutex`
+    std::atomic<int> m_num_sleeping_workers{0};
+    std::atomic<int> m_num_sleeping_joiners{0};
+    bool m_terminate = false;                               ///< Indicates destruction of ThreadPool instance to worker threads; protected by `m_sleep_mutex`
+    std::mutex m_sleep_mutex;                               ///< Only taken to go to sleep or to wake up sleeping threads
+    std::condition_variable m_work_available_cv;            ///< Wakes up workers when work is submitted
+    std::condition_variable m_group_finished_cv;            ///< Wakes up threads waiting in Join()
 };
+
+inline void Task::join() const
+{
+    m_pool->Join(m_group);
+}
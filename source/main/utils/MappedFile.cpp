@@ -0,0 +1,102 @@
+/*
+    This source file is part of Rigs of Rods
+    Copyright 2013-2017 Petr Ohlidal & contributors
+
+    For more information, see http://www.rigsofrods.org/
+
+    Rigs of Rods is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License version 3, as
+    published by the Free Software Foundation.
+
+    Rigs of Rods is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with Rigs of Rods. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "MappedFile.h"
+
+#ifdef _WIN32
+#   include <windows.h>
+#else
+#   include <fcntl.h>
+#   include <sys/mman.h>
+#   include <sys/stat.h>
+#   include <unistd.h>
+#endif
+
+using namespace RoR;
+
+MappedFile::MappedFile():
+    m_data(nullptr),
+    m_size(0)
+{
+}
+
+MappedFile::~MappedFile()
+{
+    this->Close();
+}
+
+bool MappedFile::Open(std::string const& filename)
+{
+    this->Close();
+
+#ifdef _WIN32
+    HANDLE file = CreateFileA(filename.c_str(), GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+    if (file == INVALID_HANDLE_VALUE)
+        return false;
+    LARGE_INTEGER file_size;
+    if (!GetFileSizeEx(file, &file_size) || file_size.QuadPart <= 0)
+    {
+        CloseHandle(file);
+        return false;
+    }
+    HANDLE mapping = CreateFileMappingA(file, NULL, PAGE_READONLY, 0, 0, NULL);
+    void* data = (mapping) ? MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0) : nullptr;
+    // The view keeps the file mapped
+    if (mapping)
+        CloseHandle(mapping);
+    CloseHandle(file);
+    if (!data)
+        return false;
+    const size_t size = static_cast<size_t>(file_size.QuadPart);
+#else
+    int fd = open(filename.c_str(), O_RDONLY);
+    if (fd < 0)
+        return false;
+    struct stat st;
+    if (fstat(fd, &st) != 0 || st.st_size <= 0)
+    {
+        close(fd);
+        return false;
+    }
+    const size_t size = static_cast<size_t>(st.st_size);
+    void* data = mmap(nullptr, size, PROT_READ, MAP_SHARED, fd, 0);
+    // The mapping keeps the file open
+    close(fd);
+    if (data == MAP_FAILED)
+        return false;
+#endif
+
+    m_data = data;
+    m_size = size;
+    return true;
+}
+
+void MappedFile::Close()
+{
+    if (!m_data)
+        return;
+
+#ifdef _WIN32
+    UnmapViewOfFile(m_data);
+#else
+    munmap(m_data, m_size);
+#endif
+    m_data = nullptr;
+    m_size = 0;
+}
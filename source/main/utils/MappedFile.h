@@ -0,0 +1,53 @@
+/*
+    This source file is part of Rigs of Rods
+    Copyright 2013-2017 Petr Ohlidal & contributors
+
+    For more information, see http://www.rigsofrods.org/
+
+    Rigs of Rods is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License version 3, as
+    published by the Free Software Foundation.
+
+    Rigs of Rods is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with Rigs of Rods. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+/// @file
+/// @brief Read-only memory mapping of a file.
+
+#pragma once
+
+#include <cstddef>
+#include <string>
+
+namespace RoR {
+
+/// Maps a whole file into memory for reading; used for binary cache files.
+class MappedFile
+{
+public:
+    MappedFile();
+    ~MappedFile();
+
+    /// @return False if the file doesn't exist, is empty or can't be mapped.
+    bool Open(std::string const& filename);
+    void Close();
+
+    bool        IsOpen() const  { return m_data != nullptr; }
+    const char* GetData() const { return static_cast<const char*>(m_data); }
+    size_t      GetSize() const { return m_size; }
+
+private:
+    MappedFile(MappedFile const&);            // Not copyable
+    MappedFile& operator=(MappedFile const&);
+
+    void*  m_data;
+    size_t m_size;
+};
+
+} // namespace RoR
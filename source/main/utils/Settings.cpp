@@ -71,7 +71,12 @@ enum {
     OPT_INCLUDEPATH,
     OPT_ADVLOG,
     OPT_NOCACHE,
-    OPT_JOINMPSERVER
+    OPT_JOINMPSERVER,
+    OPT_BENCHPHYSICS,
+    OPT_BENCHTHREADS,
+    OPT_RECORDPHYSICS,
+    OPT_PLAYPHYSICS,
+    OPT_PHYSICSTOLERANCE
 };
 
 // option array
@@ -93,6 +98,11 @@ CSimpleOpt::SOption cmdline_options[] = {
     { OPT_INCLUDEPATH,    ("-includepath"), SO_REQ_SEP },
     { OPT_NOCACHE,        ("-nocache"),     SO_NONE    },
     { OPT_JOINMPSERVER,   ("-joinserver"),  SO_REQ_CMB },
+    { OPT_BENCHPHYSICS,   ("-benchphysics"), SO_REQ_SEP },
+    { OPT_BENCHTHREADS,   ("-benchthreads"), SO_REQ_SEP },
+    { OPT_RECORDPHYSICS,  ("-recordphysics"), SO_REQ_SEP },
+    { OPT_PLAYPHYSICS,    ("-playphysics"), SO_REQ_SEP },
+    { OPT_PHYSICSTOLERANCE, ("-physicstolerance"), SO_REQ_SEP },
     SO_END_OF_OPTIONS
 };
 
@@ -109,6 +119,11 @@ void ShowCommandLineUsage()
             "-version shows the version information"    "\n"
             "-enter enters the selected truck"          "\n"
             "-userpath <path> sets the user directory"  "\n"
+            "-benchphysics <seconds> runs the physics of the preselected map/truck for the given simulated time, prints the speed and exits" "\n"
+            "-benchthreads <n,n,...> thread pool sizes to benchmark, 0 = no pool (default: 0 and the configured size)" "\n"
+            "-recordphysics <file> records the physics inputs of the session (or of -playphysics) to a file" "\n"
+            "-playphysics <file> replays a physics recording of the preselected map/truck, reports speed and divergence and exits" "\n"
+            "-physicstolerance <meters> node position divergence accepted by -playphysics (default: 0, bit-identical)" "\n"
             "For example: RoR.exe -map oahu -truck semi"));
 }
 
@@ -329,6 +344,26 @@ void Settings::ProcessCommandLine(int argc, char *argv[])
         {
             SETTINGS.setSetting("USE_OGRE_CONFIG", "Yes");
         } 
+        else if (args.OptionId() == OPT_BENCHPHYSICS) 
+        {
+            SETTINGS.setSetting("Physics Benchmark", args.OptionArg());
+        } 
+        else if (args.OptionId() == OPT_BENCHTHREADS) 
+        {
+            SETTINGS.setSetting("Physics Benchmark Threads", args.OptionArg());
+        } 
+        else if (args.OptionId() == OPT_RECORDPHYSICS) 
+        {
+            SETTINGS.setSetting("Physics Recording", args.OptionArg());
+        } 
+        else if (args.OptionId() == OPT_PLAYPHYSICS) 
+        {
+            SETTINGS.setSetting("Physics Playback", args.OptionArg());
+        } 
+        else if (args.OptionId() == OPT_PHYSICSTOLERANCE) 
+        {
+            SETTINGS.setSetting("Physics Playback Tolerance", args.OptionArg());
+        } 
         else if (args.OptionId() == OPT_JOINMPSERVER) 
         {
             std::string server_args = args.OptionArg();
@@ -0,0 +1,325 @@
+
+// Spring kernel of Beam::calcBeams(): array-of-structures (original) vs. structure-of-arrays (RoR::BeamSoA)
+// Self-contained; node_t/beam_t are reduced mock-ups with roughly the same memory footprint as the real thing.
+
+#include "benchmark/benchmark.h"
+#include <cmath>
+#include <cstring>
+#include <iostream>
+#include <vector>
+
+#include <emmintrin.h> // SSE2
+
+// ################################# Data #####################################
+
+struct Vec3 { float x, y, z; };
+
+struct node_t // Real node_t: ~150 bytes
+{
+    Vec3  RelPosition;
+    Vec3  AbsPosition;
+    Vec3  Velocity;
+    Vec3  Forces;
+    float mass;
+    char  padding[100];
+};
+
+struct beam_t // Real beam_t: ~200 bytes
+{
+    node_t* p1;
+    node_t* p2;
+    float   k;
+    float   d;
+    float   L;
+    float   minmaxposnegstress;
+    float   stress;
+    char    padding[160];
+};
+
+const int NUM_SEGMENTS = 250; // 4 nodes per segment -> 1000 nodes, 20 beams per segment -> ~5000 beams
+
+std::vector<node_t> nodes;
+std::vector<beam_t> beams;
+
+void AddBeam(int a, int b)
+{
+    beam_t beam;
+    memset(&beam, 0, sizeof(beam_t));
+    beam.p1 = &nodes[a];
+    beam.p2 = &nodes[b];
+    beam.k = 9000000.f;
+    beam.d = 12000.f;
+    float dx = nodes[a].RelPosition.x - nodes[b].RelPosition.x;
+    float dy = nodes[a].RelPosition.y - nodes[b].RelPosition.y;
+    float dz = nodes[a].RelPosition.z - nodes[b].RelPosition.z;
+    beam.L = std::sqrt(dx*dx + dy*dy + dz*dz);
+    beam.minmaxposnegstress = 1e12f;
+    beams.push_back(beam);
+}
+
+void PrepareTruck()
+{
+    nodes.resize(NUM_SEGMENTS * 4);
+    memset(nodes.data(), 0, nodes.size() * sizeof(node_t));
+    for (int i = 0; i < (int)nodes.size(); ++i)
+    {
+        int seg = i / 4, corner = i % 4;
+        // Slightly perturbed lattice so that springs are under load
+        nodes[i].RelPosition.x = seg * 0.5f + 0.01f * (i % 7);
+        nodes[i].RelPosition.y = (corner & 1) * 1.f;
+        nodes[i].RelPosition.z = (corner >> 1) * 1.f;
+        nodes[i].Velocity.x = 0.1f * (i % 3);
+    }
+    // Ladder-frame lattice with all cross-bracing, like a typical truck chassis
+    for (int s = 0; s < NUM_SEGMENTS; ++s)
+    {
+        int b = s * 4;
+        AddBeam(b+0, b+1); AddBeam(b+0, b+2); AddBeam(b+1, b+3); AddBeam(b+2, b+3);
+        AddBeam(b+0, b+3); AddBeam(b+1, b+2);
+        if (s + 1 < NUM_SEGMENTS)
+        {
+            int n = b + 4;
+            for (int i = 0; i < 4; ++i)
+            {
+                AddBeam(b+i, n+i);     // longitudinal
+                AddBeam(b+i, n+(i^1)); // side diagonals
+                AddBeam(b+i, n+(i^2));
+            }
+            AddBeam(b+0, n+3); AddBeam(b+1, n+2); // space diagonals
+        }
+    }
+}
+
+float fast_invSqrt(const float v) // Copy of ApproxMath.h
+{
+    union { float f; int i; } u;
+    const float x2 = v * 0.5f;
+    u.f = v;
+    u.i = 0x5f3759df - (u.i >> 1);
+    u.f = u.f * (1.5f - (x2 * u.f * u.f));
+    return u.f;
+}
+
+// ################################# Solution 1 - AoS (original calcBeams()) #################################
+
+static void Bench_sol1__AoS(benchmark::State& state)
+{
+    while (state.KeepRunning())
+    {
+        for (size_t i = 0; i < beams.size(); ++i)
+        {
+            beam_t& beam = beams[i];
+            float dx = beam.p1->RelPosition.x - beam.p2->RelPosition.x;
+            float dy = beam.p1->RelPosition.y - beam.p2->RelPosition.y;
+            float dz = beam.p1->RelPosition.z - beam.p2->RelPosition.z;
+            float dislen = dx*dx + dy*dy + dz*dz;
+            float inverted_dislen = fast_invSqrt(dislen);
+            dislen *= inverted_dislen;
+            float difftoBeamL = dislen - beam.L;
+            float vx = beam.p1->Velocity.x - beam.p2->Velocity.x;
+            float vy = beam.p1->Velocity.y - beam.p2->Velocity.y;
+            float vz = beam.p1->Velocity.z - beam.p2->Velocity.z;
+            float slen = -beam.k * difftoBeamL - beam.d * (vx*dx + vy*dy + vz*dz) * inverted_dislen;
+            beam.stress = slen;
+            if (std::abs(slen) > beam.minmaxposnegstress)
+                continue;
+            slen *= inverted_dislen;
+            beam.p1->Forces.x += dx * slen; beam.p1->Forces.y += dy * slen; beam.p1->Forces.z += dz * slen;
+            beam.p2->Forces.x -= dx * slen; beam.p2->Forces.y -= dy * slen; beam.p2->Forces.z -= dz * slen;
+        }
+        benchmark::DoNotOptimize(nodes.data());
+    }
+}
+BENCHMARK(Bench_sol1__AoS);
+
+// ################################# Solution 2 - SoA (RoR::BeamSoA) #################################
+// Beams are split per field; nodes are packed (position + velocity = 8 floats, forces = 4 floats per node)
+// so that the SSE kernel loads and updates a node with single 4-wide operations.
+
+struct SoA
+{
+    std::vector<float> node_state, forces;
+    std::vector<int>   node1, node2;
+    std::vector<float> k, d, L, minmaxposnegstress, stress;
+    std::vector<int>   exceeded;
+} soa;
+
+void PrepareSoA()
+{
+    for (beam_t& beam : beams)
+    {
+        soa.node1.push_back((int)(beam.p1 - nodes.data()));
+        soa.node2.push_back((int)(beam.p2 - nodes.data()));
+        soa.k.push_back(beam.k);
+        soa.d.push_back(beam.d);
+        soa.L.push_back(beam.L);
+        soa.minmaxposnegstress.push_back(beam.minmaxposnegstress);
+    }
+    soa.stress.resize(beams.size());
+}
+
+void GatherNodes()
+{
+    const size_t n = nodes.size();
+    soa.node_state.resize(n * 8);
+    soa.forces.assign(n * 4, 0.f);
+    for (size_t i = 0; i < n; ++i)
+    {
+        float* s = &soa.node_state[i * 8];
+        s[0] = nodes[i].RelPosition.x; s[1] = nodes[i].RelPosition.y; s[2] = nodes[i].RelPosition.z; s[3] = 0.f;
+        s[4] = nodes[i].Velocity.x;    s[5] = nodes[i].Velocity.y;    s[6] = nodes[i].Velocity.z;    s[7] = 0.f;
+    }
+}
+
+void ScatterForces()
+{
+    for (size_t i = 0; i < nodes.size(); ++i)
+    {
+        nodes[i].Forces.x += soa.forces[i*4]; nodes[i].Forces.y += soa.forces[i*4+1]; nodes[i].Forces.z += soa.forces[i*4+2];
+    }
+}
+
+void CalcSpringsRange(size_t begin, size_t end)
+{
+    for (size_t slot = begin; slot < end; ++slot)
+    {
+        const float* s1 = &soa.node_state[soa.node1[slot] * 8];
+        const float* s2 = &soa.node_state[soa.node2[slot] * 8];
+        const float dx = s1[0] - s2[0];
+        const float dy = s1[1] - s2[1];
+        const float dz = s1[2] - s2[2];
+        float dislen = dx*dx + dy*dy + dz*dz;
+        const float inv_dislen = fast_invSqrt(dislen);
+        dislen *= inv_dislen;
+        const float vx = s1[4] - s2[4];
+        const float vy = s1[5] - s2[5];
+        const float vz = s1[6] - s2[6];
+        const float slen = -soa.k[slot] * (dislen - soa.L[slot]) - soa.d[slot] * (vx*dx + vy*dy + vz*dz) * inv_dislen;
+        soa.stress[slot] = slen;
+        if (std::abs(slen) > soa.minmaxposnegstress[slot])
+        {
+            soa.exceeded.push_back((int)slot);
+            continue;
+        }
+        const float scale = slen * inv_dislen;
+        float* f1 = &soa.forces[soa.node1[slot] * 4];
+        float* f2 = &soa.forces[soa.node2[slot] * 4];
+        f1[0] += dx * scale; f1[1] += dy * scale; f1[2] += dz * scale;
+        f2[0] -= dx * scale; f2[1] -= dy * scale; f2[2] -= dz * scale;
+    }
+}
+
+void CalcSpringsSSE()
+{
+    const size_t num_beams = soa.node1.size();
+    const size_t num_packed = num_beams - (num_beams % 4);
+    const __m128 half       = _mm_set1_ps(0.5f);
+    const __m128 three_half = _mm_set1_ps(1.5f);
+    const __m128i magic     = _mm_set1_epi32(0x5f3759df);
+    const __m128 abs_mask   = _mm_castsi128_ps(_mm_set1_epi32(0x7fffffff));
+    const __m128 sign_mask  = _mm_castsi128_ps(_mm_set1_epi32(0x80000000));
+    const float* state = soa.node_state.data();
+    float* forces = soa.forces.data();
+
+    for (size_t slot = 0; slot < num_packed; slot += 4)
+    {
+        const int* n1 = &soa.node1[slot];
+        const int* n2 = &soa.node2[slot];
+        const __m128 dis0 = _mm_sub_ps(_mm_loadu_ps(state + n1[0] * 8), _mm_loadu_ps(state + n2[0] * 8));
+        const __m128 dis1 = _mm_sub_ps(_mm_loadu_ps(state + n1[1] * 8), _mm_loadu_ps(state + n2[1] * 8));
+        const __m128 dis2 = _mm_sub_ps(_mm_loadu_ps(state + n1[2] * 8), _mm_loadu_ps(state + n2[2] * 8));
+        const __m128 dis3 = _mm_sub_ps(_mm_loadu_ps(state + n1[3] * 8), _mm_loadu_ps(state + n2[3] * 8));
+        __m128 vvx = _mm_sub_ps(_mm_loadu_ps(state + n1[0] * 8 + 4), _mm_loadu_ps(state + n2[0] * 8 + 4));
+        __m128 vvy = _mm_sub_ps(_mm_loadu_ps(state + n1[1] * 8 + 4), _mm_loadu_ps(state + n2[1] * 8 + 4));
+        __m128 vvz = _mm_sub_ps(_mm_loadu_ps(state + n1[2] * 8 + 4), _mm_loadu_ps(state + n2[2] * 8 + 4));
+        __m128 vvw = _mm_sub_ps(_mm_loadu_ps(state + n1[3] * 8 + 4), _mm_loadu_ps(state + n2[3] * 8 + 4));
+        __m128 vdx = dis0, vdy = dis1, vdz = dis2, vdw = dis3;
+        _MM_TRANSPOSE4_PS(vdx, vdy, vdz, vdw);
+        _MM_TRANSPOSE4_PS(vvx, vvy, vvz, vvw);
+        const __m128 dislen_sq = _mm_add_ps(_mm_add_ps(_mm_mul_ps(vdx, vdx), _mm_mul_ps(vdy, vdy)), _mm_mul_ps(vdz, vdz));
+        __m128 vinv = _mm_castsi128_ps(_mm_sub_epi32(magic, _mm_srai_epi32(_mm_castps_si128(dislen_sq), 1)));
+        vinv = _mm_mul_ps(vinv, _mm_sub_ps(three_half, _mm_mul_ps(_mm_mul_ps(_mm_mul_ps(half, dislen_sq), vinv), vinv)));
+        const __m128 difftoBeamL = _mm_sub_ps(_mm_mul_ps(dislen_sq, vinv), _mm_loadu_ps(&soa.L[slot]));
+        const __m128 vdot = _mm_add_ps(_mm_add_ps(_mm_mul_ps(vvx, vdx), _mm_mul_ps(vvy, vdy)), _mm_mul_ps(vvz, vdz));
+        const __m128 vslen = _mm_sub_ps(
+            _mm_xor_ps(_mm_mul_ps(_mm_loadu_ps(&soa.k[slot]), difftoBeamL), sign_mask),
+            _mm_mul_ps(_mm_mul_ps(_mm_loadu_ps(&soa.d[slot]), vdot), vinv));
+        _mm_storeu_ps(&soa.stress[slot], vslen);
+        const __m128 exceeded = _mm_cmpgt_ps(_mm_and_ps(vslen, abs_mask), _mm_loadu_ps(&soa.minmaxposnegstress[slot]));
+        const __m128 vscale = _mm_andnot_ps(exceeded, _mm_mul_ps(vslen, vinv));
+        const __m128 f0 = _mm_mul_ps(dis0, _mm_shuffle_ps(vscale, vscale, _MM_SHUFFLE(0, 0, 0, 0)));
+        const __m128 f1 = _mm_mul_ps(dis1, _mm_shuffle_ps(vscale, vscale, _MM_SHUFFLE(1, 1, 1, 1)));
+        const __m128 f2 = _mm_mul_ps(dis2, _mm_shuffle_ps(vscale, vscale, _MM_SHUFFLE(2, 2, 2, 2)));
+        const __m128 f3 = _mm_mul_ps(dis3, _mm_shuffle_ps(vscale, vscale, _MM_SHUFFLE(3, 3, 3, 3)));
+        float* a; float* b;
+        a = forces + n1[0] * 4; b = forces + n2[0] * 4; _mm_storeu_ps(a, _mm_add_ps(_mm_loadu_ps(a), f0)); _mm_storeu_ps(b, _mm_sub_ps(_mm_loadu_ps(b), f0));
+        a = forces + n1[1] * 4; b = forces + n2[1] * 4; _mm_storeu_ps(a, _mm_add_ps(_mm_loadu_ps(a), f1)); _mm_storeu_ps(b, _mm_sub_ps(_mm_loadu_ps(b), f1));
+        a = forces + n1[2] * 4; b = forces + n2[2] * 4; _mm_storeu_ps(a, _mm_add_ps(_mm_loadu_ps(a), f2)); _mm_storeu_ps(b, _mm_sub_ps(_mm_loadu_ps(b), f2));
+        a = forces + n1[3] * 4; b = forces + n2[3] * 4; _mm_storeu_ps(a, _mm_add_ps(_mm_loadu_ps(a), f3)); _mm_storeu_ps(b, _mm_sub_ps(_mm_loadu_ps(b), f3));
+        const int exceeded_bits = _mm_movemask_ps(exceeded);
+        if (exceeded_bits)
+        {
+            for (int lane = 0; lane < 4; ++lane)
+                if (exceeded_bits & (1 << lane)) soa.exceeded.push_back((int)(slot + lane));
+        }
+    }
+    CalcSpringsRange(num_packed, num_beams);
+}
+
+static void Bench_sol2__SoAScalar(benchmark::State& state)
+{
+    while (state.KeepRunning())
+    {
+        GatherNodes();
+        soa.exceeded.clear();
+        CalcSpringsRange(0, soa.node1.size());
+        ScatterForces();
+        benchmark::DoNotOptimize(nodes.data());
+    }
+}
+BENCHMARK(Bench_sol2__SoAScalar);
+
+static void Bench_sol2b_SoASSE(benchmark::State& state)
+{
+    while (state.KeepRunning())
+    {
+        GatherNodes();
+        soa.exceeded.clear();
+        CalcSpringsSSE();
+        ScatterForces();
+        benchmark::DoNotOptimize(nodes.data());
+    }
+}
+BENCHMARK(Bench_sol2b_SoASSE);
+
+static void Bench_sol2c_SoASSEKernelOnly(benchmark::State& state)
+{
+    GatherNodes();
+    while (state.KeepRunning())
+    {
+        soa.exceeded.clear();
+        CalcSpringsSSE();
+        benchmark::DoNotOptimize(soa.forces.data());
+    }
+}
+BENCHMARK(Bench_sol2c_SoASSEKernelOnly);
+
+int main(int argc, char** argv)
+{
+    using namespace std;
+
+    // prepare
+    cout << "Preparing..." << endl;
+    nodes.reserve(NUM_SEGMENTS * 4);
+    PrepareTruck();
+    PrepareSoA();
+    cout << "Nodes: " << nodes.size() << ", beams: " << beams.size() << endl;
+
+    // benchmark
+    ::benchmark::Initialize(&argc, argv);
+    ::benchmark::RunSpecifiedBenchmarks();
+#ifdef _MSC_VER
+    system("pause");
+#endif
+    return 0;
+}
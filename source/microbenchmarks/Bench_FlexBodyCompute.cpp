@@ -0,0 +1,368 @@
+// Deformation kernel of FlexBody::flexitCompute(): array-of-structures locators (original) vs. structure-of-arrays + SIMD
+// Self-contained; node_t/Locator_t are reduced mock-ups with roughly the same memory footprint as the real thing.
+// Build with -mavx2 to include the AVX2 variant.
+
+#include "benchmark/benchmark.h"
+#include <cmath>
+#include <cstddef>
+#include <cstring>
+#include <iostream>
+#include <vector>
+
+#include <emmintrin.h> // SSE2
+#ifdef __AVX2__
+#   include <immintrin.h>
+#endif
+
+// ################################# Data #####################################
+
+struct Vec3
+{
+    float x, y, z;
+
+    Vec3 operator-(Vec3 const& o) const { Vec3 r = {x - o.x, y - o.y, z - o.z}; return r; }
+    Vec3 operator*(float f) const       { Vec3 r = {x * f, y * f, z * f}; return r; }
+    Vec3& operator+=(Vec3 const& o)     { x += o.x; y += o.y; z += o.z; return *this; }
+    Vec3 crossProduct(Vec3 const& o) const { Vec3 r = {y * o.z - z * o.y, z * o.x - x * o.z, x * o.y - y * o.x}; return r; }
+    float squaredLength() const         { return x * x + y * y + z * z; }
+};
+
+struct node_t // Real node_t: ~150 bytes
+{
+    Vec3  RelPosition;
+    Vec3  AbsPosition;
+    Vec3  Velocity;
+    Vec3  Forces;
+    float mass;
+    char  padding[100];
+};
+
+struct Locator_t
+{
+    int  ref;
+    int  nx;
+    int  ny;
+    int  nz;
+    Vec3 coords;
+};
+
+const int NUM_NODES    = 1000;
+const int NUM_VERTICES = 100000;
+
+std::vector<node_t>    nodes;
+std::vector<Locator_t> locators;
+std::vector<Vec3>      src_normals;
+Vec3                   flexit_center = {1.f, 2.f, 3.f};
+
+// Outputs (staging buffers, same layout as the VET_FLOAT3 hardware buffers)
+std::vector<Vec3>      dst_pos;
+std::vector<Vec3>      dst_normals;
+
+// Structure-of-arrays copy of locators + source normals
+std::vector<int>       loc_ref, loc_nx, loc_ny;
+std::vector<float>     coord_x, coord_y, coord_z, normal_x, normal_y, normal_z;
+
+float fast_invSqrt(const float v) // Copy of ApproxMath.h
+{
+    union { float f; int i; } u;
+    u.f = v;
+    u.i = 0x5f3759df - (u.i >> 1);
+    u.f *= (1.5f - (0.5f * v * u.f * u.f));
+    return u.f;
+}
+
+Vec3 fast_normalise(Vec3 v)
+{
+    return v * fast_invSqrt(v.squaredLength());
+}
+
+unsigned int rng_state = 12345;
+float Random01()
+{
+    rng_state = rng_state * 1103515245u + 12345u;
+    return static_cast<float>((rng_state >> 8) & 0xFFFF) / 65535.f;
+}
+
+void PrepareFlexbody()
+{
+    // Nodes of a truck-sized box, slightly deformed
+    nodes.resize(NUM_NODES);
+    memset(nodes.data(), 0, nodes.size() * sizeof(node_t));
+    for (int i = 0; i < NUM_NODES; ++i)
+    {
+        nodes[i].AbsPosition.x = (i % 10) * 0.8f + 0.05f * Random01();
+        nodes[i].AbsPosition.y = ((i / 10) % 10) * 0.3f + 0.05f * Random01();
+        nodes[i].AbsPosition.z = (i / 100) * 0.25f + 0.05f * Random01();
+    }
+    // Locators referencing nearby nodes, like FlexBody's constructor produces
+    locators.resize(NUM_VERTICES);
+    src_normals.resize(NUM_VERTICES);
+    for (int i = 0; i < NUM_VERTICES; ++i)
+    {
+        int ref = (i * 7) % NUM_NODES;
+        locators[i].ref = ref;
+        locators[i].nx  = (ref % 10 < 9) ? ref + 1 : ref - 1;
+        locators[i].ny  = ((ref / 10) % 10 < 9) ? ref + 10 : ref - 10;
+        locators[i].nz  = 0;
+        locators[i].coords.x = Random01() - 0.5f;
+        locators[i].coords.y = Random01() - 0.5f;
+        locators[i].coords.z = 0.1f * (Random01() - 0.5f);
+        Vec3 n = {Random01() - 0.5f, Random01() - 0.5f, Random01() - 0.5f};
+        src_normals[i] = n;
+    }
+    dst_pos.resize(NUM_VERTICES);
+    dst_normals.resize(NUM_VERTICES);
+}
+
+void PrepareSoA()
+{
+    loc_ref.resize(NUM_VERTICES); loc_nx.resize(NUM_VERTICES); loc_ny.resize(NUM_VERTICES);
+    coord_x.resize(NUM_VERTICES); coord_y.resize(NUM_VERTICES); coord_z.resize(NUM_VERTICES);
+    normal_x.resize(NUM_VERTICES); normal_y.resize(NUM_VERTICES); normal_z.resize(NUM_VERTICES);
+    for (int i = 0; i < NUM_VERTICES; ++i)
+    {
+        loc_ref[i] = locators[i].ref; loc_nx[i] = locators[i].nx; loc_ny[i] = locators[i].ny;
+        coord_x[i] = locators[i].coords.x; coord_y[i] = locators[i].coords.y; coord_z[i] = locators[i].coords.z;
+        normal_x[i] = src_normals[i].x; normal_y[i] = src_normals[i].y; normal_z[i] = src_normals[i].z;
+    }
+}
+
+// ################################# Solution 1 - AoS (original flexitCompute()) #################################
+
+void ComputeScalar(int begin, int end)
+{
+    for (int i = begin; i < end; i++)
+    {
+        Vec3 diffX = nodes[locators[i].nx].AbsPosition - nodes[locators[i].ref].AbsPosition;
+        Vec3 diffY = nodes[locators[i].ny].AbsPosition - nodes[locators[i].ref].AbsPosition;
+        Vec3 nCross = fast_normalise(diffX.crossProduct(diffY));
+
+        dst_pos[i].x = diffX.x * locators[i].coords.x + diffY.x * locators[i].coords.y + nCross.x * locators[i].coords.z;
+        dst_pos[i].y = diffX.y * locators[i].coords.x + diffY.y * locators[i].coords.y + nCross.y * locators[i].coords.z;
+        dst_pos[i].z = diffX.z * locators[i].coords.x + diffY.z * locators[i].coords.y + nCross.z * locators[i].coords.z;
+
+        dst_pos[i] += nodes[locators[i].ref].AbsPosition - flexit_center;
+
+        dst_normals[i].x = diffX.x * src_normals[i].x + diffY.x * src_normals[i].y + nCross.x * src_normals[i].z;
+        dst_normals[i].y = diffX.y * src_normals[i].x + diffY.y * src_normals[i].y + nCross.y * src_normals[i].z;
+        dst_normals[i].z = diffX.z * src_normals[i].x + diffY.z * src_normals[i].y + nCross.z * src_normals[i].z;
+
+        dst_normals[i] = fast_normalise(dst_normals[i]);
+    }
+}
+
+static void Bench_sol1__AoS(benchmark::State& state)
+{
+    while (state.KeepRunning())
+    {
+        ComputeScalar(0, NUM_VERTICES);
+        benchmark::DoNotOptimize(dst_pos.data());
+        benchmark::DoNotOptimize(dst_normals.data());
+    }
+}
+BENCHMARK(Bench_sol1__AoS)->Unit(benchmark::kMicrosecond);
+
+// ################################# Solution 2 - SoA + SSE2 (FlexBody.cpp) #################################
+
+inline __m128 FastInvSqrt4(__m128 v)
+{
+    const __m128 y = _mm_castsi128_ps(_mm_sub_epi32(_mm_set1_epi32(0x5f3759df), _mm_srai_epi32(_mm_castps_si128(v), 1)));
+    return _mm_mul_ps(y, _mm_sub_ps(_mm_set1_ps(1.5f), _mm_mul_ps(_mm_mul_ps(_mm_mul_ps(_mm_set1_ps(0.5f), v), y), y)));
+}
+
+inline void StoreVector3x4(Vec3* dst, __m128 x, __m128 y, __m128 z)
+{
+    const __m128 xy_lo = _mm_unpacklo_ps(x, y);
+    const __m128 xy_hi = _mm_unpackhi_ps(x, y);
+    const __m128 z0x1  = _mm_shuffle_ps(z, xy_lo, _MM_SHUFFLE(2, 2, 0, 0));
+    const __m128 y1z1  = _mm_shuffle_ps(xy_lo, z, _MM_SHUFFLE(1, 1, 3, 3));
+    const __m128 z2z3  = _mm_shuffle_ps(z, xy_hi, _MM_SHUFFLE(3, 2, 3, 2));
+    float* out = &dst[0].x;
+    _mm_storeu_ps(out,     _mm_shuffle_ps(xy_lo, z0x1, _MM_SHUFFLE(2, 0, 1, 0)));
+    _mm_storeu_ps(out + 4, _mm_shuffle_ps(y1z1, xy_hi, _MM_SHUFFLE(1, 0, 2, 0)));
+    _mm_storeu_ps(out + 8, _mm_shuffle_ps(z2z3, z2z3, _MM_SHUFFLE(1, 3, 2, 0)));
+}
+
+inline void GatherAbsPosition4(const int* indices, __m128& x, __m128& y, __m128& z)
+{
+    __m128 r0 = _mm_loadu_ps(&nodes[indices[0]].AbsPosition.x);
+    __m128 r1 = _mm_loadu_ps(&nodes[indices[1]].AbsPosition.x);
+    __m128 r2 = _mm_loadu_ps(&nodes[indices[2]].AbsPosition.x);
+    __m128 r3 = _mm_loadu_ps(&nodes[indices[3]].AbsPosition.x);
+    _MM_TRANSPOSE4_PS(r0, r1, r2, r3);
+    x = r0; y = r1; z = r2;
+}
+
+void ComputeSSE()
+{
+    const __m128 center_x = _mm_set1_ps(flexit_center.x);
+    const __m128 center_y = _mm_set1_ps(flexit_center.y);
+    const __m128 center_z = _mm_set1_ps(flexit_center.z);
+    const int simd_end = NUM_VERTICES & ~3;
+    int i = 0;
+    for (; i < simd_end; i += 4)
+    {
+        __m128 ref_x, ref_y, ref_z, nx_x, nx_y, nx_z, ny_x, ny_y, ny_z;
+        GatherAbsPosition4(&loc_ref[i], ref_x, ref_y, ref_z);
+        GatherAbsPosition4(&loc_nx[i],  nx_x,  nx_y,  nx_z);
+        GatherAbsPosition4(&loc_ny[i],  ny_x,  ny_y,  ny_z);
+
+        const __m128 dX_x = _mm_sub_ps(nx_x, ref_x), dX_y = _mm_sub_ps(nx_y, ref_y), dX_z = _mm_sub_ps(nx_z, ref_z);
+        const __m128 dY_x = _mm_sub_ps(ny_x, ref_x), dY_y = _mm_sub_ps(ny_y, ref_y), dY_z = _mm_sub_ps(ny_z, ref_z);
+
+        __m128 c_x = _mm_sub_ps(_mm_mul_ps(dX_y, dY_z), _mm_mul_ps(dX_z, dY_y));
+        __m128 c_y = _mm_sub_ps(_mm_mul_ps(dX_z, dY_x), _mm_mul_ps(dX_x, dY_z));
+        __m128 c_z = _mm_sub_ps(_mm_mul_ps(dX_x, dY_y), _mm_mul_ps(dX_y, dY_x));
+        const __m128 c_inv = FastInvSqrt4(_mm_add_ps(_mm_add_ps(_mm_mul_ps(c_x, c_x), _mm_mul_ps(c_y, c_y)), _mm_mul_ps(c_z, c_z)));
+        c_x = _mm_mul_ps(c_x, c_inv); c_y = _mm_mul_ps(c_y, c_inv); c_z = _mm_mul_ps(c_z, c_inv);
+
+        const __m128 k_x = _mm_loadu_ps(&coord_x[i]), k_y = _mm_loadu_ps(&coord_y[i]), k_z = _mm_loadu_ps(&coord_z[i]);
+        const __m128 p_x = _mm_add_ps(_mm_add_ps(_mm_add_ps(_mm_mul_ps(dX_x, k_x), _mm_mul_ps(dY_x, k_y)), _mm_mul_ps(c_x, k_z)), _mm_sub_ps(ref_x, center_x));
+        const __m128 p_y = _mm_add_ps(_mm_add_ps(_mm_add_ps(_mm_mul_ps(dX_y, k_x), _mm_mul_ps(dY_y, k_y)), _mm_mul_ps(c_y, k_z)), _mm_sub_ps(ref_y, center_y));
+        const __m128 p_z = _mm_add_ps(_mm_add_ps(_mm_add_ps(_mm_mul_ps(dX_z, k_x), _mm_mul_ps(dY_z, k_y)), _mm_mul_ps(c_z, k_z)), _mm_sub_ps(ref_z, center_z));
+
+        const __m128 s_x = _mm_loadu_ps(&normal_x[i]), s_y = _mm_loadu_ps(&normal_y[i]), s_z = _mm_loadu_ps(&normal_z[i]);
+        __m128 n_x = _mm_add_ps(_mm_add_ps(_mm_mul_ps(dX_x, s_x), _mm_mul_ps(dY_x, s_y)), _mm_mul_ps(c_x, s_z));
+        __m128 n_y = _mm_add_ps(_mm_add_ps(_mm_mul_ps(dX_y, s_x), _mm_mul_ps(dY_y, s_y)), _mm_mul_ps(c_y, s_z));
+        __m128 n_z = _mm_add_ps(_mm_add_ps(_mm_mul_ps(dX_z, s_x), _mm_mul_ps(dY_z, s_y)), _mm_mul_ps(c_z, s_z));
+        const __m128 n_inv = FastInvSqrt4(_mm_add_ps(_mm_add_ps(_mm_mul_ps(n_x, n_x), _mm_mul_ps(n_y, n_y)), _mm_mul_ps(n_z, n_z)));
+        n_x = _mm_mul_ps(n_x, n_inv); n_y = _mm_mul_ps(n_y, n_inv); n_z = _mm_mul_ps(n_z, n_inv);
+
+        StoreVector3x4(&dst_pos[i],     p_x, p_y, p_z);
+        StoreVector3x4(&dst_normals[i], n_x, n_y, n_z);
+    }
+    ComputeScalar(i, NUM_VERTICES);
+}
+
+static void Bench_sol2__SoASSE(benchmark::State& state)
+{
+    while (state.KeepRunning())
+    {
+        ComputeSSE();
+        benchmark::DoNotOptimize(dst_pos.data());
+        benchmark::DoNotOptimize(dst_normals.data());
+    }
+}
+BENCHMARK(Bench_sol2__SoASSE)->Unit(benchmark::kMicrosecond);
+
+// ################################# Solution 2b - SoA + AVX2 hardware gathers (FlexBody.cpp) #################################
+
+#ifdef __AVX2__
+
+inline __m256 FastInvSqrt8(__m256 v)
+{
+    const __m256 y = _mm256_castsi256_ps(_mm256_sub_epi32(_mm256_set1_epi32(0x5f3759df), _mm256_srai_epi32(_mm256_castps_si256(v), 1)));
+    return _mm256_mul_ps(y, _mm256_sub_ps(_mm256_set1_ps(1.5f), _mm256_mul_ps(_mm256_mul_ps(_mm256_mul_ps(_mm256_set1_ps(0.5f), v), y), y)));
+}
+
+inline void GatherAbsPosition8(const int* indices, __m256& x, __m256& y, __m256& z)
+{
+    const float* base = &nodes[0].AbsPosition.x;
+    const __m256i offsets = _mm256_mullo_epi32(
+        _mm256_loadu_si256(reinterpret_cast<const __m256i*>(indices)), _mm256_set1_epi32(sizeof(node_t) / sizeof(float)));
+    x = _mm256_i32gather_ps(base,     offsets, 4);
+    y = _mm256_i32gather_ps(base + 1, offsets, 4);
+    z = _mm256_i32gather_ps(base + 2, offsets, 4);
+}
+
+void ComputeAVX2()
+{
+    const __m256 center_x = _mm256_set1_ps(flexit_center.x);
+    const __m256 center_y = _mm256_set1_ps(flexit_center.y);
+    const __m256 center_z = _mm256_set1_ps(flexit_center.z);
+    const int simd_end = NUM_VERTICES & ~7;
+    int i = 0;
+    for (; i < simd_end; i += 8)
+    {
+        __m256 ref_x, ref_y, ref_z, nx_x, nx_y, nx_z, ny_x, ny_y, ny_z;
+        GatherAbsPosition8(&loc_ref[i], ref_x, ref_y, ref_z);
+        GatherAbsPosition8(&loc_nx[i],  nx_x,  nx_y,  nx_z);
+        GatherAbsPosition8(&loc_ny[i],  ny_x,  ny_y,  ny_z);
+
+        const __m256 dX_x = _mm256_sub_ps(nx_x, ref_x), dX_y = _mm256_sub_ps(nx_y, ref_y), dX_z = _mm256_sub_ps(nx_z, ref_z);
+        const __m256 dY_x = _mm256_sub_ps(ny_x, ref_x), dY_y = _mm256_sub_ps(ny_y, ref_y), dY_z = _mm256_sub_ps(ny_z, ref_z);
+
+        __m256 c_x = _mm256_sub_ps(_mm256_mul_ps(dX_y, dY_z), _mm256_mul_ps(dX_z, dY_y));
+        __m256 c_y = _mm256_sub_ps(_mm256_mul_ps(dX_z, dY_x), _mm256_mul_ps(dX_x, dY_z));
+        __m256 c_z = _mm256_sub_ps(_mm256_mul_ps(dX_x, dY_y), _mm256_mul_ps(dX_y, dY_x));
+        const __m256 c_inv = FastInvSqrt8(_mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(c_x, c_x), _mm256_mul_ps(c_y, c_y)), _mm256_mul_ps(c_z, c_z)));
+        c_x = _mm256_mul_ps(c_x, c_inv); c_y = _mm256_mul_ps(c_y, c_inv); c_z = _mm256_mul_ps(c_z, c_inv);
+
+        const __m256 k_x = _mm256_loadu_ps(&coord_x[i]), k_y = _mm256_loadu_ps(&coord_y[i]), k_z = _mm256_loadu_ps(&coord_z[i]);
+        const __m256 p_x = _mm256_add_ps(_mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(dX_x, k_x), _mm256_mul_ps(dY_x, k_y)), _mm256_mul_ps(c_x, k_z)), _mm256_sub_ps(ref_x, center_x));
+        const __m256 p_y = _mm256_add_ps(_mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(dX_y, k_x), _mm256_mul_ps(dY_y, k_y)), _mm256_mul_ps(c_y, k_z)), _mm256_sub_ps(ref_y, center_y));
+        const __m256 p_z = _mm256_add_ps(_mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(dX_z, k_x), _mm256_mul_ps(dY_z, k_y)), _mm256_mul_ps(c_z, k_z)), _mm256_sub_ps(ref_z, center_z));
+
+        const __m256 s_x = _mm256_loadu_ps(&normal_x[i]), s_y = _mm256_loadu_ps(&normal_y[i]), s_z = _mm256_loadu_ps(&normal_z[i]);
+        __m256 n_x = _mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(dX_x, s_x), _mm256_mul_ps(dY_x, s_y)), _mm256_mul_ps(c_x, s_z));
+        __m256 n_y = _mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(dX_y, s_x), _mm256_mul_ps(dY_y, s_y)), _mm256_mul_ps(c_y, s_z));
+        __m256 n_z = _mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(dX_z, s_x), _mm256_mul_ps(dY_z, s_y)), _mm256_mul_ps(c_z, s_z));
+        const __m256 n_inv = FastInvSqrt8(_mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(n_x, n_x), _mm256_mul_ps(n_y, n_y)), _mm256_mul_ps(n_z, n_z)));
+        n_x = _mm256_mul_ps(n_x, n_inv); n_y = _mm256_mul_ps(n_y, n_inv); n_z = _mm256_mul_ps(n_z, n_inv);
+
+        StoreVector3x4(&dst_pos[i],         _mm256_castps256_ps128(p_x), _mm256_castps256_ps128(p_y), _mm256_castps256_ps128(p_z));
+        StoreVector3x4(&dst_pos[i + 4],     _mm256_extractf128_ps(p_x, 1), _mm256_extractf128_ps(p_y, 1), _mm256_extractf128_ps(p_z, 1));
+        StoreVector3x4(&dst_normals[i],     _mm256_castps256_ps128(n_x), _mm256_castps256_ps128(n_y), _mm256_castps256_ps128(n_z));
+        StoreVector3x4(&dst_normals[i + 4], _mm256_extractf128_ps(n_x, 1), _mm256_extractf128_ps(n_y, 1), _mm256_extractf128_ps(n_z, 1));
+    }
+    ComputeScalar(i, NUM_VERTICES);
+}
+
+static void Bench_sol2b_SoAAVX2(benchmark::State& state)
+{
+    while (state.KeepRunning())
+    {
+        ComputeAVX2();
+        benchmark::DoNotOptimize(dst_pos.data());
+        benchmark::DoNotOptimize(dst_normals.data());
+    }
+}
+BENCHMARK(Bench_sol2b_SoAAVX2)->Unit(benchmark::kMicrosecond);
+
+#endif // __AVX2__
+
+// ################################# Validation #################################
+
+float MaxDifference(std::vector<Vec3> const& a, std::vector<Vec3> const& b)
+{
+    float max_diff = 0.f;
+    for (size_t i = 0; i < a.size(); ++i)
+    {
+        max_diff = std::max(max_diff, std::abs(a[i].x - b[i].x));
+        max_diff = std::max(max_diff, std::abs(a[i].y - b[i].y));
+        max_diff = std::max(max_diff, std::abs(a[i].z - b[i].z));
+    }
+    return max_diff;
+}
+
+void Validate(const char* name, void (*compute)())
+{
+    ComputeScalar(0, NUM_VERTICES);
+    std::vector<Vec3> ref_pos = dst_pos, ref_normals = dst_normals;
+    compute();
+    std::cout << name << " vs. AoS: max difference of positions " << MaxDifference(ref_pos, dst_pos)
+              << ", normals " << MaxDifference(ref_normals, dst_normals) << std::endl;
+}
+
+int main(int argc, char** argv)
+{
+    using namespace std;
+
+    // prepare
+    cout << "Preparing..." << endl;
+    PrepareFlexbody();
+    PrepareSoA();
+    cout << "Nodes: " << nodes.size() << ", vertices: " << NUM_VERTICES << endl;
+    Validate("SSE2", ComputeSSE);
+#ifdef __AVX2__
+    Validate("AVX2", ComputeAVX2);
+#endif
+
+    // benchmark
+    ::benchmark::Initialize(&argc, argv);
+    ::benchmark::RunSpecifiedBenchmarks();
+#ifdef _MSC_VER
+    system("pause");
+#endif
+    return 0;
+}
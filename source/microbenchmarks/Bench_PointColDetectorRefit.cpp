@@ -0,0 +1,322 @@
+// PointColDetector: lazy k-d tree rebuilt every substep (original) vs. full build + refit of subtree bounds
+// Self-contained; the detector is reduced to the k-d tree over contacter positions and the box query.
+
+#include "benchmark/benchmark.h"
+#include <algorithm>
+#include <cmath>
+#include <iostream>
+#include <vector>
+
+// ################################# Data #####################################
+
+struct Vec3 { float x, y, z; };
+
+struct Truck
+{
+    std::vector<Vec3> contacters;
+    std::vector<int>  collcabs;  // Triplets of contacter indices, queried like collision cabs
+    float             phase;
+};
+
+const int   TRUCK_CONTACTERS     = 1000;
+const int   SCENE_TRUCKS         = 50;
+const int   SCENE_CONTACTERS     = 200;
+const float REFIT_MAX_DEGRADATION = 1.5f;
+
+std::vector<Truck> big_truck;   // 1 truck with 1000 contacters
+std::vector<Truck> scene;       // 50 trucks, each with its own (intra) detector
+
+void PrepareTruck(Truck& truck, int num_contacters, float offset)
+{
+    truck.contacters.resize(num_contacters);
+    for (int i = 0; i < num_contacters; ++i)
+    {
+        // Box-ish shell with some noise, 2.5 x 3 x 10 meters
+        truck.contacters[i].x = offset + 2.5f * ((i * 7919) % 101) / 100.f;
+        truck.contacters[i].y = 3.0f * ((i * 104729) % 97) / 96.f;
+        truck.contacters[i].z = 10.f * i / num_contacters;
+    }
+    for (int i = 0; i + 2 < num_contacters; i += 3)
+    {
+        truck.collcabs.push_back(i); truck.collcabs.push_back(i + 1); truck.collcabs.push_back(i + 2);
+    }
+    truck.phase = offset;
+}
+
+/// One physics substep: rigid translation plus a small deformation wobble
+void MoveTruck(Truck& truck)
+{
+    truck.phase += 0.01f;
+    const float wobble = 0.002f * std::sin(truck.phase);
+    for (size_t i = 0; i < truck.contacters.size(); ++i)
+    {
+        truck.contacters[i].x += 0.01f + wobble * (i & 1);
+        truck.contacters[i].z += 0.02f - wobble * (i & 2);
+    }
+}
+
+// ################################# Detector #####################################
+
+struct Detector
+{
+    struct kdnode_t { float min; int end; float max; Vec3* ref; float middle; int begin; };
+    struct kdbounds_t { float min[3]; float max[3]; };
+
+    std::vector<Vec3*>      ref_list;
+    std::vector<kdnode_t>   kdtree;
+    std::vector<kdbounds_t> bounds;
+    std::vector<int>        order;
+    std::vector<Vec3*>      hit_list;
+    int                     hit_count;
+    float                   bbmin[3], bbmax[3];
+    bool                    tree_valid;
+    float                   build_cost;
+
+    void Init(Truck& truck)
+    {
+        const int n = (int)truck.contacters.size();
+        ref_list.resize(n);
+        for (int i = 0; i < n; ++i) { ref_list[i] = &truck.contacters[i]; }
+        hit_list.resize(n);
+        kdnode_t kdelem = {0.0f, 0, 0.0f, nullptr, 0.0f, 0};
+        kdtree.resize((size_t)std::pow(2.f, (int)std::ceil(std::log2(n)) + 1), kdelem);
+        bounds.resize(kdtree.size());
+        tree_valid = false;
+    }
+
+    static float Coord(const Vec3* p, int axis) { return (&p->x)[axis]; }
+
+    void PartInTwo(int start, int median, int end, int axis, float& minex, float& maxex)
+    {
+        std::nth_element(ref_list.begin() + start, ref_list.begin() + median, ref_list.begin() + end,
+            [axis](Vec3* a, Vec3* b) { return Coord(a, axis) < Coord(b, axis); });
+        minex = maxex = Coord(ref_list[median], axis);
+        for (int i = start; i < end; ++i)
+        {
+            minex = std::min(minex, Coord(ref_list[i], axis));
+            maxex = std::max(maxex, Coord(ref_list[i], axis));
+        }
+    }
+
+    // ----- Original: lazy tree, reset every substep -----
+
+    void UpdateLazy()
+    {
+        kdtree[0].ref = nullptr;
+        kdtree[0].begin = 0;
+        kdtree[0].end = -(int)ref_list.size();
+    }
+
+    void BuildIncr(int axis, int index)
+    {
+        int end = -kdtree[index].end;
+        kdtree[index].end = end;
+        int begin = kdtree[index].begin;
+        if (end - begin == 1)
+        {
+            kdtree[index].ref = ref_list[begin];
+            kdtree[index].middle = kdtree[index].min = kdtree[index].max = Coord(ref_list[begin], axis);
+            return;
+        }
+        int median = begin + (end - begin) / 2;
+        PartInTwo(begin, median, end, axis, kdtree[index].min, kdtree[index].max);
+        kdtree[index].middle = Coord(ref_list[median], axis);
+        kdtree[index].ref = nullptr;
+        kdtree[2 * index + 1].begin = begin;
+        kdtree[2 * index + 1].end = -median;
+        kdtree[2 * index + 2].begin = median;
+        kdtree[2 * index + 2].end = -end;
+    }
+
+    void QueryRecLazy(int kdindex, int axis)
+    {
+        for (;;)
+        {
+            if (kdtree[kdindex].end < 0) { BuildIncr(axis, kdindex); }
+            if (kdtree[kdindex].ref != nullptr)
+            {
+                const float* p = &kdtree[kdindex].ref->x;
+                if (p[0] >= bbmin[0] && p[0] <= bbmax[0] && p[1] >= bbmin[1] && p[1] <= bbmax[1] && p[2] >= bbmin[2] && p[2] <= bbmax[2])
+                {
+                    hit_list[hit_count++] = kdtree[kdindex].ref;
+                }
+                return;
+            }
+            int newaxis = (axis + 1) % 3;
+            if (bbmax[axis] >= kdtree[kdindex].middle)
+            {
+                if (bbmin[axis] > kdtree[kdindex].max) { return; }
+                if (bbmin[axis] <= kdtree[kdindex].middle) { QueryRecLazy(2 * kdindex + 1, newaxis); }
+                kdindex = 2 * kdindex + 2;
+            }
+            else
+            {
+                if (bbmax[axis] < kdtree[kdindex].min) { return; }
+                kdindex = 2 * kdindex + 1;
+            }
+            axis = newaxis;
+        }
+    }
+
+    // ----- Refit: full build once, afterwards only bounds are updated -----
+
+    void BuildFull(int index, int begin, int end, int axis)
+    {
+        order.push_back(index);
+        if (end - begin == 1)
+        {
+            kdtree[index].ref = ref_list[begin];
+            return;
+        }
+        int median = begin + (end - begin) / 2;
+        PartInTwo(begin, median, end, axis, kdtree[index].min, kdtree[index].max);
+        kdtree[index].ref = nullptr;
+        BuildFull(2 * index + 1, begin, median, (axis + 1) % 3);
+        BuildFull(2 * index + 2, median, end, (axis + 1) % 3);
+    }
+
+    float Refit()
+    {
+        float cost = 0.f;
+        for (int i = (int)order.size() - 1; i >= 0; --i)
+        {
+            const int index = order[i];
+            kdbounds_t& b = bounds[index];
+            if (kdtree[index].ref != nullptr)
+            {
+                const float* p = &kdtree[index].ref->x;
+                for (int k = 0; k < 3; ++k) { b.min[k] = b.max[k] = p[k]; }
+            }
+            else
+            {
+                const kdbounds_t& l = bounds[2 * index + 1];
+                const kdbounds_t& r = bounds[2 * index + 2];
+                for (int k = 0; k < 3; ++k)
+                {
+                    b.min[k] = std::min(l.min[k], r.min[k]);
+                    b.max[k] = std::max(l.max[k], r.max[k]);
+                    cost += b.max[k] - b.min[k];
+                }
+            }
+        }
+        return cost;
+    }
+
+    void UpdateRefit()
+    {
+        if (tree_valid && Refit() <= build_cost * REFIT_MAX_DEGRADATION) { return; }
+        order.clear();
+        BuildFull(0, 0, (int)ref_list.size(), 0);
+        build_cost = Refit();
+        tree_valid = true;
+    }
+
+    void QueryBounds()
+    {
+        int stack[64];
+        int stack_size = 0;
+        stack[stack_size++] = 0;
+        while (stack_size > 0)
+        {
+            const int kdindex = stack[--stack_size];
+            const kdbounds_t& b = bounds[kdindex];
+            if (b.max[0] < bbmin[0] || b.min[0] > bbmax[0] || b.max[1] < bbmin[1] || b.min[1] > bbmax[1] || b.max[2] < bbmin[2] || b.min[2] > bbmax[2])
+            {
+                continue;
+            }
+            if (kdtree[kdindex].ref != nullptr)
+            {
+                hit_list[hit_count++] = kdtree[kdindex].ref;
+            }
+            else
+            {
+                stack[stack_size++] = 2 * kdindex + 2;
+                stack[stack_size++] = 2 * kdindex + 1;
+            }
+        }
+    }
+
+    template <bool REFIT> int QueryCabs(const Truck& truck)
+    {
+        int total = 0;
+        for (size_t c = 0; c + 2 < truck.collcabs.size(); c += 3)
+        {
+            const Vec3& a = truck.contacters[truck.collcabs[c]];
+            const Vec3& b = truck.contacters[truck.collcabs[c + 1]];
+            const Vec3& d = truck.contacters[truck.collcabs[c + 2]];
+            const float enlarge = 0.05f;
+            bbmin[0] = std::min(a.x, std::min(b.x, d.x)) - enlarge; bbmax[0] = std::max(a.x, std::max(b.x, d.x)) + enlarge;
+            bbmin[1] = std::min(a.y, std::min(b.y, d.y)) - enlarge; bbmax[1] = std::max(a.y, std::max(b.y, d.y)) + enlarge;
+            bbmin[2] = std::min(a.z, std::min(b.z, d.z)) - enlarge; bbmax[2] = std::max(a.z, std::max(b.z, d.z)) + enlarge;
+            hit_count = 0;
+            if (REFIT) { QueryBounds(); } else { QueryRecLazy(0, 0); }
+            total += hit_count;
+        }
+        return total;
+    }
+};
+
+std::vector<Detector> big_truck_cd;
+std::vector<Detector> scene_cd;
+
+template <bool REFIT> void Substep(std::vector<Truck>& trucks, std::vector<Detector>& detectors)
+{
+    for (size_t t = 0; t < trucks.size(); ++t)
+    {
+        MoveTruck(trucks[t]);
+        if (REFIT) { detectors[t].UpdateRefit(); } else { detectors[t].UpdateLazy(); }
+        benchmark::DoNotOptimize(detectors[t].QueryCabs<REFIT>(trucks[t]));
+    }
+}
+
+// ################################# Benchmarks #####################################
+
+static void Bench_1000contacters_orig_LazyRebuild(benchmark::State& state)
+{
+    while (state.KeepRunning()) { Substep<false>(big_truck, big_truck_cd); }
+}
+BENCHMARK(Bench_1000contacters_orig_LazyRebuild);
+
+static void Bench_1000contacters_sol1_Refit(benchmark::State& state)
+{
+    while (state.KeepRunning()) { Substep<true>(big_truck, big_truck_cd); }
+}
+BENCHMARK(Bench_1000contacters_sol1_Refit);
+
+static void Bench_50trucks_orig_LazyRebuild(benchmark::State& state)
+{
+    while (state.KeepRunning()) { Substep<false>(scene, scene_cd); }
+}
+BENCHMARK(Bench_50trucks_orig_LazyRebuild);
+
+static void Bench_50trucks_sol1_Refit(benchmark::State& state)
+{
+    while (state.KeepRunning()) { Substep<true>(scene, scene_cd); }
+}
+BENCHMARK(Bench_50trucks_sol1_Refit);
+
+int main(int argc, char** argv)
+{
+    using namespace std;
+
+    // prepare
+    cout << "Preparing..." << endl;
+    big_truck.resize(1);
+    PrepareTruck(big_truck[0], TRUCK_CONTACTERS, 0.f);
+    scene.resize(SCENE_TRUCKS);
+    for (int t = 0; t < SCENE_TRUCKS; ++t) { PrepareTruck(scene[t], SCENE_CONTACTERS, t * 5.f); }
+
+    big_truck_cd.resize(big_truck.size());
+    for (size_t t = 0; t < big_truck.size(); ++t) { big_truck_cd[t].Init(big_truck[t]); }
+    scene_cd.resize(scene.size());
+    for (size_t t = 0; t < scene.size(); ++t) { scene_cd[t].Init(scene[t]); }
+    cout << "Big truck: " << TRUCK_CONTACTERS << " contacters, scene: " << SCENE_TRUCKS << " trucks x " << SCENE_CONTACTERS << " contacters" << endl;
+
+    // benchmark
+    ::benchmark::Initialize(&argc, argv);
+    ::benchmark::RunSpecifiedBenchmarks();
+#ifdef _MSC_VER
+    system("pause");
+#endif
+    return 0;
+}
@@ -2,6 +2,10 @@
 #include "benchmark/benchmark.h"
 #include <regex>
 #include <iostream>
+#include <climits>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
 
     enum Keyword
     {
@@ -1841,6 +1845,277 @@ static void Bench_sol2b_SwitchPreCond(benchmark::State& state)
 }
 BENCHMARK(Bench_sol2b_SwitchPreCond);
 
+// ################################# Solution 3 - perfect hash ######################################
+// Mirrors RigDef::Lexer (source/main/resources/rig_def_fileformat/RigDef_Lexer.cpp)
+
+enum KeywordForm { FORM_BLOCK, FORM_INLINE, FORM_INLINE_TOLERANT };
+
+struct KeywordDef
+{
+    const char*  name;
+    Keyword      keyword;
+    KeywordForm  form;
+};
+
+// Reuse the regex definition, so both solutions see the same keywords in the same order
+#undef E_KEYWORD_BLOCK
+#undef E_KEYWORD_INLINE
+#undef E_KEYWORD_INLINE_TOLERANT
+#define E_KEYWORD_BLOCK(_NAME_)            { _NAME_, (Keyword) (__COUNTER__ - KEYWORD_COUNTER_BASE), FORM_BLOCK },
+#define E_KEYWORD_INLINE(_NAME_)           { _NAME_, (Keyword) (__COUNTER__ - KEYWORD_COUNTER_BASE), FORM_INLINE },
+#define E_KEYWORD_INLINE_TOLERANT(_NAME_)  { _NAME_, (Keyword) (__COUNTER__ - KEYWORD_COUNTER_BASE), FORM_INLINE_TOLERANT },
+
+enum { KEYWORD_COUNTER_BASE = __COUNTER__ };
+const KeywordDef KEYWORDS[] = { IDENTIFY_KEYWORD_REGEX_STRING };
+
+const int NUM_KEYWORDS = sizeof(KEYWORDS) / sizeof(KeywordDef);
+const int KEYWORD_MAX_LENGTH = 28;
+const int HASH_TABLE_SIZE = 4096;
+
+inline bool IsBlank(char c)       { return (c == ' ') || (c == '\t'); }
+inline bool IsDigit(char c)       { return (c >= '0') && (c <= '9'); }
+inline char ToLowerAscii(char c)  { return ((c >= 'A') && (c <= 'Z')) ? (c + ('a' - 'A')) : c; }
+
+inline uint32_t HashWord(const char* word, int len, uint32_t seed)
+{
+    uint32_t hash = 2166136261u ^ seed;
+    for (int i = 0; i < len; ++i)
+    {
+        hash ^= static_cast<uint8_t>(ToLowerAscii(word[i]));
+        hash *= 16777619u;
+    }
+    return (hash ^ (hash >> 15)) & (HASH_TABLE_SIZE - 1);
+}
+
+struct KeywordHashTable
+{
+    KeywordHashTable(): seed(0)
+    {
+        for (;; ++seed)
+        {
+            memset(slots, 0, sizeof(slots));
+            bool collision = false;
+            for (int i = 0; (i < NUM_KEYWORDS) && !collision; ++i)
+            {
+                uint8_t& slot = slots[HashWord(KEYWORDS[i].name, (int) strlen(KEYWORDS[i].name), seed)];
+                collision = (slot != 0);
+                slot = (uint8_t) (i + 1);
+            }
+            if (!collision)
+                return;
+        }
+    }
+
+    uint32_t seed;
+    uint8_t  slots[HASH_TABLE_SIZE];
+};
+
+KeywordHashTable keyword_table;
+
+Keyword IdentifyKeywordHash(const char* line)
+{
+    int len = 0;
+    while ((line[len] != '\0') && !IsBlank(line[len]) && (line[len] != ','))
+    {
+        if (++len > KEYWORD_MAX_LENGTH)
+            return KEYWORD_INVALID;
+    }
+    if (len == 0)
+        return KEYWORD_INVALID;
+
+    const uint8_t slot = keyword_table.slots[HashWord(line, len, keyword_table.seed)];
+    if (slot == 0)
+        return KEYWORD_INVALID;
+    KeywordDef const& def = KEYWORDS[slot - 1];
+    for (int i = 0; i < len; ++i)
+    {
+        if ((def.name[i] == '\0') || (ToLowerAscii(line[i]) != ToLowerAscii(def.name[i])))
+            return KEYWORD_INVALID;
+    }
+    if (def.name[len] != '\0')
+        return KEYWORD_INVALID;
+
+    const char* rest = line + len;
+    if (def.form == FORM_BLOCK)
+    {
+        while (IsBlank(*rest))
+            ++rest;
+        return (*rest == '\0') ? def.keyword : KEYWORD_INVALID;
+    }
+    if (!IsBlank(*rest) && !((def.form == FORM_INLINE_TOLERANT) && (*rest == ',')))
+        return KEYWORD_INVALID;
+    return def.keyword;
+}
+
+static void Bench_sol3__PerfectHash(benchmark::State& state)
+{
+    while (state.KeepRunning()) 
+    {
+        int count = sizeof(trucklines)/sizeof(const char*);
+        for (int i = 0; i < count; ++i)
+        {
+            keyword = (int) IdentifyKeywordHash(trucklines[i]);
+        }
+    }
+}
+BENCHMARK(Bench_sol3__PerfectHash);
+
+static void Bench_sol3b_PerfectHashPreCond(benchmark::State& state)
+{
+    while (state.KeepRunning()) 
+    {
+        int count = sizeof(trucklines)/sizeof(const char*);
+        for (int i = 0; i < count; ++i)
+        {
+            // precondition
+            char c = trucklines[i][0];
+            if (! ((c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z')))
+            {
+                keyword = (int) KEYWORD_INVALID;
+                continue;
+            }
+            // precondition
+
+            keyword = (int) IdentifyKeywordHash(trucklines[i]);
+        }
+    }
+}
+BENCHMARK(Bench_sol3b_PerfectHashPreCond);
+
+// ################################# Full file parsing ######################################
+// Keyword identification + tokenizing + number conversion of every argument,
+// over a large vehicle (the example truckfile repeated).
+
+const int LARGE_VEHICLE_REPEAT = 16;
+std::vector<std::string> large_vehicle;
+static double args_sum;
+
+void PrepareBench_FullFile()
+{
+    const int count = sizeof(trucklines)/sizeof(const char*);
+    for (int r = 0; r < LARGE_VEHICLE_REPEAT; ++r)
+    {
+        for (int i = 0; i < count; ++i)
+        {
+            large_vehicle.emplace_back(trucklines[i]);
+        }
+    }
+}
+
+/// Exact decimal conversion (Clinger's fast path), as RigDef::Lexer::ParseReal()
+bool ParseRealFast(const char* str, int len, double& out_value)
+{
+    static const double POW10[] = { 1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9, 1e10, 1e11,
+                                    1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22 };
+    const char* pos = str;
+    const char* end = str + len;
+    bool negative = false;
+    if ((pos != end) && ((*pos == '-') || (*pos == '+')))
+    {
+        negative = (*pos == '-');
+        ++pos;
+    }
+    uint64_t mantissa = 0;
+    int num_digits = 0;
+    int exponent = 0;
+    bool any_digit = false;
+    for (; (pos != end) && IsDigit(*pos); ++pos)
+    {
+        any_digit = true;
+        if ((mantissa == 0) && (*pos == '0'))
+            continue;
+        if (++num_digits > 19)
+            return false;
+        mantissa = (mantissa * 10) + (*pos - '0');
+    }
+    if ((pos != end) && (*pos == '.'))
+    {
+        for (++pos; (pos != end) && IsDigit(*pos); ++pos)
+        {
+            any_digit = true;
+            --exponent;
+            if ((mantissa == 0) && (*pos == '0'))
+                continue;
+            if (++num_digits > 19)
+                return false;
+            mantissa = (mantissa * 10) + (*pos - '0');
+        }
+    }
+    if (!any_digit || (pos != end) || (mantissa > (uint64_t(1) << 53)) || (exponent < -22))
+        return false;
+    const double value = (double) mantissa / POW10[-exponent];
+    out_value = (negative) ? -value : value;
+    return true;
+}
+
+template<bool USE_REGEX>
+void ParseLargeVehicle()
+{
+    std::smatch results;
+    const int count = (int) large_vehicle.size();
+    for (int i = 0; i < count; ++i)
+    {
+        std::string const& line = large_vehicle[i];
+        const char* c_line = line.c_str();
+        const char c = c_line[0]; // Same precondition as RigDef::Parser
+        if (! ((c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z')))
+        {
+            keyword = (int) KEYWORD_INVALID;
+        }
+        else if (USE_REGEX)
+        {
+            std::regex_search(line, results, IDENTIFY_KEYWORD_IGNORE_CASE);
+            keyword = FindKeywordMatch(results);
+        }
+        else
+        {
+            keyword = (int) IdentifyKeywordHash(c_line);
+        }
+
+        // Tokenize like RigDef::Parser::TokenizeCurrentLine() and convert each argument
+        const char* pos = c_line;
+        while (*pos != '\0')
+        {
+            while ((*pos == ',') || IsBlank(*pos) || (*pos == ':') || (*pos == '|'))
+                ++pos;
+            const char* start = pos;
+            while ((*pos != '\0') && (*pos != ',') && !IsBlank(*pos) && (*pos != ':') && (*pos != '|'))
+                ++pos;
+            const int len = (int) (pos - start);
+            if (len == 0)
+                continue;
+
+            double value = 0.0;
+            if (USE_REGEX || !ParseRealFast(start, len, value))
+            {
+                std::string arg(start, len); // The regex path also copied each argument out
+                value = strtod(arg.c_str(), nullptr);
+            }
+            args_sum += value;
+        }
+    }
+}
+
+static void Bench_FullFile_RegexStrtod(benchmark::State& state)
+{
+    while (state.KeepRunning()) 
+    {
+        ParseLargeVehicle<true>();
+    }
+    state.SetItemsProcessed(state.iterations() * large_vehicle.size());
+}
+BENCHMARK(Bench_FullFile_RegexStrtod)->Unit(benchmark::kMillisecond);
+
+static void Bench_FullFile_Lexer(benchmark::State& state)
+{
+    while (state.KeepRunning()) 
+    {
+        ParseLargeVehicle<false>();
+    }
+    state.SetItemsProcessed(state.iterations() * large_vehicle.size());
+}
+BENCHMARK(Bench_FullFile_Lexer)->Unit(benchmark::kMillisecond);
+
 int main(int argc, char** argv)
 {
     using namespace std;
@@ -1848,6 +2123,7 @@ int main(int argc, char** argv)
     // prepare
     cout << "Preparing..." << endl;
     PrepareBench_sol1();
+    PrepareBench_FullFile();
 
 
     // benchmark
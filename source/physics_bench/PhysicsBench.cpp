@@ -0,0 +1,402 @@
+/*
+    This source file is part of Rigs of Rods
+    Copyright 2013-2017 Petr Ohlidal & contributors
+
+    For more information, see http://www.rigsofrods.org/
+
+    Rigs of Rods is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License version 3, as
+    published by the Free Software Foundation.
+
+    Rigs of Rods is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with Rigs of Rods. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+/// @file
+/// @brief RoRPhysicsBench - headless benchmark of the physics core.
+///
+/// Builds without a render system, only the simulator's physics core is compiled in: the BeamSoA
+/// spring kernel, primitiveCollision() and the ThreadPool, on a flat IHeightFinder. Synthetic trucks
+/// (box lattices of nodes and beams) drop onto the terrain and slide on it; the steps are threaded
+/// like BeamFactory's physics job - trucks in parallel, springs split into chunks while there are
+/// fewer trucks than threads.
+///
+/// Not covered (they need a spawned Beam): shocks, hydros, wheels, engine, deformation, inter-truck
+/// collisions. For those, run the full game with `-benchphysics` (see RoR::PhysicsBenchmark).
+///
+/// Usage: `RoRPhysicsBench [-trucks 4] [-size 8,4,20] [-seconds 10] [-threads 0,2,4]`
+/// Size is nodes per truck along X,Y,Z. Thread pool size 0 runs everything on the calling thread.
+
+#include "ApproxMath.h"
+#include "BeamData.h"
+#include "BeamSoA.h"
+#include "IHeightFinder.h"
+#include "PrimitiveCollision.h"
+#include "ThreadPool.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <limits>
+#include <memory>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+
+using namespace Ogre;
+using namespace RoR;
+
+namespace {
+
+const float PHYSICS_STEP          = 0.0005f; //!< Same as PHYSICS_DT, see BeamFactory.h
+const int   STEPS_PER_FRAME       = 33;      //!< Physics steps per frame, as in a 60 FPS frame
+const float WARMUP_SECONDS        = 0.5f;    //!< Simulated time before measuring
+const int   MIN_BEAMS_PER_CHUNK   = 512;     //!< Same as INTRA_TRUCK_MIN_BEAMS_PER_CHUNK, see BeamForcesEuler.cpp
+const float NODE_SPACING          = 0.5f;    //!< Meters between neighbouring lattice nodes
+const float NODE_MASS             = 50.f;
+const float TRUCK_GAP             = 5.f;     //!< Meters between trucks
+const float DROP_HEIGHT           = 0.5f;
+const float INITIAL_SPEED         = 10.f;    //!< m/s along Z, so the trucks slide on the ground
+
+/// Flat terrain at height 0
+class FlatHeightFinder : public IHeightFinder
+{
+public:
+    float getHeightAt(float x, float z) override
+    {
+        return 0.0f;
+    }
+
+    Vector3 getNormalAt(float x, float y, float z, float precision) override
+    {
+        return Vector3::UNIT_Y;
+    }
+
+    void getHeightsAt(int count, const float* x, const float* z, float* heights) override
+    {
+        std::fill(heights, heights + count, 0.0f);
+    }
+};
+
+struct BenchTruck
+{
+    std::vector<node_t> nodes;
+    std::vector<beam_t> beams; //!< Reference `nodes`, so trucks aren't copied
+    BeamSoA             beams_soa;
+    ground_batch_t      ground_batch;
+};
+
+struct BenchConfig
+{
+    int              num_trucks = 4;
+    int              size[3] = { 8, 4, 20 };
+    float            sim_seconds = 10.f;
+    std::vector<int> thread_counts;
+};
+
+/// Box lattice of nodes, braced like a truss: every node is connected to its neighbours along
+/// the axes and the face diagonals (no body diagonals; that many beams per node would be too stiff
+/// for the integrator at 50 kg nodes, unlike real trucks)
+void BuildTruck(BenchTruck& truck, int index, BenchConfig const& config)
+{
+    const int sx = config.size[0];
+    const int sy = config.size[1];
+    const int sz = config.size[2];
+    const float offset_x = index * ((sx - 1) * NODE_SPACING + TRUCK_GAP);
+
+    truck.nodes.resize(sx * sy * sz);
+    for (int x = 0; x < sx; x++)
+    {
+        for (int y = 0; y < sy; y++)
+        {
+            for (int z = 0; z < sz; z++)
+            {
+                const int i = (x * sy + y) * sz + z;
+                node_t& node = truck.nodes[i];
+                memset(&node, 0, sizeof(node_t));
+                node.RelPosition = Vector3(offset_x + x * NODE_SPACING, DROP_HEIGHT + y * NODE_SPACING, z * NODE_SPACING);
+                node.AbsPosition = node.RelPosition;
+                node.Velocity = Vector3(0.f, 0.f, INITIAL_SPEED);
+                node.Forces = Vector3(0.f, NODE_MASS * DEFAULT_GRAVITY, 0.f);
+                node.mass = NODE_MASS;
+                node.friction_coef = 1.f;
+                node.surface_coef = 1.f;
+                node.volume_coef = 1.f;
+                node.wheelid = -1;
+                node.pos = static_cast<short>(i);
+                node.id = static_cast<short>(i);
+            }
+        }
+    }
+
+    truck.beams.clear();
+    for (int x = 0; x < sx; x++)
+    {
+        for (int y = 0; y < sy; y++)
+        {
+            for (int z = 0; z < sz; z++)
+            {
+                // Each pair once: only neighbours which come later in the lattice order
+                for (int n = 14; n < 27; n++)
+                {
+                    const int nx = x + n / 9 - 1;
+                    const int ny = y + (n / 3) % 3 - 1;
+                    const int nz = z + n % 3 - 1;
+                    if (nx < 0 || ny < 0 || nz < 0 || nx >= sx || ny >= sy || nz >= sz)
+                        continue;
+                    if (nx != x && ny != y && nz != z)
+                        continue; // Body diagonal
+
+                    beam_t beam;
+                    memset(&beam, 0, sizeof(beam_t));
+                    beam.p1 = &truck.nodes[(x * sy + y) * sz + z];
+                    beam.p2 = &truck.nodes[(nx * sy + ny) * sz + nz];
+                    beam.k = DEFAULT_SPRING;
+                    beam.d = DEFAULT_DAMP;
+                    beam.L = beam.p1->RelPosition.distance(beam.p2->RelPosition);
+                    beam.refL = beam.L;
+                    beam.type = BEAM_NORMAL;
+                    beam.bounded = NOSHOCK;
+                    // No deformation; the kernel never hands a beam back to the (not present) scalar path
+                    beam.minmaxposnegstress = std::numeric_limits<float>::max();
+                    beam.maxposstress = std::numeric_limits<float>::max();
+                    beam.maxnegstress = -std::numeric_limits<float>::max();
+                    beam.strength = std::numeric_limits<float>::max();
+                    truck.beams.push_back(beam);
+                }
+            }
+        }
+    }
+
+    truck.beams_soa.Build(truck.beams.data(), static_cast<int>(truck.beams.size()), truck.nodes.data());
+}
+
+/// One physics step of a truck; the parts of Beam::calcForcesEulerCompute() which don't need a spawned truck
+void StepTruck(BenchTruck& truck, ThreadPool& pool, int num_chunks, IHeightFinder& terrain, ground_model_t& gm)
+{
+    node_t* nodes = truck.nodes.data();
+    const int num_nodes = static_cast<int>(truck.nodes.size());
+
+    // Springs, see Beam::calcBeams()
+    BeamSoA& soa = truck.beams_soa;
+    soa.GatherNodes(nodes, num_nodes);
+    if (num_chunks > 1)
+    {
+        soa.PrepareChunks(num_chunks);
+        pool.ParallelFor(0, num_chunks, 1, [&soa](int c) { soa.CalcSpringsChunk(c); });
+        soa.ReduceChunks();
+    }
+    else
+    {
+        soa.CalcSprings();
+    }
+    soa.ScatterForces(nodes, num_nodes);
+
+    // Ground contacts, see Beam::calcNodesRange() and Collisions::groundCollisionBatch()
+    ground_batch_t& batch = truck.ground_batch;
+    batch.clear();
+    for (int i = 0; i < num_nodes; i++)
+    {
+        batch.add(i, nodes[i].AbsPosition);
+    }
+    batch.height.resize(batch.size());
+    batch.normal.resize(batch.size());
+    batch.contacts.clear();
+    terrain.getHeightsAt(batch.size(), batch.x.data(), batch.z.data(), batch.height.data());
+    for (int k = 0; k < batch.size(); k++)
+    {
+        if (batch.height[k] > batch.y[k])
+            batch.contacts.push_back(k);
+    }
+    if (!batch.contacts.empty())
+    {
+        terrain.getNormalsAt(static_cast<int>(batch.contacts.size()), batch.contacts.data(),
+            batch.x.data(), batch.height.data(), batch.z.data(), batch.normal.data());
+    }
+    for (int k : batch.contacts)
+    {
+        node_t& node = nodes[batch.node_ids[k]];
+        float ns = 0.f;
+        primitiveCollision(&node, node.Forces, node.Velocity, batch.normal[k], PHYSICS_STEP, &gm, &ns, batch.height[k] - node.AbsPosition.y);
+    }
+
+    // Integration, then gravity and air drag for the next step
+    for (int i = 0; i < num_nodes; i++)
+    {
+        node_t& node = nodes[i];
+        node.Velocity += node.Forces / node.mass * PHYSICS_STEP;
+        node.RelPosition += node.Velocity * PHYSICS_STEP;
+        node.AbsPosition = node.RelPosition;
+
+        node.Forces = Vector3(0.f, node.mass * DEFAULT_GRAVITY, 0.f);
+        const float speed = approx_sqrt(node.Velocity.squaredLength());
+        node.Forces -= (DEFAULT_DRAG * speed) * node.Velocity;
+    }
+}
+
+/// Values of the "gravel" ground model from ground_models.cfg, which is the default for terrain contacts
+ground_model_t MakeGroundModel()
+{
+    ground_model_t gm;
+    memset(&gm, 0, sizeof(ground_model_t));
+    gm.va = 3.0f;
+    gm.ms = 0.85f;
+    gm.mc = 0.6f;
+    gm.t2 = 0.006f;
+    gm.vs = 3.0f;
+    gm.alpha = 2.0f;
+    gm.strength = 1.0f;
+    gm.flow_behavior_index = 1.0f;
+    strncpy(gm.name, "gravel", 255);
+    return gm;
+}
+
+void Report(const char* line)
+{
+    printf("%s\n", line);
+    fflush(stdout);
+}
+
+void RunOnce(BenchConfig const& config, ThreadPool& pool, int num_threads)
+{
+    pool.SetNumActiveThreads(num_threads);
+
+    std::vector<std::unique_ptr<BenchTruck>> trucks;
+    for (int t = 0; t < config.num_trucks; t++)
+    {
+        trucks.emplace_back(new BenchTruck());
+        BuildTruck(*trucks.back(), t, config);
+    }
+    FlatHeightFinder terrain;
+    ground_model_t gm = MakeGroundModel();
+
+    // While there are fewer trucks than threads, split the springs as well (see BeamFactory::RunPhysicsJob())
+    int num_chunks = 1;
+    if (config.num_trucks <= num_threads)
+    {
+        const int num_beams = static_cast<int>(trucks[0]->beams_soa.GetNumBeams());
+        num_chunks = std::max(1, std::min(num_threads + 1, num_beams / MIN_BEAMS_PER_CHUNK));
+    }
+
+    auto step = [&](int t) { StepTruck(*trucks[t], pool, num_chunks, terrain, gm); };
+    const int warmup_steps = static_cast<int>(WARMUP_SECONDS / PHYSICS_STEP);
+    for (int i = 0; i < warmup_steps; i++)
+    {
+        pool.ParallelFor(0, config.num_trucks, 1, step);
+    }
+
+    const int num_steps = static_cast<int>(config.sim_seconds / PHYSICS_STEP);
+    int steps_done = 0;
+    const auto start = std::chrono::steady_clock::now();
+    while (steps_done < num_steps)
+    {
+        for (int i = 0; i < STEPS_PER_FRAME; i++)
+        {
+            pool.ParallelFor(0, config.num_trucks, 1, step);
+        }
+        steps_done += STEPS_PER_FRAME;
+    }
+    const std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+    const double steps_per_second = (elapsed.count() > 0.0) ? (steps_done / elapsed.count()) : 0.0;
+
+    // Sanity check: the trucks should rest on the ground (lowest node ~0 m), not sink or explode
+    float min_y = std::numeric_limits<float>::max();
+    float max_y = -std::numeric_limits<float>::max();
+    for (auto& truck : trucks)
+    {
+        for (node_t const& node : truck->nodes)
+        {
+            min_y = std::min(min_y, node.AbsPosition.y);
+            max_y = std::max(max_y, node.AbsPosition.y);
+        }
+    }
+
+    char line[300];
+    snprintf(line, sizeof(line), "[RoR|PhysicsBench] threads: %2d | chunks: %2d | steps: %7d | wall time: %8.3fs | steps/s: %10.1f | realtime factor: %6.2fx | node height: %.3f..%.3fm",
+        num_threads, num_chunks, steps_done, elapsed.count(), steps_per_second, steps_per_second * PHYSICS_STEP, min_y, max_y);
+    Report(line);
+}
+
+bool ParseArgs(int argc, char** argv, BenchConfig& config)
+{
+    for (int i = 1; i < argc; i++)
+    {
+        const std::string arg = argv[i];
+        const char* value = (i + 1 < argc) ? argv[i + 1] : nullptr;
+        if (!value)
+            return false;
+
+        if (arg == "-trucks")
+        {
+            config.num_trucks = std::max(1, atoi(value));
+        }
+        else if (arg == "-seconds")
+        {
+            config.sim_seconds = std::max(0.f, static_cast<float>(atof(value)));
+        }
+        else if (arg == "-size")
+        {
+            if (sscanf(value, "%d,%d,%d", &config.size[0], &config.size[1], &config.size[2]) != 3)
+                return false;
+            for (int& s : config.size)
+                s = std::max(2, s);
+        }
+        else if (arg == "-threads")
+        {
+            std::istringstream stream(value);
+            std::string token;
+            while (std::getline(stream, token, ','))
+            {
+                if (!token.empty())
+                    config.thread_counts.push_back(std::max(0, atoi(token.c_str())));
+            }
+        }
+        else
+        {
+            return false;
+        }
+        i++;
+    }
+    return true;
+}
+
+} // namespace
+
+int main(int argc, char** argv)
+{
+    BenchConfig config;
+    if (!ParseArgs(argc, argv, config))
+    {
+        printf("Usage: %s [-trucks 4] [-size 8,4,20] [-seconds 10] [-threads 0,2,4]\n", argv[0]);
+        return 1;
+    }
+    if (config.thread_counts.empty())
+    {
+        config.thread_counts.push_back(0);
+        config.thread_counts.push_back(std::max(1, static_cast<int>(std::thread::hardware_concurrency()) - 1));
+    }
+
+    const int max_threads = *std::max_element(config.thread_counts.begin(), config.thread_counts.end());
+    ThreadPool pool(std::max(1, max_threads));
+
+    BenchTruck sample;
+    BuildTruck(sample, 0, config);
+    char line[200];
+    snprintf(line, sizeof(line), "[RoR|PhysicsBench] %d truck(s), %d nodes, %d beams each; %.1fs simulated time per run",
+        config.num_trucks, static_cast<int>(sample.nodes.size()), static_cast<int>(sample.beams.size()), config.sim_seconds);
+    Report(line);
+
+    for (int num_threads : config.thread_counts)
+    {
+        RunOnce(config, pool, num_threads);
+    }
+    return 0;
+}